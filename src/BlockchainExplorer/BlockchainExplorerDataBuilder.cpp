@@ -183,9 +183,14 @@ bool BlockchainExplorerDataBuilder::fillBlockDetails(const Block &block, BlockDe
 
   blockDetails.totalFeeAmount = 0;
 
+  // main chain transactions are found in the order the block lists them, pool ones of an orphan may not be
+  auto txHash = block.transactionHashes.begin();
   for (const Transaction& tx : found) {
     TransactionDetails transactionDetails;
-    if (!fillTransactionDetails(tx, transactionDetails, block.timestamp)) {
+    bool filled = blockDetails.isOrphaned ?
+      fillTransactionDetails(tx, transactionDetails, block.timestamp) :
+      fillTransactionDetails(tx, *txHash++, transactionDetails, block.timestamp);
+    if (!filled) {
       return false;
     }
     blockDetails.transactions.push_back(std::move(transactionDetails));
@@ -195,7 +200,10 @@ bool BlockchainExplorerDataBuilder::fillBlockDetails(const Block &block, BlockDe
 }
 
 bool BlockchainExplorerDataBuilder::fillTransactionDetails(const Transaction& transaction, TransactionDetails& transactionDetails, uint64_t timestamp) {
-  Crypto::Hash hash = getObjectHash(transaction);
+  return fillTransactionDetails(transaction, getObjectHash(transaction), transactionDetails, timestamp);
+}
+
+bool BlockchainExplorerDataBuilder::fillTransactionDetails(const Transaction& transaction, const Crypto::Hash& hash, TransactionDetails& transactionDetails, uint64_t timestamp) {
   transactionDetails.hash = hash;
 
   transactionDetails.timestamp = timestamp;
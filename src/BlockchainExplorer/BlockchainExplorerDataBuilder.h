@@ -38,6 +38,7 @@ public:
 
   bool fillBlockDetails(const Block& block, BlockDetails& blockDetails);
   bool fillTransactionDetails(const Transaction &tx, TransactionDetails& txRpcInfo, uint64_t timestamp = 0);
+  bool fillTransactionDetails(const Transaction &tx, const Crypto::Hash& txHash, TransactionDetails& txRpcInfo, uint64_t timestamp = 0);
 
   static bool getPaymentId(const Transaction& transaction, Crypto::Hash& paymentId);
 
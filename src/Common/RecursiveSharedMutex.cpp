@@ -0,0 +1,99 @@
+// Copyright (c) 2017-2022 Fuego Developers
+// Copyright (c) 2016-2019 The Karbowanec developers
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Copyright (c) 2012-2018 The CryptoNote developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free & open source software distributed in the hope that
+// it will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You may redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#include "RecursiveSharedMutex.h"
+
+#include <cassert>
+#include <stdexcept>
+
+namespace Tools {
+
+RecursiveSharedMutex::RecursiveSharedMutex() : m_ownerDepth(0), m_waitingWriters(0) {
+}
+
+void RecursiveSharedMutex::lock() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  std::thread::id self = std::this_thread::get_id();
+  if (m_ownerDepth != 0 && m_owner == self) {
+    ++m_ownerDepth;
+    return;
+  }
+
+  if (m_readers.count(self) != 0) {
+    throw std::logic_error("RecursiveSharedMutex: cannot lock exclusively while owning shared");
+  }
+
+  ++m_waitingWriters;
+  m_released.wait(lock, [this] { return m_ownerDepth == 0 && m_readers.empty(); });
+  --m_waitingWriters;
+  m_owner = self;
+  m_ownerDepth = 1;
+}
+
+void RecursiveSharedMutex::unlock() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  assert(m_ownerDepth != 0 && m_owner == std::this_thread::get_id());
+  if (--m_ownerDepth == 0) {
+    m_owner = std::thread::id();
+    lock.unlock();
+    m_released.notify_all();
+  }
+}
+
+void RecursiveSharedMutex::lock_shared() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  std::thread::id self = std::this_thread::get_id();
+  if (m_ownerDepth != 0 && m_owner == self) {
+    ++m_ownerDepth;
+    return;
+  }
+
+  auto reader = m_readers.find(self);
+  if (reader != m_readers.end()) {
+    ++reader->second;
+    return;
+  }
+
+  m_released.wait(lock, [this] { return m_ownerDepth == 0 && m_waitingWriters == 0; });
+  m_readers.emplace(self, 1);
+}
+
+void RecursiveSharedMutex::unlock_shared() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  std::thread::id self = std::this_thread::get_id();
+  if (m_ownerDepth != 0 && m_owner == self) {
+    if (--m_ownerDepth == 0) {
+      m_owner = std::thread::id();
+      lock.unlock();
+      m_released.notify_all();
+    }
+
+    return;
+  }
+
+  auto reader = m_readers.find(self);
+  assert(reader != m_readers.end());
+  if (--reader->second == 0) {
+    m_readers.erase(reader);
+    if (m_readers.empty()) {
+      lock.unlock();
+      m_released.notify_all();
+    }
+  }
+}
+
+}
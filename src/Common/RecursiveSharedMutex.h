@@ -0,0 +1,55 @@
+// Copyright (c) 2017-2022 Fuego Developers
+// Copyright (c) 2016-2019 The Karbowanec developers
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Copyright (c) 2012-2018 The CryptoNote developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free & open source software distributed in the hope that
+// it will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You may redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace Tools {
+
+// Shared/exclusive mutex in which both kinds of ownership are recursive: a thread may
+// re-lock shared while it owns the mutex shared or exclusively, and may re-lock
+// exclusively while it owns it exclusively. Upgrading from shared to exclusive is not
+// supported and throws std::logic_error. Waiting writers block new readers, but not
+// a thread re-locking a mutex it already owns, so recursion never waits on a writer.
+// Ownership is per thread: code holding the mutex must not wait for another thread
+// (a pool task, say) that locks it too, as that thread blocks once a writer queues.
+class RecursiveSharedMutex {
+public:
+  RecursiveSharedMutex();
+  RecursiveSharedMutex(const RecursiveSharedMutex&) = delete;
+  RecursiveSharedMutex& operator=(const RecursiveSharedMutex&) = delete;
+
+  void lock();
+  void unlock();
+  void lock_shared();
+  void unlock_shared();
+
+private:
+  std::mutex m_mutex;
+  std::condition_variable m_released;
+  std::thread::id m_owner;
+  size_t m_ownerDepth;
+  size_t m_waitingWriters;
+  std::unordered_map<std::thread::id, size_t> m_readers;
+};
+
+}
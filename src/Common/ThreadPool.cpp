@@ -0,0 +1,129 @@
+// Copyright (c) 2017-2022 Fuego Developers
+// Copyright (c) 2016-2019 The Karbowanec developers
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Copyright (c) 2012-2018 The CryptoNote developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free & open source software distributed in the hope that
+// it will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You may redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+
+namespace Tools {
+
+ThreadPool::ThreadPool(size_t threadCount) : m_queue(std::numeric_limits<size_t>::max()) {
+  threadCount = std::max<size_t>(threadCount, 1);
+  m_threads.reserve(threadCount);
+  for (size_t i = 0; i < threadCount; ++i) {
+    m_threads.emplace_back(&ThreadPool::workerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  m_queue.close();
+  for (auto& thread : m_threads) {
+    thread.join();
+  }
+}
+
+size_t ThreadPool::size() const {
+  return m_threads.size();
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& func) {
+  if (count == 0) {
+    return;
+  }
+
+  // Helpers that have not started by the time the caller runs out of indices are
+  // skipped rather than waited for, so a worker calling parallelFor never blocks on
+  // tasks queued behind itself.
+  struct State {
+    std::atomic<size_t> next;
+    size_t count;
+    const std::function<void(size_t)>* func;
+    std::mutex mutex;
+    std::condition_variable finished;
+    size_t running;
+    bool closed;
+    std::exception_ptr error;
+
+    void run() {
+      try {
+        for (size_t i = next++; i < count; i = next++) {
+          (*func)(i);
+        }
+      } catch (...) {
+        next = count;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+      }
+    }
+  };
+
+  auto state = std::make_shared<State>();
+  state->next = 0;
+  state->count = count;
+  state->func = &func;
+  state->running = 0;
+  state->closed = false;
+
+  size_t helperCount = std::min(m_threads.size(), count - 1);
+  for (size_t i = 0; i < helperCount; ++i) {
+    bool pushed = m_queue.push([state] {
+      {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (state->closed) {
+          return;
+        }
+
+        ++state->running;
+      }
+
+      state->run();
+
+      std::lock_guard<std::mutex> lock(state->mutex);
+      if (--state->running == 0) {
+        state->finished.notify_all();
+      }
+    });
+
+    if (!pushed) {
+      break;
+    }
+  }
+
+  state->run();
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->closed = true;
+  state->finished.wait(lock, [&state] { return state->running == 0; });
+  if (state->error) {
+    std::rethrow_exception(state->error);
+  }
+}
+
+void ThreadPool::workerLoop() {
+  std::function<void()> task;
+  while (m_queue.pop(task)) {
+    task();
+  }
+}
+
+}
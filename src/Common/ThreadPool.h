@@ -0,0 +1,68 @@
+// Copyright (c) 2017-2022 Fuego Developers
+// Copyright (c) 2016-2019 The Karbowanec developers
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Copyright (c) 2012-2018 The CryptoNote developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free & open source software distributed in the hope that
+// it will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You may redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "BlockingQueue.h"
+
+namespace Tools {
+
+// Fixed set of worker threads fed from a single queue. Used to fan CPU-bound work
+// (signature checks, hashing, decoding) out over all cores and to wait for it.
+class ThreadPool {
+public:
+  explicit ThreadPool(size_t threadCount = std::thread::hardware_concurrency());
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  ~ThreadPool();
+
+  size_t size() const;
+
+  template<class F>
+  std::future<typename std::result_of<F()>::type> submit(F&& func) {
+    typedef typename std::result_of<F()>::type ResultType;
+    auto task = std::make_shared<std::packaged_task<ResultType()>>(std::forward<F>(func));
+    std::future<ResultType> result = task->get_future();
+    if (!m_queue.push([task] { (*task)(); })) {
+      throw std::runtime_error("ThreadPool::submit: pool is stopped");
+    }
+
+    return result;
+  }
+
+  // Calls func(i) for every i in [0, count) on the workers and the calling thread and
+  // returns once all calls are done. The first exception thrown by func is rethrown.
+  // May be called from a worker of the same pool.
+  void parallelFor(size_t count, const std::function<void(size_t)>& func);
+
+private:
+  BlockingQueue<std::function<void()>> m_queue;
+  std::vector<std::thread> m_threads;
+
+  void workerLoop();
+};
+
+}
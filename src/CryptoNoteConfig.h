@@ -104,6 +104,8 @@ namespace CryptoNote
 		const uint64_t CRYPTONOTE_MEMPOOL_TX_LIVETIME = (60 * 60 * 12);					/* 1 hour in seconds */
 		const uint64_t CRYPTONOTE_MEMPOOL_TX_FROM_ALT_BLOCK_LIVETIME = (60 * 60 * 12);	/* 24 hours in seconds */
 		const uint64_t CRYPTONOTE_NUMBER_OF_PERIODS_TO_FORGET_TX_DELETED_FROM_POOL = 7; /* CRYPTONOTE_NUMBER_OF_PERIODS_TO_FORGET_TX_DELETED_FROM_POOL * CRYPTONOTE_MEMPOOL_TX_LIVETIME  = time to forget tx */
+		const uint64_t CRYPTONOTE_MEMPOOL_MAX_SIZE = 256 * 1024 * 1024;					/* bytes of transactions, lowest fee rate ones are dropped beyond it */
+		const uint64_t CRYPTONOTE_MEMPOOL_FAILED_CHECK_LIVETIME = 30;					/* seconds a failed readiness check of a pool transaction is reused for */
 
 		const size_t FUSION_TX_MAX_SIZE = CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE * 30 / 100;
 		const size_t FUSION_TX_MIN_INPUT_COUNT = 12;
@@ -127,7 +129,11 @@ namespace CryptoNote
 		const char CRYPTONOTE_BLOCKS_FILENAME[] = "blocks.dat";
  		const char CRYPTONOTE_BLOCKINDEXES_FILENAME[] = "blockindexes.dat";
  		const char CRYPTONOTE_BLOCKSCACHE_FILENAME[] = "blockscache.dat";
+ 		const char CRYPTONOTE_BLOCKHEADERS_FILENAME[] = "blockheaders.dat";
+ 		const char CRYPTONOTE_BLOCKLAYOUTS_FILENAME[] = "blocklayouts.dat";
+ 		const char CRYPTONOTE_BLOCKSCACHE_JOURNAL_FILENAME[] = "blockscache.journal";
  		const char CRYPTONOTE_POOLDATA_FILENAME[] = "poolstate.bin";
+ 		const char CRYPTONOTE_POOLDATA_JOURNAL_FILENAME[] = "poolstate.journal";
  		const char P2P_NET_DATA_FILENAME[] = "p2pstate.bin";
  		const char CRYPTONOTE_BLOCKCHAIN_INDICES_FILENAME[] = "blockchainindices.dat";
  		const char MINER_CONFIG_FILE_NAME[] = "miner_conf.json";
@@ -153,6 +159,9 @@ namespace CryptoNote
 
 	const size_t BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT = 10000; // by default, blocks ids count in synchronizing
 	const size_t BLOCKS_SYNCHRONIZING_DEFAULT_COUNT = 128;		 // by default, blocks count in blocks downloading
+	const size_t BLOCKS_SYNCHRONIZING_MAX_PENDING_SPANS = 32;	 // downloaded block spans buffered ahead of the chain tip
+	const uint32_t BLOCKS_SYNCHRONIZING_PENDING_SPAN_TIMEOUT = 180; // seconds a buffered span may wait for its parent before it is dropped
+	const uint32_t BLOCKS_SYNCHRONIZING_REQUEST_TIMEOUT = 60;	 // seconds before blocks requested from a silent peer may be requested elsewhere
 	const size_t COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT = 1000;
 
 	const int P2P_DEFAULT_PORT = 10808;
@@ -23,6 +23,8 @@
 #include <numeric>
 #include <cstdio>
 #include <cmath>
+#include <fstream>
+#include <boost/filesystem.hpp>
 #include <boost/foreach.hpp>
 #include "Common/Math.h"
 #include "Common/int-util.h"
@@ -30,6 +32,7 @@
 #include "Common/StdInputStream.h"
 #include "Common/StdOutputStream.h"
 #include "Rpc/CoreRpcServerCommandsDefinitions.h"
+#include "Serialization/BinaryCountingSerializer.h"
 #include "Serialization/BinarySerializationTools.h"
 #include "CryptoNoteTools.h"
 #include "TransactionExtra.h"
@@ -51,6 +54,46 @@ std::string appendPath(const std::string& path, const std::string& fileName) {
   return result;
 }
 
+// Number of blocks decoded in parallel before they are merged into the cache by rebuildCache.
+const uint32_t CACHE_REBUILD_BATCH_SIZE = 4096;
+
+// Precomputed proof of work hashes for blocks that never reach addNewBlock are dropped past this size.
+const size_t PRECOMPUTED_PROOF_OF_WORK_MAX_COUNT = 16384;
+
+// Records of the blockchain cache journal, each followed by the block's Blockchain::BlockCacheChange.
+// removeLastBlock leaves the deposit index alone, unlike popBlock, and is journaled apart.
+const uint8_t CACHE_JOURNAL_BLOCK_PUSHED = 1;
+const uint8_t CACHE_JOURNAL_BLOCK_POPPED = 2;
+const uint8_t CACHE_JOURNAL_BLOCK_REMOVED = 3;
+
+// Autosave sets the journal aside under this suffix until the cache it folds into is saved.
+const char CACHE_JOURNAL_PREVIOUS_SUFFIX[] = ".prev";
+// Cache files are written under this suffix and renamed into place once complete.
+const char CACHE_TEMP_SUFFIX[] = ".tmp";
+
+int64_t getDepositChange(const CryptoNote::Transaction& transaction) {
+  int64_t deposit = 0;
+  for (const auto& in : transaction.inputs) {
+    if (in.type() == typeid(CryptoNote::MultisignatureInput)) {
+      auto& multisign = boost::get<CryptoNote::MultisignatureInput>(in);
+      if (multisign.term > 0) {
+        deposit -= multisign.amount;
+      }
+    }
+  }
+
+  for (const auto& out : transaction.outputs) {
+    if (out.target.type() == typeid(CryptoNote::MultisignatureOutput)) {
+      auto& multisign = boost::get<CryptoNote::MultisignatureOutput>(out.target);
+      if (multisign.term > 0) {
+        deposit += out.amount;
+      }
+    }
+  }
+
+  return deposit;
+}
+
 }
 
 namespace std {
@@ -65,6 +108,8 @@ bool operator<(const Crypto::KeyImage& keyImage1, const Crypto::KeyImage& keyIma
 
 #define CURRENT_BLOCKCACHE_STORAGE_ARCHIVE_VER 4
 #define CURRENT_BLOCKCHAININDICES_STORAGE_ARCHIVE_VER 1
+#define CURRENT_BLOCKHEADERS_STORAGE_VER 2
+#define CURRENT_BLOCKCACHE_JOURNAL_VER 2
 
 namespace CryptoNote {
 class BlockCacheSerializer;
@@ -134,8 +179,8 @@ void serialize(Blockchain::TransactionIndex& value, ISerializer& s) {
 class BlockCacheSerializer {
 
 public:
-  BlockCacheSerializer(Blockchain& bs, const Crypto::Hash lastBlockHash, ILogger& logger) :
-    m_bs(bs), m_lastBlockHash(lastBlockHash), m_loaded(false), logger(logger, "BlockCacheSerializer") {
+  BlockCacheSerializer(const Blockchain::BlockCacheState& cache, const std::string& folder, const Crypto::Hash lastBlockHash, ILogger& logger) :
+    m_cache(cache), m_folder(folder), m_lastBlockHash(lastBlockHash), m_loaded(false), logger(logger, "BlockCacheSerializer") {
   }
 
   void load(const std::string& filename) {
@@ -153,23 +198,6 @@ public:
     }
   }
 
-  bool save(const std::string& filename) {
-    try {
-      std::ofstream file(filename, std::ios::binary);
-      if (!file) {
-        return false;
-      }
-
-      StdOutputStream stream(file);
-      BinaryOutputStreamSerializer s(stream);
-      CryptoNote::serialize(*this, s);
-    } catch (std::exception&) {
-      return false;
-    }
-
-    return true;
-  }
-
   void serialize(ISerializer& s) {
     auto start = std::chrono::steady_clock::now();
 
@@ -184,12 +212,8 @@ public:
     std::string operation;
     if (s.type() == ISerializer::INPUT) {
       operation = "- loading ";
-      Crypto::Hash blockHash;
-      s(blockHash, "last_block");
-
-      if (blockHash != m_lastBlockHash) {
-        return;
-      }
+      // the cache may be behind or off the current chain, Blockchain::init brings it up to date
+      s(m_lastBlockHash, "last_block");
 
     } else {
       operation = "- saving ";
@@ -197,40 +221,28 @@ public:
     }
 
     logger(INFO) << operation << "block index...";
-    s(m_bs.m_blockIndex, "block_index");
+    s(m_cache.blockIndex, "block_index");
 
-      logger(INFO) << operation << "transaction map";
+      // on save both are dumped straight from the maps by Blockchain::writeCacheFiles
       if (s.type() == ISerializer::INPUT)
       {
-        phmap::BinaryInputArchive ar_in(appendPath(m_bs.m_config_folder, "transactionsmap.dat").c_str());
-        m_bs.m_transactionMap.load(ar_in);
-      }
-      else
-      {
-        phmap::BinaryOutputArchive ar_out(appendPath(m_bs.m_config_folder, "transactionsmap.dat").c_str());
-        m_bs.m_transactionMap.dump(ar_out);
-      }
+        logger(INFO) << operation << "transaction map";
+        phmap::BinaryInputArchive ar_in(appendPath(m_folder, "transactionsmap.dat").c_str());
+        m_cache.transactionMap.load(ar_in);
 
-      logger(INFO) << operation << "spent keys";
-      if (s.type() == ISerializer::INPUT)
-      {
-        phmap::BinaryInputArchive ar_in(appendPath(m_bs.m_config_folder, "spentkeys.dat").c_str());
-        m_bs.m_spent_keys.load(ar_in);
-      }
-      else
-      {
-        phmap::BinaryOutputArchive ar_out(appendPath(m_bs.m_config_folder, "spentkeys.dat").c_str());
-        m_bs.m_spent_keys.dump(ar_out);
+        logger(INFO) << operation << "spent keys";
+        phmap::BinaryInputArchive ar_keys(appendPath(m_folder, "spentkeys.dat").c_str());
+        m_cache.spentKeys.load(ar_keys);
       }
 
       logger(INFO) << operation << "outputs";
-      s(m_bs.m_outputs, "outputs");
+      s(m_cache.outputs, "outputs");
 
       logger(INFO) << operation << "multi-signature outputs";
-      s(m_bs.m_multisignatureOutputs, "multisig_outputs");
+      s(m_cache.multisignatureOutputs, "multisig_outputs");
 
       logger(INFO) << operation << "deposit index";
-      s(m_bs.m_depositIndex, "deposit_index");
+      s(m_cache.depositIndex, "deposit_index");
 
     auto dur = std::chrono::steady_clock::now() - start;
 
@@ -243,11 +255,16 @@ public:
     return m_loaded;
   }
 
+  const Crypto::Hash& lastBlockHash() const {
+    return m_lastBlockHash;
+  }
+
 private:
 
   LoggerRef logger;
   bool m_loaded;
-  Blockchain& m_bs;
+  Blockchain::BlockCacheState m_cache;
+  std::string m_folder;
   Crypto::Hash m_lastBlockHash;
 };
 
@@ -364,7 +381,16 @@ private:
                          m_upgradeDetectorV6(currency, m_blocks, BLOCK_MAJOR_VERSION_6, logger), 
 			 m_upgradeDetectorV7(currency, m_blocks, BLOCK_MAJOR_VERSION_7, logger),
 			 m_upgradeDetectorV8(currency, m_blocks, BLOCK_MAJOR_VERSION_8, logger),
-        		 m_upgradeDetectorV9(currency, m_blocks, BLOCK_MAJOR_VERSION_9, logger) {
+        		 m_upgradeDetectorV9(currency, m_blocks, BLOCK_MAJOR_VERSION_9, logger),
+                         m_cacheSaveRunning(false),
+                         m_cacheJournalGeneration(0) {
+}
+
+Blockchain::~Blockchain() {
+  std::lock_guard<std::mutex> storeLock(m_storeCacheLock);
+  if (m_cacheSaveThread.joinable()) {
+    m_cacheSaveThread.join();
+  }
 }
 
 bool Blockchain::addObserver(IBlockchainStorageObserver* observer) {
@@ -438,17 +464,17 @@ bool Blockchain::checkTransactionSize(size_t blobSize) {
 }
 
 bool Blockchain::haveTransaction(const Crypto::Hash &id) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   return m_transactionMap.find(id) != m_transactionMap.end();
 }
 
 bool Blockchain::have_tx_keyimg_as_spent(const Crypto::KeyImage &key_im) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   return  m_spent_keys.find(key_im) != m_spent_keys.end();
 }
 
 uint32_t Blockchain::getCurrentBlockchainHeight() {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   return static_cast<uint32_t>(m_blocks.size());
 }
 
@@ -465,16 +491,28 @@ bool Blockchain::init(const std::string& config_folder, bool load_existing) {
     return false;
   }
 
+  if (!openBlockHeaders(appendPath(config_folder, m_currency.blockHeadersFileName()), appendPath(config_folder, m_currency.blockLayoutsFileName()))) {
+    return false;
+  }
+
   if (load_existing && !m_blocks.empty()) {
     logger(INFO, BRIGHT_WHITE) << "Loading blockchain...";
-    BlockCacheSerializer loader(*this, get_block_hash(m_blocks.back().bl), logger.getLogger());
+    BlockCacheSerializer loader(liveCache(), config_folder, get_block_hash(m_blocks.back().bl), logger.getLogger());
     loader.load(appendPath(config_folder, m_currency.blocksCacheFileName()));
 
+    // a rebuilt cache is saved right away, the journal can only be replayed on top of a saved one
     if (!loader.loaded()) {
       logger(WARNING, BRIGHT_YELLOW) << "No actual blockchain cache found, rebuilding internal structures...";
       rebuildCache();
+      storeCache();
+    } else if (!replayCacheJournal(loader.lastBlockHash())) {
+      logger(WARNING, BRIGHT_YELLOW) << "Blockchain cache cannot be brought up to date, rebuilding internal structures...";
+      rebuildCache();
+      storeCache();
     }
 
+    loadBlockHeaders();
+
       /* Load (or generate) the indices only if Explorer mode is enabled */
       if (m_blockchainIndexesEnabled)
       {
@@ -489,11 +527,14 @@ bool Blockchain::init(const std::string& config_folder, bool load_existing) {
     else
     {
       m_blocks.clear();
+      clearBlockHeaders();
+      restartCacheJournal();
     }
 
   if (m_blocks.empty()) {
     logger(INFO, BRIGHT_WHITE)
       << "Blockchain not loaded, generating genesis block.";
+    clearBlockHeaders();
     block_verification_context bvc = boost::value_initialized<block_verification_context>();
     pushBlock(m_currency.genesisBlock(), get_block_hash(m_currency.genesisBlock()), bvc, 0);
     if (bvc.m_verification_failed) {
@@ -579,8 +620,8 @@ if (!m_upgradeDetectorV2.init() || !m_upgradeDetectorV3.init() || !m_upgradeDete
 
   update_next_comulative_size_limit();
 
-  uint64_t timestamp_diff = time(NULL) - m_blocks.back().bl.timestamp;
-  if (!m_blocks.back().bl.timestamp) {
+  uint64_t timestamp_diff = time(NULL) - m_blockHeaders.back().timestamp;
+  if (!m_blockHeaders.back().timestamp) {
     timestamp_diff = time(NULL) - 1341378000;
   }
 
@@ -624,70 +665,589 @@ if (!m_upgradeDetectorV2.init() || !m_upgradeDetectorV3.init() || !m_upgradeDete
     m_spent_keys.clear();
     m_outputs.clear();
     m_multisignatureOutputs.clear();
-    for (uint32_t b = 0; b < m_blocks.size(); ++b)
-    {
-      if (b % 1000 == 0)
-      {
-        logger(INFO, BRIGHT_WHITE) << "Rebuilding Cache for Height " << b << " of " << m_blocks.size();
-      }
+    m_depositIndex = DepositIndex();
 
-      const BlockEntry &block = m_blocks[b];
-      Crypto::Hash blockHash = get_block_hash(block.bl);
-      m_blockIndex.push(blockHash);
-      uint64_t interest = 0;
-      for (uint16_t t = 0; t < block.transactions.size(); ++t)
-      {
-        const TransactionEntry &transaction = block.transactions[t];
-        Crypto::Hash transactionHash = getObjectHash(transaction.tx);
-        TransactionIndex transactionIndex = {b, t};
-        m_transactionMap.insert(std::make_pair(transactionHash, transactionIndex));
+    // the old journal does not apply to the rebuilt cache, which is saved whole after it
+    m_cacheJournal.close();
+    replayBlocks(0);
 
-        // process inputs
-        for (auto &i : transaction.tx.inputs)
+    std::chrono::duration<double> duration = std::chrono::steady_clock::now() - timePoint;
+    logger(INFO, BRIGHT_WHITE) << "Rebuilding internal structures took: " << duration.count();
+  }
+
+  // Blocks are decoded and hashed in parallel, one batch at a time. The transaction map
+  // and the spent key images do not depend on order and are filled on the pool, while
+  // the calling thread appends outputs and deposits in height order and journals the block.
+  void Blockchain::replayBlocks(uint32_t startHeight)
+  {
+    std::vector<BlockCacheChange> batch;
+    for (uint32_t batchStart = startHeight; batchStart < m_blocks.size(); batchStart += CACHE_REBUILD_BATCH_SIZE)
+    {
+      logger(INFO, BRIGHT_WHITE) << "Rebuilding Cache for Height " << batchStart << " of " << m_blocks.size();
+
+      uint32_t batchEnd = static_cast<uint32_t>(std::min<uint64_t>(batchStart + CACHE_REBUILD_BATCH_SIZE, m_blocks.size()));
+      batch.clear();
+      batch.resize(batchEnd - batchStart);
+      m_workerPool.parallelFor(batch.size(), [&](size_t i) {
+        uint32_t b = batchStart + static_cast<uint32_t>(i);
+        const BlockEntry& block = m_blocks[b];
+        makeCacheChange(block, b, get_block_hash(block.bl), getObjectHash(block.bl.baseTransaction), batch[i]);
+      });
+
+      auto transactionsDone = m_workerPool.submit([&] {
+        for (const BlockCacheChange& change : batch)
         {
-          if (i.type() == typeid(KeyInput))
+          for (uint16_t t = 0; t < change.transactions.size(); ++t)
           {
-            m_spent_keys.insert(std::make_pair(::boost::get<KeyInput>(i).keyImage, b));
+            TransactionIndex transactionIndex = { change.height, t };
+            m_transactionMap.insert(std::make_pair(change.transactions[t].hash, transactionIndex));
           }
-          else if (i.type() == typeid(MultisignatureInput))
+        }
+      });
+
+      auto keyImagesDone = m_workerPool.submit([&] {
+        for (const BlockCacheChange& change : batch)
+        {
+          for (const TransactionCacheChange& transaction : change.transactions)
           {
-            auto out = ::boost::get<MultisignatureInput>(i);
-            m_multisignatureOutputs[out.amount][out.outputIndex].isUsed = true;
+            for (const Crypto::KeyImage& keyImage : transaction.keyImages)
+            {
+              m_spent_keys.insert(std::make_pair(keyImage, change.height));
+            }
           }
         }
+      });
+
+      for (const BlockCacheChange& change : batch)
+      {
+        applyOrderedCacheChange(liveCache(), change);
+        journalCacheChange(CACHE_JOURNAL_BLOCK_PUSHED, change);
+      }
+
+      transactionsDone.get();
+      keyImagesDone.get();
+    }
+  }
+
+// The height is passed in, block.height is not always set on blocks read back from m_blocks.
+void Blockchain::makeCacheChange(const BlockEntry& block, uint32_t height, const Crypto::Hash& blockHash,
+  const Crypto::Hash& minerTransactionHash, BlockCacheChange& change) const {
+  change.height = height;
+  change.hash = blockHash;
+  change.interest = 0;
+  change.depositChange = 0;
+  change.transactions.clear();
+  change.transactions.resize(block.transactions.size());
+  for (uint16_t t = 0; t < block.transactions.size(); ++t) {
+    const Transaction& tx = block.transactions[t].tx;
+    TransactionCacheChange& transaction = change.transactions[t];
+    transaction.hash = t == 0 ? minerTransactionHash : block.bl.transactionHashes[t - 1];
+    for (const auto& in : tx.inputs) {
+      if (in.type() == typeid(KeyInput)) {
+        transaction.keyImages.push_back(::boost::get<KeyInput>(in).keyImage);
+      } else if (in.type() == typeid(MultisignatureInput)) {
+        const MultisignatureInput& multisignatureInput = ::boost::get<MultisignatureInput>(in);
+        transaction.multisignatureInputs.emplace_back(multisignatureInput.amount, multisignatureInput.outputIndex);
+      }
+    }
+
+    for (uint16_t o = 0; o < tx.outputs.size(); ++o) {
+      const auto& out = tx.outputs[o];
+      if (out.target.type() == typeid(KeyOutput)) {
+        transaction.outputs.push_back({ out.amount, o, false });
+      } else if (out.target.type() == typeid(MultisignatureOutput)) {
+        transaction.outputs.push_back({ out.amount, o, true });
+      }
+    }
+
+    change.interest += m_currency.calculateTotalTransactionInterest(tx, height);
+    change.depositChange += getDepositChange(tx);
+  }
+}
+
+Blockchain::BlockCacheState Blockchain::liveCache() {
+  return { m_blockIndex, m_transactionMap, m_spent_keys, m_outputs, m_multisignatureOutputs, m_depositIndex };
+}
+
+void Blockchain::applyCacheChange(const BlockCacheState& cache, const BlockCacheChange& change) {
+  for (uint16_t t = 0; t < change.transactions.size(); ++t) {
+    const TransactionCacheChange& transaction = change.transactions[t];
+    TransactionIndex transactionIndex = { change.height, t };
+    cache.transactionMap.insert(std::make_pair(transaction.hash, transactionIndex));
+    for (const Crypto::KeyImage& keyImage : transaction.keyImages) {
+      cache.spentKeys.insert(std::make_pair(keyImage, change.height));
+    }
+  }
+
+  applyOrderedCacheChange(cache, change);
+}
+
+// The part of a block's change that has to be applied in height order.
+void Blockchain::applyOrderedCacheChange(const BlockCacheState& cache, const BlockCacheChange& change) {
+  cache.blockIndex.push(change.hash);
+  for (uint16_t t = 0; t < change.transactions.size(); ++t) {
+    const TransactionCacheChange& transaction = change.transactions[t];
+    TransactionIndex transactionIndex = { change.height, t };
+    for (const auto& in : transaction.multisignatureInputs) {
+      cache.multisignatureOutputs[in.first][in.second].isUsed = true;
+    }
 
-      // process outputs
-      for (uint16_t o = 0; o < transaction.tx.outputs.size(); ++o) {
-        const auto& out = transaction.tx.outputs[o];
-        if (out.target.type() == typeid(KeyOutput)) {
-          m_outputs[out.amount].push_back(std::make_pair<>(transactionIndex, o));
-        } else if (out.target.type() == typeid(MultisignatureOutput)) {
-          MultisignatureOutputUsage usage = { transactionIndex, o, false };
-          m_multisignatureOutputs[out.amount].push_back(usage);
+    for (const OutputCacheChange& out : transaction.outputs) {
+      if (out.isMultisignature) {
+        MultisignatureOutputUsage usage = { transactionIndex, out.index, false };
+        cache.multisignatureOutputs[out.amount].push_back(usage);
+      } else {
+        cache.outputs[out.amount].push_back(std::make_pair<>(transactionIndex, out.index));
+      }
+    }
+  }
+
+  cache.depositIndex.pushBlock(change.depositChange, change.interest);
+}
+
+// Takes the change of the last block in the cache back out, the way popTransactions does.
+void Blockchain::undoCacheChange(const BlockCacheState& cache, const BlockCacheChange& change, bool popDeposit) {
+  for (size_t t = change.transactions.size(); t-- > 0;) {
+    const TransactionCacheChange& transaction = change.transactions[t];
+    for (size_t o = transaction.outputs.size(); o-- > 0;) {
+      const OutputCacheChange& out = transaction.outputs[o];
+      if (out.isMultisignature) {
+        auto amountOutputs = cache.multisignatureOutputs.find(out.amount);
+        if (amountOutputs != cache.multisignatureOutputs.end() && !amountOutputs->second.empty()) {
+          amountOutputs->second.pop_back();
+          if (amountOutputs->second.empty()) {
+            cache.multisignatureOutputs.erase(amountOutputs);
+          }
+        }
+      } else {
+        auto amountOutputs = cache.outputs.find(out.amount);
+        if (amountOutputs != cache.outputs.end() && !amountOutputs->second.empty()) {
+          amountOutputs->second.pop_back();
+          if (amountOutputs->second.empty()) {
+            cache.outputs.erase(amountOutputs);
+          }
         }
       }
-        interest += m_currency.calculateTotalTransactionInterest(transaction.tx, b); //block.height); //block.height shows 0 wrongly sometimes apparently
+    }
+
+    for (const auto& in : transaction.multisignatureInputs) {
+      auto amountOutputs = cache.multisignatureOutputs.find(in.first);
+      if (amountOutputs != cache.multisignatureOutputs.end() && in.second < amountOutputs->second.size()) {
+        amountOutputs->second[in.second].isUsed = false;
       }
-      pushToDepositIndex(block, interest);
     }
 
-  std::chrono::duration<double> duration = std::chrono::steady_clock::now() - timePoint;
-  logger(INFO, BRIGHT_WHITE) << "Rebuilding internal structures took: " << duration.count();
+    for (const Crypto::KeyImage& keyImage : transaction.keyImages) {
+      cache.spentKeys.erase(keyImage);
+    }
+
+    cache.transactionMap.erase(transaction.hash);
+  }
+
+  if (popDeposit) {
+    cache.depositIndex.popBlock();
+  }
+
+  cache.blockIndex.pop();
+}
+
+void Blockchain::openCacheJournal(bool truncate) {
+  std::string path = appendPath(m_config_folder, m_currency.blocksCacheJournalFileName());
+  m_cacheJournal.close();
+  m_cacheJournal.clear();
+  m_cacheJournal.open(path, std::ios::binary | (truncate ? std::ios::trunc : std::ios::app));
+  if (!m_cacheJournal) {
+    logger(WARNING, BRIGHT_YELLOW) << "Failed to open blockchain cache journal " << path;
+  }
 }
 
+// The journal starts with the tail and height of the cache its records apply to, which is the
+// live cache as it is now, and the records of any other cache are not replayed.
+void Blockchain::startCacheJournal() {
+  openCacheJournal(true);
+  ++m_cacheJournalGeneration;
+  if (!m_cacheJournal.is_open()) {
+    return;
+  }
+
+  StdOutputStream stream(m_cacheJournal);
+  BinaryOutputStreamSerializer s(stream);
+  uint8_t version = CURRENT_BLOCKCACHE_JOURNAL_VER;
+  Crypto::Hash cacheTail = m_blockIndex.size() == 0 ? NULL_HASH : m_blockIndex.getTailId();
+  uint32_t cacheHeight = m_blockIndex.size() == 0 ? 0 : m_blockIndex.size() - 1;
+  s(version, "version");
+  s(cacheTail, "cache_tail");
+  s(cacheHeight, "cache_height");
+  m_cacheJournal.flush();
+}
+
+// Starts the journal over once the cache is saved whole, or is to be rebuilt, so that the journal
+// an autosave set aside does not apply any more either.
+void Blockchain::restartCacheJournal() {
+  std::remove(appendPath(m_config_folder, m_currency.blocksCacheJournalFileName() + CACHE_JOURNAL_PREVIOUS_SUFFIX).c_str());
+  startCacheJournal();
+}
+
+// Every block pushed to or popped from the cache is journaled as it happens, so that the saved
+// cache and the journal give the cache back after a crash without a rebuild.
+void Blockchain::journalCacheChange(uint8_t type, const BlockCacheChange& change) {
+  if (!m_cacheJournal.is_open()) {
+    return;
+  }
+
+  StdOutputStream stream(m_cacheJournal);
+  BinaryOutputStreamSerializer s(stream);
+  s(type, "type");
+  s(const_cast<BlockCacheChange&>(change), "change");
+  m_cacheJournal.flush();
+  if (!m_cacheJournal) {
+    // records behind a missing one could not be replayed, the next start rebuilds what the journal lacks
+    logger(WARNING, BRIGHT_YELLOW) << "Failed to write blockchain cache journal, journaling stopped until the cache is saved";
+    m_cacheJournal.close();
+  }
+}
+
+// Replays the journal an autosave set aside, if the saved cache is still the one it applies to,
+// and then the journal that follows on from it.
+bool Blockchain::replayCacheJournal(const Crypto::Hash& cacheTail) {
+  if (m_blockIndex.size() == 0 || m_blockIndex.getTailId() != cacheTail) {
+    return false;
+  }
+
+  // the journaled pushes still in the cache, the tail last
+  std::vector<BlockCacheChange> pushedBlocks;
+  size_t replayedRecords = 0;
+  std::string previousPath = appendPath(m_config_folder, m_currency.blocksCacheJournalFileName() + CACHE_JOURNAL_PREVIOUS_SUFFIX);
+  bool previousMatches = false;
+  if (!replayCacheJournalFile(previousPath, pushedBlocks, replayedRecords, previousMatches)) {
+    return false;
+  }
+
+  if (!previousMatches) {
+    // left by an autosave that saved its cache but stopped before removing it
+    std::remove(previousPath.c_str());
+  }
+
+  bool journalMatches = false;
+  if (!replayCacheJournalFile(appendPath(m_config_folder, m_currency.blocksCacheJournalFileName()), pushedBlocks, replayedRecords, journalMatches)) {
+    return false;
+  }
+
+  if (journalMatches) {
+    openCacheJournal(false);
+  } else if (previousMatches) {
+    startCacheJournal();
+  } else {
+    restartCacheJournal();
+  }
+
+  // blocks the journal has but m_blocks lost are undone, and journaled as popped
+  uint32_t journalHeight = m_blockIndex.size();
+  while (m_blockIndex.size() > 0 && (m_blockIndex.size() > m_blocks.size() ||
+    m_blockIndex.getTailId() != get_block_hash(m_blocks[m_blockIndex.size() - 1].bl))) {
+    if (pushedBlocks.empty()) {
+      logger(WARNING, BRIGHT_YELLOW) << "Blockchain cache journal misses block " << m_blockIndex.getTailId();
+      return false;
+    }
+
+    journalCacheChange(CACHE_JOURNAL_BLOCK_POPPED, pushedBlocks.back());
+    undoCacheChange(liveCache(), pushedBlocks.back(), true);
+    pushedBlocks.pop_back();
+  }
+
+  if (m_blockIndex.size() == 0) {
+    return false;
+  }
+
+  logger(INFO, BRIGHT_WHITE) << "Replaying blockchain cache: " << replayedRecords << " journal records, " <<
+    journalHeight - m_blockIndex.size() << " blocks undone, " << m_blocks.size() - m_blockIndex.size() << " blocks to apply";
+  replayBlocks(m_blockIndex.size());
+  return true;
+}
+
+// Applies the records of one journal file to the live cache if it starts at the cache's tail. Returns
+// false if a record does not fit the cache, which then has to be rebuilt.
+bool Blockchain::replayCacheJournalFile(const std::string& path, std::vector<BlockCacheChange>& pushedBlocks, size_t& replayedRecords,
+  bool& journalMatches) {
+  journalMatches = false;
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return true;
+  }
+
+  uint64_t replayedSize = 0;
+  StdInputStream stream(file);
+  BinaryInputStreamSerializer s(stream);
+  try {
+    uint8_t version;
+    Crypto::Hash journalTail;
+    uint32_t journalHeight;
+    s(version, "version");
+    s(journalTail, "cache_tail");
+    s(journalHeight, "cache_height");
+    journalMatches = version == CURRENT_BLOCKCACHE_JOURNAL_VER && journalHeight + 1 == m_blockIndex.size() &&
+      journalTail == m_blockIndex.getTailId();
+    replayedSize = static_cast<uint64_t>(file.tellg());
+    while (journalMatches && file.peek() != std::ifstream::traits_type::eof()) {
+      uint8_t type;
+      BlockCacheChange change;
+      s(type, "type");
+      s(change, "change");
+      replayedSize = static_cast<uint64_t>(file.tellg());
+      if (type == CACHE_JOURNAL_BLOCK_PUSHED) {
+        if (change.height != m_blockIndex.size()) {
+          logger(WARNING, BRIGHT_YELLOW) << "Blockchain cache journal pushes block " << change.hash << " at a wrong height";
+          return false;
+        }
+
+        applyCacheChange(liveCache(), change);
+        pushedBlocks.push_back(std::move(change));
+      } else {
+        if (change.height + 1 != m_blockIndex.size() || change.hash != m_blockIndex.getTailId()) {
+          logger(WARNING, BRIGHT_YELLOW) << "Blockchain cache journal pops block " << change.hash << " which is not the tail";
+          return false;
+        }
+
+        undoCacheChange(liveCache(), change, type == CACHE_JOURNAL_BLOCK_POPPED);
+        if (!pushedBlocks.empty()) {
+          pushedBlocks.pop_back();
+        }
+      }
+
+      ++replayedRecords;
+    }
+  } catch (std::exception&) {
+    // a record torn by a crash can only be the last one
+  }
+
+  file.close();
+
+  // records behind a torn one would never be read, neither by a replay nor by an autosave
+  boost::system::error_code ec;
+  uint64_t journalSize = boost::filesystem::file_size(path, ec);
+  if (journalMatches && !ec && journalSize > replayedSize) {
+    logger(WARNING, BRIGHT_YELLOW) << "Blockchain cache journal " << path << " ends with a torn record, " << journalSize - replayedSize << " bytes dropped";
+    boost::filesystem::resize_file(path, replayedSize, ec);
+    if (ec) {
+      logger(WARNING, BRIGHT_YELLOW) << "Failed to truncate blockchain cache journal " << path << ": " << ec.message();
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Writes the cache next to the saved one, which is left alone until replaceCacheFiles.
+bool Blockchain::writeCacheFiles(const BlockCacheState& cache, const Crypto::Hash& tailId) {
+  std::string filename = appendPath(m_config_folder, m_currency.blocksCacheFileName());
+  std::string transactionMapFilename = appendPath(m_config_folder, "transactionsmap.dat");
+  std::string spentKeysFilename = appendPath(m_config_folder, "spentkeys.dat");
+  try {
+    {
+      phmap::BinaryOutputArchive ar_out((transactionMapFilename + CACHE_TEMP_SUFFIX).c_str());
+      cache.transactionMap.dump(ar_out);
+    }
+
+    {
+      phmap::BinaryOutputArchive ar_out((spentKeysFilename + CACHE_TEMP_SUFFIX).c_str());
+      cache.spentKeys.dump(ar_out);
+    }
+
+    std::ofstream file(filename + CACHE_TEMP_SUFFIX, std::ios::binary);
+    StdOutputStream stream(file);
+    BinaryOutputStreamSerializer s(stream);
+    BlockCacheSerializer ser(cache, m_config_folder, tailId, logger.getLogger());
+    CryptoNote::serialize(ser, s);
+    file.close();
+    if (!file) {
+      logger(ERROR, BRIGHT_RED) << "Failed to save blockchain cache";
+      return false;
+    }
+  } catch (std::exception& e) {
+    logger(ERROR, BRIGHT_RED) << "Failed to save blockchain cache: " << e.what();
+    return false;
+  }
+
+  return true;
+}
+
+// Everything is complete on disk before the old files are touched. The old cache is dropped first
+// so that it never sits next to newer companions, and the new one is renamed in last.
+bool Blockchain::replaceCacheFiles() {
+  std::string filename = appendPath(m_config_folder, m_currency.blocksCacheFileName());
+  std::string transactionMapFilename = appendPath(m_config_folder, "transactionsmap.dat");
+  std::string spentKeysFilename = appendPath(m_config_folder, "spentkeys.dat");
+  std::remove(filename.c_str());
+  if (std::rename((transactionMapFilename + CACHE_TEMP_SUFFIX).c_str(), transactionMapFilename.c_str()) != 0 ||
+      std::rename((spentKeysFilename + CACHE_TEMP_SUFFIX).c_str(), spentKeysFilename.c_str()) != 0 ||
+      std::rename((filename + CACHE_TEMP_SUFFIX).c_str(), filename.c_str()) != 0) {
+    logger(ERROR, BRIGHT_RED) << "Failed to save blockchain cache";
+    return false;
+  }
+
+  return true;
+}
+
+// The cache is written straight from the live structures and the journal then starts over. The
+// shared lock holds new blocks back for the whole save, so this is only done at shutdown, after a
+// rebuild and on request. Autosave builds and saves its cache off the live one instead.
 bool Blockchain::storeCache() {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::lock_guard<std::mutex> storeLock(m_storeCacheLock);
+  if (m_cacheSaveThread.joinable()) {
+    m_cacheSaveThread.join();
+  }
 
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   logger(INFO, BRIGHT_WHITE) << "Saving blockchain...";
-  BlockCacheSerializer ser(*this, getTailId(), logger.getLogger());
-  if (!ser.save(appendPath(m_config_folder, m_currency.blocksCacheFileName()))) {
-    logger(ERROR, BRIGHT_RED) << "Failed to save blockchain cache";
+  m_blockHeaders.flush();
+  m_blockLayouts.flush();
+  if (!writeCacheFiles(liveCache(), getTailId()) || !replaceCacheFiles()) {
     return false;
   }
-    logger(INFO, BRIGHT_GREEN) << "Fuego blockchain was successfully saved.";
+
+  restartCacheJournal();
+  logger(INFO, BRIGHT_GREEN) << "Fuego blockchain was successfully saved.";
   return true;
 }
 
+// Autosave sets the journal aside and starts a new one at the current tail, which is all it does
+// under the lock. The cache at that tail is then built and saved on a thread of its own, so that a
+// crash never replays more than the blocks since the last autosave.
+void Blockchain::startCacheAutosave() {
+  std::lock_guard<std::mutex> storeLock(m_storeCacheLock);
+  if (m_cacheSaveRunning) {
+    logger(INFO, BRIGHT_WHITE) << "Previous blockchain cache autosave is still running, autosave skipped";
+    return;
+  }
+
+  if (m_cacheSaveThread.joinable()) {
+    m_cacheSaveThread.join();
+  }
+
+  uint64_t generation;
+  {
+    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    m_blockHeaders.flush();
+    m_blockLayouts.flush();
+    if (!m_cacheJournal.is_open()) {
+      logger(WARNING, BRIGHT_YELLOW) << "Blockchain cache journal is not written, autosave skipped";
+      return;
+    }
+
+    // the journal set aside by an autosave that failed is folded again, and the current one still follows on from it
+    std::string path = appendPath(m_config_folder, m_currency.blocksCacheJournalFileName());
+    std::string previousPath = path + CACHE_JOURNAL_PREVIOUS_SUFFIX;
+    if (!boost::filesystem::exists(previousPath)) {
+      m_cacheJournal.close();
+      boost::system::error_code ec;
+      boost::filesystem::rename(path, previousPath, ec);
+      if (ec) {
+        logger(WARNING, BRIGHT_YELLOW) << "Failed to set blockchain cache journal aside, autosave skipped: " << ec.message();
+        openCacheJournal(false);
+        return;
+      }
+
+      startCacheJournal();
+    }
+
+    generation = m_cacheJournalGeneration;
+  }
+
+  m_cacheSaveRunning = true;
+  m_cacheSaveThread = std::thread([this, generation] {
+    foldCacheJournal(generation);
+    m_cacheSaveRunning = false;
+  });
+}
+
+// Loads the saved cache into a set of structures of its own, which takes as much memory again as
+// the cache, applies the journal set aside to it and saves the result. The live cache is not read,
+// the lock is only taken, shared, for the renames that put the new files in place.
+void Blockchain::foldCacheJournal(uint64_t generation) {
+  auto start = std::chrono::steady_clock::now();
+  BlockIndex blockIndex;
+  TransactionMap transactionMap;
+  key_images_container spentKeys;
+  outputs_container outputs;
+  MultisignatureOutputsContainer multisignatureOutputs;
+  DepositIndex depositIndex;
+  BlockCacheState cache = { blockIndex, transactionMap, spentKeys, outputs, multisignatureOutputs, depositIndex };
+
+  BlockCacheSerializer loader(cache, m_config_folder, NULL_HASH, logger.getLogger());
+  loader.load(appendPath(m_config_folder, m_currency.blocksCacheFileName()));
+  if (!loader.loaded() || blockIndex.size() == 0) {
+    logger(WARNING, BRIGHT_YELLOW) << "Failed to load the saved blockchain cache, autosave skipped";
+    return;
+  }
+
+  std::string path = appendPath(m_config_folder, m_currency.blocksCacheJournalFileName());
+  std::string previousPath = path + CACHE_JOURNAL_PREVIOUS_SUFFIX;
+  size_t foldedRecords = 0;
+  try {
+    std::ifstream file(previousPath, std::ios::binary);
+    StdInputStream stream(file);
+    BinaryInputStreamSerializer s(stream);
+    uint8_t version;
+    Crypto::Hash journalTail;
+    uint32_t journalHeight;
+    s(version, "version");
+    s(journalTail, "cache_tail");
+    s(journalHeight, "cache_height");
+    if (version != CURRENT_BLOCKCACHE_JOURNAL_VER || journalHeight + 1 != blockIndex.size() || journalTail != blockIndex.getTailId()) {
+      logger(WARNING, BRIGHT_YELLOW) << "Blockchain cache journal set aside does not apply to the saved cache, autosave skipped";
+      return;
+    }
+
+    while (file.peek() != std::ifstream::traits_type::eof()) {
+      uint8_t type;
+      BlockCacheChange change;
+      s(type, "type");
+      s(change, "change");
+      if (type == CACHE_JOURNAL_BLOCK_PUSHED ? change.height != blockIndex.size() :
+        change.height + 1 != blockIndex.size() || change.hash != blockIndex.getTailId()) {
+        logger(WARNING, BRIGHT_YELLOW) << "Blockchain cache journal set aside does not fit the saved cache, autosave skipped";
+        return;
+      }
+
+      if (type == CACHE_JOURNAL_BLOCK_PUSHED) {
+        applyCacheChange(cache, change);
+      } else {
+        undoCacheChange(cache, change, type == CACHE_JOURNAL_BLOCK_POPPED);
+      }
+
+      ++foldedRecords;
+    }
+  } catch (std::exception& e) {
+    logger(WARNING, BRIGHT_YELLOW) << "Failed to read blockchain cache journal set aside, autosave skipped: " << e.what();
+    return;
+  }
+
+  if (blockIndex.size() == 0) {
+    return;
+  }
+
+  uint32_t height = blockIndex.size() - 1;
+  if (!writeCacheFiles(cache, blockIndex.getTailId())) {
+    return;
+  }
+
+  // a journal started over meanwhile belongs to a cache saved whole or dropped, which this one must not replace
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  if (generation != m_cacheJournalGeneration) {
+    logger(INFO, BRIGHT_WHITE) << "Blockchain cache journal started over during autosave, autosave dropped";
+    return;
+  }
+
+  if (!replaceCacheFiles()) {
+    return;
+  }
+
+  std::remove(previousPath.c_str());
+  std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+  logger(INFO, BRIGHT_WHITE) << "Blockchain cache saved at height " << height << ", " << foldedRecords << " journal records folded in " <<
+    duration.count() << " s";
+}
+
 bool Blockchain::deinit() {
   storeCache();
   if (m_blockchainIndexesEnabled) {
@@ -700,6 +1260,7 @@ bool Blockchain::deinit() {
 bool Blockchain::resetAndSetGenesisBlock(const Block& b) {
   std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   m_blocks.clear();
+  clearBlockHeaders();
   m_blockIndex.clear();
   m_transactionMap.clear();
 
@@ -711,6 +1272,7 @@ bool Blockchain::resetAndSetGenesisBlock(const Block& b) {
   m_timestampIndex.clear();
   m_generatedTransactionsIndex.clear();
   m_orthanBlocksIndex.clear();
+  restartCacheJournal();
 
   block_verification_context bvc = boost::value_initialized<block_verification_context>();
   addNewBlock(b, bvc);
@@ -719,24 +1281,24 @@ bool Blockchain::resetAndSetGenesisBlock(const Block& b) {
 
 Crypto::Hash Blockchain::getTailId(uint32_t& height) {
   assert(!m_blocks.empty());
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   height = getCurrentBlockchainHeight() - 1;
   return getTailId();
 }
 
 Crypto::Hash Blockchain::getTailId() {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   return m_blocks.empty() ? NULL_HASH : m_blockIndex.getTailId();
 }
 
 std::vector<Crypto::Hash> Blockchain::buildSparseChain() {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   assert(m_blockIndex.size() != 0);
   return doBuildSparseChain(m_blockIndex.getTailId());
 }
 
 std::vector<Crypto::Hash> Blockchain::buildSparseChain(const Crypto::Hash& startBlockId) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   assert(haveBlock(startBlockId));
   return doBuildSparseChain(startBlockId);
 }
@@ -773,13 +1335,13 @@ std::vector<Crypto::Hash> Blockchain::doBuildSparseChain(const Crypto::Hash& sta
 }
 
 Crypto::Hash Blockchain::getBlockIdByHeight(uint32_t height) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   assert(height < m_blockIndex.size());
   return m_blockIndex.getBlockId(height);
 }
 
 bool Blockchain::getBlockByHash(const Crypto::Hash& blockHash, Block& b) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
   uint32_t height = 0;
 
@@ -800,12 +1362,12 @@ bool Blockchain::getBlockByHash(const Crypto::Hash& blockHash, Block& b) {
 }
 
 bool Blockchain::getBlockHeight(const Crypto::Hash& blockId, uint32_t& blockHeight) {
-  std::lock_guard<decltype(m_blockchain_lock)> lock(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lock(m_blockchain_lock);
   return m_blockIndex.getBlockHeight(blockId, blockHeight);
 }
 
 difficulty_type Blockchain::getDifficultyForNextBlock() {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   std::vector<uint64_t> timestamps;
   std::vector<difficulty_type> cumulative_difficulties;
   uint8_t BlockMajorVersion = getBlockMajorVersionForHeight(static_cast<uint32_t>(m_blocks.size()));
@@ -816,43 +1378,42 @@ difficulty_type Blockchain::getDifficultyForNextBlock() {
     ++offset;
   }
   for (; offset < m_blocks.size(); offset++) {
-    timestamps.push_back(m_blocks[offset].bl.timestamp);
-    cumulative_difficulties.push_back(m_blocks[offset].cumulative_difficulty);
+    timestamps.push_back(m_blockHeaders[offset].timestamp);
+    cumulative_difficulties.push_back(m_blockHeaders[offset].cumulativeDifficulty);
   }
   return m_currency.nextDifficulty(static_cast<uint32_t>(m_blocks.size()), BlockMajorVersion, timestamps, cumulative_difficulties);
 }
 
 uint64_t Blockchain::getBlockTimestamp(uint32_t height) {
   assert(height < m_blocks.size());
-  return m_blocks[height].bl.timestamp;
+  return m_blockHeaders[height].timestamp;
 }
 
 uint64_t Blockchain::getCoinsInCirculation() {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   if (m_blocks.empty()) {
     return 0;
   } else {
-    return m_blocks.back().already_generated_coins;
+    return m_blockHeaders.back().alreadyGeneratedCoins;
   }
 }
     
 uint64_t Blockchain::coinsEmittedAtHeight(uint64_t height) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-  const auto& block = m_blocks[height];
-  return block.already_generated_coins;
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  return m_blockHeaders[height].alreadyGeneratedCoins;
 }
   
   difficulty_type Blockchain::difficultyAtHeight(uint64_t height)
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
-    const auto &current = m_blocks[height];
+    std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    const auto &current = m_blockHeaders[height];
     if (height < 1)
     {
-      return current.cumulative_difficulty;
+      return current.cumulativeDifficulty;
     }
 
-    const auto &previous = m_blocks[height - 1];
-    return current.cumulative_difficulty - previous.cumulative_difficulty;
+    const auto &previous = m_blockHeaders[height - 1];
+    return current.cumulativeDifficulty - previous.cumulativeDifficulty;
   }
   
 uint8_t Blockchain::getBlockMajorVersionForHeight(uint32_t height) const {
@@ -877,11 +1438,11 @@ uint8_t Blockchain::getBlockMajorVersionForHeight(uint32_t height) const {
   }
 }
 
-bool Blockchain::rollback_blockchain_switching(std::list<Block> &original_chain, size_t rollback_height) {
+bool Blockchain::rollback_blockchain_switching(std::list<std::pair<Crypto::Hash, Block>> &original_chain, size_t rollback_height) {
   std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   // remove failed subchain
   for (size_t i = m_blocks.size() - 1; i >= rollback_height; i--) {
-    popBlock(get_block_hash(m_blocks.back().bl));
+    popBlock(m_blockIndex.getTailId());
   }
 
     uint32_t height = static_cast<uint32_t>(rollback_height - 1);
@@ -890,7 +1451,7 @@ bool Blockchain::rollback_blockchain_switching(std::list<Block> &original_chain,
   for (auto &bl : original_chain) {
     block_verification_context bvc =
       boost::value_initialized<block_verification_context>();
-    bool r = pushBlock(bl, get_block_hash(bl), bvc, ++height);
+    bool r = pushBlock(bl.second, bl.first, bvc, ++height);
     if (!(r && bvc.m_added_to_main_chain)) {
       logger(ERROR, BRIGHT_RED) << "PANIC!!! failed to add block (again) while "
         "chain switching during the rollback!";
@@ -1013,13 +1574,14 @@ bool Blockchain::switch_to_alternative_blockchain(std::list<blocks_ext_by_hash::
     }
   }
 	
-  //disconnecting old chain
-  std::list<Block> disconnected_chain;
+  //disconnecting old chain, the block index already holds the hashes of the blocks taken off
+  std::list<std::pair<Crypto::Hash, Block>> disconnected_chain;
   for (size_t i = m_blocks.size() - 1; i >= split_height; i--) {
+    Crypto::Hash blockHash = m_blockIndex.getBlockId(static_cast<uint32_t>(i));
     Block b = m_blocks[i].bl;
-    popBlock(get_block_hash(b));
+    popBlock(blockHash);
     //if (!(r)) { logger(ERROR, BRIGHT_RED) << "failed to remove block on chain switching"; return false; }
-    disconnected_chain.push_front(b);
+    disconnected_chain.push_front(std::make_pair(blockHash, std::move(b)));
   }
 
     uint32_t height = static_cast<uint32_t>(split_height - 1);
@@ -1028,12 +1590,12 @@ bool Blockchain::switch_to_alternative_blockchain(std::list<blocks_ext_by_hash::
   for (auto alt_ch_iter = alt_chain.begin(); alt_ch_iter != alt_chain.end(); alt_ch_iter++) {
     auto ch_ent = *alt_ch_iter;
     block_verification_context bvc = boost::value_initialized<block_verification_context>();
-    bool r = pushBlock(ch_ent->second.bl, get_block_hash(ch_ent->second.bl), bvc, ++height);
+    bool r = pushBlock(ch_ent->second.bl, ch_ent->first, bvc, ++height);
     if (!r || !bvc.m_added_to_main_chain) {
       logger(INFO, BRIGHT_WHITE) << "Failed to switch to alternative blockchain";
       rollback_blockchain_switching(disconnected_chain, split_height);
       //add_block_as_invalid(ch_ent->second, get_block_hash(ch_ent->second.bl));
-      logger(INFO, BRIGHT_WHITE) << "The block was inserted as invalid while connecting new alternative chain,  block_id: " << get_block_hash(ch_ent->second.bl);
+      logger(INFO, BRIGHT_WHITE) << "The block was inserted as invalid while connecting new alternative chain,  block_id: " << ch_ent->first;
       m_orthanBlocksIndex.remove(ch_ent->second.bl);
       m_alternative_chains.erase(ch_ent);
 
@@ -1052,7 +1614,7 @@ bool Blockchain::switch_to_alternative_blockchain(std::list<blocks_ext_by_hash::
     //pushing old chain as alternative chain
     for (auto& old_ch_ent : disconnected_chain) {
       block_verification_context bvc = boost::value_initialized<block_verification_context>();
-      bool r = handle_alternative_block(old_ch_ent, get_block_hash(old_ch_ent), bvc, false);
+      bool r = handle_alternative_block(old_ch_ent.second, old_ch_ent.first, bvc, false);
       if (!r) {
         logger(WARNING, BRIGHT_MAGENTA) << ("Failed to push ex-main chain blocks to alternative chain ");
         break;
@@ -1066,7 +1628,7 @@ bool Blockchain::switch_to_alternative_blockchain(std::list<blocks_ext_by_hash::
 
   //removing all_chain entries from alternative chain
   for (auto ch_ent : alt_chain) {
-    blocksFromCommonRoot.push_back(get_block_hash(ch_ent->second.bl));
+    blocksFromCommonRoot.push_back(ch_ent->first);
     m_orthanBlocksIndex.remove(ch_ent->second.bl);
     m_alternative_chains.erase(ch_ent);
   }
@@ -1087,7 +1649,7 @@ difficulty_type Blockchain::get_next_difficulty_for_alternative_chain(const std:
   // if the alt chain isn't long enough to calculate the difficulty target
   // based on its blocks alone, need to get more blocks from the main chain
   if (alt_chain.size() < m_currency.difficultyBlocksCountByBlockVersion(BlockMajorVersion)) {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
     size_t main_chain_stop_offset = alt_chain.size() ? alt_chain.front()->second.height : bei.height;
     size_t main_chain_count = m_currency.difficultyBlocksCountByBlockVersion(BlockMajorVersion) - std::min(m_currency.difficultyBlocksCountByBlockVersion(BlockMajorVersion), alt_chain.size());
     main_chain_count = std::min(main_chain_count, main_chain_stop_offset);
@@ -1098,8 +1660,8 @@ difficulty_type Blockchain::get_next_difficulty_for_alternative_chain(const std:
     
     // get difficulties and timestamps from relevant main chain blocks
     for (; main_chain_start_offset < main_chain_stop_offset; ++main_chain_start_offset) {
-      timestamps.push_back(m_blocks[main_chain_start_offset].bl.timestamp);
-      cumulative_difficulties.push_back(m_blocks[main_chain_start_offset].cumulative_difficulty);
+      timestamps.push_back(m_blockHeaders[main_chain_start_offset].timestamp);
+      cumulative_difficulties.push_back(m_blockHeaders[main_chain_start_offset].cumulativeDifficulty);
     }
 
     // make sure we haven't accidentally grabbed too many blocks... ???
@@ -1205,7 +1767,7 @@ bool Blockchain::validate_miner_transaction(const Block& b, uint32_t height, siz
 }
 
 bool Blockchain::getBackwardBlocksSize(size_t from_height, std::vector<size_t>& sz, size_t count) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   if (!(from_height < m_blocks.size())) {
     logger(ERROR, BRIGHT_RED)
       << "Internal error: get_backward_blocks_sizes called with from_height="
@@ -1214,14 +1776,14 @@ bool Blockchain::getBackwardBlocksSize(size_t from_height, std::vector<size_t>&
   }
   size_t start_offset = (from_height + 1) - std::min((from_height + 1), count);
   for (size_t i = start_offset; i != from_height + 1; i++) {
-    sz.push_back(m_blocks[i].block_cumulative_size);
+    sz.push_back(m_blockHeaders[i].blockCumulativeSize);
   }
 
   return true;
 }
 
 bool Blockchain::get_last_n_blocks_sizes(std::vector<size_t>& sz, size_t count) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   if (!m_blocks.size()) {
     return true;
   }
@@ -1237,12 +1799,12 @@ uint64_t Blockchain::getCurrentCumulativeBlocksizeLimit() {
    if (timestamps.size() >= m_currency.timestampCheckWindow(blockMajorVersion)) 
     return true;
 
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   size_t need_elements = m_currency.timestampCheckWindow(blockMajorVersion) - timestamps.size(); 
   if (!(start_top_height < m_blocks.size())) { logger(ERROR, BRIGHT_RED) << "internal error: passed start_height = " << start_top_height << " not less then m_blocks.size()=" << m_blocks.size(); return false; }
   size_t stop_offset = start_top_height > need_elements ? start_top_height - need_elements : 0;
   do {
-    timestamps.push_back(m_blocks[start_top_height].bl.timestamp);
+    timestamps.push_back(m_blockHeaders[start_top_height].timestamp);
     if (start_top_height == 0)
       break;
     --start_top_height;
@@ -1353,7 +1915,7 @@ bool Blockchain::handle_alternative_block(const Block& b, const Crypto::Hash& id
     difficulty_type current_diff = get_next_difficulty_for_alternative_chain(alt_chain, bei);
     if (!(current_diff)) { logger(ERROR, BRIGHT_RED) << "!!!!!!! DIFFICULTY OVERHEAD !!!!!!!"; return false; }
     Crypto::Hash proof_of_work = NULL_HASH;
-    if (!m_currency.checkProofOfWork(m_cn_context, bei.bl, current_diff, proof_of_work)) {
+    if (!checkProofOfWork(bei.bl, id, current_diff, proof_of_work)) {
       logger(INFO, BRIGHT_RED) <<
         "Block with id: " << id
         << ENDL << " for alternative chain, lacks enough proof of work: " << proof_of_work
@@ -1369,7 +1931,7 @@ bool Blockchain::handle_alternative_block(const Block& b, const Crypto::Hash& id
       return false;
     }
 
-    bei.cumulative_difficulty = alt_chain.size() ? it_prev->second.cumulative_difficulty : m_blocks[mainPrevHeight].cumulative_difficulty;
+    bei.cumulative_difficulty = alt_chain.size() ? it_prev->second.cumulative_difficulty : m_blockHeaders[mainPrevHeight].cumulativeDifficulty;
     bei.cumulative_difficulty += current_diff;
 
 #ifdef _DEBUG
@@ -1397,11 +1959,11 @@ bool Blockchain::handle_alternative_block(const Block& b, const Crypto::Hash& id
         bvc.m_verification_failed = true;
       }
       return r;
-    } else if (m_blocks.back().cumulative_difficulty < bei.cumulative_difficulty) //check if difficulty bigger then in main chain
+    } else if (m_blockHeaders.back().cumulativeDifficulty < bei.cumulative_difficulty) //check if difficulty bigger then in main chain
     {
       //do reorganize!
       logger(INFO, BRIGHT_YELLOW) <<
-        "###### REORGANIZE on height: " << alt_chain.front()->second.height << " of " << m_blocks.size() - 1 << " with cumulative_difficulty " << m_blocks.back().cumulative_difficulty
+        "###### REORGANIZE on height: " << alt_chain.front()->second.height << " of " << m_blocks.size() - 1 << " with cumulative_difficulty " << m_blockHeaders.back().cumulativeDifficulty
         << ENDL << " alternative blockchain size: " << alt_chain.size() << " with cumulative_difficulty " << bei.cumulative_difficulty;
       bool r = switch_to_alternative_blockchain(alt_chain, false);
       if (r) {
@@ -1433,7 +1995,7 @@ bool Blockchain::handle_alternative_block(const Block& b, const Crypto::Hash& id
 }
 
 bool Blockchain::getBlocks(uint32_t start_offset, uint32_t count, std::list<Block>& blocks, std::list<Transaction>& txs) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   if (start_offset >= m_blocks.size())
     return false;
   for (size_t i = start_offset; i < start_offset + count && i < m_blocks.size(); i++) {
@@ -1447,7 +2009,7 @@ bool Blockchain::getBlocks(uint32_t start_offset, uint32_t count, std::list<Bloc
 }
 
 bool Blockchain::getBlocks(uint32_t start_offset, uint32_t count, std::list<Block>& blocks) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   if (start_offset >= m_blocks.size()) {
     return false;
   }
@@ -1460,23 +2022,14 @@ bool Blockchain::getBlocks(uint32_t start_offset, uint32_t count, std::list<Bloc
 }
 
 bool Blockchain::handleGetObjects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NOTIFY_RESPONSE_GET_OBJECTS::request& rsp) { //Deprecated. Should be removed with CryptoNoteProtocolHandler.
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   rsp.current_blockchain_height = getCurrentBlockchainHeight();
-  std::list<Block> blocks;
-  getBlocks(arg.blocks, blocks, rsp.missed_ids);
-
-  for (const auto& bl : blocks) {
-    std::list<Crypto::Hash> missed_tx_id;
-    std::list<Transaction> txs;
-    getTransactions(bl.transactionHashes, txs, rsp.missed_ids);
-    if (!(!missed_tx_id.size())) { logger(ERROR, BRIGHT_RED) << "Internal error: have missed missed_tx_id.size()=" << missed_tx_id.size() << ENDL << "for block id = " << get_block_hash(bl); return false; } //WTF???
+
+  for (const auto& blockHash : arg.blocks) {
     rsp.blocks.push_back(block_complete_entry());
-    block_complete_entry& e = rsp.blocks.back();
-    //pack block
-    e.block = asString(toBinaryArray(bl));
-    //pack transactions
-    for (Transaction& tx : txs) {
-      e.txs.push_back(asString(toBinaryArray(tx)));
+    if (!getBlockCompleteEntry(blockHash, rsp.blocks.back())) {
+      rsp.blocks.pop_back();
+      rsp.missed_ids.push_back(blockHash);
     }
   }
 
@@ -1491,8 +2044,54 @@ bool Blockchain::handleGetObjects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NOTI
   return true;
 }
 
+bool Blockchain::getBlockCompleteEntry(uint32_t height, block_complete_entry& entry) {
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  if (height >= m_blocks.size()) {
+    return false;
+  }
+
+  // The block and its transactions are stored in blocks.dat in the same binary form they are
+  // sent in, so they are copied out of the stored item at the ranges recorded by pushBlockHeader.
+  Common::StringView item = m_blocks.serializedItem(height);
+  uint64_t layoutBegin = height == 0 ? 0 : m_blockHeaders[height - 1].layoutEnd;
+  uint64_t layoutEnd = m_blockHeaders[height].layoutEnd;
+  if (layoutBegin >= layoutEnd || layoutEnd > m_blockLayouts.size()) {
+    logger(ERROR, BRIGHT_RED) << "Stored block at height " << height << " has no layout";
+    return false;
+  }
+
+  for (uint64_t i = layoutBegin; i < layoutEnd; ++i) {
+    const ItemRange& range = m_blockLayouts[i];
+    if (static_cast<uint64_t>(range.offset) + range.size > item.getSize()) {
+      logger(ERROR, BRIGHT_RED) << "Stored block at height " << height << " does not match its layout";
+      return false;
+    }
+  }
+
+  const ItemRange& blockRange = m_blockLayouts[layoutBegin];
+  entry.block.assign(item.getData() + blockRange.offset, blockRange.size);
+  entry.txs.clear();
+  entry.txs.reserve(layoutEnd - layoutBegin - 1);
+  for (uint64_t i = layoutBegin + 1; i < layoutEnd; ++i) {
+    const ItemRange& range = m_blockLayouts[i];
+    entry.txs.emplace_back(item.getData() + range.offset, range.size);
+  }
+
+  return true;
+}
+
+bool Blockchain::getBlockCompleteEntry(const Crypto::Hash& blockHash, block_complete_entry& entry) {
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  uint32_t height;
+  if (!m_blockIndex.getBlockHeight(blockHash, height)) {
+    return false;
+  }
+
+  return getBlockCompleteEntry(height, entry);
+}
+
 bool Blockchain::getAlternativeBlocks(std::list<Block>& blocks) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   for (auto& alt_bl : m_alternative_chains) {
     blocks.push_back(alt_bl.second.bl);
   }
@@ -1501,12 +2100,12 @@ bool Blockchain::getAlternativeBlocks(std::list<Block>& blocks) {
 }
 
 uint32_t Blockchain::getAlternativeBlocksCount() {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   return static_cast<uint32_t>(m_alternative_chains.size());
 }
 
 bool Blockchain::add_out_to_get_random_outs(std::vector<std::pair<TransactionIndex, uint16_t>>& amount_outs, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& result_outs, uint64_t amount, size_t i) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   const Transaction& tx = transactionByIndex(amount_outs[i].first).tx;
   if (!(tx.outputs.size() > amount_outs[i].second)) {
     logger(ERROR, BRIGHT_RED) << "internal error: in global outs index, transaction out index="
@@ -1525,7 +2124,7 @@ bool Blockchain::add_out_to_get_random_outs(std::vector<std::pair<TransactionInd
 }
 
 size_t Blockchain::find_end_of_allowed_index(const std::vector<std::pair<TransactionIndex, uint16_t>>& amount_outs) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   if (amount_outs.empty()) {
     return 0;
   }
@@ -1542,7 +2141,7 @@ size_t Blockchain::find_end_of_allowed_index(const std::vector<std::pair<Transac
 }
 
 bool Blockchain::getRandomOutsByAmount(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response& res) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
   for (uint64_t amount : req.amounts) {
     COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& result_outs = *res.outs.insert(res.outs.end(), COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount());
@@ -1591,7 +2190,7 @@ uint32_t Blockchain::findBlockchainSupplement(const std::vector<Crypto::Hash>& q
   assert(!qblock_ids.empty());
   assert(qblock_ids.back() == m_blockIndex.getBlockId(0));
 
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   uint32_t blockIndex;
   // assert above guarantees that method returns true
   m_blockIndex.findSupplement(qblock_ids, blockIndex);
@@ -1599,17 +2198,17 @@ uint32_t Blockchain::findBlockchainSupplement(const std::vector<Crypto::Hash>& q
 }
 
 uint64_t Blockchain::blockDifficulty(size_t i) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   if (!(i < m_blocks.size())) { logger(ERROR, BRIGHT_RED) << "wrong block index i = " << i << " at Blockchain::block_difficulty()"; return false; }
   if (i == 0)
-    return m_blocks[i].cumulative_difficulty;
+    return m_blockHeaders[i].cumulativeDifficulty;
 
-  return m_blocks[i].cumulative_difficulty - m_blocks[i - 1].cumulative_difficulty;
+  return m_blockHeaders[i].cumulativeDifficulty - m_blockHeaders[i - 1].cumulativeDifficulty;
 }
 
 void Blockchain::print_blockchain(uint64_t start_index, uint64_t end_index) {
   std::stringstream ss;
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   if (start_index >= m_blocks.size()) {
     logger(INFO, BRIGHT_WHITE) <<
       "Wrong starter index set: " << start_index << ", expected max index " << m_blocks.size() - 1;
@@ -1629,7 +2228,7 @@ void Blockchain::print_blockchain(uint64_t start_index, uint64_t end_index) {
 
 void Blockchain::print_blockchain_index() {
   std::stringstream ss;
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
   std::vector<Crypto::Hash> blockIds = m_blockIndex.getBlockIds(0, std::numeric_limits<uint32_t>::max());
   logger(INFO, BRIGHT_WHITE) << "Current blockchain index:";
@@ -1643,7 +2242,7 @@ void Blockchain::print_blockchain_index() {
 
 void Blockchain::print_blockchain_outs(const std::string& file) {
   std::stringstream ss;
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   for (const outputs_container::value_type& v : m_outputs) {
     const std::vector<std::pair<TransactionIndex, uint16_t>>& vals = v.second;
     if (!vals.empty()) {
@@ -1669,7 +2268,7 @@ std::vector<Crypto::Hash> Blockchain::findBlockchainSupplement(const std::vector
   assert(!remoteBlockIds.empty());
   assert(remoteBlockIds.back() == m_blockIndex.getBlockId(0));
 
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   totalBlockCount = getCurrentBlockchainHeight();
   startBlockIndex = findBlockchainSupplement(remoteBlockIds);
 
@@ -1677,7 +2276,7 @@ std::vector<Crypto::Hash> Blockchain::findBlockchainSupplement(const std::vector
 }
 
 bool Blockchain::haveBlock(const Crypto::Hash& id) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   if (m_blockIndex.hasBlock(id))
     return true;
 
@@ -1688,12 +2287,12 @@ bool Blockchain::haveBlock(const Crypto::Hash& id) {
 }
 
 size_t Blockchain::getTotalTransactions() {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   return m_transactionMap.size();
 }
 
 bool Blockchain::getTransactionOutputGlobalIndexes(const Crypto::Hash& tx_id, std::vector<uint32_t>& indexs) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   auto it = m_transactionMap.find(tx_id);
   if (it == m_transactionMap.end()) {
     logger(WARNING, YELLOW) << "warning: get_tx_outputs_gindexs failed to find transaction with id = " << tx_id;
@@ -1711,7 +2310,7 @@ bool Blockchain::getTransactionOutputGlobalIndexes(const Crypto::Hash& tx_id, st
 }
 
 bool Blockchain::get_out_by_msig_gindex(uint64_t amount, uint64_t gindex, MultisignatureOutput& out) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   auto it = m_multisignatureOutputs.find(amount);
   if (it == m_multisignatureOutputs.end()) {
     return false;
@@ -1734,7 +2333,7 @@ bool Blockchain::get_out_by_msig_gindex(uint64_t amount, uint64_t gindex, Multis
 
 
 bool Blockchain::checkTransactionInputs(const Transaction& tx, uint32_t& max_used_block_height, Crypto::Hash& max_used_block_id, BlockInfo* tail) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
   if (tail)
     tail->id = getTailId(tail->height);
@@ -1758,24 +2357,23 @@ bool Blockchain::haveTransactionKeyImagesAsSpent(const Transaction &tx) {
   return false;
 }
 
-bool Blockchain::checkTransactionInputs(const Transaction& tx, uint32_t* pmax_used_block_height) {
+bool Blockchain::checkTransactionInputs(const Transaction& tx, uint32_t* pmax_used_block_height, std::vector<SignatureCheck>* deferredChecks) {
   Crypto::Hash tx_prefix_hash = getObjectHash(*static_cast<const TransactionPrefix*>(&tx));
-  return checkTransactionInputs(tx, tx_prefix_hash, pmax_used_block_height);
+  return checkTransactionInputs(tx, tx_prefix_hash, getObjectHash(tx), pmax_used_block_height, deferredChecks);
 }
 
-bool Blockchain::checkTransactionInputs(const Transaction& tx, const Crypto::Hash& tx_prefix_hash, uint32_t* pmax_used_block_height) {
+bool Blockchain::checkTransactionInputs(const Transaction& tx, const Crypto::Hash& tx_prefix_hash, const Crypto::Hash& transactionHash, uint32_t* pmax_used_block_height, std::vector<SignatureCheck>* deferredChecks) {
   size_t inputIndex = 0;
   if (pmax_used_block_height) {
     *pmax_used_block_height = 0;
   }
 
-  Crypto::Hash transactionHash = getObjectHash(tx);
   for (const auto& txin : tx.inputs) {
     assert(inputIndex < tx.signatures.size());
     if (txin.type() == typeid(KeyInput)) {
 
       const KeyInput& in_to_key = boost::get<KeyInput>(txin);
-      if (!(!in_to_key.outputIndexes.empty())) { logger(ERROR, BRIGHT_RED) << "empty in_to_key.outputIndexes in transaction with id " << getObjectHash(tx); return false; }
+      if (!(!in_to_key.outputIndexes.empty())) { logger(ERROR, BRIGHT_RED) << "empty in_to_key.outputIndexes in transaction with id " << transactionHash; return false; }
 
       if (have_tx_keyimg_as_spent(in_to_key.keyImage)) {
         logger(DEBUGGING) <<
@@ -1783,28 +2381,19 @@ bool Blockchain::checkTransactionInputs(const Transaction& tx, const Crypto::Has
         return false;
       }
 
-      if (!check_tx_input(in_to_key, tx_prefix_hash, tx.signatures[inputIndex], pmax_used_block_height)) {
+      if (!check_tx_input(in_to_key, tx_prefix_hash, tx.signatures[inputIndex], pmax_used_block_height, deferredChecks)) {
         logger(DEBUGGING, BRIGHT_WHITE) <<
           "Failed to check ring signature for tx " << transactionHash;
         return false;
       }
 
-        if (!isInCheckpointZone(getCurrentBlockchainHeight()))
-        {
-          if (!check_tx_input(in_to_key, tx_prefix_hash, tx.signatures[inputIndex], pmax_used_block_height))
-          {
-            logger(INFO, BRIGHT_WHITE) << "Failed to check input in transaction " << transactionHash;
-            return false;
-          }
-        }
-
         ++inputIndex;
       }
       else if (txin.type() == typeid(MultisignatureInput))
       {
         if (!isInCheckpointZone(getCurrentBlockchainHeight()))
         {
-          if (!validateInput(::boost::get<MultisignatureInput>(txin), transactionHash, tx_prefix_hash, tx.signatures[inputIndex]))
+          if (!validateInput(::boost::get<MultisignatureInput>(txin), transactionHash, tx_prefix_hash, tx.signatures[inputIndex], deferredChecks))
           {
             return false;
           }
@@ -1841,8 +2430,8 @@ bool Blockchain::is_tx_spendtime_unlocked(uint64_t unlock_time) {
   return false;
 }
 
-bool Blockchain::check_tx_input(const KeyInput& txin, const Crypto::Hash& tx_prefix_hash, const std::vector<Crypto::Signature>& sig, uint32_t* pmax_related_block_height) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+bool Blockchain::check_tx_input(const KeyInput& txin, const Crypto::Hash& tx_prefix_hash, const std::vector<Crypto::Signature>& sig, uint32_t* pmax_related_block_height, std::vector<SignatureCheck>* deferredChecks) {
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
   struct outputs_visitor {
     std::vector<const Crypto::PublicKey *>& m_results_collector;
@@ -1899,6 +2488,18 @@ bool Blockchain::check_tx_input(const KeyInput& txin, const Crypto::Hash& tx_pre
     return true;
   }
 
+  if (deferredChecks != nullptr) {
+    // output keys are copied: the blocks they point into may be evicted from the block cache
+    SignatureCheck check = { 0, tx_prefix_hash, txin.keyImage, {}, &sig, false };
+    check.keys.reserve(output_keys.size());
+    for (const Crypto::PublicKey* key : output_keys) {
+      check.keys.push_back(*key);
+    }
+
+    deferredChecks->push_back(std::move(check));
+    return true;
+  }
+
   bool check_tx_ring_signature = Crypto::check_ring_signature(tx_prefix_hash, txin.keyImage, output_keys, sig.data());
   if (!check_tx_ring_signature) {
     logger(DEBUGGING) << "Failed to check ring signature for keyImage: " << txin.keyImage;
@@ -1906,6 +2507,95 @@ bool Blockchain::check_tx_input(const KeyInput& txin, const Crypto::Hash& tx_pre
   return check_tx_ring_signature;
 }
 
+bool Blockchain::checkSignature(const SignatureCheck& check) {
+  const std::vector<Crypto::Signature>& signatures = *check.signatures;
+  if (!check.isMultisignature) {
+    std::vector<const Crypto::PublicKey*> keys;
+    keys.reserve(check.keys.size());
+    for (const Crypto::PublicKey& key : check.keys) {
+      keys.push_back(&key);
+    }
+
+    return Crypto::check_ring_signature(check.prefixHash, check.keyImage, keys, signatures.data());
+  }
+
+  size_t signatureIndex = 0;
+  size_t keyIndex = 0;
+  while (signatureIndex < signatures.size()) {
+    if (keyIndex == check.keys.size()) {
+      return false;
+    }
+
+    if (Crypto::check_signature(check.prefixHash, check.keys[keyIndex], signatures[signatureIndex])) {
+      ++signatureIndex;
+    }
+
+    ++keyIndex;
+  }
+
+  return true;
+}
+
+// Checks after a known failure are skipped, the ones before it still run, so that the
+// reported check is the first failing one whichever thread finds it.
+bool Blockchain::checkSignatures(const std::vector<SignatureCheck>& checks, size_t& failedCheck) {
+  std::atomic<size_t> firstFailed(checks.size());
+  m_workerPool.parallelFor(checks.size(), [&](size_t i) {
+    if (i > firstFailed.load(std::memory_order_relaxed)) {
+      return;
+    }
+
+    if (!checkSignature(checks[i])) {
+      size_t current = firstFailed.load();
+      while (i < current && !firstFailed.compare_exchange_weak(current, i)) {
+      }
+    }
+  });
+
+  failedCheck = firstFailed;
+  return failedCheck == checks.size();
+}
+
+void Blockchain::precomputeProofOfWork(const std::vector<const Block*>& blocks) {
+  std::vector<std::pair<Crypto::Hash, Crypto::Hash>> proofs(blocks.size(), std::make_pair(NULL_HASH, NULL_HASH));
+  m_workerPool.parallelFor(blocks.size(), [&](size_t i) {
+    const Block& block = *blocks[i];
+    if (m_checkpoints.is_in_checkpoint_zone(get_block_height(block))) {
+      return;
+    }
+
+    static thread_local Crypto::cn_context context;
+    if (get_block_longhash(context, block, proofs[i].second)) {
+      proofs[i].first = get_block_hash(block);
+    }
+  });
+
+  std::lock_guard<std::mutex> lock(m_precomputedProofOfWorkLock);
+  if (m_precomputedProofOfWork.size() > PRECOMPUTED_PROOF_OF_WORK_MAX_COUNT) {
+    m_precomputedProofOfWork.clear();
+  }
+
+  for (const auto& proof : proofs) {
+    if (proof.first != NULL_HASH) {
+      m_precomputedProofOfWork[proof.first] = proof.second;
+    }
+  }
+}
+
+bool Blockchain::checkProofOfWork(const Block& block, const Crypto::Hash& blockHash, difficulty_type currentDifficulty, Crypto::Hash& proofOfWork) {
+  {
+    std::lock_guard<std::mutex> lock(m_precomputedProofOfWorkLock);
+    auto it = m_precomputedProofOfWork.find(blockHash);
+    if (it != m_precomputedProofOfWork.end()) {
+      proofOfWork = it->second;
+      m_precomputedProofOfWork.erase(it);
+      return m_currency.checkProofOfWork(block, currentDifficulty, proofOfWork);
+    }
+  }
+
+  return m_currency.checkProofOfWork(m_cn_context, block, currentDifficulty, proofOfWork);
+}
+
 uint64_t Blockchain::get_adjusted_time() {
   //TODO: add collecting median time
   return time(NULL);
@@ -1945,7 +2635,7 @@ bool Blockchain::check_block_timestamp_main(const Block& b) {
 
   std::vector<uint64_t> timestamps;
  size_t offset = m_blocks.size() <= m_currency.timestampCheckWindow(b.majorVersion) ? 0 : m_blocks.size() - m_currency.timestampCheckWindow(b.majorVersion);  for (; offset != m_blocks.size(); ++offset) { 
-    timestamps.push_back(m_blocks[offset].bl.timestamp);
+    timestamps.push_back(m_blockHeaders[offset].timestamp);
   }
 
   return check_block_timestamp(std::move(timestamps), b);
@@ -2028,16 +2718,24 @@ bool Blockchain::checkCumulativeBlockSize(const Crypto::Hash& blockId, size_t cu
 }
 
 // Returns true, if cumulativeSize is calculated precisely, else returns false.
+// Sizes of known transactions are taken from the block layouts and the pool, none is copied or serialized.
 bool Blockchain::getBlockCumulativeSize(const Block& block, size_t& cumulativeSize) {
-  std::vector<Transaction> blockTxs;
-  std::vector<Crypto::Hash> missedTxs;
-  getTransactions(block.transactionHashes, blockTxs, missedTxs, true);
+  std::lock_guard<decltype(m_tx_pool)> txLock(m_tx_pool);
+  std::shared_lock<decltype(m_blockchain_lock)> bcLock(m_blockchain_lock);
 
   cumulativeSize = getObjectBinarySize(block.baseTransaction);
-  for (const Transaction& tx : blockTxs) {
-    cumulativeSize += getObjectBinarySize(tx);
+  std::vector<Crypto::Hash> poolTxs;
+  for (const Crypto::Hash& transactionHash : block.transactionHashes) {
+    auto it = m_transactionMap.find(transactionHash);
+    if (it == m_transactionMap.end()) {
+      poolTxs.push_back(transactionHash);
+    } else {
+      cumulativeSize += transactionBinarySize(it->second);
+    }
   }
 
+  std::vector<Crypto::Hash> missedTxs;
+  cumulativeSize += m_tx_pool.getTransactionsSize(poolTxs, missedTxs);
   return missedTxs.empty();
 }
 
@@ -2070,6 +2768,7 @@ bool Blockchain::addNewBlock(const Block& bl_, block_verification_context& bvc)
   }
 
   bool add_result;
+  bool autosave = false;
 
   { //to avoid deadlock lets lock tx_pool for whole add/reorganize process
     std::lock_guard<decltype(m_tx_pool)> poolLock(m_tx_pool);
@@ -2101,7 +2800,7 @@ bool Blockchain::addNewBlock(const Block& bl_, block_verification_context& bvc)
           if (m_blockchainAutosaveEnabled) {
             if (height % 720 == 0)
             {
-              storeCache();
+              autosave = true;
             }
           }
 
@@ -2109,6 +2808,11 @@ bool Blockchain::addNewBlock(const Block& bl_, block_verification_context& bvc)
       }
     }
 
+  // started after the pool and the exclusive lock are released, the cache is saved in the background
+  if (autosave) {
+    startCacheAutosave();
+  }
+
   if (add_result && bvc.m_added_to_main_chain) {
     m_observerManager.notify(&IBlockchainStorageObserver::blockchainUpdated);
   }
@@ -2120,8 +2824,18 @@ const Blockchain::TransactionEntry& Blockchain::transactionByIndex(TransactionIn
   return m_blocks[index.block].transactions[index.transaction];
 }
 
+// Precondition: m_blockchain_lock is locked. Only the miner transaction has no layout range of its own.
+size_t Blockchain::transactionBinarySize(TransactionIndex index) {
+  if (index.transaction == 0) {
+    return getObjectBinarySize(transactionByIndex(index).tx);
+  }
+
+  uint64_t layoutBegin = index.block == 0 ? 0 : m_blockHeaders[index.block - 1].layoutEnd;
+  return m_blockLayouts[layoutBegin + index.transaction].size;
+}
+
 bool Blockchain::pushBlock(const Block &blockData, const Crypto::Hash &id, block_verification_context &bvc, uint32_t height) {
-  std::vector<Transaction> transactions;
+  std::vector<CachedTransaction> transactions;
   if (!loadTransactions(blockData, transactions, height)) {
     bvc.m_verification_failed = true;
     return false;
@@ -2135,12 +2849,13 @@ bool Blockchain::pushBlock(const Block &blockData, const Crypto::Hash &id, block
   return true;
 }
 
-bool Blockchain::pushBlock(const Block &blockData, const std::vector<Transaction> &transactions, const Crypto::Hash &id, block_verification_context &bvc) {
+bool Blockchain::pushBlock(const Block &blockData, const std::vector<CachedTransaction> &transactions, const Crypto::Hash &id, block_verification_context &bvc) {
   std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
   auto blockProcessingStart = std::chrono::steady_clock::now();
 
-  Crypto::Hash blockHash = get_block_hash(blockData);
+  // every caller has already hashed blockData to get 'id'
+  const Crypto::Hash& blockHash = id;
 
   if (m_blockIndex.hasBlock(blockHash)) {
     logger(ERROR, BRIGHT_RED) <<
@@ -2195,7 +2910,7 @@ bool Blockchain::pushBlock(const Block &blockData, const std::vector<Transaction
       return false;
     }
   } else {
-    if (!m_currency.checkProofOfWork(m_cn_context, blockData, currentDifficulty, proof_of_work)) {
+    if (!checkProofOfWork(blockData, blockHash, currentDifficulty, proof_of_work)) {
       logger(INFO, BRIGHT_WHITE) <<
         "Block " << blockHash << ", has too weak proof of work: " << proof_of_work << ", expected difficulty: " << currentDifficulty;
       bvc.m_verification_failed = true;
@@ -2212,7 +2927,9 @@ bool Blockchain::pushBlock(const Block &blockData, const std::vector<Transaction
     return false;
   }
 
-  Crypto::Hash minerTransactionHash = getObjectHash(blockData.baseTransaction);
+  Crypto::Hash minerTransactionHash;
+  size_t coinbase_blob_size;
+  getObjectHash(blockData.baseTransaction, minerTransactionHash, coinbase_blob_size);
 
   BlockEntry block;
   block.bl = blockData;
@@ -2222,34 +2939,40 @@ bool Blockchain::pushBlock(const Block &blockData, const std::vector<Transaction
   TransactionIndex transactionIndex = { block.height, static_cast<uint16_t>(0) };
   pushTransaction(block, minerTransactionHash, transactionIndex);
 
-  size_t coinbase_blob_size = getObjectBinarySize(blockData.baseTransaction);
   size_t cumulative_block_size = coinbase_blob_size;
   uint64_t fee_summary = 0;
     uint64_t interestSummary = 0;
+  std::vector<SignatureCheck> signatureChecks;
 
     for (size_t i = 0; i < transactions.size(); ++i)
     {
       const Crypto::Hash &tx_id = blockData.transactionHashes[i];
       block.transactions.resize(block.transactions.size() + 1);
-      block.transactions.back().tx = transactions[i];
-      size_t blob_size = toBinaryArray(transactions[i]).size();
+      const Transaction& transaction = transactions[i].getTransaction();
+      block.transactions.back().tx = transaction;
+      size_t blob_size = transactions[i].getTransactionBinarySize();
 
-    uint64_t in_amount = m_currency.getTransactionAllInputsAmount(transactions[i], block.height);
-	  uint64_t out_amount = getOutputAmount(transactions[i]);
+    uint64_t in_amount = m_currency.getTransactionAllInputsAmount(transaction, block.height);
+	  uint64_t out_amount = getOutputAmount(transaction);
     uint64_t fee = in_amount < out_amount ? CryptoNote::parameters::MINIMUM_FEE : in_amount - out_amount;
 
     bool isTransactionValid = true;
-    if (block.bl.majorVersion < BLOCK_MAJOR_VERSION_8 && transactions[i].version > TRANSACTION_VERSION_1) {
+    if (block.bl.majorVersion < BLOCK_MAJOR_VERSION_8 && transaction.version > TRANSACTION_VERSION_1) {
       isTransactionValid = false;
-      logger(INFO, BRIGHT_WHITE) << "Block " << blockHash << " can't contain transaction " << tx_id << " because it has invalid version " << transactions[i].version;
+      logger(INFO, BRIGHT_WHITE) << "Block " << blockHash << " can't contain transaction " << tx_id << " because it has invalid version " << transaction.version;
     }
 
-    if (!checkTransactionInputs(transactions[i])) {
+    size_t firstSignatureCheck = signatureChecks.size();
+    if (!checkTransactionInputs(transaction, transactions[i].getTransactionPrefixHash(), transactions[i].getTransactionHash(), nullptr, &signatureChecks)) {
       isTransactionValid = false;
       logger(INFO, BRIGHT_WHITE) << "Block " << blockHash << " has at least one transaction with wrong inputs: " << tx_id;
     }
 
-    if (!check_tx_outputs(transactions[i], block.height)) {
+    for (size_t j = firstSignatureCheck; j < signatureChecks.size(); ++j) {
+      signatureChecks[j].transactionIndex = i;
+    }
+
+    if (!check_tx_outputs(transaction, block.height)) {
       isTransactionValid = false;
       logger(INFO, BRIGHT_WHITE) << "Transaction " << tx_id << " has at least one invalid output";
     }
@@ -2268,7 +2991,18 @@ bool Blockchain::pushBlock(const Block &blockData, const std::vector<Transaction
 
     cumulative_block_size += blob_size;
     fee_summary += fee;
-      interestSummary += m_currency.calculateTotalTransactionInterest(transactions[i], block.height);
+      interestSummary += m_currency.calculateTotalTransactionInterest(transaction, block.height);
+  }
+
+  // Key images and output references were checked above, in order; the signatures of
+  // the whole block are independent of each other and are verified in parallel.
+  size_t failedSignatureCheck;
+  if (!checkSignatures(signatureChecks, failedSignatureCheck)) {
+    logger(INFO, BRIGHT_WHITE) << "Block " << blockHash << " has at least one transaction with invalid signatures: " <<
+      blockData.transactionHashes[signatureChecks[failedSignatureCheck].transactionIndex];
+    bvc.m_verification_failed = true;
+    popTransactions(block, minerTransactionHash);
+    return false;
   }
 
   if (!checkCumulativeBlockSize(blockHash, cumulative_block_size, m_blocks.size())) {
@@ -2278,7 +3012,7 @@ bool Blockchain::pushBlock(const Block &blockData, const std::vector<Transaction
 
   int64_t emissionChange = 0;
   uint64_t reward = 0;
-  uint64_t already_generated_coins = m_blocks.empty() ? 0 : m_blocks.back().already_generated_coins;
+  uint64_t already_generated_coins = m_blocks.empty() ? 0 : m_blockHeaders.back().alreadyGeneratedCoins;
   if (!validate_miner_transaction(blockData, static_cast<uint32_t>(m_blocks.size()), cumulative_block_size, already_generated_coins, fee_summary, reward, emissionChange)) {
     logger(INFO, BRIGHT_WHITE) << "Block " << blockHash << " has invalid miner transaction";
     bvc.m_verification_failed = true;
@@ -2291,12 +3025,17 @@ bool Blockchain::pushBlock(const Block &blockData, const std::vector<Transaction
   block.cumulative_difficulty = currentDifficulty;
   block.already_generated_coins = already_generated_coins + emissionChange;
   if (m_blocks.size() > 0) {
-    block.cumulative_difficulty += m_blocks.back().cumulative_difficulty;
+    block.cumulative_difficulty += m_blockHeaders.back().cumulativeDifficulty;
   }
 
-  pushBlock(block);
+  pushBlock(block, blockHash);
     pushToDepositIndex(block, interestSummary);
 
+  BlockCacheChange cacheChange;
+  makeCacheChange(block, block.height, blockHash, minerTransactionHash, cacheChange);
+  cacheChange.interest = interestSummary;
+  journalCacheChange(CACHE_JOURNAL_BLOCK_PUSHED, cacheChange);
+
   auto block_processing_time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - blockProcessingStart).count();
 
   logger(DEBUGGING, YELLOW) <<
@@ -2324,18 +3063,18 @@ bool Blockchain::pushBlock(const Block &blockData, const std::vector<Transaction
 }
 
 uint64_t Blockchain::fullDepositAmount() const {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   return m_depositIndex.fullDepositAmount();
 }
 
 uint64_t Blockchain::depositAmountAtHeight(size_t height) const {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   return m_depositIndex.depositAmountAtHeight(static_cast<DepositIndex::DepositHeight>(height));
 }
 
   uint64_t Blockchain::depositInterestAtHeight(size_t height) const
   {
-    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+    std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
     return m_depositIndex.depositInterestAtHeight(static_cast<DepositIndex::DepositHeight>(height));
   }
 
@@ -2344,36 +3083,14 @@ uint64_t Blockchain::depositAmountAtHeight(size_t height) const {
     int64_t deposit = 0;
     for (const auto &tx : block.transactions)
     {
-      for (const auto &in : tx.tx.inputs)
-      {
-        if (in.type() == typeid(MultisignatureInput))
-        {
-          auto &multisign = boost::get<MultisignatureInput>(in);
-          if (multisign.term > 0)
-          {
-            deposit -= multisign.amount;
-          }
-        }
-      }
-      for (const auto &out : tx.tx.outputs)
-      {
-        if (out.target.type() == typeid(MultisignatureOutput))
-        {
-          auto &multisign = boost::get<MultisignatureOutput>(out.target);
-          if (multisign.term > 0)
-          {
-            deposit += out.amount;
-          }
-        }
-      }
+      deposit += getDepositChange(tx.tx);
     }
     m_depositIndex.pushBlock(deposit, interest);
   }
 
-bool Blockchain::pushBlock(BlockEntry &block) {
-  Crypto::Hash blockHash = get_block_hash(block.bl);
-
+bool Blockchain::pushBlock(BlockEntry &block, const Crypto::Hash &blockHash) {
   m_blocks.push_back(block);
+  pushBlockHeader(block);
   m_blockIndex.push(blockHash);
 
   m_timestampIndex.add(block.bl.timestamp, blockHash);
@@ -2381,6 +3098,129 @@ bool Blockchain::pushBlock(BlockEntry &block) {
 
   assert(m_blockIndex.size() == m_blocks.size());
 
+  m_tx_pool.on_blockchain_inc(m_blocks.size(), blockHash);
+  return true;
+}
+
+bool Blockchain::openBlockHeaders(const std::string& path, const std::string& layoutsPath) {
+  try {
+    try {
+      m_blockHeaders.open(path, Common::FileMappedVectorOpenMode::OPEN_OR_CREATE, sizeof(BlockHeadersPrefix));
+    } catch (std::exception& e) {
+      logger(WARNING, BRIGHT_YELLOW) << "Block headers file cannot be opened, recreating it: " << e.what();
+      std::error_code ec;
+      m_blockHeaders.close(ec);
+      m_blockHeaders.open(path, Common::FileMappedVectorOpenMode::CREATE, sizeof(BlockHeadersPrefix));
+    }
+
+    try {
+      m_blockLayouts.open(layoutsPath);
+    } catch (std::exception& e) {
+      logger(WARNING, BRIGHT_YELLOW) << "Block layouts file cannot be opened, recreating it: " << e.what();
+      std::error_code ec;
+      m_blockLayouts.close(ec);
+      m_blockLayouts.open(layoutsPath, Common::FileMappedVectorOpenMode::CREATE);
+    }
+
+    m_blockHeaders.setAutoFlush(false);
+    m_blockLayouts.setAutoFlush(false);
+    const BlockHeadersPrefix* prefix = reinterpret_cast<const BlockHeadersPrefix*>(m_blockHeaders.prefix());
+    if (prefix->version != CURRENT_BLOCKHEADERS_STORAGE_VER || prefix->headerSize != sizeof(BlockHeaderInfo)) {
+      if (!m_blockHeaders.empty()) {
+        logger(INFO, BRIGHT_WHITE) << "Block headers file has an unknown layout, it will be rebuilt";
+      }
+
+      // loadBlockHeaders refills the emptied files from m_blocks
+      clearBlockHeaders();
+      BlockHeadersPrefix* newPrefix = reinterpret_cast<BlockHeadersPrefix*>(m_blockHeaders.prefix());
+      newPrefix->version = CURRENT_BLOCKHEADERS_STORAGE_VER;
+      newPrefix->headerSize = sizeof(BlockHeaderInfo);
+      m_blockHeaders.flush();
+    }
+  } catch (std::exception& e) {
+    logger(ERROR, BRIGHT_RED) << "Failed to open block headers file: " << e.what();
+    return false;
+  }
+
+  return true;
+}
+
+// The block's ranges are counted the way m_blocks has just serialized it, in the order
+// BlockEntry::serialize writes its fields.
+void Blockchain::pushBlockHeader(const BlockEntry& block) {
+  BinaryCountingSerializer s;
+  s(const_cast<Block&>(block.bl), "block");
+  m_blockLayouts.push_back({ 0, static_cast<uint32_t>(s.getSize()) });
+
+  s(const_cast<uint32_t&>(block.height), "height");
+  s(const_cast<uint64_t&>(block.block_cumulative_size), "block_cumulative_size");
+  s(const_cast<difficulty_type&>(block.cumulative_difficulty), "cumulative_difficulty");
+  s(const_cast<uint64_t&>(block.already_generated_coins), "already_generated_coins");
+  size_t count = block.transactions.size();
+  s.beginArray(count, "transactions");
+  for (size_t i = 0; i < count; ++i) {
+    TransactionEntry& transaction = const_cast<TransactionEntry&>(block.transactions[i]);
+    size_t offset = s.getSize();
+    s(transaction.tx, "tx");
+    if (i != 0) {
+      m_blockLayouts.push_back({ static_cast<uint32_t>(offset), static_cast<uint32_t>(s.getSize() - offset) });
+    }
+
+    s(transaction.m_global_output_indexes, "indexes");
+  }
+
+  m_blockHeaders.push_back({ block.bl.timestamp, block.cumulative_difficulty, block.block_cumulative_size, block.already_generated_coins,
+    m_blockLayouts.size(), block.bl.majorVersion });
+}
+
+void Blockchain::popBlockHeader() {
+  m_blockHeaders.pop_back();
+  uint64_t layoutEnd = m_blockHeaders.empty() ? 0 : m_blockHeaders.back().layoutEnd;
+  while (m_blockLayouts.size() > layoutEnd) {
+    m_blockLayouts.pop_back();
+  }
+}
+
+void Blockchain::clearBlockHeaders() {
+  m_blockHeaders.clear();
+  m_blockLayouts.clear();
+}
+
+// Brings the block headers and layouts files in line with m_blocks after a restart. They are
+// written in lockstep, so after an unclean shutdown only the tail can differ and only the tail
+// is redone. A file of another version or layout has already been emptied by openBlockHeaders.
+bool Blockchain::loadBlockHeaders() {
+  while (m_blockHeaders.size() > m_blocks.size()) {
+    m_blockHeaders.pop_back();
+  }
+
+  while (!m_blockHeaders.empty()) {
+    const BlockHeaderInfo& header = m_blockHeaders.back();
+    const BlockEntry& block = m_blocks[m_blockHeaders.size() - 1];
+    if (header.timestamp == block.bl.timestamp && header.cumulativeDifficulty == block.cumulative_difficulty &&
+      header.alreadyGeneratedCoins == block.already_generated_coins && header.layoutEnd <= m_blockLayouts.size()) {
+      break;
+    }
+
+    m_blockHeaders.pop_back();
+  }
+
+  uint64_t layoutEnd = m_blockHeaders.empty() ? 0 : m_blockHeaders.back().layoutEnd;
+  while (m_blockLayouts.size() > layoutEnd) {
+    m_blockLayouts.pop_back();
+  }
+
+  if (m_blockHeaders.size() < m_blocks.size()) {
+    logger(INFO, BRIGHT_WHITE) << "Rebuilding block headers from height " << m_blockHeaders.size();
+    m_blockHeaders.reserve(m_blocks.size());
+    for (uint64_t b = m_blockHeaders.size(); b < m_blocks.size(); ++b) {
+      pushBlockHeader(m_blocks[b]);
+    }
+
+    m_blockHeaders.flush();
+    m_blockLayouts.flush();
+  }
+
   return true;
 }
 
@@ -2391,21 +3231,30 @@ void Blockchain::popBlock(const Crypto::Hash& blockHash) {
     return;
   }
 
-  std::vector<Transaction> transactions(m_blocks.back().transactions.size() - 1);
+  uint32_t height = m_blocks.size(); //height of popped block should be same as number of blocks
+
+  // returned to the pool with the hashes the block lists and the sizes its layout records
+  std::vector<CachedTransaction> transactions;
+  transactions.reserve(m_blocks.back().transactions.size() - 1);
   for (size_t i = 0; i < m_blocks.back().transactions.size() - 1; ++i) {
-    transactions[i] = m_blocks.back().transactions[1 + i].tx;
+    transactions.emplace_back(Transaction(m_blocks.back().transactions[1 + i].tx), m_blocks.back().bl.transactionHashes[i],
+      transactionBinarySize({ height - 1, static_cast<uint16_t>(1 + i) }));
   }
 
-  uint32_t height = m_blocks.size(); //height of popped block should be same as number of blocks
   saveTransactions(transactions, height);
 
-  popTransactions(m_blocks.back(), getObjectHash(m_blocks.back().bl.baseTransaction));
+  Crypto::Hash minerTransactionHash = getObjectHash(m_blocks.back().bl.baseTransaction);
+  BlockCacheChange cacheChange;
+  makeCacheChange(m_blocks.back(), height - 1, blockHash, minerTransactionHash, cacheChange);
+  journalCacheChange(CACHE_JOURNAL_BLOCK_POPPED, cacheChange);
+  popTransactions(m_blocks.back(), minerTransactionHash);
 
   m_timestampIndex.remove(m_blocks.back().bl.timestamp, blockHash);
   m_generatedTransactionsIndex.remove(m_blocks.back().bl);
 
   m_depositIndex.popBlock();
   m_blocks.pop_back();
+  popBlockHeader();
   m_blockIndex.pop();
 
   assert(m_blockIndex.size() == m_blocks.size());
@@ -2597,7 +3446,7 @@ void Blockchain::popTransactions(const BlockEntry& block, const Crypto::Hash& mi
   popTransaction(block.bl.baseTransaction, minerTransactionHash);
 }
 
-bool Blockchain::validateInput(const MultisignatureInput& input, const Crypto::Hash& transactionHash, const Crypto::Hash& transactionPrefixHash, const std::vector<Crypto::Signature>& transactionSignatures) {
+bool Blockchain::validateInput(const MultisignatureInput& input, const Crypto::Hash& transactionHash, const Crypto::Hash& transactionPrefixHash, const std::vector<Crypto::Signature>& transactionSignatures, std::vector<SignatureCheck>* deferredChecks) {
   assert(input.signatureCount == transactionSignatures.size());
   MultisignatureOutputsContainer::const_iterator amountOutputs = m_multisignatureOutputs.find(input.amount);
   if (amountOutputs == m_multisignatureOutputs.end()) {
@@ -2645,6 +3494,11 @@ bool Blockchain::validateInput(const MultisignatureInput& input, const Crypto::H
     return false;
   }
 
+  if (deferredChecks != nullptr) {
+    deferredChecks->push_back({ 0, transactionPrefixHash, Crypto::KeyImage(), output.keys, &transactionSignatures, true });
+    return true;
+  }
+
   size_t inputSignatureIndex = 0;
   size_t outputKeyIndex = 0;
   while (inputSignatureIndex < input.signatureCount) {
@@ -2666,6 +3520,7 @@ bool Blockchain::validateInput(const MultisignatureInput& input, const Crypto::H
 
   bool Blockchain::rollbackBlockchainTo(uint32_t height)
   {
+    std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
     logger(INFO) << "Rolling back blockchain to " << height;
     while (height + 1 < m_blocks.size())
     {
@@ -2684,23 +3539,31 @@ bool Blockchain::validateInput(const MultisignatureInput& input, const Crypto::H
   }
 
   logger(DEBUGGING) << "Removing last block with height " << m_blocks.back().height;
-  popTransactions(m_blocks.back(), getObjectHash(m_blocks.back().bl.baseTransaction));
-
+  Crypto::Hash minerTransactionHash = getObjectHash(m_blocks.back().bl.baseTransaction);
   Crypto::Hash blockHash = getBlockIdByHeight(m_blocks.back().height);
+  BlockCacheChange cacheChange;
+  makeCacheChange(m_blocks.back(), static_cast<uint32_t>(m_blocks.size() - 1), m_blockIndex.getTailId(), minerTransactionHash, cacheChange);
+  journalCacheChange(CACHE_JOURNAL_BLOCK_REMOVED, cacheChange);
+  popTransactions(m_blocks.back(), minerTransactionHash);
+
   m_timestampIndex.remove(m_blocks.back().bl.timestamp, blockHash);
   m_generatedTransactionsIndex.remove(m_blocks.back().bl);
 
   m_blocks.pop_back();
+  popBlockHeader();
   m_blockIndex.pop();
 
   assert(m_blockIndex.size() == m_blocks.size());
+  // rollbackBlockchainTo pops through here too, and checks cached by the pool must not outlive the block
+  m_tx_pool.on_blockchain_dec(m_blocks.size(), getTailId());
+  return true;
 }
 
 bool Blockchain::checkUpgradeHeight(const UpgradeDetector& upgradeDetector) {
   uint32_t upgradeHeight = upgradeDetector.upgradeHeight();
   if (upgradeHeight != UpgradeDetectorBase::UNDEF_HEIGHT && upgradeHeight + 1 < m_blocks.size()) {
     logger(INFO) << "Checking block version at " << upgradeHeight + 1;
-    if (m_blocks[upgradeHeight + 1].bl.majorVersion != upgradeDetector.targetVersion()) {
+    if (m_blockHeaders[upgradeHeight + 1].majorVersion != upgradeDetector.targetVersion()) {
       return false;
     }
   }
@@ -2709,28 +3572,28 @@ bool Blockchain::checkUpgradeHeight(const UpgradeDetector& upgradeDetector) {
 }
 
 bool Blockchain::getLowerBound(uint64_t timestamp, uint64_t startOffset, uint32_t& height) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
   assert(startOffset < m_blocks.size());
 
-  auto bound = std::lower_bound(m_blocks.begin() + startOffset, m_blocks.end(), timestamp - m_currency.blockFutureTimeLimit(),
-    [](const BlockEntry& b, uint64_t timestamp) { return b.bl.timestamp < timestamp; });
+  auto bound = std::lower_bound(m_blockHeaders.cbegin() + startOffset, m_blockHeaders.cend(), timestamp - m_currency.blockFutureTimeLimit(),
+    [](const BlockHeaderInfo& b, uint64_t timestamp) { return b.timestamp < timestamp; });
 
-  if (bound == m_blocks.end()) {
+  if (bound == m_blockHeaders.cend()) {
     return false;
   }
 
-  height = static_cast<uint32_t>(std::distance(m_blocks.begin(), bound));
+  height = static_cast<uint32_t>(std::distance(m_blockHeaders.cbegin(), bound));
   return true;
 }
 
 std::vector<Crypto::Hash> Blockchain::getBlockIds(uint32_t startHeight, uint32_t maxCount) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   return m_blockIndex.getBlockIds(startHeight, maxCount);
 }
 
 bool Blockchain::getBlockContainingTransaction(const Crypto::Hash& txId, Crypto::Hash& blockId, uint32_t& blockHeight) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   auto it = m_transactionMap.find(txId);
   if (it == m_transactionMap.end()) {
     return false;
@@ -2742,12 +3605,12 @@ bool Blockchain::getBlockContainingTransaction(const Crypto::Hash& txId, Crypto:
 }
 
 bool Blockchain::getAlreadyGeneratedCoins(const Crypto::Hash& hash, uint64_t& generatedCoins) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
   // try to find block in main chain
   uint32_t height = 0;
   if (m_blockIndex.getBlockHeight(hash, height)) {
-    generatedCoins = m_blocks[height].already_generated_coins;
+    generatedCoins = m_blockHeaders[height].alreadyGeneratedCoins;
     return true;
   }
 
@@ -2763,12 +3626,12 @@ bool Blockchain::getAlreadyGeneratedCoins(const Crypto::Hash& hash, uint64_t& ge
 }
 
 bool Blockchain::getBlockSize(const Crypto::Hash& hash, size_t& size) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
   // try to find block in main chain
   uint32_t height = 0;
   if (m_blockIndex.getBlockHeight(hash, height)) {
-    size = m_blocks[height].block_cumulative_size;
+    size = m_blockHeaders[height].blockCumulativeSize;
     return true;
   }
 
@@ -2783,8 +3646,28 @@ bool Blockchain::getBlockSize(const Crypto::Hash& hash, size_t& size) {
   return false;
 }
 
+bool Blockchain::getBlockBinarySizes(const Crypto::Hash& hash, size_t& blockSize, std::vector<size_t>& transactionSizes) {
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+
+  uint32_t height = 0;
+  if (!m_blockIndex.getBlockHeight(hash, height)) {
+    return false;
+  }
+
+  uint64_t layoutBegin = height == 0 ? 0 : m_blockHeaders[height - 1].layoutEnd;
+  uint64_t layoutEnd = m_blockHeaders[height].layoutEnd;
+  blockSize = m_blockLayouts[layoutBegin].size;
+  transactionSizes.clear();
+  transactionSizes.reserve(layoutEnd - layoutBegin - 1);
+  for (uint64_t i = layoutBegin + 1; i < layoutEnd; ++i) {
+    transactionSizes.push_back(m_blockLayouts[i].size);
+  }
+
+  return true;
+}
+
 bool Blockchain::getMultisigOutputReference(const MultisignatureInput& txInMultisig, std::pair<Crypto::Hash, size_t>& outputReference) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   MultisignatureOutputsContainer::const_iterator amountIter = m_multisignatureOutputs.find(txInMultisig.amount);
   if (amountIter == m_multisignatureOutputs.end()) {
     logger(DEBUGGING) << "Transaction contains multisignature input with invalid amount.";
@@ -2851,49 +3734,56 @@ bool Blockchain::loadBlockchainIndices() {
 }
 
 bool Blockchain::getGeneratedTransactionsNumber(uint32_t height, uint64_t& generatedTransactions) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   return m_generatedTransactionsIndex.find(height, generatedTransactions);
 }
 
 bool Blockchain::getOrphanBlockIdsByHeight(uint32_t height, std::vector<Crypto::Hash>& blockHashes) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   return m_orthanBlocksIndex.find(height, blockHashes);
 }
 
 bool Blockchain::getBlockIdsByTimestamp(uint64_t timestampBegin, uint64_t timestampEnd, uint32_t blocksNumberLimit, std::vector<Crypto::Hash>& hashes, uint32_t& blocksNumberWithinTimestamps) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   return m_timestampIndex.find(timestampBegin, timestampEnd, blocksNumberLimit, hashes, blocksNumberWithinTimestamps);
 }
 
 bool Blockchain::getTransactionIdsByPaymentId(const Crypto::Hash& paymentId, std::vector<Crypto::Hash>& transactionHashes) {
-  std::lock_guard<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
+  std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
   return m_paymentIdIndex.find(paymentId, transactionHashes);
 }
 
-bool Blockchain::loadTransactions(const Block& block, std::vector<Transaction>& transactions, uint32_t height) {
-  transactions.resize(block.transactionHashes.size());
+bool Blockchain::loadTransactions(const Block& block, std::vector<CachedTransaction>& transactions, uint32_t height) {
+  transactions.clear();
+  transactions.reserve(block.transactionHashes.size());
+  Transaction transaction;
   size_t transactionSize;
   uint64_t fee;
   for (size_t i = 0; i < block.transactionHashes.size(); ++i) {
-    if (!m_tx_pool.take_tx(block.transactionHashes[i], transactions[i], transactionSize, fee)) {
+    if (!m_tx_pool.take_tx(block.transactionHashes[i], transaction, transactionSize, fee)) {
       tx_verification_context context;
       for (size_t j = 0; j < i; ++j) {
-        if (!m_tx_pool.add_tx(transactions[i - 1 - j], context, true, height)) {
+        const CachedTransaction& taken = transactions[i - 1 - j];
+        if (!m_tx_pool.add_tx(taken.getTransaction(), taken.getTransactionHash(), taken.getTransactionBinarySize(), context, true, height)) {
           throw std::runtime_error("Blockchain::loadTransactions, failed to add transaction to pool");
         }
       }
 
       return false;
     }
+
+    // the pool keys transactions by their hash and keeps their size, neither is computed again
+    transactions.emplace_back(std::move(transaction), block.transactionHashes[i], transactionSize);
   }
 
   return true;
 }
 
-void Blockchain::saveTransactions(const std::vector<Transaction>& transactions, uint32_t height) {
+void Blockchain::saveTransactions(const std::vector<CachedTransaction>& transactions, uint32_t height) {
   tx_verification_context context;
   for (size_t i = 0; i < transactions.size(); ++i) {
-    if (!m_tx_pool.add_tx(transactions[transactions.size() - 1 - i], context, true, height)) {
+    const CachedTransaction& transaction = transactions[transactions.size() - 1 - i];
+    if (!m_tx_pool.add_tx(transaction.getTransaction(), transaction.getTransactionHash(), transaction.getTransactionBinarySize(), context, true, height)) {
       logger(WARNING, BRIGHT_MAGENTA) << "Blockchain::saveTransactions, failed to add transaction to pool";
     }
   }
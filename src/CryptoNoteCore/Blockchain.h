@@ -19,20 +19,28 @@
 #pragma once
 
 #include <atomic>
+#include <fstream>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
 
 #include "google/sparse_hash_set"
 #include "google/sparse_hash_map"
 #include <parallel_hashmap/phmap.h>
 
+#include "Common/FileMappedVector.h"
 #include "Common/ObserverManager.h"
+#include "Common/RecursiveSharedMutex.h"
+#include "Common/ThreadPool.h"
 #include "Common/Util.h"
 #include "CryptoNoteCore/BlockIndex.h"
+#include "CryptoNoteCore/CachedTransaction.h"
 #include "CryptoNoteCore/Checkpoints.h"
 #include "CryptoNoteCore/Currency.h"
 #include "CryptoNoteCore/DepositIndex.h"
 #include "CryptoNoteCore/IBlockchainStorageObserver.h"
 #include "CryptoNoteCore/ITransactionValidator.h"
-#include "CryptoNoteCore/SwappedVector.h"
+#include "CryptoNoteCore/MappedVector.h"
 #include "CryptoNoteCore/UpgradeDetector.h"
 #include "CryptoNoteCore/CryptoNoteFormatUtils.h"
 #include "CryptoNoteCore/TransactionPool.h"
@@ -49,6 +57,7 @@ using phmap::parallel_flat_hash_map;
 namespace CryptoNote {
   struct NOTIFY_REQUEST_GET_OBJECTS_request;
   struct NOTIFY_RESPONSE_GET_OBJECTS_request;
+  struct block_complete_entry;
   struct COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_request;
   struct COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_response;
   struct COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_outs_for_amount;
@@ -57,6 +66,7 @@ namespace CryptoNote {
   class Blockchain : public CryptoNote::ITransactionValidator {
   public:
     Blockchain(const Currency &currency, tx_memory_pool &tx_pool, Logging::ILogger &logger, bool blockchainIndexesEnabled, bool blockchainAutosaveEnabled);
+    ~Blockchain();
 
     bool addObserver(IBlockchainStorageObserver* observer);
     bool removeObserver(IBlockchainStorageObserver* observer);
@@ -100,6 +110,10 @@ namespace CryptoNote {
     uint8_t getBlockMajorVersionForHeight(uint32_t height) const;
     uint8_t blockMajorVersion;
     bool addNewBlock(const Block& bl_, block_verification_context& bvc);
+    // Computes the proof of work hashes of blocks that are about to be added on the worker
+    // pool, so that addNewBlock only compares them with the difficulty. Blocks inside the
+    // checkpoint zone are skipped, as their proof of work is never checked.
+    void precomputeProofOfWork(const std::vector<const Block*>& blocks);
     bool resetAndSetGenesisBlock(const Block& b);
     bool haveBlock(const Crypto::Hash& id);
     size_t getTotalTransactions();
@@ -109,6 +123,9 @@ namespace CryptoNote {
     std::vector<Crypto::Hash> findBlockchainSupplement(const std::vector<Crypto::Hash>& remoteBlockIds, size_t maxCount,
       uint32_t& totalBlockCount, uint32_t& startBlockIndex);
     bool handleGetObjects(NOTIFY_REQUEST_GET_OBJECTS_request& arg, NOTIFY_RESPONSE_GET_OBJECTS_request& rsp); //Deprecated. Should be removed with CryptoNoteProtocolHandler.
+    // Copies the stored binary forms of a main chain block and its transactions, nothing is re-serialized.
+    bool getBlockCompleteEntry(uint32_t height, block_complete_entry& entry);
+    bool getBlockCompleteEntry(const Crypto::Hash& blockHash, block_complete_entry& entry);
     bool getRandomOutsByAmount(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_response& res);
     bool getBackwardBlocksSize(size_t from_height, std::vector<size_t>& sz, size_t count);
     bool getTransactionOutputGlobalIndexes(const Crypto::Hash& tx_id, std::vector<uint32_t>& indexs);
@@ -119,6 +136,8 @@ namespace CryptoNote {
     bool getBlockContainingTransaction(const Crypto::Hash& txId, Crypto::Hash& blockId, uint32_t& blockHeight);
     bool getAlreadyGeneratedCoins(const Crypto::Hash& hash, uint64_t& generatedCoins);
     bool getBlockSize(const Crypto::Hash& hash, size_t& size);
+    // Sizes of a main chain block and of its transactions but the miner's, read from the stored layout.
+    bool getBlockBinarySizes(const Crypto::Hash& hash, size_t& blockSize, std::vector<size_t>& transactionSizes);
     bool getMultisigOutputReference(const MultisignatureInput& txInMultisig, std::pair<Crypto::Hash, size_t>& outputReference);
     bool getGeneratedTransactionsNumber(uint32_t height, uint64_t& generatedTransactions);
     bool getOrphanBlockIdsByHeight(uint32_t height, std::vector<Crypto::Hash>& blockHashes);
@@ -140,7 +159,7 @@ namespace CryptoNote {
 
     template<class t_ids_container, class t_blocks_container, class t_missed_container>
     bool getBlocks(const t_ids_container& block_ids, t_blocks_container& blocks, t_missed_container& missed_bs) {
-      std::lock_guard<std::recursive_mutex> lk(m_blockchain_lock);
+      std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
 
       for (const auto& bl_id : block_ids) {
         uint32_t height = 0;
@@ -158,7 +177,7 @@ namespace CryptoNote {
 
     template<class t_ids_container, class t_tx_container, class t_missed_container>
     void getBlockchainTransactions(const t_ids_container& txs_ids, t_tx_container& txs, t_missed_container& missed_txs) {
-      std::lock_guard<decltype(m_blockchain_lock)> bcLock(m_blockchain_lock);
+      std::shared_lock<decltype(m_blockchain_lock)> bcLock(m_blockchain_lock);
 
       for (const auto& tx_id : txs_ids) {
         auto it = m_transactionMap.find(tx_id);
@@ -204,6 +223,9 @@ namespace CryptoNote {
     bool rollbackBlockchainTo(uint32_t height);
     bool have_tx_keyimg_as_spent(const Crypto::KeyImage &key_im);
 
+    // Workers of the block checks, also used by the core to check incoming transactions.
+    Tools::ThreadPool& getWorkerPool() { return m_workerPool; }
+
   private:
 
     struct MultisignatureOutputUsage {
@@ -246,6 +268,86 @@ namespace CryptoNote {
       }
     };
 
+    struct OutputCacheChange {
+      uint64_t amount;
+      uint16_t index;
+      bool isMultisignature;
+
+      void serialize(ISerializer& s) {
+        s(amount, "amount");
+        s(index, "index");
+        s(isMultisignature, "multisig");
+      }
+    };
+
+    struct TransactionCacheChange {
+      Crypto::Hash hash;
+      std::vector<Crypto::KeyImage> keyImages;
+      std::vector<std::pair<uint64_t, uint32_t>> multisignatureInputs; // amount, output index
+      std::vector<OutputCacheChange> outputs;
+
+      void serialize(ISerializer& s) {
+        s(hash, "hash");
+        s(keyImages, "key_images");
+        s(multisignatureInputs, "multisig_inputs");
+        s(outputs, "outputs");
+      }
+    };
+
+    // What a block adds to the cache: a batch item of replayBlocks and a record of the cache journal.
+    struct BlockCacheChange {
+      uint32_t height;
+      Crypto::Hash hash;
+      std::vector<TransactionCacheChange> transactions;
+      uint64_t interest;
+      int64_t depositChange;
+
+      void serialize(ISerializer& s) {
+        s(height, "height");
+        s(hash, "hash");
+        s(transactions, "transactions");
+        s(interest, "interest");
+        s(depositChange, "deposit_change");
+      }
+    };
+
+    // Per-height facts used by the difficulty, timestamp and block size windows, kept
+    // apart from BlockEntry so that these windows never have to decode whole blocks.
+    struct BlockHeaderInfo {
+      uint64_t timestamp;
+      difficulty_type cumulativeDifficulty;
+      uint64_t blockCumulativeSize;
+      uint64_t alreadyGeneratedCoins;
+      uint64_t layoutEnd; // end of the block's ranges in m_blockLayouts, which begin at the previous block's layoutEnd
+      uint8_t majorVersion;
+      uint8_t reserved[7]; // explicit padding, so that no uninitialized bytes reach the file
+    };
+
+    // Bytes of a blocks.dat item holding the block or one of its transactions in the binary form
+    // block_complete_entry carries them in. Recorded as the block is pushed, the block first and
+    // then every transaction but the miner's, so that serving a block only copies these ranges.
+    struct ItemRange {
+      uint32_t offset;
+      uint32_t size;
+    };
+
+    // Leads the block headers file. A file written for another version or layout is rebuilt.
+    struct BlockHeadersPrefix {
+      uint32_t version;
+      uint32_t headerSize;
+    };
+
+    // Signature check collected while a block's inputs are validated and run later,
+    // together with the rest of the block's checks, on m_workerPool.
+    struct SignatureCheck {
+      size_t transactionIndex;
+      Crypto::Hash prefixHash;
+      Crypto::KeyImage keyImage;
+      std::vector<Crypto::PublicKey> keys;
+      const std::vector<Crypto::Signature>* signatures;
+      bool isMultisignature;
+    };
+
     typedef parallel_flat_hash_map<Crypto::KeyImage, uint32_t> key_images_container;
     typedef parallel_flat_hash_map<Crypto::Hash, BlockEntry> blocks_ext_by_hash;
     typedef parallel_flat_hash_map<uint64_t, std::vector<std::pair<TransactionIndex, uint16_t>>> outputs_container; //Crypto::Hash - tx hash, size_t - index of out in transaction
@@ -253,7 +355,7 @@ namespace CryptoNote {
 
     const Currency& m_currency;
     tx_memory_pool& m_tx_pool;
-    mutable std::recursive_mutex m_blockchain_lock; // TODO: add here reader/writer lock
+    mutable Tools::RecursiveSharedMutex m_blockchain_lock; // shared for queries, exclusive while the chain changes
     Crypto::cn_context m_cn_context;
     Tools::ObserverManager<IBlockchainStorageObserver> m_observerManager;
 
@@ -266,15 +368,30 @@ namespace CryptoNote {
     Checkpoints m_checkpoints;
     std::atomic<bool> m_is_in_checkpoint_zone;
 
-    typedef SwappedVector<BlockEntry> Blocks;
+    typedef MappedVector<BlockEntry> Blocks;
+    typedef Common::FileMappedVector<BlockHeaderInfo> BlockHeaders;
+    typedef Common::FileMappedVector<ItemRange> BlockLayouts;
     typedef parallel_flat_hash_map<Crypto::Hash, uint32_t> BlockMap;
     typedef parallel_flat_hash_map<Crypto::Hash, TransactionIndex> TransactionMap;
     typedef BasicUpgradeDetector<Blocks> UpgradeDetector;
 
+    // The structures the cache is made of. The live cache is made of Blockchain's members, autosave
+    // builds its snapshot in a set of its own.
+    struct BlockCacheState {
+      BlockIndex& blockIndex;
+      TransactionMap& transactionMap;
+      key_images_container& spentKeys;
+      outputs_container& outputs;
+      MultisignatureOutputsContainer& multisignatureOutputs;
+      DepositIndex& depositIndex;
+    };
+
     friend class BlockCacheSerializer;
     friend class BlockchainIndicesSerializer;
 
     Blocks m_blocks;
+    BlockHeaders m_blockHeaders;
+    BlockLayouts m_blockLayouts;
     CryptoNote::BlockIndex m_blockIndex;
     CryptoNote::DepositIndex m_depositIndex;
     TransactionMap m_transactionMap;
@@ -299,6 +416,14 @@ namespace CryptoNote {
     IntrusiveLinkedList<MessageQueue<BlockchainMessage>> m_messageQueueList;
 
     Logging::LoggerRef logger;
+    Tools::ThreadPool m_workerPool;
+    std::ofstream m_cacheJournal;
+    std::mutex m_storeCacheLock;
+    std::thread m_cacheSaveThread; // autosave folding the previous cache journal, joined under m_storeCacheLock
+    std::atomic<bool> m_cacheSaveRunning;
+    uint64_t m_cacheJournalGeneration; // bumped whenever the journal is started over, autosave gives up if it changes
+    std::unordered_map<Crypto::Hash, Crypto::Hash> m_precomputedProofOfWork; // block hash -> proof of work
+    std::mutex m_precomputedProofOfWorkLock;
 
 
     bool switch_to_alternative_blockchain(std::list<blocks_ext_by_hash::iterator> &alt_chain, bool discard_disconnected_chain);
@@ -307,7 +432,7 @@ namespace CryptoNote {
     void pushToDepositIndex(const BlockEntry &block, uint64_t interest);
     bool prevalidate_miner_transaction(const Block &b, uint32_t height);
     bool validate_miner_transaction(const Block &b, uint32_t height, size_t cumulativeBlockSize, uint64_t alreadyGeneratedCoins, uint64_t fee, uint64_t &reward, int64_t &emissionChange);
-    bool rollback_blockchain_switching(std::list<Block> &original_chain, size_t rollback_height);
+    bool rollback_blockchain_switching(std::list<std::pair<Crypto::Hash, Block>> &original_chain, size_t rollback_height);
     bool get_last_n_blocks_sizes(std::vector<size_t> &sz, size_t count);
     bool add_out_to_get_random_outs(std::vector<std::pair<TransactionIndex, uint16_t>> &amount_outs, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS_outs_for_amount &result_outs, uint64_t amount, size_t i);
     bool is_tx_spendtime_unlocked(uint64_t unlock_time);
@@ -322,19 +447,44 @@ namespace CryptoNote {
     std::vector<Crypto::Hash> doBuildSparseChain(const Crypto::Hash& startBlockId) const;
     bool getBlockCumulativeSize(const Block& block, size_t& cumulativeSize);
     bool update_next_comulative_size_limit();
-    bool check_tx_input(const KeyInput& txin, const Crypto::Hash& tx_prefix_hash, const std::vector<Crypto::Signature>& sig, uint32_t* pmax_related_block_height = NULL);
-    bool checkTransactionInputs(const Transaction& tx, const Crypto::Hash& tx_prefix_hash, uint32_t* pmax_used_block_height = NULL);
-    bool checkTransactionInputs(const Transaction& tx, uint32_t* pmax_used_block_height = NULL);
+    bool check_tx_input(const KeyInput& txin, const Crypto::Hash& tx_prefix_hash, const std::vector<Crypto::Signature>& sig, uint32_t* pmax_related_block_height = NULL, std::vector<SignatureCheck>* deferredChecks = NULL);
+    bool checkTransactionInputs(const Transaction& tx, const Crypto::Hash& tx_prefix_hash, const Crypto::Hash& transactionHash, uint32_t* pmax_used_block_height = NULL, std::vector<SignatureCheck>* deferredChecks = NULL);
+    bool checkTransactionInputs(const Transaction& tx, uint32_t* pmax_used_block_height = NULL, std::vector<SignatureCheck>* deferredChecks = NULL);
+    static bool checkSignature(const SignatureCheck& check);
+    bool checkSignatures(const std::vector<SignatureCheck>& checks, size_t& failedCheck);
+    bool checkProofOfWork(const Block& block, const Crypto::Hash& blockHash, difficulty_type currentDifficulty, Crypto::Hash& proofOfWork);
     bool check_tx_outputs(const Transaction& tx, uint32_t height) const;
     const TransactionEntry& transactionByIndex(TransactionIndex index);
+    size_t transactionBinarySize(TransactionIndex index);
     bool pushBlock(const Block &blockData, const Crypto::Hash &id, block_verification_context &bvc, uint32_t height);
-    bool pushBlock(const Block &blockData, const std::vector<Transaction> &transactions, const Crypto::Hash &id, block_verification_context &bvc);
-    bool pushBlock(BlockEntry &block);
+    bool pushBlock(const Block &blockData, const std::vector<CachedTransaction> &transactions, const Crypto::Hash &id, block_verification_context &bvc);
+    bool pushBlock(BlockEntry &block, const Crypto::Hash &blockHash);
+    bool openBlockHeaders(const std::string& path, const std::string& layoutsPath);
+    void pushBlockHeader(const BlockEntry& block);
+    void popBlockHeader();
+    void clearBlockHeaders();
+    bool loadBlockHeaders();
+    void replayBlocks(uint32_t startHeight);
+    void makeCacheChange(const BlockEntry& block, uint32_t height, const Crypto::Hash& blockHash, const Crypto::Hash& minerTransactionHash, BlockCacheChange& change) const;
+    BlockCacheState liveCache();
+    static void applyCacheChange(const BlockCacheState& cache, const BlockCacheChange& change);
+    static void applyOrderedCacheChange(const BlockCacheState& cache, const BlockCacheChange& change);
+    static void undoCacheChange(const BlockCacheState& cache, const BlockCacheChange& change, bool popDeposit);
+    bool writeCacheFiles(const BlockCacheState& cache, const Crypto::Hash& tailId);
+    bool replaceCacheFiles();
+    void startCacheAutosave();
+    void foldCacheJournal(uint64_t generation);
+    void openCacheJournal(bool truncate);
+    void startCacheJournal();
+    void restartCacheJournal();
+    void journalCacheChange(uint8_t type, const BlockCacheChange& change);
+    bool replayCacheJournal(const Crypto::Hash& cacheTail);
+    bool replayCacheJournalFile(const std::string& path, std::vector<BlockCacheChange>& pushedBlocks, size_t& replayedRecords, bool& journalMatches);
     void popBlock(const Crypto::Hash &blockHash);
     bool pushTransaction(BlockEntry &block, const Crypto::Hash &transactionHash, TransactionIndex transactionIndex);
     void popTransaction(const Transaction &transaction, const Crypto::Hash &transactionHash);
     void popTransactions(const BlockEntry &block, const Crypto::Hash &minerTransactionHash);
-    bool validateInput(const MultisignatureInput &input, const Crypto::Hash &transactionHash, const Crypto::Hash &transactionPrefixHash, const std::vector<Crypto::Signature> &transactionSignatures);
+    bool validateInput(const MultisignatureInput &input, const Crypto::Hash &transactionHash, const Crypto::Hash &transactionPrefixHash, const std::vector<Crypto::Signature> &transactionSignatures, std::vector<SignatureCheck>* deferredChecks = NULL);
     bool removeLastBlock();
     bool checkCheckpoints(uint32_t &lastValidCheckpointHeight);
     bool checkUpgradeHeight(const UpgradeDetector& upgradeDetector);
@@ -342,18 +492,18 @@ namespace CryptoNote {
     bool storeBlockchainIndices();
     bool loadBlockchainIndices();
 
-    bool loadTransactions(const Block& block, std::vector<Transaction>& transactions, uint32_t height);
-    void saveTransactions(const std::vector<Transaction>& transactions, uint32_t height);
+    bool loadTransactions(const Block& block, std::vector<CachedTransaction>& transactions, uint32_t height);
+    void saveTransactions(const std::vector<CachedTransaction>& transactions, uint32_t height);
 
     void sendMessage(const BlockchainMessage& message);
 
-    friend class LockedBlockchainStorage;
+    template<class Lock> friend class BasicLockedBlockchainStorage;
   };
 
-  class LockedBlockchainStorage: boost::noncopyable {
+  template<class Lock> class BasicLockedBlockchainStorage: boost::noncopyable {
   public:
 
-    LockedBlockchainStorage(Blockchain& bc)
+    BasicLockedBlockchainStorage(Blockchain& bc)
       : m_bc(bc), m_lock(bc.m_blockchain_lock) {}
 
     Blockchain* operator -> () {
@@ -363,11 +513,15 @@ namespace CryptoNote {
   private:
 
     Blockchain& m_bc;
-    std::lock_guard<std::recursive_mutex> m_lock;
+    Lock m_lock;
   };
 
+  // Readers run concurrently with each other; a writer excludes everyone else.
+  typedef BasicLockedBlockchainStorage<std::shared_lock<Tools::RecursiveSharedMutex>> ReadLockedBlockchainStorage;
+  typedef BasicLockedBlockchainStorage<std::lock_guard<Tools::RecursiveSharedMutex>> WriteLockedBlockchainStorage;
+
   template<class visitor_t> bool Blockchain::scanOutputKeysForIndexes(const KeyInput& tx_in_to_key, visitor_t& vis, uint32_t* pmax_related_block_height) {
-    std::lock_guard<std::recursive_mutex> lk(m_blockchain_lock);
+    std::shared_lock<decltype(m_blockchain_lock)> lk(m_blockchain_lock);
     auto it = m_outputs.find(tx_in_to_key.amount);
     if (it == m_outputs.end() || !tx_in_to_key.outputIndexes.size())
       return false;
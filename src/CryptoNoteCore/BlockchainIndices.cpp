@@ -17,7 +17,10 @@
 
 #include "BlockchainIndices.h"
 
+#include <algorithm>
+
 #include "Common/StringTools.h"
+#include "Common/int-util.h"
 #include "CryptoNoteCore/CryptoNoteTools.h"
 #include "CryptoNoteCore/CryptoNoteFormatUtils.h"
 #include "BlockchainExplorer/BlockchainExplorerDataBuilder.h"
@@ -163,6 +166,77 @@ void TimestampTransactionsIndex::serialize(ISerializer& s) {
   s(index, "index");
 }
 
+TransactionPriorityIndex::Entry TransactionPriorityIndex::makeEntry(const Crypto::Hash& id, uint64_t fee, size_t blobSize, uint64_t receiveTime, uint64_t& bucketRate) {
+  // fee * 2^64 / blobSize, exact enough to order any two transactions the way fee * otherSize does:
+  // rates of transactions smaller than 2^31 bytes that differ at all differ by more than 2^-62
+  Entry entry;
+  entry.id = id;
+  entry.fee = fee;
+  entry.receiveTime = receiveTime;
+  entry.blobSize = blobSize;
+  div128_32(fee, 0, static_cast<uint32_t>(blobSize), &bucketRate, &entry.feeRate);
+  return entry;
+}
+
+bool TransactionPriorityIndex::isPreferred(const Entry& lhs, const Entry& rhs) {
+  return
+    // prefer more profitable transactions
+    (lhs.feeRate > rhs.feeRate) ||
+    // prefer smaller
+    (lhs.feeRate == rhs.feeRate && lhs.blobSize < rhs.blobSize) ||
+    // prefer older
+    (lhs.feeRate == rhs.feeRate && lhs.blobSize == rhs.blobSize && lhs.receiveTime < rhs.receiveTime);
+}
+
+bool TransactionPriorityIndex::add(const Crypto::Hash& id, uint64_t fee, size_t blobSize, uint64_t receiveTime) {
+  if (blobSize == 0) {
+    return false;
+  }
+
+  uint64_t bucketRate;
+  Entry entry = makeEntry(id, fee, blobSize, receiveTime, bucketRate);
+  buckets[bucketRate].insert(entry);
+  ++count;
+  return true;
+}
+
+bool TransactionPriorityIndex::remove(const Crypto::Hash& id, uint64_t fee, size_t blobSize, uint64_t receiveTime) {
+  if (blobSize == 0) {
+    return false;
+  }
+
+  uint64_t bucketRate;
+  Entry entry = makeEntry(id, fee, blobSize, receiveTime, bucketRate);
+  auto bucket = buckets.find(bucketRate);
+  if (bucket == buckets.end()) {
+    return false;
+  }
+
+  auto range = bucket->second.equal_range(entry);
+  for (auto iter = range.first; iter != range.second; ++iter) {
+    if (iter->id == id) {
+      bucket->second.erase(iter);
+      if (bucket->second.empty()) {
+        buckets.erase(bucket);
+      }
+
+      --count;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+size_t TransactionPriorityIndex::size() const {
+  return count;
+}
+
+void TransactionPriorityIndex::clear() {
+  buckets.clear();
+  count = 0;
+}
+
 GeneratedTransactionsIndex::GeneratedTransactionsIndex() : lastGeneratedTxNumber(0) {
 
 }
@@ -20,6 +20,8 @@
 #include <string>
 #include <unordered_map>
 #include <map>
+#include <set>
+#include <vector>
 #include <parallel_hashmap/phmap.h>
 #include "crypto/hash.h"
 #include "CryptoNoteBasic.h"
@@ -85,6 +87,63 @@ private:
   std::multimap<uint64_t, Crypto::Hash> index;
 };
 
+// Pool transactions in the order they are preferred for a block: higher fee per byte, then smaller, then older.
+// Transactions are grouped in buckets by whole fee per byte, each bucket a multiset of small entries kept in
+// preference order, so that adding, removing and walking the pool does not touch the transactions themselves.
+class TransactionPriorityIndex {
+public:
+  struct Entry {
+    Crypto::Hash id;
+    uint64_t feeRate; // fractional part of fee per byte, scaled by 2^64
+    uint64_t fee;
+    uint64_t receiveTime;
+    uint64_t blobSize;
+  };
+
+  TransactionPriorityIndex() = default;
+
+  bool add(const Crypto::Hash& id, uint64_t fee, size_t blobSize, uint64_t receiveTime);
+  bool remove(const Crypto::Hash& id, uint64_t fee, size_t blobSize, uint64_t receiveTime);
+  size_t size() const;
+  void clear();
+
+  // Calls func(entry) from the most preferred transaction to the least preferred one.
+  template<class F>
+  void forEach(F&& func) const {
+    for (auto bucket = buckets.rbegin(); bucket != buckets.rend(); ++bucket) {
+      for (const Entry& entry : bucket->second) {
+        func(entry);
+      }
+    }
+  }
+
+  // Calls func(entry) from the least preferred transaction to the most preferred one, until it returns false.
+  template<class F>
+  void forEachReverse(F&& func) const {
+    for (auto bucket = buckets.begin(); bucket != buckets.end(); ++bucket) {
+      for (auto entry = bucket->second.rbegin(); entry != bucket->second.rend(); ++entry) {
+        if (!func(*entry)) {
+          return;
+        }
+      }
+    }
+  }
+
+private:
+  static Entry makeEntry(const Crypto::Hash& id, uint64_t fee, size_t blobSize, uint64_t receiveTime, uint64_t& bucketRate);
+  static bool isPreferred(const Entry& lhs, const Entry& rhs);
+
+  struct Preference {
+    bool operator()(const Entry& lhs, const Entry& rhs) const {
+      return isPreferred(lhs, rhs);
+    }
+  };
+
+  // node based, so that a full bucket of same rate transactions is not shifted on every add and remove
+  std::map<uint64_t, std::multiset<Entry, Preference>> buckets; // whole fee per byte -> entries, most preferred first
+  size_t count = 0;
+};
+
 class GeneratedTransactionsIndex {
 public:
   GeneratedTransactionsIndex();
@@ -0,0 +1,74 @@
+// Copyright (c) 2017-2022 Fuego Developers
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Copyright (c) 2016-2019 The Karbowanec developers
+// Copyright (c) 2012-2018 The CryptoNote developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#include "CachedTransaction.h"
+#include "CryptoNoteTools.h"
+
+namespace CryptoNote {
+
+CachedTransaction::CachedTransaction(const Transaction& transaction) : transaction(transaction) {
+}
+
+CachedTransaction::CachedTransaction(Transaction&& transaction) : transaction(std::move(transaction)) {
+}
+
+CachedTransaction::CachedTransaction(Transaction&& transaction, const Crypto::Hash& transactionHash, size_t transactionBinarySize) :
+  transaction(std::move(transaction)), transactionHash(transactionHash), transactionBinarySize(transactionBinarySize) {
+}
+
+const Transaction& CachedTransaction::getTransaction() const {
+  return transaction;
+}
+
+const Crypto::Hash& CachedTransaction::getTransactionHash() const {
+  if (!transactionHash.is_initialized()) {
+    hashTransaction();
+  }
+
+  return transactionHash.get();
+}
+
+const Crypto::Hash& CachedTransaction::getTransactionPrefixHash() const {
+  if (!transactionPrefixHash.is_initialized()) {
+    transactionPrefixHash = getObjectHash(static_cast<const TransactionPrefix&>(transaction));
+  }
+
+  return transactionPrefixHash.get();
+}
+
+size_t CachedTransaction::getTransactionBinarySize() const {
+  if (!transactionBinarySize.is_initialized()) {
+    if (transactionHash.is_initialized()) {
+      transactionBinarySize = getObjectBinarySize(transaction);
+    } else {
+      hashTransaction();
+    }
+  }
+
+  return transactionBinarySize.get();
+}
+
+void CachedTransaction::hashTransaction() const {
+  // the hash and the size come out of the same serialization
+  Crypto::Hash hash;
+  size_t size;
+  getObjectHash(transaction, hash, size);
+  transactionHash = hash;
+  transactionBinarySize = size;
+}
+
+}
@@ -0,0 +1,47 @@
+// Copyright (c) 2017-2022 Fuego Developers
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Copyright (c) 2016-2019 The Karbowanec developers
+// Copyright (c) 2012-2018 The CryptoNote developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <boost/optional.hpp>
+#include "CryptoNoteBasic.h"
+
+namespace CryptoNote {
+
+// A transaction together with its hash, prefix hash and binary size. Each of them is
+// computed at most once, the first time it is asked for, or handed in when already known.
+class CachedTransaction {
+public:
+  explicit CachedTransaction(const Transaction& transaction);
+  explicit CachedTransaction(Transaction&& transaction);
+  CachedTransaction(Transaction&& transaction, const Crypto::Hash& transactionHash, size_t transactionBinarySize);
+
+  const Transaction& getTransaction() const;
+  const Crypto::Hash& getTransactionHash() const;
+  const Crypto::Hash& getTransactionPrefixHash() const;
+  size_t getTransactionBinarySize() const;
+
+private:
+  Transaction transaction;
+  mutable boost::optional<Crypto::Hash> transactionHash;
+  mutable boost::optional<Crypto::Hash> transactionPrefixHash;
+  mutable boost::optional<size_t> transactionBinarySize;
+
+  void hashTransaction() const;
+};
+
+}
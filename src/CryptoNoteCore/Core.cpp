@@ -73,8 +73,11 @@ core::core(const Currency &currency, i_cryptonote_protocol *pprotocol, Logging::
                                                                                                                                                                   m_mempool(currency, m_blockchain, m_timeProvider, logger),
                                                                                                                                                                   m_blockchain(currency, m_mempool, logger, blockchainIndexesEnabled, blockchainAutosaveEnabled),
                                                                                                                                                                   m_miner(new miner(currency, *this, logger)),
-                                                                                                                                                                  m_starter_message_showed(false)
+                                                                                                                                                                  m_starter_message_showed(false),
+                                                                                                                                                                  m_blockTemplateVersion(1)
 {
+  m_blockTemplateTransactions.version = 0;
+  m_blockTemplateTransactions.selectionTime = 0;
 
   set_cryptonote_protocol(pprotocol);
   m_blockchain.addObserver(this);
@@ -165,6 +168,7 @@ std::time_t core::getStartTime() const {
   //-----------------------------------------------------------------------------------------------
 bool core::init(const CoreConfig& config, const MinerConfig& minerConfig, bool load_existing) {
   m_config_folder = config.configFolder;
+  m_mempool.setMaxSize(config.mempoolMaxSize);
   bool r = m_mempool.init(m_config_folder);
 
   if (!(r)) {
@@ -247,28 +251,76 @@ bool core::handle_incoming_tx(const BinaryArray& tx_blob, tx_verification_contex
   tvc = boost::value_initialized<tx_verification_context>();
   //want to process all transactions sequentially
 
-  if (tx_blob.size() > m_currency.maxTxSize()) {
-    logger(INFO) << "WRONG TRANSACTION BLOB, too big size " << tx_blob.size() << ", rejected";
-    tvc.m_verification_failed = true;
+  Transaction tx;
+  Crypto::Hash tx_hash = NULL_HASH;
+  uint32_t blockHeight;
+  if (!parseIncomingTransaction(tx_blob, tx, tx_hash, blockHeight, tvc)) {
     return false;
   }
 
-  Crypto::Hash tx_hash = NULL_HASH;
-  Crypto::Hash tx_prefixt_hash = NULL_HASH;
-  Transaction tx;
+  return handleIncomingTransaction(tx, tx_hash, tx_blob.size(), tvc, keeped_by_block, blockHeight);
+}
 
-  if (!parse_tx_from_blob(tx, tx_hash, tx_prefixt_hash, tx_blob)) {
+bool core::parseIncomingTransaction(const BinaryArray& blob, Transaction& tx, Crypto::Hash& txHash, uint32_t& height, tx_verification_context& tvc) {
+  if (blob.size() > m_currency.maxTxSize()) {
+    logger(INFO) << "WRONG TRANSACTION BLOB, too big size " << blob.size() << ", rejected";
+    tvc.m_verification_failed = true;
+    return false;
+  }
+
+  Crypto::Hash txPrefixHash = NULL_HASH;
+  if (!parse_tx_from_blob(tx, txHash, txPrefixHash, blob)) {
     logger(INFO) << "WRONG TRANSACTION BLOB, Failed to parse, rejected";
     tvc.m_verification_failed = true;
     return false;
   }
-  //std::cout << "!"<< tx.inputs.size() << std::endl;
 
   Crypto::Hash blockId;
-  uint32_t blockHeight;
-  bool ok = getBlockContainingTx(tx_hash, blockId, blockHeight);
-  if (!ok) blockHeight = this->get_current_blockchain_height(); //this assumption fails for withdrawals
-  return handleIncomingTransaction(tx, tx_hash, tx_blob.size(), tvc, keeped_by_block, blockHeight);
+  if (!getBlockContainingTx(txHash, blockId, height)) {
+    height = get_current_blockchain_height(); //this assumption fails for withdrawals
+  }
+
+  return true;
+}
+
+bool core::checkIncomingTransaction(const Transaction& tx, const Crypto::Hash& txHash, tx_verification_context& tvc, bool keptByBlock, uint32_t height) {
+  if (!check_tx_syntax(tx)) {
+    logger(ERROR) << "WRONG TRANSACTION BLOB, Failed to check tx " << txHash << " syntax, rejected";
+    tvc.m_verification_failed = true;
+    return false;
+  }
+
+  if (!check_tx_semantic(tx, keptByBlock, height)) {
+    logger(ERROR) << "WRONG TRANSACTION BLOB, Failed to check tx " << txHash << " semantic, rejected";
+    tvc.m_verification_failed = true;
+    return false;
+  }
+
+  //No lock is held across the admission, so unrelated transactions are checked concurrently. A block with
+  //this transaction pushed after the check below spends its inputs, which the pool notices when it commits.
+  if (m_blockchain.haveTransaction(txHash)) {
+    logger(TRACE) << "tx " << txHash << " is already in blockchain";
+    return false;
+  }
+
+  if (m_mempool.have_tx(txHash)) {
+    logger(TRACE) << "tx " << txHash << " is already in transaction pool";
+    return false;
+  }
+
+  return true;
+}
+
+void core::logIncomingTransaction(const Crypto::Hash& txHash, const tx_verification_context& tvc) {
+  if (tvc.m_verification_failed) {
+    logger(ERROR) << "Transaction verification failed: " << txHash;
+  } else if (tvc.m_verification_impossible) {
+    logger(ERROR) << "Transaction verification impossible: " << txHash;
+  }
+
+  if (tvc.m_added_to_pool) {
+    logger(DEBUGGING) << "tx added: " << txHash;
+  }
 }
 
 bool core::get_stat_info(core_stat_info& st_inf) {
@@ -299,37 +351,6 @@ bool core::check_tx_mixin(const Transaction& tx) {
   return true;
 }
 
-bool core::check_tx_fee(const Transaction& tx, size_t blobSize, tx_verification_context& tvc) {
-	uint64_t inputs_amount = 0;
-	if (!get_inputs_money_amount(tx, inputs_amount)) {
-		tvc.m_verification_failed = true;
-		return false;
-	}
-
-	uint64_t outputs_amount = get_outs_money_amount(tx);
-
-	if (outputs_amount > inputs_amount) {
-		logger(DEBUGGING) << "transaction uses more money then it has: use " << m_currency.formatAmount(outputs_amount) <<
-			", have " << m_currency.formatAmount(inputs_amount);
-		tvc.m_verification_failed = true;
-		return false;
-	}
-
-	Crypto::Hash h = NULL_HASH;
-	getObjectHash(tx, h, blobSize);
-	const uint64_t fee = inputs_amount - outputs_amount;
-	bool isFusionTransaction = fee == 0 && m_currency.isFusionTransaction(tx, blobSize);
-	if (!isFusionTransaction && fee < m_currency.minimumFee()) {
-		logger(DEBUGGING) << "transaction fee is not enough: " << m_currency.formatAmount(fee) <<
-			", minimum fee: " << m_currency.formatAmount(m_currency.minimumFee());
-		tvc.m_verification_failed = true;
-		tvc.m_tx_fee_too_small = true;
-		return false;
-	}
-
-	return true;
-}
-
 bool core::check_tx_semantic(const Transaction& tx, bool keeped_by_block, uint32_t &height) {
   if (!tx.inputs.size()) {
     logger(ERROR) << "tx with empty inputs, rejected for tx id= " << getObjectHash(tx);
@@ -424,19 +445,10 @@ size_t core::get_blockchain_total_transactions() {
 //}
 
 bool core::add_new_tx(const Transaction& tx, const Crypto::Hash& tx_hash, size_t blob_size, tx_verification_context& tvc, bool keeped_by_block, uint32_t height) {
-  //Locking on m_mempool and m_blockchain closes possibility to add tx to memory pool which is already in blockchain
-  std::lock_guard<decltype(m_mempool)> lk(m_mempool);
-  LockedBlockchainStorage lbs(m_blockchain);
-
-  if (m_blockchain.haveTransaction(tx_hash)) {
-    logger(TRACE) << "tx " << tx_hash << " is already in blockchain";
-    return true;
+  if (!checkIncomingTransaction(tx, tx_hash, tvc, keeped_by_block, height)) {
+    return !tvc.m_verification_failed;
   }
 
-  if (m_mempool.have_tx(tx_hash)) {
-    logger(TRACE) << "tx " << tx_hash << " is already in transaction pool";
-    return true;
-  }
   return m_mempool.add_tx(tx, tx_hash, blob_size, tvc, keeped_by_block, height);
 }
 
@@ -445,7 +457,7 @@ bool core::get_block_template(Block& b, const AccountPublicAddress& adr, difficu
   uint64_t already_generated_coins;
 
   {
-    LockedBlockchainStorage blockchainLock(m_blockchain);
+    ReadLockedBlockchainStorage blockchainLock(m_blockchain);
     height = m_blockchain.getCurrentBlockchainHeight();
     diffic = m_blockchain.getDifficultyForNextBlock();
     if (!(diffic)) {
@@ -527,9 +539,28 @@ bool core::get_block_template(Block& b, const AccountPublicAddress& adr, difficu
 
   size_t txs_size;
   uint64_t fee;
-  if (!m_mempool.fill_block_template(b, median_size, m_currency.maxBlockCumulativeSize(height), already_generated_coins, txs_size, fee, height)) {
-    return false;
+  uint64_t templateVersion = m_blockTemplateVersion;
+  uint64_t now = time(nullptr);
+  std::unique_lock<std::mutex> templateLock(m_blockTemplateLock);
+  if (m_blockTemplateTransactions.version == templateVersion && m_blockTemplateTransactions.previousBlockHash == b.previousBlockHash &&
+      now < m_blockTemplateTransactions.selectionTime + parameters::CRYPTONOTE_MEMPOOL_FAILED_CHECK_LIVETIME) {
+    b.transactionHashes = m_blockTemplateTransactions.transactionHashes;
+    txs_size = m_blockTemplateTransactions.size;
+    fee = m_blockTemplateTransactions.fee;
+  } else {
+    if (!m_mempool.fill_block_template(b, median_size, m_currency.maxBlockCumulativeSize(height), already_generated_coins, txs_size, fee, height)) {
+      return false;
+    }
+
+    // an update during the selection has already moved the version on, so this one is not reused
+    m_blockTemplateTransactions.version = templateVersion;
+    m_blockTemplateTransactions.selectionTime = now;
+    m_blockTemplateTransactions.previousBlockHash = b.previousBlockHash;
+    m_blockTemplateTransactions.transactionHashes = b.transactionHashes;
+    m_blockTemplateTransactions.size = txs_size;
+    m_blockTemplateTransactions.fee = fee;
   }
+  templateLock.unlock();
 
   /*
      two-phase miner transaction generation: we don't know exact block size until we prepare block, but we don't know reward until we know
@@ -677,7 +708,7 @@ void core::getPoolChanges(const std::vector<Crypto::Hash>& knownTxsIds, std::vec
                           std::vector<Crypto::Hash>& deletedTxsIds) {
 
   std::vector<Crypto::Hash> addedTxsIds;
-  auto guard = m_mempool.obtainGuard();
+  std::shared_lock<tx_memory_pool> guard(m_mempool);
   m_mempool.get_difference(knownTxsIds, addedTxsIds, deletedTxsIds);
   std::vector<Crypto::Hash> misses;
   m_mempool.getTransactions(addedTxsIds, addedTxs, misses);
@@ -701,6 +732,10 @@ bool core::handle_incoming_block_blob(const BinaryArray& block_blob, block_verif
   return handle_incoming_block(b, bvc, control_miner, relay_block);
 }
 
+void core::precomputeProofOfWork(const std::vector<const Block*>& blocks) {
+  m_blockchain.precomputeProofOfWork(blocks);
+}
+
 bool core::handle_incoming_block(const Block& b, block_verification_context& bvc, bool control_miner, bool relay_block) {
   if (control_miner) {
     pause_mining();
@@ -750,6 +785,10 @@ size_t core::get_pool_transactions_count() {
   return m_mempool.get_transactions_count();
 }
 
+tx_memory_pool::Statistics core::getPoolStatistics() const {
+  return m_mempool.getStatistics();
+}
+
 bool core::have_block(const Crypto::Hash& id) {
   return m_blockchain.haveBlock(id);
 }
@@ -780,17 +819,21 @@ std::vector<Crypto::Hash> core::buildSparseChain() {
 }
 
 std::vector<Crypto::Hash> core::buildSparseChain(const Crypto::Hash& startBlockId) {
-  LockedBlockchainStorage lbs(m_blockchain);
+  ReadLockedBlockchainStorage lbs(m_blockchain);
   assert(m_blockchain.haveBlock(startBlockId));
   return m_blockchain.buildSparseChain(startBlockId);
 }
 
+bool core::getBlockCompleteEntry(const Crypto::Hash& blockId, block_complete_entry& entry) {
+  return m_blockchain.getBlockCompleteEntry(blockId, entry);
+}
+
 bool core::handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NOTIFY_RESPONSE_GET_OBJECTS::request& rsp) { //Deprecated. Should be removed with CryptoNoteProtocolHandler.
   return m_blockchain.handleGetObjects(arg, rsp);
 }
 
 Crypto::Hash core::getBlockIdByHeight(uint32_t height) {
-  LockedBlockchainStorage lbs(m_blockchain);
+  ReadLockedBlockchainStorage lbs(m_blockchain);
   if (height < m_blockchain.getCurrentBlockchainHeight()) {
     return m_blockchain.getBlockIdByHeight(height);
   } else {
@@ -857,6 +900,7 @@ bool core::removeObserver(ICoreObserver* observer) {
 }
 
 void core::blockchainUpdated() {
+  ++m_blockTemplateVersion;
   m_observerManager.notify(&ICoreObserver::blockchainUpdated);
 }
 
@@ -865,13 +909,14 @@ void core::txDeletedFromPool() {
 }
 
 void core::poolUpdated() {
+  ++m_blockTemplateVersion;
   m_observerManager.notify(&ICoreObserver::poolUpdated);
 }
 
 bool core::queryBlocks(const std::vector<Crypto::Hash>& knownBlockIds, uint64_t timestamp,
   uint32_t& resStartHeight, uint32_t& resCurrentHeight, uint32_t& resFullOffset, std::vector<BlockFullInfo>& entries) {
 
-  LockedBlockchainStorage lbs(m_blockchain);
+  ReadLockedBlockchainStorage lbs(m_blockchain);
 
   uint32_t currentHeight = lbs->getCurrentBlockchainHeight();
   uint32_t startOffset = 0;
@@ -899,25 +944,18 @@ bool core::queryBlocks(const std::vector<Crypto::Hash>& knownBlockIds, uint64_t
     return true;
   }
 
-  std::list<Block> blocks;
-  lbs->getBlocks(startFullOffset, blocksLeft, blocks);
-
-  for (auto& b : blocks) {
+  uint32_t endOffset = std::min(currentHeight, startFullOffset + blocksLeft);
+  for (uint32_t height = startFullOffset; height < endOffset; ++height) {
     BlockFullInfo item;
 
-    item.block_id = get_block_hash(b);
+    item.block_id = lbs->getBlockIdByHeight(height);
 
-    if (b.timestamp >= timestamp) {
-      // query transactions
-      std::list<Transaction> txs;
-      std::list<Crypto::Hash> missedTxs;
-      lbs->getTransactions(b.transactionHashes, txs, missedTxs);
-
-      // fill data
+    if (lbs->getBlockTimestamp(height) >= timestamp) {
+      // blobs are stored as they were pushed
       block_complete_entry& completeEntry = item;
-      completeEntry.block = asString(toBinaryArray(b));
-      for (auto& tx : txs) {
-        completeEntry.txs.push_back(asString(toBinaryArray(tx)));
+      if (!lbs->getBlockCompleteEntry(height, completeEntry)) {
+        logger(ERROR, BRIGHT_RED) << "Failed to read block at height " << height << " for a blocks query";
+        return false;
       }
     }
 
@@ -928,7 +966,7 @@ bool core::queryBlocks(const std::vector<Crypto::Hash>& knownBlockIds, uint64_t
 }
 
 bool core::findStartAndFullOffsets(const std::vector<Crypto::Hash>& knownBlockIds, uint64_t timestamp, uint32_t& startOffset, uint32_t& startFullOffset) {
-  LockedBlockchainStorage lbs(m_blockchain);
+  ReadLockedBlockchainStorage lbs(m_blockchain);
 
   if (knownBlockIds.empty()) {
     logger(ERROR, BRIGHT_RED) << "knownBlockIds is empty";
@@ -951,7 +989,7 @@ bool core::findStartAndFullOffsets(const std::vector<Crypto::Hash>& knownBlockId
 std::vector<Crypto::Hash> core::findIdsForShortBlocks(uint32_t startOffset, uint32_t startFullOffset) {
   assert(startOffset <= startFullOffset);
 
-  LockedBlockchainStorage lbs(m_blockchain);
+  ReadLockedBlockchainStorage lbs(m_blockchain);
 
   std::vector<Crypto::Hash> result;
   if (startOffset < startFullOffset) {
@@ -963,7 +1001,7 @@ std::vector<Crypto::Hash> core::findIdsForShortBlocks(uint32_t startOffset, uint
 
 bool core::queryBlocksLite(const std::vector<Crypto::Hash>& knownBlockIds, uint64_t timestamp, uint32_t& resStartHeight,
   uint32_t& resCurrentHeight, uint32_t& resFullOffset, std::vector<BlockShortInfo>& entries) {
-  LockedBlockchainStorage lbs(m_blockchain);
+  ReadLockedBlockchainStorage lbs(m_blockchain);
 
   resCurrentHeight = lbs->getCurrentBlockchainHeight();
   resStartHeight = 0;
@@ -1035,6 +1073,10 @@ bool core::getBlockSize(const Crypto::Hash& hash, size_t& size) {
   return m_blockchain.getBlockSize(hash, size);
 }
 
+bool core::getBlockBinarySizes(const Crypto::Hash& hash, size_t& blockSize, std::vector<size_t>& transactionSizes) {
+  return m_blockchain.getBlockBinarySizes(hash, blockSize, transactionSizes);
+}
+
 bool core::getAlreadyGeneratedCoins(const Crypto::Hash& hash, uint64_t& generatedCoins) {
   return m_blockchain.getAlreadyGeneratedCoins(hash, generatedCoins);
 }
@@ -1153,11 +1195,15 @@ bool core::getTransactionsByPaymentId(const Crypto::Hash& paymentId, std::vector
 
 std::error_code core::executeLocked(const std::function<std::error_code()>& func) {
   std::lock_guard<decltype(m_mempool)> lk(m_mempool);
-  LockedBlockchainStorage lbs(m_blockchain);
+  ReadLockedBlockchainStorage lbs(m_blockchain);
 
   return func();
 }
 
+Tools::ThreadPool& core::getWorkerPool() {
+  return m_blockchain.getWorkerPool();
+}
+
 uint64_t core::getNextBlockDifficulty() {
   return m_blockchain.getDifficultyForNextBlock();
 }
@@ -1178,40 +1224,55 @@ uint64_t core::depositAmountAtHeight(size_t height) const {
 }
 
 bool core::handleIncomingTransaction(const Transaction& tx, const Crypto::Hash& txHash, size_t blobSize, tx_verification_context& tvc, bool keptByBlock, uint32_t height) {
-  if (!check_tx_syntax(tx)) {
-    logger(ERROR) << "WRONG TRANSACTION BLOB, Failed to check tx " << txHash << " syntax, rejected";
-    tvc.m_verification_failed = true;
-    return false;
+  bool r = add_new_tx(tx, txHash, blobSize, tvc, keptByBlock, height);
+  logIncomingTransaction(txHash, tvc);
+  if (tvc.m_added_to_pool) {
+    poolUpdated();
   }
 
-  if (!check_tx_semantic(tx, keptByBlock, height)) {
-    logger(ERROR) << "WRONG TRANSACTION BLOB, Failed to check tx " << txHash << " semantic, rejected";
-    tvc.m_verification_failed = true;
-    return false;
-  }
+  return r;
+}
 
-  bool r = add_new_tx(tx, txHash, blobSize, tvc, keptByBlock, height);
-  if (tvc.m_verification_failed) {
-    if (!tvc.m_tx_fee_too_small) {
-      logger(ERROR) << "Transaction verification failed: " << txHash;
-    } else {
-      logger(ERROR) << "Transaction verification failed: " << txHash;
+void core::handleIncomingTransactions(const std::vector<BinaryArray>& transactionBlobs, std::vector<tx_verification_context>& tvcs) {
+  tvcs.assign(transactionBlobs.size(), boost::value_initialized<tx_verification_context>());
+
+  std::vector<Transaction> transactions(transactionBlobs.size());
+  std::vector<tx_memory_pool::TransactionAdmission> admissions(transactionBlobs.size());
+
+  //parsing and every check that needs no pool lock run on all cores, the survivors are then added under one lock
+  m_blockchain.getWorkerPool().parallelFor(transactionBlobs.size(), [&](size_t i) {
+    tx_verification_context& tvc = tvcs[i];
+    Crypto::Hash txHash = NULL_HASH;
+    uint32_t height;
+    if (!parseIncomingTransaction(transactionBlobs[i], transactions[i], txHash, height, tvc) ||
+        !checkIncomingTransaction(transactions[i], txHash, tvc, false, height)) {
+      return;
     }
-  } else if (tvc.m_verification_impossible) {
-    logger(ERROR) << "Transaction verification impossible: " << txHash;
+
+    admissions[i] = m_mempool.makeAdmission(transactions[i], txHash, transactionBlobs[i].size(), tvc, false, height);
+    m_mempool.checkTransaction(admissions[i]);
+  });
+
+  m_mempool.commitTransactions(admissions);
+
+  bool added = false;
+  for (size_t i = 0; i < tvcs.size(); ++i) {
+    if (admissions[i].tx == nullptr) {
+      continue;
+    }
+
+    logIncomingTransaction(admissions[i].id, tvcs[i]);
+    added = added || tvcs[i].m_added_to_pool;
   }
 
-  if (tvc.m_added_to_pool) {
-    logger(DEBUGGING) << "tx added: " << txHash;
+  if (added) {
     poolUpdated();
   }
-
-  return r;
 }
 
 std::unique_ptr<IBlock> core::getBlock(const Crypto::Hash& blockId) {
   std::lock_guard<decltype(m_mempool)> lk(m_mempool);
-  LockedBlockchainStorage lbs(m_blockchain);
+  ReadLockedBlockchainStorage lbs(m_blockchain);
 
   std::unique_ptr<BlockWithTransactions> blockPtr(new BlockWithTransactions());
   if (!lbs->getBlockByHash(blockId, blockPtr->block)) {
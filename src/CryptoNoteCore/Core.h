@@ -18,6 +18,8 @@
 #pragma once
 
 #include <ctime>
+#include <atomic>
+#include <mutex>
 #include <boost/program_options/options_description.hpp>
 #include <boost/program_options/variables_map.hpp>
 
@@ -52,12 +54,15 @@ namespace CryptoNote {
      bool on_idle() override;
      virtual bool handle_incoming_tx(const BinaryArray& tx_blob, tx_verification_context& tvc, bool keeped_by_block) override; //Deprecated. Should be removed with CryptoNoteProtocolHandler.
      bool handle_incoming_block_blob(const BinaryArray& block_blob, block_verification_context& bvc, bool control_miner, bool relay_block) override;
+     virtual void precomputeProofOfWork(const std::vector<const Block*>& blocks) override;
      virtual i_cryptonote_protocol* get_protocol() override {return m_pprotocol;}
      virtual const Currency& currency() const override { return m_currency; }
 
      //-------------------- IMinerHandler -----------------------
      virtual bool handle_block_found(Block& b) override;
      virtual bool get_block_template(Block& b, const AccountPublicAddress& adr, difficulty_type& diffic, uint32_t& height, const BinaryArray& ex_nonce) override;
+     // Changes whenever the chain or the pool does, and with it the block template contents.
+     uint64_t getBlockTemplateVersion() const { return m_blockTemplateVersion; }
 
      bool addObserver(ICoreObserver* observer) override;
      bool removeObserver(ICoreObserver* observer) override;
@@ -72,8 +77,10 @@ namespace CryptoNote {
      virtual bool saveBlockchain() override;
      virtual size_t addChain(const std::vector<const IBlock*>& chain) override;
      virtual bool handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS_request& arg, NOTIFY_RESPONSE_GET_OBJECTS_request& rsp) override; //Deprecated. Should be removed with CryptoNoteProtocolHandler.
+     bool getBlockCompleteEntry(const Crypto::Hash& blockId, block_complete_entry& entry);
      virtual bool getBackwardBlocksSizes(uint32_t fromHeight, std::vector<size_t>& sizes, size_t count) override;
      virtual bool getBlockSize(const Crypto::Hash& hash, size_t& size) override;
+     bool getBlockBinarySizes(const Crypto::Hash& hash, size_t& blockSize, std::vector<size_t>& transactionSizes);
      virtual bool getAlreadyGeneratedCoins(const Crypto::Hash& hash, uint64_t& generatedCoins) override;
      virtual bool getBlockReward(uint8_t blockMajorVersion, size_t medianSize, size_t currentBlockSize, uint64_t alreadyGeneratedCoins, uint64_t fee, uint32_t height,
                                  uint64_t& reward, int64_t& emissionChange) override;
@@ -89,7 +96,9 @@ namespace CryptoNote {
      virtual bool getOutByMSigGIndex(uint64_t amount, uint64_t gindex, MultisignatureOutput& out) override;
      virtual std::unique_ptr<IBlock> getBlock(const Crypto::Hash& blocksId) override;
      virtual bool handleIncomingTransaction(const Transaction& tx, const Crypto::Hash& txHash, size_t blobSize, tx_verification_context& tvc, bool keptByBlock, uint32_t height) override;
+     virtual void handleIncomingTransactions(const std::vector<BinaryArray>& transactionBlobs, std::vector<tx_verification_context>& tvcs) override;
      virtual std::error_code executeLocked(const std::function<std::error_code()>& func) override;
+     virtual Tools::ThreadPool& getWorkerPool() override;
      
      virtual bool addMessageQueue(MessageQueue<BlockchainMessage>& messageQueue) override;
      virtual bool removeMessageQueue(MessageQueue<BlockchainMessage>& messageQueue) override;
@@ -133,6 +142,7 @@ namespace CryptoNote {
     std::vector<Transaction> getPoolTransactions() override;
     bool getPoolTransaction(const Crypto::Hash &tx_hash, Transaction &transaction) override;
     size_t get_pool_transactions_count();
+    tx_memory_pool::Statistics getPoolStatistics() const;
     size_t get_blockchain_total_transactions();
     //bool get_outs(uint64_t amount, std::list<Crypto::PublicKey>& pkeys);
     virtual std::vector<Crypto::Hash> findBlockchainSupplement(const std::vector<Crypto::Hash> &remoteBlockIds, size_t maxCount,
@@ -168,6 +178,11 @@ namespace CryptoNote {
 
   private:
     bool add_new_tx(const Transaction &tx, const Crypto::Hash &tx_hash, size_t blob_size, tx_verification_context &tvc, bool keeped_by_block, uint32_t height);
+    // Checks shared by every way a transaction reaches the pool. They return false if the transaction is
+    // not to be added, tvc.m_verification_failed telling a rejected one from one that is already known.
+    bool parseIncomingTransaction(const BinaryArray &blob, Transaction &tx, Crypto::Hash &txHash, uint32_t &height, tx_verification_context &tvc);
+    bool checkIncomingTransaction(const Transaction &tx, const Crypto::Hash &txHash, tx_verification_context &tvc, bool keptByBlock, uint32_t height);
+    void logIncomingTransaction(const Crypto::Hash &txHash, const tx_verification_context &tvc);
     bool load_state_data();
     bool parse_tx_from_blob(Transaction &tx, Crypto::Hash &tx_hash, Crypto::Hash &tx_prefix_hash, const BinaryArray &blob);
     bool handle_incoming_block(const Block &b, block_verification_context &bvc, bool control_miner, bool relay_block);
@@ -175,7 +190,6 @@ namespace CryptoNote {
     bool check_tx_syntax(const Transaction &tx);  //check correct values, amounts and all lightweight checks not related with database
     bool check_tx_semantic(const Transaction &tx, bool keeped_by_block, uint32_t &height); //check if tx already in memory pool or in main blockchain
     bool check_tx_mixin(const Transaction& tx);   //check if the mixin is not too large
-    bool check_tx_fee(const Transaction& tx, size_t blobSize, tx_verification_context& tvc); //check for proper tx fee
 
     bool check_tx_ring_signature(const KeyInput &tx, const Crypto::Hash &tx_prefix_hash, const std::vector<Crypto::Signature> &sig);
     bool is_tx_spendtime_unlocked(uint64_t unlock_time);
@@ -187,6 +201,17 @@ namespace CryptoNote {
     virtual void txDeletedFromPool() override;
     void poolUpdated();
 
+    // Transactions chosen for the block template at a template version, reused until the version changes
+    // or the pool's failed readiness checks, some of which pass as time goes by, are due to be run again.
+    struct BlockTemplateTransactions {
+      uint64_t version;
+      uint64_t selectionTime;
+      Crypto::Hash previousBlockHash;
+      std::vector<Crypto::Hash> transactionHashes;
+      size_t size;
+      uint64_t fee;
+    };
+
     bool findStartAndFullOffsets(const std::vector<Crypto::Hash> &knownBlockIds, uint64_t timestamp, uint32_t &startOffset, uint32_t &startFullOffset);
     std::vector<Crypto::Hash> findIdsForShortBlocks(uint32_t startOffset, uint32_t startFullOffset);
 
@@ -202,6 +227,9 @@ namespace CryptoNote {
     friend class tx_validate_inputs;
     std::atomic<bool> m_starter_message_showed;
     Tools::ObserverManager<ICoreObserver> m_observerManager;
+    std::atomic<uint64_t> m_blockTemplateVersion;
+    std::mutex m_blockTemplateLock;
+    BlockTemplateTransactions m_blockTemplateTransactions;
      time_t start_time;
    };
 }
@@ -19,11 +19,18 @@
 
 #include "Common/Util.h"
 #include "Common/CommandLine.h"
+#include "CryptoNoteConfig.h"
 
 namespace CryptoNote {
 
+namespace {
+const command_line::arg_descriptor<uint64_t> arg_mempool_max_size = {"mempool-max-size", "Specify the size limit of the transaction pool in megabytes",
+  parameters::CRYPTONOTE_MEMPOOL_MAX_SIZE / (1024 * 1024)};
+}
+
 CoreConfig::CoreConfig() {
   configFolder = Tools::getDefaultDataDirectory();
+  mempoolMaxSize = parameters::CRYPTONOTE_MEMPOOL_MAX_SIZE;
 }
 
 void CoreConfig::init(const boost::program_options::variables_map& options) {
@@ -31,8 +38,13 @@ void CoreConfig::init(const boost::program_options::variables_map& options) {
     configFolder = command_line::get_arg(options, command_line::arg_data_dir);
     configFolderDefaulted = options[command_line::arg_data_dir.name].defaulted();
   }
+
+  if (command_line::has_arg(options, arg_mempool_max_size)) {
+    mempoolMaxSize = command_line::get_arg(options, arg_mempool_max_size) * 1024 * 1024;
+  }
 }
 
 void CoreConfig::initOptions(boost::program_options::options_description& desc) {
+  command_line::add_arg(desc, arg_mempool_max_size);
 }
 } //namespace CryptoNote
@@ -32,6 +32,7 @@ public:
 
   std::string configFolder;
   bool configFolderDefaulted = true;
+  uint64_t mempoolMaxSize;
 };
 
 } //namespace CryptoNote
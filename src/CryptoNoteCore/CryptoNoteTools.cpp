@@ -33,6 +33,16 @@ bool toBinaryArray(const BinaryArray& object, BinaryArray& binaryArray) {
   return true;
 }
 
+template<>
+bool getObjectBinarySize(const BinaryArray& object, size_t& size) {
+  // same layout as toBinaryArray writes: a size prefix followed by the blob
+  BinaryCountingSerializer serializer;
+  uint64_t blobSize = object.size();
+  serializer(blobSize, "");
+  size = serializer.getSize() + object.size();
+  return true;
+}
+
 void getBinaryArrayHash(const BinaryArray& binaryArray, Crypto::Hash& hash) {
   cn_fast_hash(binaryArray.data(), binaryArray.size(), hash);
 }
@@ -21,6 +21,7 @@
 #include "Common/MemoryInputStream.h"
 #include "Common/StringTools.h"
 #include "Common/VectorOutputStream.h"
+#include "Serialization/BinaryCountingSerializer.h"
 #include "Serialization/BinaryOutputStreamSerializer.h"
 #include "Serialization/BinaryInputStreamSerializer.h"
 #include "CryptoNoteSerialization.h"
@@ -70,16 +71,21 @@ bool fromBinaryArray(T& object, const BinaryArray& binaryArray) {
 
 template<class T>
 bool getObjectBinarySize(const T& object, size_t& size) {
-  BinaryArray ba;
-  if (!toBinaryArray(object, ba)) {
+  try {
+    BinaryCountingSerializer serializer;
+    serialize(const_cast<T&>(object), serializer);
+    size = serializer.getSize();
+  } catch (std::exception&) {
     size = (std::numeric_limits<size_t>::max)();
     return false;
   }
 
-  size = ba.size();
   return true;
 }
 
+template<>
+bool getObjectBinarySize(const BinaryArray& object, size_t& size);
+
 template<class T>
 size_t getObjectBinarySize(const T& object) {
   size_t size;
@@ -88,7 +88,11 @@ namespace CryptoNote
       m_blocksFileName = "testnet_" + m_blocksFileName;
       m_blocksCacheFileName = "testnet_" + m_blocksCacheFileName;
       m_blockIndexesFileName = "testnet_" + m_blockIndexesFileName;
+      m_blockHeadersFileName = "testnet_" + m_blockHeadersFileName;
+      m_blockLayoutsFileName = "testnet_" + m_blockLayoutsFileName;
+      m_blocksCacheJournalFileName = "testnet_" + m_blocksCacheJournalFileName;
       m_txPoolFileName = "testnet_" + m_txPoolFileName;
+      m_txPoolJournalFileName = "testnet_" + m_txPoolJournalFileName;
       m_blockchinIndicesFileName = "testnet_" + m_blockchinIndicesFileName;
     }
 
@@ -1132,6 +1136,14 @@ namespace CryptoNote
 			return false;
 		}
 
+		return checkProofOfWorkV1(block, currentDiffic, proofOfWork);
+	}
+
+	bool Currency::checkProofOfWorkV1(const Block& block, difficulty_type currentDiffic, const Crypto::Hash& proofOfWork) const {
+		if (BLOCK_MAJOR_VERSION_1 != block.majorVersion) {
+			return false;
+		}
+
 		return check_hash(proofOfWork, currentDiffic);
 	}
 
@@ -1145,6 +1157,14 @@ namespace CryptoNote
 			return false;
 		}
 
+		return checkProofOfWorkV2(block, currentDiffic, proofOfWork);
+	}
+
+	bool Currency::checkProofOfWorkV2(const Block& block, difficulty_type currentDiffic, const Crypto::Hash& proofOfWork) const {
+		if (block.majorVersion < BLOCK_MAJOR_VERSION_2) {
+			return false;
+		}
+
 		if (!check_hash(proofOfWork, currentDiffic)) {
 			return false;
 		}
@@ -1197,6 +1217,26 @@ namespace CryptoNote
 		logger(ERROR, BRIGHT_RED) << "Unknown block major version: " << block.majorVersion << "." << block.minorVersion;
 		return false;
 	}
+
+	bool Currency::checkProofOfWork(const Block& block, difficulty_type currentDiffic, const Crypto::Hash& proofOfWork) const {
+		switch (block.majorVersion) {
+		case BLOCK_MAJOR_VERSION_1:
+			return checkProofOfWorkV1(block, currentDiffic, proofOfWork);
+
+		case BLOCK_MAJOR_VERSION_2:
+		case BLOCK_MAJOR_VERSION_3:
+		case BLOCK_MAJOR_VERSION_4:
+		case BLOCK_MAJOR_VERSION_5:
+		case BLOCK_MAJOR_VERSION_6:
+		case BLOCK_MAJOR_VERSION_7:
+		case BLOCK_MAJOR_VERSION_8:
+		case BLOCK_MAJOR_VERSION_9:
+			return checkProofOfWorkV2(block, currentDiffic, proofOfWork);
+		}
+
+		logger(ERROR, BRIGHT_RED) << "Unknown block major version: " << block.majorVersion << "." << block.minorVersion;
+		return false;
+	}
     size_t Currency::getApproximateMaximumInputCount(size_t transactionSize, size_t outputCount, size_t mixinCount) const {
     const size_t KEY_IMAGE_SIZE = sizeof(Crypto::KeyImage);
     const size_t OUTPUT_KEY_SIZE = sizeof(decltype(KeyOutput::key));
@@ -1302,7 +1342,11 @@ namespace CryptoNote
     blocksFileName(parameters::CRYPTONOTE_BLOCKS_FILENAME);
     blocksCacheFileName(parameters::CRYPTONOTE_BLOCKSCACHE_FILENAME);
     blockIndexesFileName(parameters::CRYPTONOTE_BLOCKINDEXES_FILENAME);
+    blockHeadersFileName(parameters::CRYPTONOTE_BLOCKHEADERS_FILENAME);
+    blockLayoutsFileName(parameters::CRYPTONOTE_BLOCKLAYOUTS_FILENAME);
+    blocksCacheJournalFileName(parameters::CRYPTONOTE_BLOCKSCACHE_JOURNAL_FILENAME);
     txPoolFileName(parameters::CRYPTONOTE_POOLDATA_FILENAME);
+    txPoolJournalFileName(parameters::CRYPTONOTE_POOLDATA_JOURNAL_FILENAME);
     blockchinIndicesFileName(parameters::CRYPTONOTE_BLOCKCHAIN_INDICES_FILENAME);
 
     testnet(false);
@@ -174,7 +174,11 @@ public:
   const std::string &blocksFileName() const { return m_blocksFileName; }
   const std::string &blocksCacheFileName() const { return m_blocksCacheFileName; }
   const std::string &blockIndexesFileName() const { return m_blockIndexesFileName; }
+  const std::string &blockHeadersFileName() const { return m_blockHeadersFileName; }
+  const std::string &blockLayoutsFileName() const { return m_blockLayoutsFileName; }
+  const std::string &blocksCacheJournalFileName() const { return m_blocksCacheJournalFileName; }
   const std::string &txPoolFileName() const { return m_txPoolFileName; }
+  const std::string &txPoolJournalFileName() const { return m_txPoolJournalFileName; }
   const std::string &blockchinIndicesFileName() const { return m_blockchinIndicesFileName; }
 
   bool isTestnet() const { return m_testnet; }
@@ -220,6 +224,10 @@ public:
   bool checkProofOfWorkV1(Crypto::cn_context& context, const Block& block, difficulty_type currentDiffic, Crypto::Hash& proofOfWork) const;
   bool checkProofOfWorkV2(Crypto::cn_context& context, const Block& block, difficulty_type currentDiffic, Crypto::Hash& proofOfWork) const;
   bool checkProofOfWork(Crypto::cn_context& context, const Block& block, difficulty_type currentDiffic, Crypto::Hash& proofOfWork) const;
+  // same checks against a proof of work hash computed beforehand with get_block_longhash
+  bool checkProofOfWorkV1(const Block& block, difficulty_type currentDiffic, const Crypto::Hash& proofOfWork) const;
+  bool checkProofOfWorkV2(const Block& block, difficulty_type currentDiffic, const Crypto::Hash& proofOfWork) const;
+  bool checkProofOfWork(const Block& block, difficulty_type currentDiffic, const Crypto::Hash& proofOfWork) const;
   size_t getApproximateMaximumInputCount(size_t transactionSize, size_t outputCount, size_t mixinCount) const;
 
 private:
@@ -308,7 +316,11 @@ private:
   std::string m_blocksFileName;
   std::string m_blocksCacheFileName;
   std::string m_blockIndexesFileName;
+  std::string m_blockHeadersFileName;
+  std::string m_blockLayoutsFileName;
+  std::string m_blocksCacheJournalFileName;
   std::string m_txPoolFileName;
+  std::string m_txPoolJournalFileName;
   std::string m_blockchinIndicesFileName;
 
   bool m_testnet;
@@ -418,7 +430,11 @@ public:
   CurrencyBuilder& blocksFileName(const std::string& val) { m_currency.m_blocksFileName = val; return *this; }
   CurrencyBuilder& blocksCacheFileName(const std::string& val) { m_currency.m_blocksCacheFileName = val; return *this; }
   CurrencyBuilder& blockIndexesFileName(const std::string& val) { m_currency.m_blockIndexesFileName = val; return *this; }
+  CurrencyBuilder& blockHeadersFileName(const std::string& val) { m_currency.m_blockHeadersFileName = val; return *this; }
+  CurrencyBuilder& blockLayoutsFileName(const std::string& val) { m_currency.m_blockLayoutsFileName = val; return *this; }
+  CurrencyBuilder& blocksCacheJournalFileName(const std::string& val) { m_currency.m_blocksCacheJournalFileName = val; return *this; }
   CurrencyBuilder& txPoolFileName(const std::string& val) { m_currency.m_txPoolFileName = val; return *this; }
+  CurrencyBuilder& txPoolJournalFileName(const std::string& val) { m_currency.m_txPoolJournalFileName = val; return *this; }
   CurrencyBuilder& blockchinIndicesFileName(const std::string& val) { m_currency.m_blockchinIndicesFileName = val; return *this; }
   
   CurrencyBuilder& testnet(bool val) { m_currency.m_testnet = val; return *this; }
@@ -0,0 +1,543 @@
+// Copyright (c) 2017-2022 Fuego Developers
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Copyright (c) 2016-2019 The Karbowanec developers
+// Copyright (c) 2012-2018 The CryptoNote developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "Common/MemoryInputStream.h"
+#include "Common/StringView.h"
+#include "Common/VectorOutputStream.h"
+#include "Serialization/BinaryInputStreamSerializer.h"
+#include "Serialization/BinaryOutputStreamSerializer.h"
+#include "System/MemoryMappedFile.h"
+
+// Append-only vector of serialized items kept in a memory-mapped file.
+//
+// The on-disk layout is the same as the one used by SwappedVector: the items file is
+// a concatenation of binary-serialized items and the index file is a uint64_t item
+// count followed by one uint32_t item size per item. Both files are grown in chunks,
+// so they may carry unused space after the last item; the logical size is always taken
+// from the index. Items are decoded on demand straight from the mapping and the most
+// recently used ones are kept in a small LRU cache.
+//
+// Reads may run concurrently with each other, but not with modifications. Every
+// reading thread gets a cache of its own, so a reference returned by operator[] stays
+// valid for as long as it would in single-threaded use, whatever other readers do.
+// The caches are thread_local: they are found without locking and freed when their
+// thread exits. A modification drops the caches of the other threads lazily, on
+// their next read; the modifying thread's own cache loses only the affected items.
+// The threads share poolSize items between them, but each keeps at least
+// minThreadCacheSize, so a thread's recent references survive others starting to read.
+template<class T> class MappedVector {
+public:
+  typedef T value_type;
+
+  const static uint64_t itemsFileChunkSize = 64 * 1024 * 1024;
+  const static uint64_t indexesFileChunkSize = 1024 * 1024;
+  const static size_t minThreadCacheSize = 64;
+
+  class const_iterator {
+  public:
+    typedef ptrdiff_t difference_type;
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef const T* pointer;
+    typedef const T& reference;
+    typedef T value_type;
+
+    const_iterator() : m_mappedVector(nullptr), m_index(0) {
+    }
+
+    const_iterator(MappedVector* mappedVector, size_t index) : m_mappedVector(mappedVector), m_index(index) {
+    }
+
+    bool operator!=(const const_iterator& other) const {
+      return m_index != other.m_index;
+    }
+
+    bool operator<(const const_iterator& other) const {
+      return m_index < other.m_index;
+    }
+
+    bool operator<=(const const_iterator& other) const {
+      return m_index <= other.m_index;
+    }
+
+    bool operator==(const const_iterator& other) const {
+      return m_index == other.m_index;
+    }
+
+    bool operator>(const const_iterator& other) const {
+      return m_index > other.m_index;
+    }
+
+    bool operator>=(const const_iterator& other) const {
+      return m_index >= other.m_index;
+    }
+
+    const_iterator& operator++() {
+      ++m_index;
+      return *this;
+    }
+
+    const_iterator operator++(int) {
+      const_iterator i = *this;
+      ++m_index;
+      return i;
+    }
+
+    const_iterator& operator--() {
+      --m_index;
+      return *this;
+    }
+
+    const_iterator operator--(int) {
+      const_iterator i = *this;
+      --m_index;
+      return i;
+    }
+
+    const_iterator& operator+=(difference_type n) {
+      m_index += n;
+      return *this;
+    }
+
+    const_iterator& operator-=(difference_type n) {
+      m_index -= n;
+      return *this;
+    }
+
+    const_iterator operator+(difference_type n) const {
+      return const_iterator(m_mappedVector, m_index + n);
+    }
+
+    friend const_iterator operator+(difference_type n, const const_iterator& i) {
+      return const_iterator(i.m_mappedVector, n + i.m_index);
+    }
+
+    difference_type operator-(const const_iterator& other) const {
+      return m_index - other.m_index;
+    }
+
+    const_iterator operator-(difference_type n) const {
+      return const_iterator(m_mappedVector, m_index - n);
+    }
+
+    const T& operator*() const {
+      return (*m_mappedVector)[m_index];
+    }
+
+    const T* operator->() const {
+      return &(*m_mappedVector)[m_index];
+    }
+
+    const T& operator[](difference_type offset) const {
+      return (*m_mappedVector)[m_index + offset];
+    }
+
+    size_t index() const {
+      return m_index;
+    }
+
+  private:
+    MappedVector* m_mappedVector;
+    size_t m_index;
+  };
+
+  MappedVector();
+  MappedVector(const MappedVector&) = delete;
+  ~MappedVector();
+  MappedVector& operator=(const MappedVector&) = delete;
+
+  bool open(const std::string& itemFileName, const std::string& indexFileName, size_t poolSize);
+  void close();
+
+  bool empty() const;
+  uint64_t size() const;
+  const_iterator begin();
+  const_iterator end();
+  const T& operator[](uint64_t index);
+  const T& front();
+  const T& back();
+  // Serialized form of an item, valid until the next modification.
+  Common::StringView serializedItem(uint64_t index) const;
+  void clear();
+  void pop_back();
+  void push_back(const T& item);
+
+private:
+  struct ItemEntry;
+  struct CacheEntry;
+
+  struct ItemEntry {
+  public:
+    T item;
+    typename std::list<CacheEntry>::iterator cacheIter;
+  };
+
+  struct CacheEntry {
+  public:
+    typename std::map<uint64_t, ItemEntry>::iterator itemIter;
+  };
+
+  // Outlives the vector for as long as a thread still has a cache of it.
+  struct CacheState {
+    std::atomic<uint64_t> generation{1};
+  };
+
+  struct Cache {
+    uint64_t generation = 0;
+    std::map<uint64_t, ItemEntry> items;
+    std::list<CacheEntry> entries;
+    // counts the thread among the readers sharing the pool
+    std::shared_ptr<CacheState> state;
+  };
+
+  System::MemoryMappedFile m_itemsFile;
+  System::MemoryMappedFile m_indexesFile;
+  size_t m_poolSize;
+  std::vector<uint64_t> m_offsets;
+  uint64_t m_itemsFileSize;
+  const uint64_t m_id;
+  const std::shared_ptr<CacheState> m_cacheState;
+  std::atomic<uint64_t> m_cacheHits;
+  std::atomic<uint64_t> m_cacheMisses;
+
+  Cache& threadCache();
+  void clearCaches();
+  static std::unordered_map<uint64_t, Cache>& threadCaches();
+  static uint64_t nextId();
+  T* prepare(Cache& cache, uint64_t index);
+  size_t threadCacheSize() const;
+  uint64_t itemSize(uint64_t index) const;
+  void writeCount(uint64_t count);
+  static void grow(System::MemoryMappedFile& file, uint64_t requiredSize, uint64_t chunkSize);
+};
+
+template<class T> MappedVector<T>::MappedVector() : m_poolSize(0), m_itemsFileSize(0), m_id(nextId()), m_cacheState(std::make_shared<CacheState>()), m_cacheHits(0), m_cacheMisses(0) {
+}
+
+template<class T> MappedVector<T>::~MappedVector() {
+  close();
+}
+
+template<class T> bool MappedVector<T>::open(const std::string& itemFileName, const std::string& indexFileName, size_t poolSize) {
+  if (poolSize == 0) {
+    return false;
+  }
+
+  std::error_code ec;
+  if (boost::filesystem::exists(itemFileName) && boost::filesystem::exists(indexFileName)) {
+    // an empty file cannot be mapped, give it its first chunk before opening
+    if (boost::filesystem::file_size(itemFileName) == 0) {
+      boost::filesystem::resize_file(itemFileName, itemsFileChunkSize);
+    }
+
+    m_itemsFile.open(itemFileName, ec);
+    if (ec) {
+      return false;
+    }
+
+    m_indexesFile.open(indexFileName, ec);
+    if (ec || m_indexesFile.size() < sizeof(uint64_t)) {
+      return false;
+    }
+
+    uint64_t count;
+    memcpy(&count, m_indexesFile.data(), sizeof count);
+    if (m_indexesFile.size() < sizeof(uint64_t) + sizeof(uint32_t) * count) {
+      return false;
+    }
+
+    std::vector<uint64_t> offsets;
+    offsets.reserve(count);
+    uint64_t itemsFileSize = 0;
+    const uint8_t* sizes = m_indexesFile.data() + sizeof(uint64_t);
+    for (uint64_t i = 0; i < count; ++i) {
+      uint32_t itemSize;
+      memcpy(&itemSize, sizes + sizeof(uint32_t) * i, sizeof itemSize);
+      offsets.emplace_back(itemsFileSize);
+      itemsFileSize += itemSize;
+    }
+
+    if (itemsFileSize > m_itemsFile.size()) {
+      return false;
+    }
+
+    m_offsets.swap(offsets);
+    m_itemsFileSize = itemsFileSize;
+  } else {
+    m_itemsFile.create(itemFileName, itemsFileChunkSize, true, ec);
+    if (ec) {
+      return false;
+    }
+
+    m_indexesFile.create(indexFileName, indexesFileChunkSize, true, ec);
+    if (ec) {
+      return false;
+    }
+
+    writeCount(0);
+    m_offsets.clear();
+    m_itemsFileSize = 0;
+  }
+
+  m_poolSize = poolSize;
+  clearCaches();
+  m_cacheHits = 0;
+  m_cacheMisses = 0;
+  return true;
+}
+
+template<class T> void MappedVector<T>::close() {
+  if (m_itemsFile.isOpened()) {
+    std::cout << "MappedVector cache hits: " << m_cacheHits << ", misses: " << m_cacheMisses << " (" << std::fixed << std::setprecision(2) << static_cast<double>(m_cacheMisses) / (m_cacheHits + m_cacheMisses) * 100 << "%)" << std::endl;
+  }
+
+  std::error_code ignore;
+  m_itemsFile.close(ignore);
+  m_indexesFile.close(ignore);
+  clearCaches();
+}
+
+template<class T> bool MappedVector<T>::empty() const {
+  return m_offsets.empty();
+}
+
+template<class T> uint64_t MappedVector<T>::size() const {
+  return m_offsets.size();
+}
+
+template<class T> typename MappedVector<T>::const_iterator MappedVector<T>::begin() {
+  return const_iterator(this, 0);
+}
+
+template<class T> typename MappedVector<T>::const_iterator MappedVector<T>::end() {
+  return const_iterator(this, m_offsets.size());
+}
+
+template<class T> const T& MappedVector<T>::operator[](uint64_t index) {
+  Cache& cache = threadCache();
+  auto itemIter = cache.items.find(index);
+  if (itemIter != cache.items.end()) {
+    if (itemIter->second.cacheIter != --cache.entries.end()) {
+      cache.entries.splice(cache.entries.end(), cache.entries, itemIter->second.cacheIter);
+    }
+
+    m_cacheHits.fetch_add(1, std::memory_order_relaxed);
+    return itemIter->second.item;
+  }
+
+  if (index >= m_offsets.size() || !m_itemsFile.isOpened()) {
+    throw std::runtime_error("MappedVector::operator[]");
+  }
+
+  T tempItem;
+  Common::MemoryInputStream stream(m_itemsFile.data() + m_offsets[index], static_cast<size_t>(itemSize(index)));
+  CryptoNote::BinaryInputStreamSerializer archive(stream);
+  serialize(tempItem, archive);
+
+  T* item = prepare(cache, index);
+  std::swap(tempItem, *item);
+  m_cacheMisses.fetch_add(1, std::memory_order_relaxed);
+  return *item;
+}
+
+template<class T> const T& MappedVector<T>::front() {
+  return operator[](0);
+}
+
+template<class T> const T& MappedVector<T>::back() {
+  return operator[](m_offsets.size() - 1);
+}
+
+template<class T> Common::StringView MappedVector<T>::serializedItem(uint64_t index) const {
+  if (index >= m_offsets.size() || !m_itemsFile.isOpened()) {
+    throw std::runtime_error("MappedVector::serializedItem");
+  }
+
+  return Common::StringView(reinterpret_cast<const char*>(m_itemsFile.data() + m_offsets[index]), static_cast<size_t>(itemSize(index)));
+}
+
+template<class T> void MappedVector<T>::clear() {
+  if (!m_indexesFile.isOpened()) {
+    throw std::runtime_error("MappedVector::clear");
+  }
+
+  writeCount(0);
+  m_offsets.clear();
+  m_itemsFileSize = 0;
+  clearCaches();
+}
+
+template<class T> void MappedVector<T>::pop_back() {
+  if (!m_indexesFile.isOpened()) {
+    throw std::runtime_error("MappedVector::pop_back");
+  }
+
+  writeCount(m_offsets.size() - 1);
+  m_itemsFileSize = m_offsets.back();
+  m_offsets.pop_back();
+
+  Cache& cache = threadCache();
+  cache.generation = ++m_cacheState->generation;
+  auto itemIter = cache.items.find(m_offsets.size());
+  if (itemIter != cache.items.end()) {
+    cache.entries.erase(itemIter->second.cacheIter);
+    cache.items.erase(itemIter);
+  }
+}
+
+template<class T> void MappedVector<T>::push_back(const T& item) {
+  if (!m_itemsFile.isOpened() || !m_indexesFile.isOpened()) {
+    throw std::runtime_error("MappedVector::push_back");
+  }
+
+  std::vector<uint8_t> data;
+  {
+    Common::VectorOutputStream stream(data);
+    CryptoNote::BinaryOutputStreamSerializer archive(stream);
+    serialize(const_cast<T&>(item), archive);
+  }
+
+  grow(m_itemsFile, m_itemsFileSize + data.size(), itemsFileChunkSize);
+  memcpy(m_itemsFile.data() + m_itemsFileSize, data.data(), data.size());
+
+  uint64_t sizeOffset = sizeof(uint64_t) + sizeof(uint32_t) * m_offsets.size();
+  grow(m_indexesFile, sizeOffset + sizeof(uint32_t), indexesFileChunkSize);
+  uint32_t itemSize = static_cast<uint32_t>(data.size());
+  memcpy(m_indexesFile.data() + sizeOffset, &itemSize, sizeof itemSize);
+  writeCount(m_offsets.size() + 1);
+
+  m_offsets.push_back(m_itemsFileSize);
+  m_itemsFileSize += data.size();
+
+  T* newItem = prepare(threadCache(), m_offsets.size() - 1);
+  *newItem = item;
+}
+
+// Keyed by instance id rather than address, so a vector allocated where a destroyed one
+// lived never sees the old one's items.
+template<class T> typename MappedVector<T>::Cache& MappedVector<T>::threadCache() {
+  Cache& cache = threadCaches()[m_id];
+  if (!cache.state) {
+    cache.state = m_cacheState;
+  }
+
+  uint64_t generation = m_cacheState->generation.load();
+  if (cache.generation != generation) {
+    cache.items.clear();
+    cache.entries.clear();
+    cache.generation = generation;
+  }
+
+  return cache;
+}
+
+template<class T> void MappedVector<T>::clearCaches() {
+  threadCaches().erase(m_id);
+  ++m_cacheState->generation;
+}
+
+template<class T> std::unordered_map<uint64_t, typename MappedVector<T>::Cache>& MappedVector<T>::threadCaches() {
+  static thread_local std::unordered_map<uint64_t, Cache> caches;
+  return caches;
+}
+
+template<class T> uint64_t MappedVector<T>::nextId() {
+  static std::atomic<uint64_t> id(0);
+  return ++id;
+}
+
+template<class T> T* MappedVector<T>::prepare(Cache& cache, uint64_t index) {
+  size_t cacheSize = threadCacheSize();
+  while (!cache.items.empty() && cache.items.size() >= cacheSize) {
+    auto cacheIter = cache.entries.begin();
+    cache.items.erase(cacheIter->itemIter);
+    cache.entries.erase(cacheIter);
+  }
+
+  auto itemIter = cache.items.insert(std::make_pair(index, ItemEntry()));
+  CacheEntry cacheEntry = { itemIter.first };
+  auto cacheIter = cache.entries.insert(cache.entries.end(), cacheEntry);
+  itemIter.first->second.cacheIter = cacheIter;
+  return &itemIter.first->second.item;
+}
+
+template<class T> size_t MappedVector<T>::threadCacheSize() const {
+  // every thread with a cache holds one reference to the state besides the vector's own
+  long threads = std::max(m_cacheState.use_count() - 1, 1L);
+  return std::max(m_poolSize / static_cast<size_t>(threads), std::min(m_poolSize, static_cast<size_t>(minThreadCacheSize)));
+}
+
+template<class T> uint64_t MappedVector<T>::itemSize(uint64_t index) const {
+  return (index + 1 < m_offsets.size() ? m_offsets[index + 1] : m_itemsFileSize) - m_offsets[index];
+}
+
+template<class T> void MappedVector<T>::writeCount(uint64_t count) {
+  memcpy(m_indexesFile.data(), &count, sizeof count);
+}
+
+// Remapping invalidates every pointer into the file, so callers must not keep any across a push_back.
+// If the file cannot be grown it is mapped again at its old size before the error is thrown.
+template<class T> void MappedVector<T>::grow(System::MemoryMappedFile& file, uint64_t requiredSize, uint64_t chunkSize) {
+  if (requiredSize <= file.size()) {
+    return;
+  }
+
+  uint64_t newSize = (requiredSize + chunkSize - 1) / chunkSize * chunkSize;
+  std::string path = file.path();
+  std::error_code ec;
+  file.close(ec);
+  if (!ec) {
+    boost::system::error_code resizeError;
+    boost::filesystem::resize_file(path, newSize, resizeError);
+    if (resizeError) {
+      ec = std::error_code(resizeError.value(), std::system_category());
+    }
+
+    std::error_code openError;
+    file.open(path, openError);
+    if (!ec) {
+      ec = openError;
+    }
+  }
+
+  if (!file.isOpened()) {
+    std::error_code ignore;
+    file.open(path, ignore);
+  }
+
+  if (ec) {
+    throw std::system_error(ec, "MappedVector::grow");
+  }
+}
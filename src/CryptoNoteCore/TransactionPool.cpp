@@ -25,6 +25,7 @@
 #include <boost/filesystem.hpp>
 
 #include "Common/int-util.h"
+#include "Common/ScopeExit.h"
 #include "Common/Util.h"
 #include "crypto/hash.h"
 
@@ -125,31 +126,70 @@ namespace CryptoNote
                                m_validator(validator),
                                m_timeProvider(timeProvider),
                                m_txCheckInterval(60, timeProvider),
-                               m_fee_index(boost::get<1>(m_transactions)),
+                               m_chainVersion(0),
+                               m_size(0),
+                               m_maxSize(parameters::CRYPTONOTE_MEMPOOL_MAX_SIZE),
+                               m_evictedCount(0),
+                               m_journalRecords(0),
                                logger(log, "txpool")
   {
   }
 
   bool tx_memory_pool::add_tx(const Transaction &tx, /*const Crypto::Hash& tx_prefix_hash,*/ const Crypto::Hash &id, size_t blobSize, tx_verification_context &tvc, bool keptByBlock, uint32_t height)
   {
+    std::vector<TransactionAdmission> admissions{makeAdmission(tx, id, blobSize, tvc, keptByBlock, height)};
+    if (checkTransaction(admissions.front()))
+    {
+      commitTransactions(admissions);
+    }
+
+    return admissions.front().result;
+  }
+
+  //---------------------------------------------------------------------------------
+  tx_memory_pool::TransactionAdmission tx_memory_pool::makeAdmission(const Transaction &tx, const Crypto::Hash &id, size_t blobSize, tx_verification_context &tvc, bool keptByBlock, uint32_t height) const
+  {
+    TransactionAdmission admission = boost::value_initialized<TransactionAdmission>();
+    admission.tx = &tx;
+    admission.tvc = &tvc;
+    admission.id = id;
+    admission.blobSize = blobSize;
+    admission.keptByBlock = keptByBlock;
+    admission.height = height;
+    return admission;
+  }
+
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::checkTransaction(TransactionAdmission &admission)
+  {
+    const Transaction &tx = *admission.tx;
+    const Crypto::Hash &id = admission.id;
+    tx_verification_context &tvc = *admission.tvc;
+    bool keptByBlock = admission.keptByBlock;
+    admission.checked = false;
+    admission.result = false;
+
     if (!check_inputs_types_supported(tx))
     {
       tvc.m_verification_failed = true;
       return false;
     }
 
-    bool isWithdrawalTransaction = false;
+    // inputs are checked against the chain without the pool lock, a block pushed meanwhile is noticed at commit
+    admission.chainVersion = m_chainVersion;
+
+    admission.isWithdrawalTransaction = false;
 
     for (const auto &in : tx.inputs)
     {
       const auto &inputType = in.type();
       if (inputType == typeid(MultisignatureInput))
       {
-        isWithdrawalTransaction = true;
+        admission.isWithdrawalTransaction = true;
       }
     }
 
-    uint64_t inputs_amount = m_currency.getTransactionAllInputsAmount(tx, height);   
+    uint64_t inputs_amount = m_currency.getTransactionAllInputsAmount(tx, admission.height);   
     uint64_t outputs_amount = get_outs_money_amount(tx);
 
     logger(DEBUGGING, WHITE) << "Processing tx " << id << " with inputs of " << inputs_amount << " and outputs of " << outputs_amount;
@@ -169,8 +209,10 @@ namespace CryptoNote
       ttl.ttl = 0;
     }
 
-    const uint64_t fee = inputs_amount - outputs_amount;
-    bool isFusionTransaction = fee == 0 && m_currency.isFusionTransaction(tx, blobSize);
+    admission.ttl = ttl.ttl;
+    admission.fee = inputs_amount - outputs_amount;
+    const uint64_t fee = admission.fee;
+    admission.isFusionTransaction = fee == 0 && m_currency.isFusionTransaction(tx, admission.blobSize);
 
     if (ttl.ttl != 0 && !keptByBlock)
     {
@@ -196,24 +238,33 @@ namespace CryptoNote
       }
     }
 
-    //check key images for transaction if it is not kept by block
-    if (!keptByBlock)
+    //the same transaction relayed by several peers is checked only once, the commit drops later copies
+    if (!keptByBlock && !beginAdmission(id))
     {
-      std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
-      if (haveSpentInputs(tx))
+      logger(TRACE) << "tx " << id << " is already being added to transaction pool";
+      admission.result = true;
+      return false;
+    }
+
+    Tools::ScopeExit admissionEnd([this, &id, keptByBlock] {
+      if (!keptByBlock)
       {
-        logger(WARNING) << "Transaction with id= " << id << " used already spent inputs";
-        tvc.m_verification_failed = true;
-        return false;
+        endAdmission(id);
       }
-    }
+    });
 
-    BlockInfo maxUsedBlock;
+    //check key images for transaction if it is not kept by block
+    if (!keptByBlock && haveSpentInputs(tx))
+    {
+      logger(WARNING) << "Transaction with id= " << id << " used already spent inputs";
+      tvc.m_verification_failed = true;
+      return false;
+    }
 
     // check inputs
-    bool inputsValid = m_validator.checkTransactionInputs(tx, maxUsedBlock);
+    admission.inputsValid = m_validator.checkTransactionInputs(tx, admission.maxUsedBlock);
 
-    if (!inputsValid)
+    if (!admission.inputsValid)
     {
       if (!keptByBlock)
       {
@@ -222,13 +273,13 @@ namespace CryptoNote
         return false;
       }
 
-      maxUsedBlock.clear();
+      admission.maxUsedBlock.clear();
       tvc.m_verification_impossible = true;
     }
 
     if (!keptByBlock)
     {
-      bool sizeValid = m_validator.checkTransactionSize(blobSize);
+      bool sizeValid = m_validator.checkTransactionSize(admission.blobSize);
       if (!sizeValid)
       {
         logger(WARNING, BRIGHT_YELLOW) << "tx too big, rejected";
@@ -237,7 +288,55 @@ namespace CryptoNote
       }
     }
 
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    admission.checked = true;
+    return true;
+  }
+
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::commitTransactions(std::vector<TransactionAdmission> &admissions)
+  {
+    bool evicted;
+    {
+      std::lock_guard<decltype(m_transactions_lock)> lock(m_transactions_lock);
+      for (TransactionAdmission &admission : admissions)
+      {
+        if (admission.checked)
+        {
+          admission.result = commitTransaction(admission);
+        }
+      }
+
+      evicted = evictTransactions();
+      if (evicted)
+      {
+        // an admitted transaction may have been the least preferred one, it is then neither kept nor relayed
+        for (TransactionAdmission &admission : admissions)
+        {
+          if (admission.checked && admission.tvc->m_added_to_pool && m_transactions.count(admission.id) == 0)
+          {
+            admission.tvc->m_added_to_pool = false;
+            admission.tvc->m_should_be_relayed = false;
+          }
+        }
+      }
+
+      flushJournal();
+    }
+
+    if (evicted)
+    {
+      m_observerManager.notify(&ITxPoolObserver::txDeletedFromPool);
+    }
+  }
+
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::commitTransaction(TransactionAdmission &admission)
+  {
+    const Transaction &tx = *admission.tx;
+    const Crypto::Hash &id = admission.id;
+    tx_verification_context &tvc = *admission.tvc;
+    bool keptByBlock = admission.keptByBlock;
+    const uint64_t fee = admission.fee;
 
     if (!keptByBlock && m_recentlyDeletedTransactions.find(id) != m_recentlyDeletedTransactions.end())
     {
@@ -248,18 +347,47 @@ namespace CryptoNote
       return true;
     }
 
+    if (m_transactions.count(id) != 0)
+    {
+      logger(TRACE) << "tx " << id << " is already in transaction pool";
+      return true;
+    }
+
+    if (!keptByBlock)
+    {
+      //another admission may have spent the same inputs while these were checked
+      if (haveSpentInputs(tx))
+      {
+        logger(WARNING) << "Transaction with id= " << id << " used already spent inputs";
+        tvc.m_verification_failed = true;
+        return false;
+      }
+
+      //blocks are pushed with the pool lock held, so only a block pushed before it was taken is checked for here
+      if (admission.chainVersion != m_chainVersion)
+      {
+        admission.maxUsedBlock.clear();
+        if (!m_validator.checkTransactionInputs(tx, admission.maxUsedBlock))
+        {
+          logger(WARNING, BRIGHT_YELLOW) << "tx used wrong inputs, rejected";
+          tvc.m_verification_failed = true;
+          return false;
+        }
+      }
+    }
+
     // add to pool
     {
       TransactionDetails txd;
 
       txd.id = id;
-      txd.blobSize = blobSize;
+      txd.blobSize = admission.blobSize;
       txd.tx = tx;
       txd.fee = fee;
       txd.keptByBlock = keptByBlock;
       txd.receiveTime = m_timeProvider.now();
 
-      txd.maxUsedBlock = maxUsedBlock;
+      txd.maxUsedBlock = admission.maxUsedBlock;
       txd.lastFailedBlock.clear();
 
       auto txd_p = m_transactions.insert(std::move(txd));
@@ -268,24 +396,27 @@ namespace CryptoNote
         logger(WARNING, BRIGHT_YELLOW) << " Transaction already exists at inserting in memory pool";
         return false;
       }
+      journalAddedTransaction(*txd_p.first);
       m_paymentIdIndex.add(txd.tx);
       m_timestampIndex.add(txd.receiveTime, txd.id);
+      m_priorityIndex.add(txd.id, txd.fee, txd.blobSize, txd.receiveTime);
+      m_size += txd.blobSize;
 
-      if (ttl.ttl != 0)
+      if (admission.ttl != 0)
       {
-        m_ttlIndex.emplace(std::make_pair(id, ttl.ttl));
+        m_ttlIndex.emplace(std::make_pair(id, admission.ttl));
       }
 
       logger(DEBUGGING) << "Transaction " << txd.id << " added to pool";
     }
 
-    if (height >= parameters::UPGRADE_HEIGHT_V8) {
+    if (admission.height >= parameters::UPGRADE_HEIGHT_V8) {
       tvc.m_added_to_pool = true;
-      tvc.m_should_be_relayed = inputsValid && (fee == CryptoNote::parameters::MINIMUM_FEE || isFusionTransaction || isWithdrawalTransaction || ttl.ttl != 0);
+      tvc.m_should_be_relayed = admission.inputsValid && (fee == CryptoNote::parameters::MINIMUM_FEE || admission.isFusionTransaction || admission.isWithdrawalTransaction || admission.ttl != 0);
       tvc.m_verification_failed = true;
     } else {
       tvc.m_added_to_pool = true;
-      tvc.m_should_be_relayed = inputsValid && (fee > 0 || isFusionTransaction || ttl.ttl != 0);
+      tvc.m_should_be_relayed = admission.inputsValid && (fee > 0 || admission.isFusionTransaction || admission.ttl != 0);
       tvc.m_verification_failed = true;
     }
 
@@ -308,7 +439,7 @@ namespace CryptoNote
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::take_tx(const Crypto::Hash &id, Transaction &tx, size_t &blobSize, uint64_t &fee)
   {
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    std::lock_guard<decltype(m_transactions_lock)> lock(m_transactions_lock);
     auto it = m_transactions.find(id);
     if (it == m_transactions.end())
     {
@@ -327,7 +458,7 @@ namespace CryptoNote
 
   bool tx_memory_pool::getTransaction(const Crypto::Hash &id, Transaction &tx)
   {
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    std::shared_lock<decltype(m_transactions_lock)> lock(m_transactions_lock);
     auto it = m_transactions.find(id);
     if (it == m_transactions.end())
     {
@@ -343,13 +474,13 @@ namespace CryptoNote
   //---------------------------------------------------------------------------------
   size_t tx_memory_pool::get_transactions_count() const
   {
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    std::shared_lock<decltype(m_transactions_lock)> lock(m_transactions_lock);
     return m_transactions.size();
   }
   //---------------------------------------------------------------------------------
   void tx_memory_pool::get_transactions(std::list<Transaction> &txs) const
   {
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    std::shared_lock<decltype(m_transactions_lock)> lock(m_transactions_lock);
     for (const auto &tx_vt : m_transactions)
     {
       txs.push_back(tx_vt.tx);
@@ -358,7 +489,7 @@ namespace CryptoNote
   //---------------------------------------------------------------------------------
   void tx_memory_pool::get_difference(const std::vector<Crypto::Hash> &known_tx_ids, std::vector<Crypto::Hash> &new_tx_ids, std::vector<Crypto::Hash> &deleted_tx_ids) const
   {
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    std::shared_lock<decltype(m_transactions_lock)> lock(m_transactions_lock);
     std::unordered_set<Crypto::Hash> ready_tx_ids;
     for (const auto &tx : m_transactions)
     {
@@ -390,17 +521,19 @@ namespace CryptoNote
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::on_blockchain_inc(uint64_t new_block_height, const Crypto::Hash &top_block_id)
   {
+    ++m_chainVersion;
     return true;
   }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::on_blockchain_dec(uint64_t new_block_height, const Crypto::Hash &top_block_id)
   {
+    ++m_chainVersion;
     return true;
   }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::have_tx(const Crypto::Hash &id) const
   {
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    std::shared_lock<decltype(m_transactions_lock)> lock(m_transactions_lock);
     if (m_transactions.count(id))
     {
       return true;
@@ -409,6 +542,26 @@ namespace CryptoNote
     return false;
   }
   //---------------------------------------------------------------------------------
+  size_t tx_memory_pool::getTransactionsSize(const std::vector<Crypto::Hash>& txsIds, std::vector<Crypto::Hash>& missedTxs) const
+  {
+    std::shared_lock<decltype(m_transactions_lock)> lock(m_transactions_lock);
+    size_t size = 0;
+    for (const auto& id : txsIds)
+    {
+      auto it = m_transactions.find(id);
+      if (it == m_transactions.end())
+      {
+        missedTxs.push_back(id);
+      }
+      else
+      {
+        size += it->blobSize;
+      }
+    }
+
+    return size;
+  }
+  //---------------------------------------------------------------------------------
   void tx_memory_pool::lock() const
   {
     m_transactions_lock.lock();
@@ -416,12 +569,24 @@ namespace CryptoNote
   //---------------------------------------------------------------------------------
   void tx_memory_pool::unlock() const
   {
+    flushJournal();
     m_transactions_lock.unlock();
   }
 
-  std::unique_lock<std::recursive_mutex> tx_memory_pool::obtainGuard() const
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::lock_shared() const
+  {
+    m_transactions_lock.lock_shared();
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::unlock_shared() const
+  {
+    m_transactions_lock.unlock_shared();
+  }
+
+  std::unique_lock<Tools::RecursiveSharedMutex> tx_memory_pool::obtainGuard() const
   {
-    return std::unique_lock<std::recursive_mutex>(m_transactions_lock);
+    return std::unique_lock<Tools::RecursiveSharedMutex>(m_transactions_lock);
   }
 
   //---------------------------------------------------------------------------------
@@ -443,12 +608,41 @@ namespace CryptoNote
     return true;
   }
   //---------------------------------------------------------------------------------
+  bool tx_memory_pool::isTransactionReady(const TransactionDetails &txd, const Crypto::Hash &topBlockId)
+  {
+    uint64_t now = m_timeProvider.now();
+    auto verdictIt = m_verdicts.find(txd.id);
+    if (verdictIt != m_verdicts.end() && verdictIt->second.topBlockId == topBlockId &&
+        (verdictIt->second.ready || now < verdictIt->second.checkTime + parameters::CRYPTONOTE_MEMPOOL_FAILED_CHECK_LIVETIME))
+    {
+      return verdictIt->second.ready;
+    }
+
+    // failures are remembered by the verdicts, per tip and only for a while; a remembered failed block would
+    // make the validator reject the transaction without checking it for as long as that block stays in the chain
+    TransactionCheckInfo checkInfo(txd);
+    checkInfo.lastFailedBlock.clear();
+    bool ready = is_transaction_ready_to_go(txd.tx, checkInfo);
+
+    // keep the block the inputs were found in, so that on the next tip only that block is looked up again
+    if (ready)
+    {
+      m_transactions.modify(m_transactions.find(txd.id), [&checkInfo](TransactionDetails &details) {
+        details.maxUsedBlock = checkInfo.maxUsedBlock;
+      });
+    }
+
+    m_verdicts[txd.id] = TransactionVerdict{topBlockId, ready, now};
+    return ready;
+  }
+  //---------------------------------------------------------------------------------
   std::string tx_memory_pool::print_pool(bool short_format) const
   {
     std::stringstream ss;
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
-    for (const auto &txd : m_fee_index)
+    std::shared_lock<decltype(m_transactions_lock)> lock(m_transactions_lock);
+    m_priorityIndex.forEach([this, &ss, short_format](const TransactionPriorityIndex::Entry &entry)
     {
+      const TransactionDetails &txd = *m_transactions.find(entry.id);
       ss << "id: " << txd.id << std::endl;
 
       if (!short_format)
@@ -468,7 +662,7 @@ namespace CryptoNote
       }
 
       ss << std::endl;
-    }
+    });
 
     return ss.str();
   }
@@ -482,7 +676,7 @@ namespace CryptoNote
       uint64_t &fee,
       uint32_t &height)
   {
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    std::lock_guard<decltype(m_transactions_lock)> lock(m_transactions_lock);
     total_size = 0;
     fee = 0;
     size_t max_total_size = (125 * median_size) / 100 - m_currency.minerTxBlobReservedSize();
@@ -490,15 +684,21 @@ namespace CryptoNote
 
     BlockTemplate blockTemplate;
 
-    for (auto it = m_fee_index.rbegin(); it != m_fee_index.rend(); ++it)
+    // the size and TTL checks only read the index entry, the transaction is looked up for those that pass them
+    m_priorityIndex.forEachReverse([&](const TransactionPriorityIndex::Entry &entry)
     {
-      const auto &txd = *it;
+      if (m_ttlIndex.count(entry.id) > 0)
+      {
+        return true;
+      }
 
-      if (m_ttlIndex.count(txd.id) > 0)
+      size_t blockSizeLimit = (entry.fee == 0) ? median_size : max_total_size;
+      if (blockSizeLimit < total_size + entry.blobSize)
       {
-        continue;
+        return true;
       }
 
+      const TransactionDetails &txd = *m_transactions.find(entry.id);
       uint64_t inputs_amount = m_currency.getTransactionAllInputsAmount(txd.tx, height);
       uint64_t outputs_amount = get_outs_money_amount(txd.tx);
 
@@ -506,17 +706,10 @@ namespace CryptoNote
       {
         logger(WARNING, BRIGHT_YELLOW) << "Transaction, with id " << txd.id << " uses more money than it has: uses " << m_currency.formatAmount(outputs_amount) << ", has " << m_currency.formatAmount(inputs_amount)
                                        << " and will not be included in the block template";
-        continue;
+        return true;
       }
 
-      size_t blockSizeLimit = (txd.fee == 0) ? median_size : max_total_size;
-      if (blockSizeLimit < total_size + txd.blobSize)
-      {
-        continue;
-      }
-
-      TransactionCheckInfo checkInfo(txd);
-      bool ready = is_transaction_ready_to_go(txd.tx, checkInfo);
+      bool ready = isTransactionReady(txd, bl.previousBlockHash);
 
       if (ready && blockTemplate.addTransaction(txd.id, txd.tx))
       {
@@ -528,7 +721,9 @@ namespace CryptoNote
       {
         logger(DEBUGGING) << "Transaction " << txd.id << " was not included in the block template";
       }
-    }
+
+      return true;
+    });
 
     bl.transactionHashes = blockTemplate.getTransactions();
     return true;
@@ -536,39 +731,66 @@ namespace CryptoNote
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::init(const std::string &config_folder)
   {
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    std::lock_guard<decltype(m_transactions_lock)> lock(m_transactions_lock);
 
     m_config_folder = config_folder;
     std::string state_file_path = config_folder + "/" + m_currency.txPoolFileName();
     boost::system::error_code ec;
-    if (!boost::filesystem::exists(state_file_path, ec))
-    {
-      return true;
-    }
-
-    if (!loadFromBinaryFile(*this, state_file_path))
+    if (boost::filesystem::exists(state_file_path, ec) && !loadFromBinaryFile(*this, state_file_path))
     {
       logger(ERROR) << "Failed to load memory pool from file " << state_file_path;
 
       m_transactions.clear();
-      m_spent_key_images.clear();
-      m_spentOutputs.clear();
+      m_size = 0;
+      for (ConflictShard &shard : m_conflictShards)
+      {
+        shard.spentKeyImages.clear();
+        shard.spentOutputs.clear();
+      }
 
       m_paymentIdIndex.clear();
       m_timestampIndex.clear();
+      m_priorityIndex.clear();
       m_ttlIndex.clear();
+      m_verdicts.clear();
+    }
+
+    if (replayJournal())
+    {
+      openJournal(false);
     }
     else
     {
-      buildIndices();
+      storeState();
     }
 
+    buildIndices();
+    evictTransactions();
+
     removeExpiredTransactions();
 
     // Ignore deserialization error
     return true;
   }
   //---------------------------------------------------------------------------------
+  void tx_memory_pool::setMaxSize(uint64_t maxSize)
+  {
+    std::lock_guard<decltype(m_transactions_lock)> lock(m_transactions_lock);
+    m_maxSize = maxSize;
+  }
+  //---------------------------------------------------------------------------------
+  tx_memory_pool::Statistics tx_memory_pool::getStatistics() const
+  {
+    std::shared_lock<decltype(m_transactions_lock)> lock(m_transactions_lock);
+
+    Statistics statistics;
+    statistics.transactionsCount = m_transactions.size();
+    statistics.size = m_size;
+    statistics.maxSize = m_maxSize;
+    statistics.evictedCount = m_evictedCount;
+    return statistics;
+  }
+  //---------------------------------------------------------------------------------
   bool tx_memory_pool::deinit()
   {
     if (!Tools::create_directories_if_necessary(m_config_folder))
@@ -577,21 +799,29 @@ namespace CryptoNote
       return false;
     }
 
-    std::string state_file_path = m_config_folder + "/" + m_currency.txPoolFileName();
-
-    if (!storeToBinaryFile(*this, state_file_path))
     {
-      logger(INFO) << "Failed to serialize memory pool to file " << state_file_path;
+      std::lock_guard<decltype(m_transactions_lock)> lock(m_transactions_lock);
+
+      // the state file and the journal already describe the pool, it is only written in full without a journal
+      if (!m_journal.is_open())
+      {
+        storeState();
+      }
+
+      m_journal.close();
     }
 
     m_paymentIdIndex.clear();
     m_timestampIndex.clear();
+    m_priorityIndex.clear();
     m_ttlIndex.clear();
+    m_verdicts.clear();
 
     return true;
   }
 
 #define CURRENT_MEMPOOL_ARCHIVE_VER 1
+  const size_t MEMPOOL_JOURNAL_MIN_RECORDS = 1000; // the journal is folded into the state file once it has more records than this and than the pool has transactions
 
   void serialize(CryptoNote::tx_memory_pool::TransactionDetails &td, ISerializer &s)
   {
@@ -619,11 +849,12 @@ namespace CryptoNote
       return;
     }
 
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    std::lock_guard<decltype(m_transactions_lock)> lock(m_transactions_lock);
 
     if (s.type() == ISerializer::INPUT)
     {
       m_transactions.clear();
+      m_size = 0;
       readSequence<TransactionDetails>(std::inserter(m_transactions, m_transactions.end()), "transactions", s);
     }
     else
@@ -631,15 +862,315 @@ namespace CryptoNote
       writeSequence<TransactionDetails>(m_transactions.begin(), m_transactions.end(), "transactions", s);
     }
 
-    KV_MEMBER(m_spent_key_images);
-    KV_MEMBER(m_spentOutputs);
+    // stored as single tables, as before they were split
+    key_images_container spentKeyImages;
+    GlobalOutputsContainer spentOutputs;
+    if (s.type() == ISerializer::OUTPUT)
+    {
+      for (ConflictShard &shard : m_conflictShards)
+      {
+        std::lock_guard<std::mutex> shardLock(shard.lock);
+        spentKeyImages.insert(shard.spentKeyImages.begin(), shard.spentKeyImages.end());
+        spentOutputs.insert(shard.spentOutputs.begin(), shard.spentOutputs.end());
+      }
+    }
+
+    s(spentKeyImages, "m_spent_key_images");
+    s(spentOutputs, "m_spentOutputs");
     KV_MEMBER(m_recentlyDeletedTransactions);
+
+    if (s.type() == ISerializer::INPUT)
+    {
+      for (ConflictShard &shard : m_conflictShards)
+      {
+        shard.spentKeyImages.clear();
+        shard.spentOutputs.clear();
+      }
+
+      for (auto &keyImage : spentKeyImages)
+      {
+        keyImageShard(keyImage.first).spentKeyImages.insert(std::move(keyImage));
+      }
+
+      for (const auto &output : spentOutputs)
+      {
+        outputShard(output).spentOutputs.insert(output);
+      }
+    }
+  }
+
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::openJournal(bool truncate)
+  {
+    std::string path = m_config_folder + "/" + m_currency.txPoolJournalFileName();
+    m_journal.close();
+    m_journal.clear();
+    m_journal.open(path, std::ios::binary | (truncate ? std::ios::trunc : std::ios::app));
+    if (!m_journal)
+    {
+      logger(WARNING, BRIGHT_YELLOW) << "Failed to open memory pool journal " << path;
+    }
+  }
+
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::journalAddedTransaction(const TransactionDetails &txd)
+  {
+    if (!m_journal.is_open())
+    {
+      return;
+    }
+
+    Common::StdOutputStream stream(m_journal);
+    BinaryOutputStreamSerializer s(stream);
+    bool added = true;
+    s(added, "added");
+    s(const_cast<TransactionDetails &>(txd), "transaction");
+    ++m_journalRecords;
+  }
+
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::journalRemovedTransaction(const Crypto::Hash &id)
+  {
+    if (!m_journal.is_open())
+    {
+      return;
+    }
+
+    // callers that drop a transaction for good have put it into m_recentlyDeletedTransactions already
+    auto deleted = m_recentlyDeletedTransactions.find(id);
+    uint64_t deletionTime = deleted == m_recentlyDeletedTransactions.end() ? 0 : deleted->second;
+
+    Common::StdOutputStream stream(m_journal);
+    BinaryOutputStreamSerializer s(stream);
+    bool added = false;
+    s(added, "added");
+    s(const_cast<Crypto::Hash &>(id), "id");
+    s(deletionTime, "deletionTime");
+    ++m_journalRecords;
+  }
+
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::flushJournal() const
+  {
+    if (m_journal.is_open())
+    {
+      m_journal.flush();
+    }
+  }
+
+  //---------------------------------------------------------------------------------
+  // Returns false if the journal ends with a torn record that could not be cut off, records appended after it would never be read back.
+  bool tx_memory_pool::replayJournal()
+  {
+    m_journalRecords = 0;
+    std::string path = m_config_folder + "/" + m_currency.txPoolJournalFileName();
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+      return true;
+    }
+
+    uint64_t replayedSize = 0;
+
+    Common::StdInputStream stream(file);
+    BinaryInputStreamSerializer s(stream);
+    try
+    {
+      while (file.peek() != std::ifstream::traits_type::eof())
+      {
+        bool added;
+        s(added, "added");
+        if (added)
+        {
+          TransactionDetails txd;
+          s(txd, "transaction");
+          if (m_transactions.count(txd.id) == 0 && (txd.keptByBlock || !haveSpentInputs(txd.tx)))
+          {
+            auto it = m_transactions.insert(std::move(txd)).first;
+            addTransactionInputs(it->id, it->tx, it->keptByBlock);
+          }
+        }
+        else
+        {
+          Crypto::Hash id;
+          uint64_t deletionTime;
+          s(id, "id");
+          s(deletionTime, "deletionTime");
+          auto it = m_transactions.find(id);
+          if (it != m_transactions.end())
+          {
+            removeTransactionInputs(it->id, it->tx, it->keptByBlock);
+            m_transactions.erase(it);
+          }
+
+          if (deletionTime != 0)
+          {
+            m_recentlyDeletedTransactions[id] = deletionTime;
+          }
+        }
+
+        ++m_journalRecords;
+        replayedSize = static_cast<uint64_t>(file.tellg());
+      }
+    }
+    catch (std::exception &)
+    {
+      // a record torn by a crash can only be the last one
+    }
+
+    file.close();
+    if (m_journalRecords != 0)
+    {
+      logger(INFO) << "Memory pool journal replayed: " << m_journalRecords << " changes, " << m_transactions.size() << " transactions";
+    }
+
+    boost::system::error_code ec;
+    uint64_t journalSize = boost::filesystem::file_size(path, ec);
+    if (ec || journalSize <= replayedSize)
+    {
+      return true;
+    }
+
+    logger(WARNING, BRIGHT_YELLOW) << "Memory pool journal ends with a torn record, " << journalSize - replayedSize << " bytes dropped";
+    boost::filesystem::resize_file(path, replayedSize, ec);
+    if (ec)
+    {
+      logger(WARNING, BRIGHT_YELLOW) << "Failed to truncate memory pool journal " << path << ": " << ec.message();
+      return false;
+    }
+
+    return true;
+  }
+
+  //---------------------------------------------------------------------------------
+  // Only copying the pool holds its lock. The state file is written without it, and the records
+  // journaled meanwhile are then kept as the start of the new journal.
+  bool tx_memory_pool::compactJournal()
+  {
+    std::string journalPath = m_config_folder + "/" + m_currency.txPoolJournalFileName();
+    BinaryArray state;
+    uint64_t savedJournalSize;
+    size_t savedJournalRecords;
+    {
+      std::lock_guard<decltype(m_transactions_lock)> lock(m_transactions_lock);
+      if (!m_journal.is_open() || m_journalRecords <= std::max(MEMPOOL_JOURNAL_MIN_RECORDS, m_transactions.size()))
+      {
+        return true;
+      }
+
+      if (!toBinaryArray(*this, state))
+      {
+        logger(INFO) << "Failed to serialize memory pool";
+        return false;
+      }
+
+      m_journal.flush();
+      boost::system::error_code ec;
+      savedJournalSize = boost::filesystem::file_size(journalPath, ec);
+      if (ec)
+      {
+        return false;
+      }
+
+      savedJournalRecords = m_journalRecords;
+    }
+
+    if (!writeState(state))
+    {
+      return false;
+    }
+
+    std::lock_guard<decltype(m_transactions_lock)> lock(m_transactions_lock);
+    m_journal.flush();
+    std::string records;
+    {
+      std::ifstream file(journalPath, std::ios::binary);
+      if (file && file.seekg(savedJournalSize))
+      {
+        records.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+      }
+    }
+
+    m_journalRecords -= savedJournalRecords;
+    if (records.empty())
+    {
+      openJournal(true);
+      return true;
+    }
+
+    std::string temporaryJournalPath = journalPath + ".tmp";
+    {
+      std::ofstream file(temporaryJournalPath, std::ios::binary | std::ios::trunc);
+      file.write(records.data(), records.size());
+      file.close();
+      if (!file)
+      {
+        logger(WARNING, BRIGHT_YELLOW) << "Failed to compact memory pool journal";
+        m_journalRecords += savedJournalRecords;
+        return false;
+      }
+    }
+
+    m_journal.close();
+    boost::system::error_code ec;
+    boost::filesystem::rename(temporaryJournalPath, journalPath, ec);
+    if (ec)
+    {
+      logger(WARNING, BRIGHT_YELLOW) << "Failed to compact memory pool journal: " << ec.message();
+      m_journalRecords += savedJournalRecords;
+    }
+
+    openJournal(false);
+    return !ec;
+  }
+
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::storeState()
+  {
+    BinaryArray state;
+    if (!toBinaryArray(*this, state) || !writeState(state))
+    {
+      return false;
+    }
+
+    openJournal(true);
+    m_journalRecords = 0;
+    return true;
+  }
+
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::writeState(const BinaryArray &state)
+  {
+    std::string state_file_path = m_config_folder + "/" + m_currency.txPoolFileName();
+    std::string temporary_file_path = state_file_path + ".tmp";
+
+    // the previous state file is replaced only once the new one is complete
+    {
+      std::ofstream file(temporary_file_path, std::ios::binary | std::ios::trunc);
+      file.write(reinterpret_cast<const char *>(state.data()), state.size());
+      file.close();
+      if (!file)
+      {
+        logger(INFO) << "Failed to serialize memory pool to file " << temporary_file_path;
+        return false;
+      }
+    }
+
+    boost::system::error_code ec;
+    boost::filesystem::rename(temporary_file_path, state_file_path, ec);
+    if (ec)
+    {
+      logger(INFO) << "Failed to replace memory pool file " << state_file_path << ": " << ec.message();
+      return false;
+    }
+
+    return true;
   }
 
   //---------------------------------------------------------------------------------
   void tx_memory_pool::on_idle()
   {
-    m_txCheckInterval.call([this]() { return removeExpiredTransactions(); });
+    m_txCheckInterval.call([this]() { return removeExpiredTransactions() && compactJournal(); });
   }
 
   //---------------------------------------------------------------------------------
@@ -647,7 +1178,7 @@ namespace CryptoNote
   {
     bool somethingRemoved = false;
     {
-      std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+      std::lock_guard<decltype(m_transactions_lock)> lock(m_transactions_lock);
 
       uint64_t now = m_timeProvider.now();
 
@@ -692,6 +1223,8 @@ namespace CryptoNote
           ++it;
         }
       }
+
+      flushJournal();
     }
 
     if (somethingRemoved)
@@ -702,12 +1235,51 @@ namespace CryptoNote
     return true;
   }
 
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::evictTransactions()
+  {
+    if (m_size <= m_maxSize)
+    {
+      return false;
+    }
+
+    // transactions of blocks being switched are kept, they are on their way back into the chain
+    std::vector<Crypto::Hash> evictedIds;
+    uint64_t excess = m_size - m_maxSize;
+    uint64_t evictedSize = 0;
+    m_priorityIndex.forEachReverse([&](const TransactionPriorityIndex::Entry &entry)
+    {
+      if (!m_transactions.find(entry.id)->keptByBlock)
+      {
+        evictedIds.push_back(entry.id);
+        evictedSize += entry.blobSize;
+      }
+
+      return evictedSize < excess;
+    });
+
+    uint64_t now = m_timeProvider.now();
+    for (const Crypto::Hash &id : evictedIds)
+    {
+      logger(INFO) << "Tx " << id << " removed from tx pool to keep it within " << m_maxSize << " bytes";
+      m_recentlyDeletedTransactions.emplace(id, now);
+      removeTransaction(m_transactions.find(id));
+      ++m_evictedCount;
+    }
+
+    return !evictedIds.empty();
+  }
+
   tx_memory_pool::tx_container_t::iterator tx_memory_pool::removeTransaction(tx_memory_pool::tx_container_t::iterator i)
   {
     removeTransactionInputs(i->id, i->tx, i->keptByBlock);
     m_paymentIdIndex.remove(i->tx);
     m_timestampIndex.remove(i->receiveTime, i->id);
+    m_priorityIndex.remove(i->id, i->fee, i->blobSize, i->receiveTime);
+    m_size -= i->blobSize;
+    journalRemovedTransaction(i->id);
     m_ttlIndex.erase(i->id);
+    m_verdicts.erase(i->id);
     return m_transactions.erase(i);
   }
 
@@ -718,8 +1290,10 @@ namespace CryptoNote
       if (in.type() == typeid(KeyInput))
       {
         const auto &txin = boost::get<KeyInput>(in);
-        auto it = m_spent_key_images.find(txin.keyImage);
-        if (!(it != m_spent_key_images.end()))
+        ConflictShard &shard = keyImageShard(txin.keyImage);
+        std::lock_guard<std::mutex> shardLock(shard.lock);
+        auto it = shard.spentKeyImages.find(txin.keyImage);
+        if (!(it != shard.spentKeyImages.end()))
         {
           logger(ERROR, BRIGHT_RED) << "failed to find transaction input in key images. img=" << txin.keyImage << std::endl
                                     << "transaction id = " << tx_id;
@@ -744,7 +1318,7 @@ namespace CryptoNote
         if (key_image_set.empty())
         {
           //it is now empty hash container for this key_image
-          m_spent_key_images.erase(it);
+          shard.spentKeyImages.erase(it);
         }
       }
       else if (in.type() == typeid(MultisignatureInput))
@@ -753,8 +1327,10 @@ namespace CryptoNote
         {
           const auto &msig = boost::get<MultisignatureInput>(in);
           auto output = GlobalOutput(msig.amount, msig.outputIndex);
-          assert(m_spentOutputs.count(output));
-          m_spentOutputs.erase(output);
+          ConflictShard &shard = outputShard(output);
+          std::lock_guard<std::mutex> shardLock(shard.lock);
+          assert(shard.spentOutputs.count(output));
+          shard.spentOutputs.erase(output);
         }
       }
     }
@@ -762,6 +1338,36 @@ namespace CryptoNote
     return true;
   }
 
+  //---------------------------------------------------------------------------------
+  tx_memory_pool::ConflictShard &tx_memory_pool::keyImageShard(const Crypto::KeyImage &keyImage) const
+  {
+    // key images and hashes are uniformly distributed already
+    return m_conflictShards[keyImage.data[0] % CONFLICT_SHARD_COUNT];
+  }
+  //---------------------------------------------------------------------------------
+  tx_memory_pool::ConflictShard &tx_memory_pool::outputShard(const GlobalOutput &output) const
+  {
+    return m_conflictShards[(output.first ^ output.second) % CONFLICT_SHARD_COUNT];
+  }
+  //---------------------------------------------------------------------------------
+  tx_memory_pool::ConflictShard &tx_memory_pool::transactionShard(const Crypto::Hash &id) const
+  {
+    return m_conflictShards[id.data[0] % CONFLICT_SHARD_COUNT];
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::beginAdmission(const Crypto::Hash &id)
+  {
+    ConflictShard &shard = transactionShard(id);
+    std::lock_guard<std::mutex> shardLock(shard.lock);
+    return shard.admissions.insert(id).second;
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::endAdmission(const Crypto::Hash &id)
+  {
+    ConflictShard &shard = transactionShard(id);
+    std::lock_guard<std::mutex> shardLock(shard.lock);
+    shard.admissions.erase(id);
+  }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::addTransactionInputs(const Crypto::Hash &id, const Transaction &tx, bool keptByBlock)
   {
@@ -771,7 +1377,9 @@ namespace CryptoNote
       if (in.type() == typeid(KeyInput))
       {
         const auto &txin = boost::get<KeyInput>(in);
-        std::unordered_set<Crypto::Hash> &kei_image_set = m_spent_key_images[txin.keyImage];
+        ConflictShard &shard = keyImageShard(txin.keyImage);
+        std::lock_guard<std::mutex> shardLock(shard.lock);
+        std::unordered_set<Crypto::Hash> &kei_image_set = shard.spentKeyImages[txin.keyImage];
         if (!(keptByBlock || kei_image_set.size() == 0))
         {
           logger(ERROR, BRIGHT_RED)
@@ -792,7 +1400,10 @@ namespace CryptoNote
         if (!keptByBlock)
         {
           const auto &msig = boost::get<MultisignatureInput>(in);
-          auto r = m_spentOutputs.insert(GlobalOutput(msig.amount, msig.outputIndex));
+          GlobalOutput output(msig.amount, msig.outputIndex);
+          ConflictShard &shard = outputShard(output);
+          std::lock_guard<std::mutex> shardLock(shard.lock);
+          auto r = shard.spentOutputs.insert(output);
           (void)r;
           assert(r.second);
         }
@@ -810,7 +1421,9 @@ namespace CryptoNote
       if (in.type() == typeid(KeyInput))
       {
         const auto &tokey_in = boost::get<KeyInput>(in);
-        if (m_spent_key_images.count(tokey_in.keyImage))
+        ConflictShard &shard = keyImageShard(tokey_in.keyImage);
+        std::lock_guard<std::mutex> shardLock(shard.lock);
+        if (shard.spentKeyImages.count(tokey_in.keyImage))
         {
           return true;
         }
@@ -818,7 +1431,10 @@ namespace CryptoNote
       else if (in.type() == typeid(MultisignatureInput))
       {
         const auto &msig = boost::get<MultisignatureInput>(in);
-        if (m_spentOutputs.count(GlobalOutput(msig.amount, msig.outputIndex)))
+        GlobalOutput output(msig.amount, msig.outputIndex);
+        ConflictShard &shard = outputShard(output);
+        std::lock_guard<std::mutex> shardLock(shard.lock);
+        if (shard.spentOutputs.count(output))
         {
           return true;
         }
@@ -839,11 +1455,13 @@ namespace CryptoNote
 
   void tx_memory_pool::buildIndices()
   {
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    std::lock_guard<decltype(m_transactions_lock)> lock(m_transactions_lock);
     for (auto it = m_transactions.begin(); it != m_transactions.end(); it++)
     {
       m_paymentIdIndex.add(it->tx);
       m_timestampIndex.add(it->receiveTime, it->id);
+      m_priorityIndex.add(it->id, it->fee, it->blobSize, it->receiveTime);
+      m_size += it->blobSize;
 
       std::vector<TransactionExtraField> txExtraFields;
       parseTransactionExtra(it->tx.extra, txExtraFields);
@@ -860,13 +1478,13 @@ namespace CryptoNote
 
   bool tx_memory_pool::getTransactionIdsByPaymentId(const Crypto::Hash &paymentId, std::vector<Crypto::Hash> &transactionIds)
   {
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    std::shared_lock<decltype(m_transactions_lock)> lock(m_transactions_lock);
     return m_paymentIdIndex.find(paymentId, transactionIds);
   }
 
   bool tx_memory_pool::getTransactionIdsByTimestamp(uint64_t timestampBegin, uint64_t timestampEnd, uint32_t transactionsNumberLimit, std::vector<Crypto::Hash> &hashes, uint64_t &transactionsNumberWithinTimestamps)
   {
-    std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+    std::shared_lock<decltype(m_transactions_lock)> lock(m_transactions_lock);
     return m_timestampIndex.find(timestampBegin, timestampEnd, transactionsNumberLimit, hashes, transactionsNumberWithinTimestamps);
   }
 } // namespace CryptoNote
@@ -17,8 +17,13 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <fstream>
 #include <list>
+#include <mutex>
 #include <set>
+#include <shared_mutex>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -27,12 +32,12 @@
 // multi index
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/hashed_index.hpp>
-#include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/member.hpp>
 
 #include "Common/Util.h"
 #include "Common/int-util.h"
 #include "Common/ObserverManager.h"
+#include "Common/RecursiveSharedMutex.h"
 #include "crypto/hash.h"
 
 #include "CryptoNoteCore/CryptoNoteBasic.h"
@@ -84,6 +89,34 @@ namespace CryptoNote {
   /************************************************************************/
   class tx_memory_pool: boost::noncopyable {
   public:
+    // A transaction on its way into the pool. checkTransaction fills it without the pool lock and may run
+    // for many transactions at once, commitTransactions then adds the checked ones under one lock.
+    struct TransactionAdmission {
+      const Transaction* tx;
+      tx_verification_context* tvc;
+      Crypto::Hash id;
+      size_t blobSize;
+      bool keptByBlock;
+      uint32_t height;
+
+      bool checked;
+      bool result;
+      uint64_t fee;
+      uint64_t ttl;
+      bool inputsValid;
+      bool isFusionTransaction;
+      bool isWithdrawalTransaction;
+      BlockInfo maxUsedBlock;
+      uint64_t chainVersion;
+    };
+
+    struct Statistics {
+      uint64_t transactionsCount;
+      uint64_t size;
+      uint64_t maxSize;
+      uint64_t evictedCount;
+    };
+
     tx_memory_pool(
       const CryptoNote::Currency& currency, 
       CryptoNote::ITransactionValidator& validator,
@@ -97,18 +130,30 @@ namespace CryptoNote {
     bool init(const std::string& config_folder);
     bool deinit();
 
+    // Bytes of transactions the pool keeps, the least preferred ones are dropped beyond it.
+    void setMaxSize(uint64_t maxSize);
+    Statistics getStatistics() const;
+
     bool have_tx(const Crypto::Hash &id) const;
+    // Sums the sizes kept for the given transactions, the ones not in the pool are added to missedTxs.
+    size_t getTransactionsSize(const std::vector<Crypto::Hash>& txsIds, std::vector<Crypto::Hash>& missedTxs) const;
     bool add_tx(const Transaction &tx, const Crypto::Hash &id, size_t blobSize, tx_verification_context& tvc, bool keeped_by_block, uint32_t height);
     bool add_tx(const Transaction &tx, tx_verification_context& tvc, bool keeped_by_block, uint32_t height);
+    TransactionAdmission makeAdmission(const Transaction& tx, const Crypto::Hash& id, size_t blobSize, tx_verification_context& tvc, bool keptByBlock, uint32_t height) const;
+    bool checkTransaction(TransactionAdmission& admission);
+    void commitTransactions(std::vector<TransactionAdmission>& admissions);
     //gets tx and remove it from pool
     bool take_tx(const Crypto::Hash &id, Transaction &tx, size_t& blobSize, uint64_t& fee);
 
     bool on_blockchain_inc(uint64_t new_block_height, const Crypto::Hash& top_block_id);
     bool on_blockchain_dec(uint64_t new_block_height, const Crypto::Hash& top_block_id);
 
+    // Exclusive ownership is what blocks and admission commits take, shared ownership only reads.
     void lock() const;
     void unlock() const;
-    std::unique_lock<std::recursive_mutex> obtainGuard() const;
+    void lock_shared() const;
+    void unlock_shared() const;
+    std::unique_lock<Tools::RecursiveSharedMutex> obtainGuard() const;
 
     bool fill_block_template(Block &bl, size_t median_size, size_t maxCumulativeSize, uint64_t already_generated_coins, size_t &total_size, uint64_t &fee, uint32_t& height);
 
@@ -124,7 +169,7 @@ namespace CryptoNote {
     
     template<class t_ids_container, class t_tx_container, class t_missed_container>
     void getTransactions(const t_ids_container& txsIds, t_tx_container& txs, t_missed_container& missedTxs) {
-      std::lock_guard<std::recursive_mutex> lock(m_transactions_lock);
+      std::shared_lock<Tools::RecursiveSharedMutex> lock(m_transactions_lock);
 
       for (const auto& id : txsIds) {
         auto it = m_transactions.find(id);
@@ -154,38 +199,48 @@ namespace CryptoNote {
 
   private:
 
-    struct TransactionPriorityComparator {
-      // lhs > hrs
-      bool operator()(const TransactionDetails& lhs, const TransactionDetails& rhs) const {
-        // price(lhs) = lhs.fee / lhs.blobSize
-        // price(lhs) > price(rhs) -->
-        // lhs.fee / lhs.blobSize > rhs.fee / rhs.blobSize -->
-        // lhs.fee * rhs.blobSize > rhs.fee * lhs.blobSize
-        uint64_t lhs_hi, lhs_lo = mul128(lhs.fee, rhs.blobSize, &lhs_hi);
-        uint64_t rhs_hi, rhs_lo = mul128(rhs.fee, lhs.blobSize, &rhs_hi);
-
-        return
-          // prefer more profitable transactions
-          (lhs_hi >  rhs_hi) ||
-          (lhs_hi == rhs_hi && lhs_lo >  rhs_lo) ||
-          // prefer smaller
-          (lhs_hi == rhs_hi && lhs_lo == rhs_lo && lhs.blobSize <  rhs.blobSize) ||
-          // prefer older
-          (lhs_hi == rhs_hi && lhs_lo == rhs_lo && lhs.blobSize == rhs.blobSize && lhs.receiveTime < rhs.receiveTime);
-      }
+    // Outcome of the last readiness check of a pool transaction and the chain tip it was made on.
+    // Spent key images of the chain only change together with the tip, and a transaction that
+    // conflicts with one already in the pool is only admitted while blocks are being switched.
+    // Outputs unlocked by timestamp also unlock as time passes, so a failed check is only reused
+    // for CRYPTONOTE_MEMPOOL_FAILED_CHECK_LIVETIME seconds.
+    struct TransactionVerdict {
+      Crypto::Hash topBlockId;
+      bool ready;
+      uint64_t checkTime;
     };
 
     typedef hashed_unique<BOOST_MULTI_INDEX_MEMBER(TransactionDetails, Crypto::Hash, id)> main_index_t;
-    typedef ordered_non_unique<identity<TransactionDetails>, TransactionPriorityComparator> fee_index_t;
 
+    // transaction bodies by id, the order they are mined in is kept apart in m_priorityIndex
     typedef multi_index_container<TransactionDetails,
-      indexed_by<main_index_t, fee_index_t>
+      indexed_by<main_index_t>
     > tx_container_t;
 
     typedef std::pair<uint64_t, uint64_t> GlobalOutput;
     typedef std::set<GlobalOutput> GlobalOutputsContainer;
     typedef std::unordered_map<Crypto::KeyImage, std::unordered_set<Crypto::Hash> > key_images_container;
 
+    // Conflict tables split by key image, output and transaction id, each part with a lock of its own,
+    // so that admissions check for double spends without the pool lock. They are only written while
+    // the pool lock is held exclusively.
+    struct ConflictShard {
+      std::mutex lock;
+      key_images_container spentKeyImages;
+      GlobalOutputsContainer spentOutputs;
+      std::unordered_set<Crypto::Hash> admissions;
+    };
+
+    static const size_t CONFLICT_SHARD_COUNT = 16;
+
+    ConflictShard& keyImageShard(const Crypto::KeyImage& keyImage) const;
+    ConflictShard& outputShard(const GlobalOutput& output) const;
+    ConflictShard& transactionShard(const Crypto::Hash& id) const;
+    bool beginAdmission(const Crypto::Hash& id);
+    void endAdmission(const Crypto::Hash& id);
+
+
+    bool commitTransaction(TransactionAdmission& admission);
 
     // double spending checking
     bool addTransactionInputs(const Crypto::Hash& id, const Transaction& tx, bool keptByBlock);
@@ -194,22 +249,41 @@ namespace CryptoNote {
 
     tx_container_t::iterator removeTransaction(tx_container_t::iterator i);
     bool removeExpiredTransactions();
+    bool evictTransactions();
+
+    // Changes of the pool since its state file was written, appended as they happen and replayed on start.
+    // Records are flushed once per batch of changes: by commitTransactions, removeExpiredTransactions,
+    // and when the lock taken through lock() is released, which covers the transactions a block takes.
+    void openJournal(bool truncate);
+    void journalAddedTransaction(const TransactionDetails& txd);
+    void journalRemovedTransaction(const Crypto::Hash& id);
+    void flushJournal() const;
+    bool replayJournal();
+    bool compactJournal();
+    bool storeState();
+    bool writeState(const BinaryArray& state);
     bool is_transaction_ready_to_go(const Transaction& tx, TransactionCheckInfo& txd) const;
+    bool isTransactionReady(const TransactionDetails& txd, const Crypto::Hash& topBlockId);
     void buildIndices();
 
     Tools::ObserverManager<ITxPoolObserver> m_observerManager;
     const CryptoNote::Currency& m_currency;
     OnceInTimeInterval m_txCheckInterval;
-    mutable std::recursive_mutex m_transactions_lock;
-    key_images_container m_spent_key_images;
-    GlobalOutputsContainer m_spentOutputs;
+    mutable Tools::RecursiveSharedMutex m_transactions_lock;
+    mutable std::array<ConflictShard, CONFLICT_SHARD_COUNT> m_conflictShards;
+    std::atomic<uint64_t> m_chainVersion;
 
     std::string m_config_folder;
     CryptoNote::ITransactionValidator& m_validator;
     CryptoNote::ITimeProvider& m_timeProvider;
 
     tx_container_t m_transactions;  
-    tx_container_t::nth_index<1>::type& m_fee_index;
+    TransactionPriorityIndex m_priorityIndex;
+    uint64_t m_size;
+    uint64_t m_maxSize;
+    uint64_t m_evictedCount;
+    mutable std::ofstream m_journal;
+    size_t m_journalRecords;
     std::unordered_map<Crypto::Hash, uint64_t> m_recentlyDeletedTransactions;
 
     Logging::LoggerRef logger;
@@ -217,5 +291,6 @@ namespace CryptoNote {
     PaymentIdIndex m_paymentIdIndex;
     TimestampTransactionsIndex m_timestampIndex;
     std::unordered_map<Crypto::Hash, uint64_t> m_ttlIndex;
+    std::unordered_map<Crypto::Hash, TransactionVerdict> m_verdicts;
   };
 }
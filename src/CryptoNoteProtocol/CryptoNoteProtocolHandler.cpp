@@ -10,10 +10,12 @@
 
 #include "CryptoNoteProtocolHandler.h"
 
+#include <algorithm>
 #include <future>
 #include <boost/scope_exit.hpp>
 #include <boost/uuid/uuid_io.hpp>
 #include <System/Dispatcher.h>
+#include <System/PoolContext.h>
 #include <boost/optional.hpp>
 #include "CryptoNoteCore/CryptoNoteBasicImpl.h"
 #include "CryptoNoteCore/CryptoNoteFormatUtils.h"
@@ -51,6 +53,7 @@ CryptoNoteProtocolHandler::CryptoNoteProtocolHandler(const Currency &currency, S
                                                                                                                                                                                   m_p2p(p_net_layout),
                                                                                                                                                                                   m_synchronized(false),
                                                                                                                                                                                   m_stop(false),
+                                                                                                                                                                                  m_committingSpans(false),
                                                                                                                                                                                   m_observedHeight(0),
                                                                                                                                                                                   m_peersCount(0),
                                                                                                                                                                                   logger(log, "protocol")
@@ -103,6 +106,21 @@ void CryptoNoteProtocolHandler::onConnectionClosed(CryptoNoteConnectionContext &
     m_peersCount--;
     m_observerManager.notify(&ICryptoNoteProtocolObserver::peerCountUpdated, m_peersCount.load());
   }
+
+  // blocks this peer never delivered, or delivered ahead of their parent, can now be fetched by the others
+  bool hadSpans = std::any_of(m_pendingSpans.begin(), m_pendingSpans.end(), [&context](const std::pair<const Crypto::Hash, PendingSpan>& span) {
+    return span.second.connectionId == context.m_connection_id;
+  });
+
+  if (!context.m_requested_objects.empty() || hadSpans)
+  {
+    releaseRequestedObjects(context);
+    discardPendingSpans(context.m_connection_id);
+    if (!m_stop)
+    {
+      requestMissingObjectsFromWaitingPeers(context.m_connection_id);
+    }
+  }
 }
 
 void CryptoNoteProtocolHandler::stop()
@@ -362,14 +380,24 @@ int CryptoNoteProtocolHandler::handle_notify_new_transactions(int command, NOTIF
   }
   else
   {
-    for (auto tx_blob_it = arg.txs.begin(); tx_blob_it != arg.txs.end();)
+    std::vector<BinaryArray> transactionBinaries;
+    transactionBinaries.reserve(arg.txs.size());
+    for (const auto& tx : arg.txs)
     {
-      auto transactionBinary = asBinaryArray(*tx_blob_it);
-      Crypto::Hash transactionHash = Crypto::cn_fast_hash(transactionBinary.data(), transactionBinary.size());
-      logger(DEBUGGING) << "transaction " << transactionHash << " came in NOTIFY_NEW_TRANSACTIONS";
+      transactionBinaries.push_back(asBinaryArray(tx));
+      logger(DEBUGGING) << "transaction " << Crypto::cn_fast_hash(tx.data(), tx.size()) << " came in NOTIFY_NEW_TRANSACTIONS";
+    }
 
-      CryptoNote::tx_verification_context tvc = boost::value_initialized<decltype(tvc)>();
-      m_core.handle_incoming_tx(transactionBinary, tvc, false);
+    // the whole notification is verified in parallel off the dispatcher and added to the pool at once
+    std::vector<tx_verification_context> tvcs;
+    System::runOnPool(m_dispatcher, m_core.getWorkerPool(), [this, &transactionBinaries, &tvcs] {
+      m_core.handleIncomingTransactions(transactionBinaries, tvcs);
+    });
+
+    size_t tvcIndex = 0;
+    for (auto tx_blob_it = arg.txs.begin(); tx_blob_it != arg.txs.end(); ++tvcIndex)
+    {
+      const tx_verification_context& tvc = tvcs[tvcIndex];
       if (tvc.m_verification_failed)
       {
         logger(Logging::DEBUGGING) << context << "Tx verification failed";
@@ -423,145 +451,325 @@ int CryptoNoteProtocolHandler::handle_response_get_objects(int command, NOTIFY_R
 
   context.m_remote_blockchain_height = arg.current_blockchain_height;
 
-  size_t count = 0;
-  std::vector<Crypto::Hash> block_hashes;
-  block_hashes.reserve(arg.blocks.size());
-  std::vector<parsed_block_entry> parsed_blocks;
-  parsed_blocks.reserve(arg.blocks.size());
-  for (const block_complete_entry& block_entry : arg.blocks) {
-    ++count;
-    Block b;
-    BinaryArray block_blob = asBinaryArray(block_entry.block);
-    if (block_blob.size() > m_currency.maxBlockBlobSize()) {
-      logger(Logging::ERROR) << context << "sent wrong block: too big size " << block_blob.size() << ", dropping connection";
-      context.m_state = CryptoNoteConnectionContext::state_shutdown;
-      return 1;
-    }
-    if (!fromBinaryArray(b, block_blob)) {
-      logger(Logging::ERROR) << context << "sent wrong block: failed to parse and validate block: \r\n"
-        << toHex(block_blob) << "\r\n dropping connection";
+  if (arg.blocks.size() > context.m_requested_objects.size()) {
+    logger(Logging::ERROR) << context << "sent wrong NOTIFY_RESPONSE_GET_OBJECTS: " << arg.blocks.size() << " blocks while "
+      << context.m_requested_objects.size() << " were requested, dropping connection";
+    context.m_state = CryptoNoteConnectionContext::state_shutdown;
+    return 1;
+  }
+
+  // decoding and hashing run on a worker thread, while the dispatcher keeps committing
+  // the spans the other connections have delivered
+  std::vector<PreparedBlock> blocks;
+  std::string error;
+  bool decoded = false;
+  System::runOnPool(m_dispatcher, m_core.getWorkerPool(), [this, &arg, &blocks, &error, &decoded] {
+    decoded = decodeBlocks(arg.blocks, blocks, error);
+  });
+
+  if (!decoded) {
+    logger(Logging::ERROR) << context << "sent wrong NOTIFY_RESPONSE_GET_OBJECTS: " << error << ", dropping connection";
+    context.m_state = CryptoNoteConnectionContext::state_shutdown;
+    return 1;
+  }
+
+  // only requested blocks are worth decoding transactions and computing proof of work for
+  std::unordered_set<Crypto::Hash> receivedBlocks;
+  for (const PreparedBlock& preparedBlock : blocks) {
+    if (context.m_requested_objects.count(preparedBlock.hash) == 0 || !receivedBlocks.insert(preparedBlock.hash).second) {
+      logger(Logging::ERROR) << context << "sent wrong NOTIFY_RESPONSE_GET_OBJECTS: block with id=" << Common::podToHex(preparedBlock.hash)
+        << " wasn't requested, dropping connection";
       context.m_state = CryptoNoteConnectionContext::state_shutdown;
       return 1;
     }
+  }
 
-    //to avoid concurrency in core between connections, suspend connections which delivered block later then first one
-    auto blockHash = get_block_hash(b);
-    if (count == 2) {
-      if (m_core.have_block(blockHash)) {
-        context.m_state = CryptoNoteConnectionContext::state_idle;
-        context.m_needed_objects.clear();
-        context.m_requested_objects.clear();
-        logger(DEBUGGING) << context << "Connection set to idle state.";
-        return 1;
-      }
+  if (receivedBlocks.size() != context.m_requested_objects.size()) {
+    logger(Logging::ERROR, Logging::BRIGHT_RED) << context <<
+      "returned not all requested objects (context.m_requested_objects.size()="
+      << context.m_requested_objects.size() - receivedBlocks.size() << "), dropping connection";
+    context.m_state = CryptoNoteConnectionContext::state_shutdown;
+    return 1;
+  }
+
+  // the blocks stay requested and claimed while they are prepared, so that neither this connection
+  // is asked for more nor another one for the same blocks until they are buffered as a span
+  bool prepared = false;
+  System::runOnPool(m_dispatcher, m_core.getWorkerPool(), [this, &arg, &blocks, &error, &prepared] {
+    prepared = prepareBlocks(arg.blocks, blocks, error);
+  });
+
+  if (!prepared) {
+    logger(Logging::ERROR) << context << "sent wrong NOTIFY_RESPONSE_GET_OBJECTS: " << error << ", dropping connection";
+    context.m_state = CryptoNoteConnectionContext::state_shutdown;
+    return 1;
+  }
+
+  releaseRequestedObjects(context);
+
+  // spans from several peers arrive in any order: buffer this one until its parent is in the chain
+  addPendingSpan(context, std::move(blocks));
+  commitPendingSpans(context);
+
+  if (!m_stop && context.m_state == CryptoNoteConnectionContext::state_synchronizing) {
+    request_missing_objects(context, true);
+  }
+
+  return 1;
+}
+
+bool CryptoNoteProtocolHandler::decodeBlocks(const std::vector<block_complete_entry>& entries, std::vector<PreparedBlock>& blocks, std::string& error) {
+  blocks.resize(entries.size());
+  for (size_t i = 0; i < entries.size(); ++i) {
+    PreparedBlock& preparedBlock = blocks[i];
+    BinaryArray blockBlob = asBinaryArray(entries[i].block);
+    if (blockBlob.size() > m_currency.maxBlockBlobSize()) {
+      error = "too big block size " + std::to_string(blockBlob.size());
+      return false;
     }
 
-    auto req_it = context.m_requested_objects.find(blockHash);
-    if (req_it == context.m_requested_objects.end()) {
-      logger(Logging::ERROR) << context << "sent wrong NOTIFY_RESPONSE_GET_OBJECTS: block with id=" << Common::podToHex(blockHash)
-        << " wasn't requested, dropping connection";
-      context.m_state = CryptoNoteConnectionContext::state_shutdown;
-      return 1;
+    if (!fromBinaryArray(preparedBlock.block, blockBlob)) {
+      error = "failed to parse and validate block: \r\n" + toHex(blockBlob);
+      return false;
     }
-    if (b.transactionHashes.size() != block_entry.txs.size()) {
-      logger(Logging::ERROR) << context << "sent wrong NOTIFY_RESPONSE_GET_OBJECTS: block with id=" << Common::podToHex(blockHash)
-        << ", transactionHashes.size()=" << b.transactionHashes.size() << " mismatch with block_complete_entry.m_txs.size()=" << block_entry.txs.size() << ", dropping connection";
-      context.m_state = CryptoNoteConnectionContext::state_shutdown;
-      return 1;
+
+    preparedBlock.hash = get_block_hash(preparedBlock.block);
+  }
+
+  return true;
+}
+
+// Runs after decodeBlocks, once the blocks are known to be the requested ones.
+bool CryptoNoteProtocolHandler::prepareBlocks(const std::vector<block_complete_entry>& entries, std::vector<PreparedBlock>& blocks, std::string& error) {
+  std::vector<const Block*> unknownBlocks;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const block_complete_entry& entry = entries[i];
+    PreparedBlock& preparedBlock = blocks[i];
+    if (preparedBlock.block.transactionHashes.size() != entry.txs.size()) {
+      error = "block with id=" + Common::podToHex(preparedBlock.hash) + ", transactionHashes.size()=" + std::to_string(preparedBlock.block.transactionHashes.size()) +
+        " mismatch with block_complete_entry.m_txs.size()=" + std::to_string(entry.txs.size());
+      return false;
     }
 
-    context.m_requested_objects.erase(req_it);
+    preparedBlock.transactions.resize(entry.txs.size());
+    for (size_t j = 0; j < entry.txs.size(); ++j) {
+      PreparedTransaction& preparedTransaction = preparedBlock.transactions[j];
+      BinaryArray transactionBlob = asBinaryArray(entry.txs[j]);
+      preparedTransaction.blobSize = transactionBlob.size();
+
+      Crypto::Hash prefixHash;
+      if (preparedTransaction.blobSize > m_currency.maxTxSize() ||
+          !parseAndValidateTransactionFromBinaryArray(transactionBlob, preparedTransaction.transaction, preparedTransaction.hash, prefixHash)) {
+        error = "failed to parse transaction " + std::to_string(j) + " of block with id=" + Common::podToHex(preparedBlock.hash);
+        return false;
+      }
 
-    block_hashes.push_back(blockHash);
+      // check if tx hashes match
+      if (preparedTransaction.hash != preparedBlock.block.transactionHashes[j]) {
+        error = "transaction mismatch, tx_id = " + Common::podToHex(preparedTransaction.hash);
+        return false;
+      }
+    }
 
-    parsed_block_entry parsedBlock;
-    parsedBlock.block = std::move(b);
-    for (auto& tx_blob : block_entry.txs) {
-      auto transactionBinary = asBinaryArray(tx_blob);
-      parsedBlock.txs.push_back(transactionBinary);
+    if (!m_core.have_block(preparedBlock.hash)) {
+      unknownBlocks.push_back(&preparedBlock.block);
     }
-    parsed_blocks.push_back(parsedBlock);
   }
 
-  if (context.m_requested_objects.size()) {
-    logger(Logging::ERROR, Logging::BRIGHT_RED) << context <<
-      "returned not all requested objects (context.m_requested_objects.size()="
-      << context.m_requested_objects.size() << "), dropping connection";
-    context.m_state = CryptoNoteConnectionContext::state_shutdown;
-    return 1;
+  m_core.precomputeProofOfWork(unknownBlocks);
+  return true;
+}
+
+void CryptoNoteProtocolHandler::addPendingSpan(const CryptoNoteConnectionContext& context, std::vector<PreparedBlock>&& blocks) {
+  // dismiss what another connection might already have done
+  size_t dismiss = 0;
+  while (dismiss < blocks.size() && m_core.have_block(blocks[dismiss].hash)) {
+    ++dismiss;
   }
 
-  uint32_t height;
-  Crypto::Hash top;
-  {
-    m_core.pause_mining();
+  if (dismiss == blocks.size()) {
+    logger(DEBUGGING) << context << "All " << blocks.size() << " received blocks are already known, dismissing";
+    return;
+  }
 
-    // we lock all the rest to avoid having multiple connections redo a lot
-    // of the same work, and one of them doing it for nothing: subsequent
-    // connections will wait until the current one's added its blocks, then
-    // will add any extra it has, if any
-    std::lock_guard<std::recursive_mutex> lk(m_sync_lock);
+  if (dismiss != 0) {
+    logger(DEBUGGING) << context << "Dismissing " << dismiss << "/" << blocks.size() << " already known blocks";
+    blocks.erase(blocks.begin(), blocks.begin() + dismiss);
+  }
 
-    // dismiss what another connection might already have done (likely everything)
-    m_core.get_blockchain_top(height, top);
-    uint64_t dismiss = 1;
-    for (const auto &h : block_hashes) {
-      if (top == h) {
-        logger(DEBUGGING) << "Found current top block in synced blocks, dismissing "
-          << dismiss << "/" << arg.blocks.size() << " blocks";
-        while (dismiss--) {
-          arg.blocks.erase(arg.blocks.begin());
-          parsed_blocks.erase(parsed_blocks.begin());
-        }
-        break;
+  const Crypto::Hash& previousBlockHash = blocks.front().block.previousBlockHash;
+  if (m_pendingSpans.count(previousBlockHash) != 0) {
+    logger(DEBUGGING) << context << "Span after block " << previousBlockHash << " is already buffered, dismissing";
+    return;
+  }
+
+  PendingSpan& span = m_pendingSpans[previousBlockHash];
+  span.connectionId = context.m_connection_id;
+  span.receiveTime = time(nullptr);
+  span.blocks = std::move(blocks);
+  for (const PreparedBlock& preparedBlock : span.blocks) {
+    m_pendingBlocks.insert(preparedBlock.hash);
+  }
+}
+
+void CryptoNoteProtocolHandler::discardPendingSpans(const boost::uuids::uuid& connectionId) {
+  for (auto it = m_pendingSpans.begin(); it != m_pendingSpans.end();) {
+    if (it->second.connectionId == connectionId) {
+      for (const PreparedBlock& preparedBlock : it->second.blocks) {
+        m_pendingBlocks.erase(preparedBlock.hash);
+      }
+      it = m_pendingSpans.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+// A span whose parent never arrives would keep its blocks claimed, and a full buffer of
+// them would stop the download for good, so spans are only kept for so long.
+bool CryptoNoteProtocolHandler::evictStalePendingSpans(time_t now) {
+  bool evicted = false;
+  for (auto it = m_pendingSpans.begin(); it != m_pendingSpans.end();) {
+    if (now - it->second.receiveTime >= static_cast<time_t>(BLOCKS_SYNCHRONIZING_PENDING_SPAN_TIMEOUT)) {
+      logger(DEBUGGING) << "Span after block " << it->first << " waited too long for its parent, dropping it";
+      for (const PreparedBlock& preparedBlock : it->second.blocks) {
+        m_pendingBlocks.erase(preparedBlock.hash);
       }
+      it = m_pendingSpans.erase(it);
+      evicted = true;
+    } else {
+      ++it;
+    }
+  }
+
+  return evicted;
+}
+
+void CryptoNoteProtocolHandler::commitPendingSpans(CryptoNoteConnectionContext& context) {
+  // processObjects yields between blocks; whichever connection is already committing
+  // will also pick up the spans buffered by the others meanwhile
+  if (m_committingSpans) {
+    return;
+  }
+
+  m_committingSpans = true;
+  BOOST_SCOPE_EXIT_ALL(this) { m_committingSpans = false; };
+
+  bool miningPaused = false;
+  BOOST_SCOPE_EXIT_ALL(this, &miningPaused) {
+    if (miningPaused) {
+      m_core.update_block_template_and_resume_mining();
+    }
+  };
+
+  // we lock all the rest to avoid having multiple connections redo a lot
+  // of the same work
+  std::lock_guard<std::recursive_mutex> lk(m_sync_lock);
+
+  bool committed = false;
+  while (!m_stop) {
+    auto spanIt = std::find_if(m_pendingSpans.begin(), m_pendingSpans.end(), [this](const std::pair<const Crypto::Hash, PendingSpan>& span) {
+      return m_core.have_block(span.first);
+    });
+
+    if (spanIt == m_pendingSpans.end()) {
+      break;
+    }
+
+    PendingSpan span = std::move(spanIt->second);
+    m_pendingSpans.erase(spanIt);
+    for (const PreparedBlock& preparedBlock : span.blocks) {
+      m_pendingBlocks.erase(preparedBlock.hash);
+    }
+
+    // the span may overlap blocks committed after it was buffered
+    size_t dismiss = 0;
+    while (dismiss < span.blocks.size() && m_core.have_block(span.blocks[dismiss].hash)) {
       ++dismiss;
     }
+    span.blocks.erase(span.blocks.begin(), span.blocks.begin() + dismiss);
+    if (span.blocks.empty()) {
+      continue;
+    }
 
-    BOOST_SCOPE_EXIT_ALL(this) { m_core.update_block_template_and_resume_mining(); };
+    if (!miningPaused) {
+      m_core.pause_mining();
+      miningPaused = true;
+    }
 
-    int result = processObjects(context, parsed_blocks);
-    if (result != 0) {
-      return result;
+    if (span.connectionId == context.m_connection_id) {
+      if (processObjects(context, span.blocks) != 0) {
+        releaseRequestedObjects(context);
+        discardPendingSpans(span.connectionId);
+        continue;
+      }
+    } else {
+      // the connection which delivered the span answers for it, even if it has gone meanwhile
+      CryptoNoteConnectionContext spanContext;
+      spanContext.m_connection_id = span.connectionId;
+      m_p2p->for_each_connection([&](CryptoNoteConnectionContext& ctx, PeerIdType peerId) {
+        if (ctx.m_connection_id == span.connectionId) {
+          spanContext.m_remote_ip = ctx.m_remote_ip;
+          spanContext.m_remote_port = ctx.m_remote_port;
+          spanContext.m_is_income = ctx.m_is_income;
+        }
+      });
+      spanContext.m_state = CryptoNoteConnectionContext::state_synchronizing;
+
+      if (processObjects(spanContext, span.blocks) != 0) {
+        discardPendingSpans(span.connectionId);
+        m_p2p->for_each_connection([&](CryptoNoteConnectionContext& ctx, PeerIdType peerId) {
+          if (ctx.m_connection_id == span.connectionId && ctx.m_state != CryptoNoteConnectionContext::state_shutdown) {
+            releaseRequestedObjects(ctx);
+            ctx.m_needed_objects.clear();
+            ctx.m_state = spanContext.m_state;
+          }
+        });
+        continue;
+      }
     }
+
+    committed = true;
   }
 
-  m_core.get_blockchain_top(height, top);
-  logger(DEBUGGING, BRIGHT_GREEN) << "Local blockchain updated, new height = " << height;
+  if (committed) {
+    uint32_t height;
+    Crypto::Hash top;
+    m_core.get_blockchain_top(height, top);
+    logger(DEBUGGING, BRIGHT_GREEN) << "Local blockchain updated, new height = " << height;
 
-  if (!m_stop && context.m_state == CryptoNoteConnectionContext::state_synchronizing) {
-    request_missing_objects(context, true);
+    if (!m_stop) {
+      requestMissingObjectsFromWaitingPeers(context.m_connection_id);
+    }
   }
-
-  return 1;
 }
 
-int CryptoNoteProtocolHandler::processObjects(CryptoNoteConnectionContext& context, const std::vector<parsed_block_entry>& blocks) {
+int CryptoNoteProtocolHandler::processObjects(CryptoNoteConnectionContext& context, const std::vector<PreparedBlock>& blocks) {
 
-  for (const parsed_block_entry& block_entry : blocks) {
+  for (const PreparedBlock& preparedBlock : blocks) {
     if (m_stop) {
       break;
     }
 
-    //process transactions
-    for (size_t i = 0; i < block_entry.txs.size(); ++i) {
-      auto transactionBinary = block_entry.txs[i];
-      Crypto::Hash transactionHash = Crypto::cn_fast_hash(transactionBinary.data(), transactionBinary.size());
-      logger(DEBUGGING) << "transaction " << transactionHash << " came in processObjects";
+    uint32_t height;
+    Crypto::Hash top;
+    m_core.get_blockchain_top(height, top);
 
-      // check if tx hashes match
-      if (transactionHash != block_entry.block.transactionHashes[i]) {
-        logger(DEBUGGING) << context << "transaction mismatch on NOTIFY_RESPONSE_GET_OBJECTS, \r\ntx_id = "
-          << Common::podToHex(transactionHash) << ", dropping connection";
-        context.m_state = CryptoNoteConnectionContext::state_shutdown;
-        return 1;
+    //process transactions, decoded and matched against the block by prepareBlocks
+    for (const PreparedTransaction& preparedTransaction : preparedBlock.transactions) {
+      logger(DEBUGGING) << "transaction " << preparedTransaction.hash << " came in processObjects";
+
+      Crypto::Hash blockId;
+      uint32_t blockHeight;
+      if (!m_core.getBlockContainingTx(preparedTransaction.hash, blockId, blockHeight)) {
+        blockHeight = height + 1;
       }
 
       tx_verification_context tvc = boost::value_initialized<decltype(tvc)>();
-      m_core.handle_incoming_tx(transactionBinary, tvc, true);
+      m_core.handleIncomingTransaction(preparedTransaction.transaction, preparedTransaction.hash, preparedTransaction.blobSize, tvc, true, blockHeight);
       if (tvc.m_verification_failed) {
         logger(DEBUGGING) << context << "transaction verification failed on NOTIFY_RESPONSE_GET_OBJECTS, \r\ntx_id = "
-          << Common::podToHex(transactionHash) << ", dropping connection";
+          << Common::podToHex(preparedTransaction.hash) << ", dropping connection";
         context.m_state = CryptoNoteConnectionContext::state_shutdown;
         return 1;
       }
@@ -569,7 +777,7 @@ int CryptoNoteProtocolHandler::processObjects(CryptoNoteConnectionContext& conte
 
     // process block
     block_verification_context bvc = boost::value_initialized<block_verification_context>();
-    m_core.handle_incoming_block(block_entry.block, bvc, false, false);
+    m_core.handle_incoming_block(preparedBlock.block, bvc, false, false);
 
     if (bvc.m_verification_failed) {
       logger(DEBUGGING) << context << "Block verification failed, dropping connection";
@@ -583,7 +791,7 @@ int CryptoNoteProtocolHandler::processObjects(CryptoNoteConnectionContext& conte
       logger(DEBUGGING) << context << "Block already exists, switching to idle state";
       context.m_state = CryptoNoteConnectionContext::state_idle;
       context.m_needed_objects.clear();
-      context.m_requested_objects.clear();
+      releaseRequestedObjects(context);
       return 1;
     }
 
@@ -596,6 +804,17 @@ int CryptoNoteProtocolHandler::processObjects(CryptoNoteConnectionContext& conte
 
 bool CryptoNoteProtocolHandler::on_idle()
 {
+  if (!m_stop)
+  {
+    time_t now = time(nullptr);
+    bool spansEvicted = evictStalePendingSpans(now);
+    bool claimsExpired = evictExpiredBlockClaims(now);
+    if (spansEvicted || claimsExpired)
+    {
+      requestMissingObjectsFromWaitingPeers(boost::uuids::uuid());
+    }
+  }
+
   return m_core.on_idle();
 }
 
@@ -629,25 +848,60 @@ bool CryptoNoteProtocolHandler::request_missing_objects(CryptoNoteConnectionCont
 {
   if (context.m_needed_objects.size())
   {
-    //we know objects that we need, request this objects
+    //we know objects that we need, request the first run of them no other connection is downloading,
+    //so that every synchronizing peer delivers a different span
     NOTIFY_REQUEST_GET_OBJECTS::request req;
-    size_t count = 0;
+    time_t now = time(nullptr);
+    bool atChainTip = true;
     auto it = context.m_needed_objects.begin();
 
-    while (it != context.m_needed_objects.end() && count < BLOCKS_SYNCHRONIZING_DEFAULT_COUNT)
+    while (it != context.m_needed_objects.end() && req.blocks.size() < BLOCKS_SYNCHRONIZING_DEFAULT_COUNT)
     {
-      if (!(check_having_blocks && m_core.have_block(*it)))
+      if (check_having_blocks && m_core.have_block(*it))
+      {
+        it = context.m_needed_objects.erase(it);
+        continue;
+      }
+
+      if (isBlockClaimed(*it, now))
+      {
+        if (!req.blocks.empty())
+        {
+          break;
+        }
+
+        atChainTip = false;
+        ++it;
+        continue;
+      }
+
+      // once the buffer is full only the span right after the chain tip may be fetched
+      if (!atChainTip && m_pendingSpans.size() >= BLOCKS_SYNCHRONIZING_MAX_PENDING_SPANS && !evictStalePendingSpans(now))
       {
-        req.blocks.push_back(*it);
-        ++count;
-        context.m_requested_objects.insert(*it);
+        break;
       }
+
+      req.blocks.push_back(*it);
+      context.m_requested_objects.insert(*it);
+      m_blocksInFlight[*it] = now;
       it = context.m_needed_objects.erase(it);
     }
-    logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_GET_OBJECTS: blocks.size()=" << req.blocks.size() << ", txs.size()=" << req.txs.size();
-    post_notify<NOTIFY_REQUEST_GET_OBJECTS>(*m_p2p, req, context);
+
+    if (!req.blocks.empty())
+    {
+      logger(Logging::TRACE) << context << "-->>NOTIFY_REQUEST_GET_OBJECTS: blocks.size()=" << req.blocks.size() << ", txs.size()=" << req.txs.size();
+      post_notify<NOTIFY_REQUEST_GET_OBJECTS>(*m_p2p, req, context);
+      return true;
+    }
+
+    if (!context.m_needed_objects.empty())
+    {
+      logger(Logging::TRACE) << context << "Needed blocks are being downloaded from other connections, waiting";
+      return true;
+    }
   }
-  else if (context.m_last_response_height < context.m_remote_blockchain_height - 1)
+
+  if (context.m_last_response_height < context.m_remote_blockchain_height - 1)
   { //we have to fetch more objects ids, request blockchain entry
 
     NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
@@ -681,6 +935,61 @@ bool CryptoNoteProtocolHandler::request_missing_objects(CryptoNoteConnectionCont
   return true;
 }
 
+void CryptoNoteProtocolHandler::requestMissingObjectsFromWaitingPeers(const boost::uuids::uuid &excludeConnection)
+{
+  m_p2p->for_each_connection([&](CryptoNoteConnectionContext &ctx, PeerIdType peerId) {
+    if (ctx.m_connection_id != excludeConnection &&
+        ctx.m_state == CryptoNoteConnectionContext::state_synchronizing &&
+        ctx.m_requested_objects.empty() &&
+        !ctx.m_needed_objects.empty())
+    {
+      request_missing_objects(ctx, true);
+    }
+  });
+}
+
+bool CryptoNoteProtocolHandler::isBlockClaimed(const Crypto::Hash &blockHash, time_t now) const
+{
+  if (m_pendingBlocks.count(blockHash) != 0)
+  {
+    return true;
+  }
+
+  auto it = m_blocksInFlight.find(blockHash);
+  return it != m_blocksInFlight.end() && now - it->second < static_cast<time_t>(BLOCKS_SYNCHRONIZING_REQUEST_TIMEOUT);
+}
+
+// Peers parked behind a claim are only woken by a response, so a claim left by a slow or dead
+// peer must be dropped here or the others would wait for the pending span timeout.
+bool CryptoNoteProtocolHandler::evictExpiredBlockClaims(time_t now)
+{
+  bool evicted = false;
+  for (auto it = m_blocksInFlight.begin(); it != m_blocksInFlight.end();)
+  {
+    if (now - it->second >= static_cast<time_t>(BLOCKS_SYNCHRONIZING_REQUEST_TIMEOUT))
+    {
+      it = m_blocksInFlight.erase(it);
+      evicted = true;
+    }
+    else
+    {
+      ++it;
+    }
+  }
+
+  return evicted;
+}
+
+void CryptoNoteProtocolHandler::releaseRequestedObjects(CryptoNoteConnectionContext &context)
+{
+  for (const auto &blockHash : context.m_requested_objects)
+  {
+    m_blocksInFlight.erase(blockHash);
+  }
+
+  context.m_requested_objects.clear();
+}
+
 bool CryptoNoteProtocolHandler::on_connection_synchronized()
 {
   bool val_expected = false;
@@ -18,6 +18,10 @@
 #pragma once
 
 #include <atomic>
+#include <ctime>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <Common/ObserverManager.h>
 
@@ -59,6 +63,29 @@ namespace CryptoNote
       }
     };
 
+    // a downloaded block decoded and hashed ahead of the commit, off the dispatcher thread
+    struct PreparedTransaction
+    {
+      Transaction transaction;
+      Crypto::Hash hash;
+      size_t blobSize;
+    };
+
+    struct PreparedBlock
+    {
+      Block block;
+      Crypto::Hash hash;
+      std::vector<PreparedTransaction> transactions;
+    };
+
+    // a run of consecutive blocks downloaded from one connection, waiting for its parent to reach the chain
+    struct PendingSpan
+    {
+      boost::uuids::uuid connectionId;
+      time_t receiveTime;
+      std::vector<PreparedBlock> blocks;
+    };
+
     CryptoNoteProtocolHandler(const Currency& currency, System::Dispatcher& dispatcher, ICore& rcore, IP2pEndpoint* p_net_layout, Logging::ILogger& log);
 
     virtual bool addObserver(ICryptoNoteProtocolObserver* observer) override;
@@ -104,10 +131,20 @@ namespace CryptoNote
     //----------------------------------------------------------------------------------
     uint32_t get_current_blockchain_height();
     bool request_missing_objects(CryptoNoteConnectionContext& context, bool check_having_blocks);
+    void requestMissingObjectsFromWaitingPeers(const boost::uuids::uuid& excludeConnection);
+    bool isBlockClaimed(const Crypto::Hash& blockHash, time_t now) const;
+    bool evictExpiredBlockClaims(time_t now);
+    void releaseRequestedObjects(CryptoNoteConnectionContext& context);
+    bool decodeBlocks(const std::vector<block_complete_entry>& entries, std::vector<PreparedBlock>& blocks, std::string& error);
+    bool prepareBlocks(const std::vector<block_complete_entry>& entries, std::vector<PreparedBlock>& blocks, std::string& error);
+    void addPendingSpan(const CryptoNoteConnectionContext& context, std::vector<PreparedBlock>&& blocks);
+    void discardPendingSpans(const boost::uuids::uuid& connectionId);
+    bool evictStalePendingSpans(time_t now);
+    void commitPendingSpans(CryptoNoteConnectionContext& context);
     bool on_connection_synchronized();
     void updateObservedHeight(uint32_t peerHeight, const CryptoNoteConnectionContext& context);
     void recalculateMaxObservedHeight(const CryptoNoteConnectionContext& context);
-    int processObjects(CryptoNoteConnectionContext& context, const std::vector<parsed_block_entry>& blocks);
+    int processObjects(CryptoNoteConnectionContext& context, const std::vector<PreparedBlock>& blocks);
     Logging::LoggerRef logger;
 
   private:
@@ -123,6 +160,12 @@ namespace CryptoNote
     std::atomic<bool> m_stop;
     std::recursive_mutex m_sync_lock;    
 
+    // parallel block download state, only touched from dispatcher fibers
+    std::unordered_map<Crypto::Hash, time_t> m_blocksInFlight;
+    std::unordered_map<Crypto::Hash, PendingSpan> m_pendingSpans; // keyed by previous block hash
+    std::unordered_set<Crypto::Hash> m_pendingBlocks;
+    bool m_committingSpans;
+
     mutable std::mutex m_observedHeightMutex;
     uint32_t m_observedHeight;
 
@@ -350,6 +350,7 @@ int main(int argc, char* argv[])
       }
     }
  
+    rpcServer.setWorkerThreads(rpcConfig.workerThreads);
     rpcServer.start(rpcConfig.bindIp, rpcConfig.bindPort);
     rpcServer.restrictRPC(command_line::get_arg(vm, arg_restricted_rpc));
     rpcServer.enableCors(command_line::get_arg(vm, arg_enable_cors));
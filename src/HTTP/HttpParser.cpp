@@ -23,6 +23,10 @@
 
 namespace {
 
+const size_t MAX_HEADERS_SIZE = 64 * 1024;
+const char LINE_END[] = "\r\n";
+const char HEADERS_END[] = "\r\n\r\n";
+
 void throwIfNotGood(std::istream& stream) {
   if (!stream.good()) {
     if (stream.eof()) {
@@ -65,6 +69,59 @@ void HttpParser::receiveRequest(std::istream& stream, HttpRequest& request) {
   }
 }
 
+size_t HttpParser::parseRequest(const char* data, size_t size, HttpRequest& request) {
+  const char* end = data + size;
+  const char* headersEnd = std::search(data, end, HEADERS_END, HEADERS_END + 4);
+  if (headersEnd == end) {
+    if (size > MAX_HEADERS_SIZE) {
+      throw std::system_error(make_error_code(CryptoNote::error::HttpParserErrorCodes::HEADERS_TOO_LARGE));
+    }
+
+    return 0;
+  }
+
+  // every line of the head, the request line included, ends with CRLF
+  const char* lineEnd = std::search(data, headersEnd + 2, LINE_END, LINE_END + 2);
+  const char* methodEnd = std::find(data, lineEnd, ' ');
+  const char* urlBegin = methodEnd == lineEnd ? lineEnd : methodEnd + 1;
+  const char* urlEnd = std::find(urlBegin, lineEnd, ' ');
+  if (methodEnd == data || urlEnd == urlBegin) {
+    throw std::system_error(make_error_code(CryptoNote::error::HttpParserErrorCodes::UNEXPECTED_SYMBOL));
+  }
+
+  request.method.assign(data, methodEnd);
+  request.url.assign(urlBegin, urlEnd);
+
+  for (const char* line = lineEnd + 2; line < headersEnd + 2; line = lineEnd + 2) {
+    lineEnd = std::search(line, headersEnd + 2, LINE_END, LINE_END + 2);
+    const char* colon = std::find(line, lineEnd, ':');
+    if (colon == lineEnd) {
+      throw std::system_error(make_error_code(CryptoNote::error::HttpParserErrorCodes::UNEXPECTED_SYMBOL));
+    }
+
+    if (colon == line) {
+      throw std::system_error(make_error_code(CryptoNote::error::HttpParserErrorCodes::EMPTY_HEADER));
+    }
+
+    const char* valueBegin = colon + 1;
+    while (valueBegin != lineEnd && (*valueBegin == ' ' || *valueBegin == '\t')) {
+      ++valueBegin;
+    }
+
+    std::string name(line, colon);
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    request.headers[name].assign(valueBegin, lineEnd);
+  }
+
+  size_t headersSize = headersEnd + 4 - data;
+  size_t bodyLen = getBodyLen(request.headers);
+  if (size - headersSize < bodyLen) {
+    return 0;
+  }
+
+  request.body.assign(headersEnd + 4, bodyLen);
+  return headersSize + bodyLen;
+}
 
 void HttpParser::receiveResponse(std::istream& stream, HttpResponse& response) {
   std::string httpVersion;
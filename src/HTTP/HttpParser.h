@@ -32,13 +32,16 @@ public:
   HttpParser() {};
 
   void receiveRequest(std::istream& stream, HttpRequest& request);
+  // Parses one request from the beginning of a receive buffer. Returns the number of bytes it takes,
+  // or 0 if the buffer does not hold the whole request yet; the rest of the buffer is left for the next one.
+  static size_t parseRequest(const char* data, size_t size, HttpRequest& request);
   void receiveResponse(std::istream& stream, HttpResponse& response);
   static HttpResponse::HTTP_STATUS parseResponseStatusFromString(const std::string& status);
 private:
   void readWord(std::istream& stream, std::string& word);
   void readHeaders(std::istream& stream, HttpRequest::Headers &headers);
   bool readHeader(std::istream& stream, std::string& name, std::string& value);
-  size_t getBodyLen(const HttpRequest::Headers& headers);
+  static size_t getBodyLen(const HttpRequest::Headers& headers);
   void readBody(std::istream& stream, std::string& body, const size_t bodyLen);
 };
 
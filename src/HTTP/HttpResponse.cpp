@@ -18,6 +18,7 @@
 #include "HttpResponse.h"
 
 #include <stdexcept>
+#include <utility>
 
 namespace {
 
@@ -74,8 +75,8 @@ void HttpResponse::addHeader(const std::string& name, const std::string& value)
   headers[name] = value;
 }
 
-void HttpResponse::setBody(const std::string& b) {
-  body = b;
+void HttpResponse::setBody(std::string b) {
+  body = std::move(b);
   if (!body.empty()) {
     headers["Content-Length"] = std::to_string(body.size());
   } else {
@@ -83,13 +84,26 @@ void HttpResponse::setBody(const std::string& b) {
   }
 }
 
-std::ostream& HttpResponse::printHttpResponse(std::ostream& os) const {
-  os << "HTTP/1.1 " << getStatusString(status) << "\r\n";
-
-  for (auto pair: headers) {
-    os << pair.first << ": " << pair.second << "\r\n";
+std::string HttpResponse::getHead() const {
+  std::string head;
+  head.reserve(256);
+  head += "HTTP/1.1 ";
+  head += getStatusString(status);
+  head += "\r\n";
+
+  for (const auto& pair: headers) {
+    head += pair.first;
+    head += ": ";
+    head += pair.second;
+    head += "\r\n";
   }
-  os << "\r\n";
+  head += "\r\n";
+
+  return head;
+}
+
+std::ostream& HttpResponse::printHttpResponse(std::ostream& os) const {
+  os << getHead();
 
   if (!body.empty()) {
     os << body;
@@ -35,11 +35,13 @@ namespace CryptoNote {
 
     void setStatus(HTTP_STATUS s);
     void addHeader(const std::string& name, const std::string& value);
-    void setBody(const std::string& b);
+    void setBody(std::string b);
 
     const std::map<std::string, std::string>& getHeaders() const { return headers; }
     HTTP_STATUS getStatus() const { return status; }
     const std::string& getBody() const { return body; }
+    // status line and headers up to the empty line, for writing them ahead of the body
+    std::string getHead() const;
 
   private:
     friend std::ostream& operator<<(std::ostream& os, const HttpResponse& resp);
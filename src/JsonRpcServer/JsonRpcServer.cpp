@@ -34,6 +34,7 @@
 #include "Common/JsonValue.h"
 #include "Serialization/JsonInputValueSerializer.h"
 #include "Serialization/JsonOutputStreamSerializer.h"
+#include "Serialization/SerializationTools.h"
 
 namespace CryptoNote {
 
@@ -70,13 +71,16 @@ void JsonRpcServer::processRequest(const CryptoNote::HttpRequest& req, CryptoNot
         return;
       }
 
-      processJsonRpcRequest(jsonRpcRequest, jsonRpcResponse);
+      std::string result;
+      processJsonRpcRequest(jsonRpcRequest, jsonRpcResponse, result);
 
-      std::ostringstream jsonOutputStream;
-      jsonOutputStream << jsonRpcResponse;
+      std::string body = jsonRpcResponse.toString();
+      if (!result.empty()) {
+        appendJsonMember(body, "result", result);
+      }
 
       resp.setStatus(CryptoNote::HttpResponse::STATUS_200);
-      resp.setBody(jsonOutputStream.str());
+      resp.setBody(std::move(body));
 
     } else {
       logger(Logging::WARNING) << "Requested url \"" << req.getUrl() << "\" is not found";
@@ -164,10 +168,6 @@ void JsonRpcServer::makeMethodNotFoundResponse(Common::JsonValue& resp) {
   resp.insert("error", error);
 }
 
-void JsonRpcServer::fillJsonResponse(const Common::JsonValue& v, Common::JsonValue& resp) {
-  resp.insert("result", v);
-}
-
 void JsonRpcServer::makeJsonParsingErrorResponse(Common::JsonValue& resp) {
   using Common::JsonValue;
 
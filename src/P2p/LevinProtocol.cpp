@@ -52,23 +52,7 @@ LevinProtocol::LevinProtocol(System::TcpConnection& connection)
   : m_conn(connection) {}
 
 void LevinProtocol::sendMessage(uint32_t command, const BinaryArray& out, bool needResponse) {
-  bucket_head2 head = { 0 };
-  head.m_signature = LEVIN_SIGNATURE;
-  head.m_cb = out.size();
-  head.m_have_to_return_data = needResponse;
-  head.m_command = command;
-  head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
-  head.m_flags = LEVIN_PACKET_REQUEST;
-
-  // write header and body in one operation
-  BinaryArray writeBuffer;
-  writeBuffer.reserve(sizeof(head) + out.size());
-
-  Common::VectorOutputStream stream(writeBuffer);
-  stream.writeSome(&head, sizeof(head));
-  stream.writeSome(out.data(), out.size());
-
-  writeStrict(writeBuffer.data(), writeBuffer.size());
+  sendPackets({ Packet{ command, &out, needResponse, false, 0 } });
 }
 
 bool LevinProtocol::readCommand(Command& cmd) {
@@ -104,29 +88,49 @@ bool LevinProtocol::readCommand(Command& cmd) {
 }
 
 void LevinProtocol::sendReply(uint32_t command, const BinaryArray& out, int32_t returnCode) {
-  bucket_head2 head = { 0 };
-  head.m_signature = LEVIN_SIGNATURE;
-  head.m_cb = out.size();
-  head.m_have_to_return_data = false;
-  head.m_command = command;
-  head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
-  head.m_flags = LEVIN_PACKET_RESPONSE;
-  head.m_return_code = returnCode;
-
-  BinaryArray writeBuffer;
-  writeBuffer.reserve(sizeof(head) + out.size());
-
-  Common::VectorOutputStream stream(writeBuffer);
-  stream.writeSome(&head, sizeof(head));
-  stream.writeSome(out.data(), out.size());
-
-  writeStrict(writeBuffer.data(), writeBuffer.size());
+  sendPackets({ Packet{ command, &out, false, true, returnCode } });
 }
 
-void LevinProtocol::writeStrict(const uint8_t* ptr, size_t size) {
-  size_t offset = 0;
-  while (offset < size) {
-    offset += m_conn.write(ptr + offset, size - offset);
+void LevinProtocol::sendPackets(const std::vector<Packet>& packets) {
+  std::vector<bucket_head2> heads(packets.size());
+  std::vector<std::pair<const uint8_t*, size_t>> buffers;
+  buffers.reserve(packets.size() * 2);
+
+  for (size_t i = 0; i < packets.size(); ++i) {
+    const Packet& packet = packets[i];
+    bucket_head2& head = heads[i];
+    head.m_signature = LEVIN_SIGNATURE;
+    head.m_cb = packet.body->size();
+    head.m_have_to_return_data = packet.needResponse;
+    head.m_command = packet.command;
+    head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
+    head.m_flags = packet.isResponse ? LEVIN_PACKET_RESPONSE : LEVIN_PACKET_REQUEST;
+    head.m_return_code = packet.returnCode;
+
+    buffers.emplace_back(reinterpret_cast<const uint8_t*>(&head), sizeof(head));
+    if (!packet.body->empty()) {
+      buffers.emplace_back(packet.body->data(), packet.body->size());
+    }
+  }
+
+  writeStrict(buffers);
+}
+
+void LevinProtocol::writeStrict(std::vector<std::pair<const uint8_t*, size_t>>& buffers) {
+  size_t index = 0;
+  while (index < buffers.size()) {
+    size_t written = m_conn.writeBuffers(&buffers[index], buffers.size() - index);
+    while (written != 0) {
+      auto& buffer = buffers[index];
+      if (written < buffer.second) {
+        buffer.first += written;
+        buffer.second -= written;
+        break;
+      }
+
+      written -= buffer.second;
+      ++index;
+    }
   }
 }
 
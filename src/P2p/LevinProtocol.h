@@ -75,10 +75,21 @@ public:
     bool needReply() const;
   };
 
+  // Outgoing packet; the body is written from the caller's buffer, which must outlive sendPackets.
+  struct Packet {
+    uint32_t command;
+    const BinaryArray* body;
+    bool needResponse;
+    bool isResponse;
+    int32_t returnCode;
+  };
+
   bool readCommand(Command& cmd);
 
   void sendMessage(uint32_t command, const BinaryArray& out, bool needResponse);
   void sendReply(uint32_t command, const BinaryArray& out, int32_t returnCode);
+  // Writes the packets back to back with gather writes, without copying their bodies.
+  void sendPackets(const std::vector<Packet>& packets);
 
   template <typename T>
   static bool decode(const BinaryArray& buf, T& value) {
@@ -106,7 +117,7 @@ public:
 private:
 
   bool readStrict(uint8_t* ptr, size_t size);
-  void writeStrict(const uint8_t* ptr, size_t size);
+  void writeStrict(std::vector<std::pair<const uint8_t*, size_t>>& buffers);
   System::TcpConnection& m_conn;
 };
 
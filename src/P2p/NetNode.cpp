@@ -347,21 +347,23 @@ namespace CryptoNote
   //-----------------------------------------------------------------------------------
   void NodeServer::externalRelayNotifyToAll(int command, const BinaryArray &data_buff, const net_connection_id *excludeConnection)
   {
-    m_dispatcher.remoteSpawn([this, command, data_buff, excludeConnection] {
-      relay_notify_to_all(command, data_buff, excludeConnection);
+    auto buffer = std::make_shared<const BinaryArray>(data_buff);
+    m_dispatcher.remoteSpawn([this, command, buffer, excludeConnection] {
+      relayNotifyToAll(command, buffer, excludeConnection);
     });
   }
 
   //-----------------------------------------------------------------------------------
   void NodeServer::externalRelayNotifyToList(int command, const BinaryArray &data_buff, const std::list<boost::uuids::uuid> relayList)
   {
-    m_dispatcher.remoteSpawn([this, command, data_buff, relayList] {
+    auto buffer = std::make_shared<const BinaryArray>(data_buff);
+    m_dispatcher.remoteSpawn([this, command, buffer, relayList] {
       forEachConnection([&](P2pConnectionContext &conn) {
         if (std::find(relayList.begin(), relayList.end(), conn.m_connection_id) != relayList.end())
         {
           if (conn.peerId && (conn.m_state == CryptoNoteConnectionContext::state_normal || conn.m_state == CryptoNoteConnectionContext::state_synchronizing))
           {
-            conn.pushMessage(P2pMessage(P2pMessage::NOTIFY, command, data_buff));
+            conn.pushMessage(P2pMessage(P2pMessage::NOTIFY, command, buffer));
           }
         }
       });
@@ -1267,13 +1269,17 @@ namespace CryptoNote
   //-----------------------------------------------------------------------------------
 
   void NodeServer::relay_notify_to_all(int command, const BinaryArray& data_buff, const net_connection_id* excludeConnection) {
+    relayNotifyToAll(command, std::make_shared<const BinaryArray>(data_buff), excludeConnection);
+  }
+
+  void NodeServer::relayNotifyToAll(int command, const std::shared_ptr<const BinaryArray>& buffer, const net_connection_id* excludeConnection) {
     net_connection_id excludeId = excludeConnection ? *excludeConnection : boost::value_initialized<net_connection_id>();
 
     forEachConnection([&](P2pConnectionContext& conn) {
       if (conn.peerId && conn.m_connection_id != excludeId &&
           (conn.m_state == CryptoNoteConnectionContext::state_normal ||
            conn.m_state == CryptoNoteConnectionContext::state_synchronizing)) {
-        conn.pushMessage(P2pMessage(P2pMessage::NOTIFY, command, data_buff));
+        conn.pushMessage(P2pMessage(P2pMessage::NOTIFY, command, buffer));
       }
     });
   }
@@ -1690,22 +1696,27 @@ namespace CryptoNote
           break;
         }
 
+        // everything queued goes out in one gather write, straight from the shared payloads
+        std::vector<LevinProtocol::Packet> packets;
+        packets.reserve(msgs.size());
         for (const auto& msg : msgs) {
           logger(DEBUGGING) << ctx << "msg " << msg.type << ':' << msg.command;
           switch (msg.type) {
           case P2pMessage::COMMAND:
-            proto.sendMessage(msg.command, msg.buffer, true);
+            packets.push_back({ msg.command, msg.buffer.get(), true, false, 0 });
             break;
           case P2pMessage::NOTIFY:
-            proto.sendMessage(msg.command, msg.buffer, false);
+            packets.push_back({ msg.command, msg.buffer.get(), false, false, 0 });
             break;
           case P2pMessage::REPLY:
-            proto.sendReply(msg.command, msg.buffer, msg.returnCode);
+            packets.push_back({ msg.command, msg.buffer.get(), false, true, msg.returnCode });
             break;
           default:
             assert(false);
           }
         }
+
+        proto.sendPackets(packets);
       }
     } catch (System::InterruptedException&) {
       // connection stopped
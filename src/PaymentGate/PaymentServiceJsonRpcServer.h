@@ -35,17 +35,17 @@ public:
   PaymentServiceJsonRpcServer(const PaymentServiceJsonRpcServer&) = delete;
 
 protected:
-  virtual void processJsonRpcRequest(const Common::JsonValue& req, Common::JsonValue& resp) override;
+  virtual void processJsonRpcRequest(const Common::JsonValue& req, Common::JsonValue& resp, std::string& result) override;
 
 private:
   WalletService& service;
   Logging::LoggerRef logger;
 
-  typedef std::function<void (const Common::JsonValue& jsonRpcParams, Common::JsonValue& jsonResponse)> HandlerFunction;
+  typedef std::function<void (const Common::JsonValue& jsonRpcParams, Common::JsonValue& jsonResponse, std::string& result)> HandlerFunction;
 
   template <typename RequestType, typename ResponseType, typename RequestHandler>
   HandlerFunction jsonHandler(RequestHandler handler) {
-    return [handler] (const Common::JsonValue& jsonRpcParams, Common::JsonValue& jsonResponse) mutable {
+    return [handler] (const Common::JsonValue& jsonRpcParams, Common::JsonValue& jsonResponse, std::string& result) mutable {
       RequestType request;
       ResponseType response;
 
@@ -65,7 +65,7 @@ private:
 
       CryptoNote::JsonOutputStreamSerializer outputSerializer;
       serialize(response, outputSerializer);
-      fillJsonResponse(outputSerializer.getValue(), jsonResponse);
+      result = outputSerializer.takeJson();
     };
   }
 
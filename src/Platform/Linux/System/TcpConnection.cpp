@@ -21,10 +21,15 @@
 #include <System/InterruptedException.h>
 #include <System/Ipv4Address.h>
 #include <arpa/inet.h>
+#include <algorithm>
 #include <cassert>
+#include <climits>
 #include <stdexcept>
 #include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
+#include <vector>
 
 namespace System {
 
@@ -161,13 +166,12 @@ size_t TcpConnection::read(uint8_t* data, size_t size) {
 
 std::size_t TcpConnection::write(const uint8_t* data, size_t size) {
   assert(dispatcher != nullptr);
-  assert(contextPair.writeContext == nullptr);
-  if (dispatcher->interrupted()) {
-    throw InterruptedException();
-  }
+  if (size == 0) {
+    assert(contextPair.writeContext == nullptr);
+    if (dispatcher->interrupted()) {
+      throw InterruptedException();
+    }
 
-  std::string message;
-  if(size == 0) {
     if(shutdown(connection, SHUT_WR) == -1) {
       throw std::runtime_error("TcpConnection::write, shutdown failed, " + lastErrorMessage());
     }
@@ -175,7 +179,31 @@ std::size_t TcpConnection::write(const uint8_t* data, size_t size) {
     return 0;
   }
 
-  ssize_t transferred = ::send(connection, (void *)data, size, MSG_NOSIGNAL);
+  Buffer buffer(data, size);
+  return writeBuffers(&buffer, 1);
+}
+
+std::size_t TcpConnection::writeBuffers(const Buffer* buffers, std::size_t count) {
+  assert(dispatcher != nullptr);
+  assert(contextPair.writeContext == nullptr);
+  if (dispatcher->interrupted()) {
+    throw InterruptedException();
+  }
+
+  std::string message;
+  std::vector<iovec> vectors(std::min<std::size_t>(count, IOV_MAX));
+  size_t size = 0;
+  for (size_t i = 0; i < vectors.size(); ++i) {
+    vectors[i].iov_base = const_cast<uint8_t*>(buffers[i].first);
+    vectors[i].iov_len = buffers[i].second;
+    size += buffers[i].second;
+  }
+
+  msghdr header = {};
+  header.msg_iov = vectors.data();
+  header.msg_iovlen = vectors.size();
+
+  ssize_t transferred = ::sendmsg(connection, &header, MSG_NOSIGNAL);
   if (transferred == -1) {
     if (errno != EAGAIN) {
       message = "send failed, " + lastErrorMessage();
@@ -238,7 +266,7 @@ std::size_t TcpConnection::write(const uint8_t* data, size_t size) {
           throw std::runtime_error("TcpConnection::write, events & (EPOLLERR | EPOLLHUP) != 0");
         }
 
-        ssize_t transferred = ::send(connection, (void *)data, size, 0);
+        ssize_t transferred = ::sendmsg(connection, &header, MSG_NOSIGNAL);
         if (transferred == -1) {
           message = "send failed, "  + lastErrorMessage();
         } else {
@@ -5,12 +5,16 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "TcpConnection.h"
+#include <algorithm>
 #include <cassert>
+#include <climits>
+#include <vector>
 
 #include <netinet/in.h>
 #include <sys/event.h>
 #include <sys/errno.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include "Dispatcher.h"
@@ -134,13 +138,12 @@ size_t TcpConnection::read(uint8_t* data, size_t size) {
 
 size_t TcpConnection::write(const uint8_t* data, size_t size) {
   assert(dispatcher != nullptr);
-  assert(writeContext == nullptr);
-  if (dispatcher->interrupted()) {
-    throw InterruptedException();
-  }
-
-  std::string message;
   if (size == 0) {
+    assert(writeContext == nullptr);
+    if (dispatcher->interrupted()) {
+      throw InterruptedException();
+    }
+
     if (shutdown(connection, SHUT_WR) == -1) {
       throw std::runtime_error("TcpConnection::write, shutdown failed, " + lastErrorMessage());
     }
@@ -148,7 +151,31 @@ size_t TcpConnection::write(const uint8_t* data, size_t size) {
     return 0;
   }
 
-  ssize_t transferred = ::send(connection, (void *)data, size, 0);
+  Buffer buffer(data, size);
+  return writeBuffers(&buffer, 1);
+}
+
+size_t TcpConnection::writeBuffers(const Buffer* buffers, size_t count) {
+  assert(dispatcher != nullptr);
+  assert(writeContext == nullptr);
+  if (dispatcher->interrupted()) {
+    throw InterruptedException();
+  }
+
+  std::string message;
+  std::vector<iovec> vectors(std::min<size_t>(count, IOV_MAX));
+  size_t size = 0;
+  for (size_t i = 0; i < vectors.size(); ++i) {
+    vectors[i].iov_base = const_cast<uint8_t*>(buffers[i].first);
+    vectors[i].iov_len = buffers[i].second;
+    size += buffers[i].second;
+  }
+
+  msghdr header = {};
+  header.msg_iov = vectors.data();
+  header.msg_iovlen = static_cast<int>(vectors.size());
+
+  ssize_t transferred = ::sendmsg(connection, &header, 0);
   if (transferred == -1) {
     if (errno != EAGAIN  && errno != EWOULDBLOCK) {
       message = "send failed, " + lastErrorMessage();
@@ -190,7 +217,7 @@ size_t TcpConnection::write(const uint8_t* data, size_t size) {
           throw InterruptedException();
         }
 
-        ssize_t transferred = ::send(connection, (void *)data, size, 0);
+        ssize_t transferred = ::sendmsg(connection, &header, 0);
         if (transferred == -1) {
           message = "send failed, " + lastErrorMessage();
         } else {
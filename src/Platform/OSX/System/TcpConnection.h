@@ -17,6 +17,8 @@ class Ipv4Address;
 
 class TcpConnection {
 public:
+  typedef std::pair<const uint8_t*, std::size_t> Buffer;
+
   TcpConnection();
   TcpConnection(const TcpConnection&) = delete;
   TcpConnection(TcpConnection&& other);
@@ -25,6 +27,8 @@ public:
   TcpConnection& operator=(TcpConnection&& other);
   std::size_t read(uint8_t* data, std::size_t size);
   std::size_t write(const uint8_t* data, std::size_t size);
+  // Gather write of the buffers in order, returns the number of bytes written. Does not shut the connection down on empty input.
+  std::size_t writeBuffers(const Buffer* buffers, std::size_t count);
   std::pair<Ipv4Address, uint16_t> getPeerAddressAndPort() const;
 
 private:
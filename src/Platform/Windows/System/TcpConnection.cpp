@@ -16,6 +16,7 @@
 #include "Dispatcher.h"
 #include "ErrorMessage.h"
 #include <stdexcept>
+#include <vector>
 
 namespace System {
 
@@ -137,12 +138,12 @@ size_t TcpConnection::read(uint8_t* data, size_t size) {
 
 size_t TcpConnection::write(const uint8_t* data, size_t size) {
   assert(dispatcher != nullptr);
-  assert(writeContext == nullptr);
-  if (dispatcher->interrupted()) {
-    throw InterruptedException();
-  }
-
   if (size == 0) {
+    assert(writeContext == nullptr);
+    if (dispatcher->interrupted()) {
+      throw InterruptedException();
+    }
+
     if (shutdown(connection, SD_SEND) != 0) {
       throw std::runtime_error("TcpConnection::write, shutdown failed, " + errorMessage(WSAGetLastError()));
     }
@@ -150,10 +151,28 @@ size_t TcpConnection::write(const uint8_t* data, size_t size) {
     return 0;
   }
 
-  WSABUF buf{static_cast<ULONG>(size), reinterpret_cast<char*>(const_cast<uint8_t*>(data))};
+  Buffer buffer(data, size);
+  return writeBuffers(&buffer, 1);
+}
+
+size_t TcpConnection::writeBuffers(const Buffer* buffers, size_t count) {
+  assert(dispatcher != nullptr);
+  assert(writeContext == nullptr);
+  if (dispatcher->interrupted()) {
+    throw InterruptedException();
+  }
+
+  std::vector<WSABUF> bufs(count);
+  size_t size = 0;
+  for (size_t i = 0; i < count; ++i) {
+    bufs[i].len = static_cast<ULONG>(buffers[i].second);
+    bufs[i].buf = reinterpret_cast<char*>(const_cast<uint8_t*>(buffers[i].first));
+    size += buffers[i].second;
+  }
+
   TcpConnectionContext context;
   context.hEvent = NULL;
-  if (WSASend(connection, &buf, 1, NULL, 0, &context, NULL) != 0) {
+  if (WSASend(connection, bufs.data(), static_cast<DWORD>(bufs.size()), NULL, 0, &context, NULL) != 0) {
     int lastError = WSAGetLastError();
     if (lastError != WSA_IO_PENDING) {
       throw std::runtime_error("TcpConnection::write, WSASend failed, " + errorMessage(lastError));
@@ -8,6 +8,7 @@
 
 #include <cstdint>
 #include <string>
+#include <utility>
 
 namespace System {
 
@@ -16,6 +17,8 @@ class Ipv4Address;
 
 class TcpConnection {
 public:
+  typedef std::pair<const uint8_t*, size_t> Buffer;
+
   TcpConnection();
   TcpConnection(const TcpConnection&) = delete;
   TcpConnection(TcpConnection&& other);
@@ -24,6 +27,8 @@ public:
   TcpConnection& operator=(TcpConnection&& other);
   size_t read(uint8_t* data, size_t size);
   size_t write(const uint8_t* data, size_t size);
+  // Gather write of the buffers in order, returns the number of bytes written. Does not shut the connection down on empty input.
+  size_t writeBuffers(const Buffer* buffers, size_t count);
   std::pair<Ipv4Address, uint16_t> getPeerAddressAndPort() const;
 
 private:
@@ -313,6 +313,9 @@ struct COMMAND_RPC_GET_INFO {
     uint64_t difficulty;
     uint64_t tx_count;
     uint64_t tx_pool_size;
+    uint64_t tx_pool_bytes;
+    uint64_t tx_pool_max_bytes;
+    uint64_t tx_pool_evicted_count;
     uint64_t alt_blocks_count;
     uint64_t outgoing_connections_count;
     uint64_t incoming_connections_count;
@@ -335,6 +338,9 @@ struct COMMAND_RPC_GET_INFO {
       KV_MEMBER(top_block_hash)
       KV_MEMBER(tx_count)
       KV_MEMBER(tx_pool_size)
+      KV_MEMBER(tx_pool_bytes)
+      KV_MEMBER(tx_pool_max_bytes)
+      KV_MEMBER(tx_pool_evicted_count)
       KV_MEMBER(alt_blocks_count)
       KV_MEMBER(outgoing_connections_count)
       KV_MEMBER(fee_address)
@@ -418,10 +424,12 @@ struct COMMAND_RPC_GETBLOCKTEMPLATE {
   struct request {
     uint64_t reserve_size; //max 255 bytes
     std::string wallet_address;
+    uint64_t longpoll_id = 0; //longpoll_id of the previous response, the call returns once the template differs from it
 
     void serialize(ISerializer &s) {
       KV_MEMBER(reserve_size)
       KV_MEMBER(wallet_address)
+      KV_MEMBER(longpoll_id)
     }
   };
 
@@ -430,6 +438,7 @@ struct COMMAND_RPC_GETBLOCKTEMPLATE {
     uint32_t height;
     uint64_t reserved_offset;
     std::string blocktemplate_blob;
+    uint64_t longpoll_id;
     std::string status;
 
     void serialize(ISerializer &s) {
@@ -437,6 +446,7 @@ struct COMMAND_RPC_GETBLOCKTEMPLATE {
       KV_MEMBER(height)
       KV_MEMBER(reserved_offset)
       KV_MEMBER(blocktemplate_blob)
+      KV_MEMBER(longpoll_id)
       KV_MEMBER(status)
     }
   };
@@ -16,17 +16,48 @@
 // along with Fuego. If not, see <https://www.gnu.org/licenses/>.
 
 #include "HttpServer.h"
+
+#include <algorithm>
+#include <vector>
+
 #include <boost/scope_exit.hpp>
 
 #include <Common/Base64.h>
 #include <HTTP/HttpParser.h>
 #include <System/InterruptedException.h>
-#include <System/TcpStream.h>
 #include <System/Ipv4Address.h>
 
 using namespace Logging;
 
 namespace {
+	const size_t RECEIVE_BUFFER_SIZE = 16 * 1024;
+
+	// head and body go out in one gather write, without joining them into another string
+	void writeResponse(System::TcpConnection& connection, const CryptoNote::HttpResponse& response) {
+		std::string head = response.getHead();
+		const std::string& body = response.getBody();
+		System::TcpConnection::Buffer buffers[] = {
+			{ reinterpret_cast<const uint8_t*>(head.data()), head.size() },
+			{ reinterpret_cast<const uint8_t*>(body.data()), body.size() } };
+
+		size_t index = 0;
+		size_t count = body.empty() ? 1 : 2;
+		while (index < count) {
+			size_t written = connection.writeBuffers(&buffers[index], count - index);
+			while (written != 0) {
+				auto& buffer = buffers[index];
+				if (written < buffer.second) {
+					buffer.first += written;
+					buffer.second -= written;
+					break;
+				}
+
+				written -= buffer.second;
+				++index;
+			}
+		}
+	}
+
 	void fillUnauthorizedResponse(CryptoNote::HttpResponse& response) {
 		response.setStatus(CryptoNote::HttpResponse::STATUS_401);
 		response.addHeader("WWW-Authenticate", "Basic realm=\"RPC\"");
@@ -88,17 +119,44 @@ void HttpServer::acceptLoop() {
 
     logger(DEBUGGING) << "Incoming connection from " << addr.first.toDottedDecimal() << ":" << addr.second;
 
-    System::TcpStreambuf streambuf(connection);
-    std::iostream stream(&streambuf);
-    HttpParser parser;
+    // requests are parsed in place from one receive buffer; pipelined ones wait there for their turn
+    std::vector<char> buffer(RECEIVE_BUFFER_SIZE);
+    size_t begin = 0;
+    size_t end = 0;
 
     for (;;) {
       HttpRequest req;
       HttpResponse resp;
 	  resp.addHeader("Access-Control-Allow-Origin", "*");
 	  resp.addHeader("content-type", "application/json");
-	
-      parser.receiveRequest(stream, req);
+
+      size_t requestSize;
+      while ((requestSize = HttpParser::parseRequest(buffer.data() + begin, end - begin, req)) == 0) {
+        if (begin != 0) {
+          std::copy(buffer.begin() + begin, buffer.begin() + end, buffer.begin());
+          end -= begin;
+          begin = 0;
+        }
+
+        if (end == buffer.size()) {
+          buffer.resize(buffer.size() * 2);
+        }
+
+        size_t received = connection.read(reinterpret_cast<uint8_t*>(buffer.data() + end), buffer.size() - end);
+        if (received == 0) {
+          break;
+        }
+
+        end += received;
+        req = HttpRequest();
+      }
+
+      if (requestSize == 0) {
+        break;
+      }
+
+      begin += requestSize;
+
 				if (authenticate(req)) {
 					processRequest(req, resp);
 				}
@@ -107,12 +165,7 @@ void HttpServer::acceptLoop() {
 					fillUnauthorizedResponse(resp);
 				}
 
-      stream << resp;
-      stream.flush();
-
-      if (stream.peek() == std::iostream::traits_type::eof()) {
-        break;
-      }
+      writeResponse(connection, resp);
     }
 
     logger(DEBUGGING) << "Closing connection from " << addr.first.toDottedDecimal() << ":" << addr.second << " total=" << m_connections.size();
@@ -20,6 +20,7 @@
 #include <boost/optional.hpp>
 #include <boost/foreach.hpp>
 #include <functional>
+#include <memory>
 
 #include "CoreRpcServerCommandsDefinitions.h"
 #include <Common/JsonValue.h>
@@ -131,11 +132,17 @@ class JsonRpcResponse {
 public:
 
   JsonRpcResponse() : psResp(Common::JsonValue::OBJECT) {}
+  // the parser points into body
+  JsonRpcResponse(const JsonRpcResponse&) = delete;
+  JsonRpcResponse& operator=(const JsonRpcResponse&) = delete;
 
+  // the body is scanned once here, getError and getResult then only look up their member
   void parse(const std::string& responseBody) {
+    body = responseBody;
     try {
-      psResp = Common::JsonValue::fromString(responseBody);
+      parser.reset(new JsonInputStreamSerializer(body));
     } catch (std::exception&) {
+      parser.reset();
       throw JsonRpcError(errParseError);
     }
   }
@@ -151,37 +158,58 @@ public:
   }
 
   bool getError(JsonRpcError& err) const {
-    if (!psResp.contains("error")) {
-      return false;
-    }
-
-    loadFromJsonValue(err, psResp("error"));
-    return true;
+    return loadMember(err, "error");
   }
 
   std::string getBody() {
     psResp.set("jsonrpc", std::string("2.0"));
-    return psResp.toString();
+    std::string response = psResp.toString();
+    if (!result.empty()) {
+      appendJsonMember(response, "result", result);
+    }
+
+    return response;
   }
 
+  // the result is serialized right away and only spliced into the body
   template <typename T>
   bool setResult(const T& v) {
-    psResp.set("result", storeToJsonValue(v));
+    result = storeToJson(v);
     return true;
   }
 
   template <typename T>
   bool getResult(T& v) const {
-    if (!psResp.contains("result")) {
+    return loadMember(v, "result");
+  }
+
+private:
+  Common::JsonValue psResp;
+  std::string result;
+  std::string body;
+  mutable std::unique_ptr<JsonInputStreamSerializer> parser;
+
+  template <typename T>
+  bool loadMember(T& v, Common::StringView name) const {
+    if (!parser) {
+      parser.reset(new JsonInputStreamSerializer(body));
+    }
+
+    if (!parser->beginObject(name)) {
       return false;
     }
 
-    loadFromJsonValue(v, psResp("result"));
+    try {
+      serialize(v, *parser);
+    } catch (...) {
+      // the parser is left inside the member, it is rebuilt for the next lookup
+      parser.reset();
+      throw;
+    }
+
+    parser->endObject();
     return true;
   }
-
-private:
-  Common::JsonValue psResp;
 };
 
 
@@ -18,12 +18,14 @@
 #include "RpcServer.h"
 
 #include <future>
+#include <numeric>
 #include <unordered_map>
 
 // CryptoNote
 #include "BlockchainExplorerData.h"
 #include "Common/StringTools.h"
 #include "Common/Base58.h"
+#include "Common/ScopeExit.h"
 #include "CryptoNoteCore/TransactionUtils.h"
 #include "CryptoNoteCore/CryptoNoteTools.h"
 #include "CryptoNoteCore/CryptoNoteFormatUtils.h"
@@ -35,6 +37,11 @@
 
 #include "P2p/NetNode.h"
 
+#include <System/Event.h>
+#include <System/InterruptedException.h>
+#include <System/PoolContext.h>
+#include <System/Timer.h>
+
 #include "CoreRpcServerErrorCodes.h"
 #include "JsonRpc.h"
 #include "version.h"
@@ -51,6 +58,8 @@ namespace CryptoNote {
 
 namespace {
 
+const uint32_t BLOCK_TEMPLATE_LONGPOLL_TIMEOUT = 60; // seconds
+
 template <typename Command>
 RpcServer::HandlerFunction binMethod(bool (RpcServer::*handler)(typename Command::request const&, typename Command::response&)) {
   return [handler](RpcServer* obj, const HttpRequest& request, HttpResponse& response) {
@@ -90,35 +99,80 @@ RpcServer::HandlerFunction jsonMethod(bool (RpcServer::*handler)(typename Comman
 std::unordered_map<std::string, RpcServer::RpcHandler<RpcServer::HandlerFunction>> RpcServer::s_handlers = {
 
   // binary handlers
-  { "/getblocks.bin", { binMethod<COMMAND_RPC_GET_BLOCKS_FAST>(&RpcServer::on_get_blocks), false } },
-  { "/queryblocks.bin", { binMethod<COMMAND_RPC_QUERY_BLOCKS>(&RpcServer::on_query_blocks), false } },
-  { "/queryblockslite.bin", { binMethod<COMMAND_RPC_QUERY_BLOCKS_LITE>(&RpcServer::on_query_blocks_lite), false } },
-  { "/get_o_indexes.bin", { binMethod<COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES>(&RpcServer::on_get_indexes), false } },
-  { "/getrandom_outs.bin", { binMethod<COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS>(&RpcServer::on_get_random_outs), false } },
-  { "/get_pool_changes.bin", { binMethod<COMMAND_RPC_GET_POOL_CHANGES>(&RpcServer::onGetPoolChanges), false } },
-  { "/get_pool_changes_lite.bin", { binMethod<COMMAND_RPC_GET_POOL_CHANGES_LITE>(&RpcServer::onGetPoolChangesLite), false } },
+  { "/getblocks.bin", { binMethod<COMMAND_RPC_GET_BLOCKS_FAST>(&RpcServer::on_get_blocks), false, true } },
+  { "/queryblocks.bin", { binMethod<COMMAND_RPC_QUERY_BLOCKS>(&RpcServer::on_query_blocks), false, true } },
+  { "/queryblockslite.bin", { binMethod<COMMAND_RPC_QUERY_BLOCKS_LITE>(&RpcServer::on_query_blocks_lite), false, true } },
+  { "/get_o_indexes.bin", { binMethod<COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES>(&RpcServer::on_get_indexes), false, true } },
+  { "/getrandom_outs.bin", { binMethod<COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS>(&RpcServer::on_get_random_outs), false, true } },
+  { "/get_pool_changes.bin", { binMethod<COMMAND_RPC_GET_POOL_CHANGES>(&RpcServer::onGetPoolChanges), false, true } },
+  { "/get_pool_changes_lite.bin", { binMethod<COMMAND_RPC_GET_POOL_CHANGES_LITE>(&RpcServer::onGetPoolChangesLite), false, true } },
 
   // json handlers
-  { "/getinfo", { jsonMethod<COMMAND_RPC_GET_INFO>(&RpcServer::on_get_info), true } },
-  { "/getheight", { jsonMethod<COMMAND_RPC_GET_HEIGHT>(&RpcServer::on_get_height), true } },
-  { "/gettransactions", { jsonMethod<COMMAND_RPC_GET_TRANSACTIONS>(&RpcServer::on_get_transactions), false } },
-  { "/sendrawtransaction", { jsonMethod<COMMAND_RPC_SEND_RAW_TX>(&RpcServer::on_send_raw_tx), false } },
-  { "/feeaddress", { jsonMethod<COMMAND_RPC_GET_FEE_ADDRESS>(&RpcServer::on_get_fee_address), true } },
-  { "/peers", { jsonMethod<COMMAND_RPC_GET_PEER_LIST>(&RpcServer::on_get_peer_list), true } },
-  { "/getpeers", { jsonMethod<COMMAND_RPC_GET_PEER_LIST>(&RpcServer::on_get_peer_list), true } },
-  { "/paymentid", { jsonMethod<COMMAND_RPC_GEN_PAYMENT_ID>(&RpcServer::on_get_payment_id), true } },
+  { "/getinfo", { jsonMethod<COMMAND_RPC_GET_INFO>(&RpcServer::on_get_info), true, false } },
+  { "/getheight", { jsonMethod<COMMAND_RPC_GET_HEIGHT>(&RpcServer::on_get_height), true, false } },
+  { "/gettransactions", { jsonMethod<COMMAND_RPC_GET_TRANSACTIONS>(&RpcServer::on_get_transactions), false, true } },
+  { "/sendrawtransaction", { jsonMethod<COMMAND_RPC_SEND_RAW_TX>(&RpcServer::on_send_raw_tx), false, false } },
+  { "/feeaddress", { jsonMethod<COMMAND_RPC_GET_FEE_ADDRESS>(&RpcServer::on_get_fee_address), true, false } },
+  { "/peers", { jsonMethod<COMMAND_RPC_GET_PEER_LIST>(&RpcServer::on_get_peer_list), true, false } },
+  { "/getpeers", { jsonMethod<COMMAND_RPC_GET_PEER_LIST>(&RpcServer::on_get_peer_list), true, false } },
+  { "/paymentid", { jsonMethod<COMMAND_RPC_GEN_PAYMENT_ID>(&RpcServer::on_get_payment_id), true, false } },
 
   // disabled in restricted rpc mode
-  { "/start_mining", { jsonMethod<COMMAND_RPC_START_MINING>(&RpcServer::on_start_mining), false } },
-  { "/stop_mining", { jsonMethod<COMMAND_RPC_STOP_MINING>(&RpcServer::on_stop_mining), false } },
-  { "/stop_daemon", { jsonMethod<COMMAND_RPC_STOP_DAEMON>(&RpcServer::on_stop_daemon), true } },
+  { "/start_mining", { jsonMethod<COMMAND_RPC_START_MINING>(&RpcServer::on_start_mining), false, false } },
+  { "/stop_mining", { jsonMethod<COMMAND_RPC_STOP_MINING>(&RpcServer::on_stop_mining), false, false } },
+  { "/stop_daemon", { jsonMethod<COMMAND_RPC_STOP_DAEMON>(&RpcServer::on_stop_daemon), true, false } },
 
   // json rpc
-  { "/json_rpc", { std::bind(&RpcServer::processJsonRpcRequest, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3), true } }
+  { "/json_rpc", { std::bind(&RpcServer::processJsonRpcRequest, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3), true, false } }
 };
 
 RpcServer::RpcServer(System::Dispatcher& dispatcher, Logging::ILogger& log, core& c, NodeServer& p2p, const ICryptoNoteProtocolQuery& protocolQuery) :
-  HttpServer(dispatcher, log), logger(log, "RpcServer"), m_core(c), m_p2p(p2p), m_protocolQuery(protocolQuery) {
+  HttpServer(dispatcher, log), logger(log, "RpcServer"), m_core(c), m_p2p(p2p), m_protocolQuery(protocolQuery),
+  m_blockTemplateWaiters(std::make_shared<std::unordered_set<System::Event*>>()) {
+  m_core.addObserver(this);
+}
+
+RpcServer::~RpcServer() {
+  m_core.removeObserver(this);
+}
+
+void RpcServer::blockchainUpdated() {
+  blockTemplateUpdated();
+}
+
+void RpcServer::poolUpdated() {
+  blockTemplateUpdated();
+}
+
+void RpcServer::blockTemplateUpdated() {
+  // runs on the dispatcher thread like the destructor, so the waiters cannot go away while they are set
+  std::weak_ptr<std::unordered_set<System::Event*>> waiters = m_blockTemplateWaiters;
+  m_dispatcher.remoteSpawn([waiters] {
+    if (auto liveWaiters = waiters.lock()) {
+      for (System::Event* waiter : *liveWaiters) {
+        waiter->set();
+      }
+    }
+  });
+}
+
+void RpcServer::waitBlockTemplateUpdate(uint64_t templateVersion) {
+  System::Event updated(m_dispatcher);
+  m_blockTemplateWaiters->insert(&updated);
+  Tools::ScopeExit removeWaiter([this, &updated] {
+    m_blockTemplateWaiters->erase(&updated);
+  });
+
+  System::ContextGroup timeoutContext(m_dispatcher);
+  timeoutContext.spawn([this, &updated] {
+    System::Timer(m_dispatcher).sleep(std::chrono::seconds(BLOCK_TEMPLATE_LONGPOLL_TIMEOUT));
+    updated.set();
+  });
+
+  // registered before the check, so an update in between still sets the event
+  if (m_core.getBlockTemplateVersion() == templateVersion) {
+    updated.wait();
+  }
 }
 
 void RpcServer::processRequest(const HttpRequest& request, HttpResponse& response) {
@@ -136,7 +190,9 @@ void RpcServer::processRequest(const HttpRequest& request, HttpResponse& respons
     return;
   }
 
-  it->second.handler(this, request, response);
+  runHandler(it->second.runOnWorker, [this, &it, &request, &response] {
+    it->second.handler(this, request, response);
+  });
 }
 
 bool RpcServer::processJsonRpcRequest(const HttpRequest& request, HttpResponse& response) {
@@ -157,21 +213,21 @@ bool RpcServer::processJsonRpcRequest(const HttpRequest& request, HttpResponse&
     jsonResponse.setId(jsonRequest.getId()); // copy id
 
     static std::unordered_map<std::string, RpcServer::RpcHandler<JsonMemberMethod>> jsonRpcHandlers = {
-        {"getaltblockslist", {makeMemberMethod(&RpcServer::on_alt_blocks_list_json), true}},
-        {"f_blocks_list_json", {makeMemberMethod(&RpcServer::f_on_blocks_list_json), false}},
-        {"f_block_json", {makeMemberMethod(&RpcServer::f_on_block_json), false}},
-        {"f_transaction_json", {makeMemberMethod(&RpcServer::f_on_transaction_json), false}},
-        {"f_on_transactions_pool_json", {makeMemberMethod(&RpcServer::f_on_transactions_pool_json), false}},
-        {"check_tx_proof", {makeMemberMethod(&RpcServer::k_on_check_tx_proof), false}},
-        {"check_reserve_proof", {makeMemberMethod(&RpcServer::k_on_check_reserve_proof), false}},
-        {"getblockcount", {makeMemberMethod(&RpcServer::on_getblockcount), true}},
-        {"on_getblockhash", {makeMemberMethod(&RpcServer::on_getblockhash), false}},
-        {"getblocktemplate", {makeMemberMethod(&RpcServer::on_getblocktemplate), false}},
-        {"getcurrencyid", {makeMemberMethod(&RpcServer::on_get_currency_id), true}},
-        {"submitblock", {makeMemberMethod(&RpcServer::on_submitblock), false}},
-        {"getlastblockheader", {makeMemberMethod(&RpcServer::on_get_last_block_header), false}},
-        {"getblockheaderbyhash", {makeMemberMethod(&RpcServer::on_get_block_header_by_hash), false}},
-        {"getblockheaderbyheight", {makeMemberMethod(&RpcServer::on_get_block_header_by_height), false}}};
+        {"getaltblockslist", {makeMemberMethod(&RpcServer::on_alt_blocks_list_json), true, true}},
+        {"f_blocks_list_json", {makeMemberMethod(&RpcServer::f_on_blocks_list_json), false, true}},
+        {"f_block_json", {makeMemberMethod(&RpcServer::f_on_block_json), false, true}},
+        {"f_transaction_json", {makeMemberMethod(&RpcServer::f_on_transaction_json), false, true}},
+        {"f_on_transactions_pool_json", {makeMemberMethod(&RpcServer::f_on_transactions_pool_json), false, true}},
+        {"check_tx_proof", {makeMemberMethod(&RpcServer::k_on_check_tx_proof), false, true}},
+        {"check_reserve_proof", {makeMemberMethod(&RpcServer::k_on_check_reserve_proof), false, true}},
+        {"getblockcount", {makeMemberMethod(&RpcServer::on_getblockcount), true, false}},
+        {"on_getblockhash", {makeMemberMethod(&RpcServer::on_getblockhash), false, false}},
+        {"getblocktemplate", {makeMemberMethod(&RpcServer::on_getblocktemplate), false, false}},
+        {"getcurrencyid", {makeMemberMethod(&RpcServer::on_get_currency_id), true, false}},
+        {"submitblock", {makeMemberMethod(&RpcServer::on_submitblock), false, false}},
+        {"getlastblockheader", {makeMemberMethod(&RpcServer::on_get_last_block_header), false, false}},
+        {"getblockheaderbyhash", {makeMemberMethod(&RpcServer::on_get_block_header_by_hash), false, true}},
+        {"getblockheaderbyheight", {makeMemberMethod(&RpcServer::on_get_block_header_by_height), false, true}}};
 
     auto it = jsonRpcHandlers.find(jsonRequest.getMethod());
     if (it == jsonRpcHandlers.end()) {
@@ -182,16 +238,22 @@ bool RpcServer::processJsonRpcRequest(const HttpRequest& request, HttpResponse&
       throw JsonRpcError(CORE_RPC_ERROR_CODE_CORE_BUSY, "Core is busy");
     }
 
-    it->second.handler(this, jsonRequest, jsonResponse);
+    runHandler(it->second.runOnWorker, [this, &it, &jsonRequest, &jsonResponse] {
+      it->second.handler(this, jsonRequest, jsonResponse);
+    });
 
   } catch (const JsonRpcError& err) {
     jsonResponse.setError(err);
+  } catch (const System::InterruptedException&) {
+    // the server is stopping, a long polling call lets its connection close
+    throw;
   } catch (const std::exception& e) {
     jsonResponse.setError(JsonRpcError(JsonRpc::errInternalError, e.what()));
   }
 
-  response.setBody(jsonResponse.getBody());
-  logger(TRACE) << "JSON-RPC response: " << jsonResponse.getBody();
+  std::string body = jsonResponse.getBody();
+  logger(TRACE) << "JSON-RPC response: " << body;
+  response.setBody(std::move(body));
   return true;
 }
 
@@ -205,6 +267,22 @@ bool RpcServer::enableCors(const std::string domain) {
   return true;
 }
 
+bool RpcServer::setWorkerThreads(size_t threadCount) {
+  m_workerPool.reset(threadCount != 0 ? new Tools::ThreadPool(threadCount) : nullptr);
+  return true;
+}
+
+// Handlers that only read the core run on the worker pool, so a heavy query does not stall block relay
+// and timed sync; the calling context waits on the dispatcher until the result is posted back.
+void RpcServer::runHandler(bool runOnWorker, const std::function<void()>& handler) {
+  if (!runOnWorker || !m_workerPool) {
+    handler();
+    return;
+  }
+
+  System::runOnPool(m_dispatcher, *m_workerPool, handler);
+}
+
 bool RpcServer::isCoreReady() {
   return m_core.currency().isTestnet() || m_p2p.get_payload_object().isSynchronized();
 }
@@ -232,17 +310,13 @@ bool RpcServer::on_get_blocks(const COMMAND_RPC_GET_BLOCKS_FAST::request& req, C
   res.current_height = totalBlockCount;
   res.start_height = startBlockIndex;
 
+  res.blocks.reserve(supplement.size());
   for (const auto& blockId : supplement) {
-    assert(m_core.have_block(blockId));
-    auto completeBlock = m_core.getBlock(blockId);
-    assert(completeBlock != nullptr);
-
     res.blocks.resize(res.blocks.size() + 1);
-    res.blocks.back().block = asString(toBinaryArray(completeBlock->getBlock()));
-
-    res.blocks.back().txs.reserve(completeBlock->getTransactionCount());
-    for (size_t i = 0; i < completeBlock->getTransactionCount(); ++i) {
-      res.blocks.back().txs.push_back(asString(toBinaryArray(completeBlock->getTransaction(i))));
+    if (!m_core.getBlockCompleteEntry(blockId, res.blocks.back())) {
+      // the block left the main chain after the supplement was taken
+      res.blocks.pop_back();
+      break;
     }
   }
 
@@ -634,7 +708,11 @@ bool RpcServer::on_get_info(const COMMAND_RPC_GET_INFO::request& req, COMMAND_RP
   res.height = m_core.get_current_blockchain_height();
   res.difficulty = m_core.getNextBlockDifficulty();
   res.tx_count = m_core.get_blockchain_total_transactions() - res.height; //without coinbase
-  res.tx_pool_size = m_core.get_pool_transactions_count();
+  tx_memory_pool::Statistics poolStatistics = m_core.getPoolStatistics();
+  res.tx_pool_size = poolStatistics.transactionsCount;
+  res.tx_pool_bytes = poolStatistics.size;
+  res.tx_pool_max_bytes = poolStatistics.maxSize;
+  res.tx_pool_evicted_count = poolStatistics.evictedCount;
   res.alt_blocks_count = m_core.get_alternative_blocks_count();
   res.fee_address = m_fee_address.empty() ? std::string() : m_fee_address;
   uint64_t total_conn = m_p2p.get_connections_count();
@@ -876,13 +954,15 @@ bool RpcServer::f_on_blocks_list_json(const F_COMMAND_RPC_GET_BLOCKS_LIST::reque
         "Internal error: can't get block by height. Height = " + std::to_string(i) + '.' };
     }
 
-    size_t tx_cumulative_block_size;
-    m_core.getBlockSize(block_hash, tx_cumulative_block_size);
-    size_t blokBlobSize = getObjectBinarySize(blk);
-    size_t minerTxBlobSize = getObjectBinarySize(blk.baseTransaction);
+    size_t blockBlobSize;
+    std::vector<size_t> transactionSizes;
+    if (!m_core.getBlockBinarySizes(block_hash, blockBlobSize, transactionSizes)) {
+      throw JsonRpc::JsonRpcError{ CORE_RPC_ERROR_CODE_INTERNAL_ERROR,
+        "Internal error: can't get block sizes by height. Height = " + std::to_string(i) + '.' };
+    }
 
     f_block_short_response block_short;
-    block_short.cumul_size = blokBlobSize + tx_cumulative_block_size - minerTxBlobSize;
+    block_short.cumul_size = std::accumulate(transactionSizes.begin(), transactionSizes.end(), blockBlobSize);
     block_short.timestamp = blk.timestamp;
     block_short.height = i;
     m_core.getBlockDifficulty(static_cast<uint32_t>(block_short.height), block_short.difficulty);
@@ -956,8 +1036,17 @@ bool RpcServer::f_on_block_json(const F_COMMAND_RPC_GET_BLOCK_DETAILS::request&
   }
   res.block.transactionsCumulativeSize = blockSize;
 
-  size_t blokBlobSize = getObjectBinarySize(blk);
-  size_t minerTxBlobSize = getObjectBinarySize(blk.baseTransaction);
+  // a main chain block has its sizes stored, only an orphan one is serialized again
+  size_t blokBlobSize;
+  std::vector<size_t> transactionSizes;
+  bool haveStoredSizes = m_core.getBlockBinarySizes(hash, blokBlobSize, transactionSizes);
+  size_t minerTxBlobSize;
+  if (haveStoredSizes) {
+    minerTxBlobSize = res.block.transactionsCumulativeSize - std::accumulate(transactionSizes.begin(), transactionSizes.end(), size_t(0));
+  } else {
+    blokBlobSize = getObjectBinarySize(blk);
+    minerTxBlobSize = getObjectBinarySize(blk.baseTransaction);
+  }
   res.block.blockSize = blokBlobSize + res.block.transactionsCumulativeSize - minerTxBlobSize;
 
   uint64_t alreadyGeneratedCoins;
@@ -1017,7 +1106,7 @@ bool RpcServer::f_on_block_json(const F_COMMAND_RPC_GET_BLOCK_DETAILS::request&
   transaction_short.hash = Common::podToHex(getObjectHash(blk.baseTransaction));
   transaction_short.fee = 0;
   transaction_short.amount_out = get_outs_money_amount(blk.baseTransaction);
-  transaction_short.size = getObjectBinarySize(blk.baseTransaction);
+  transaction_short.size = minerTxBlobSize;
   res.block.transactions.push_back(transaction_short);
 
 
@@ -1027,22 +1116,26 @@ bool RpcServer::f_on_block_json(const F_COMMAND_RPC_GET_BLOCK_DETAILS::request&
 
   res.block.totalFeeAmount = 0;
 
+  // with none missed, txs follow blk.transactionHashes and transactionSizes in order
+  size_t txIndex = 0;
   for (const Transaction& tx : txs) {
     f_transaction_short_response transaction_short;
     uint64_t amount_in = 0;
     get_inputs_money_amount(tx, amount_in);
     uint64_t amount_out = get_outs_money_amount(tx);
 
-    transaction_short.hash = Common::podToHex(getObjectHash(tx));
+    bool inOrder = missed_txs.empty();
+    transaction_short.hash = Common::podToHex(inOrder ? blk.transactionHashes[txIndex] : getObjectHash(tx));
     transaction_short.fee =
 			amount_in < amount_out + parameters::MINIMUM_FEE //account for interest in output, it always has minimum fee
 			? parameters::MINIMUM_FEE
 			: amount_in - amount_out;
     transaction_short.amount_out = amount_out;
-    transaction_short.size = getObjectBinarySize(tx);
+    transaction_short.size = inOrder && haveStoredSizes ? transactionSizes[txIndex] : getObjectBinarySize(tx);
     res.block.transactions.push_back(transaction_short);
 
     res.block.totalFeeAmount += transaction_short.fee;
+    ++txIndex;
   }
 
   res.status = CORE_RPC_STATUS_OK;
@@ -1073,22 +1166,25 @@ bool RpcServer::f_on_transaction_json(const F_COMMAND_RPC_GET_TRANSACTION_DETAIL
       "transaction wasn't found. Hash = " + req.hash + '.' };
   }
 
+  size_t transactionSize = 0;
   Crypto::Hash blockHash;
   uint32_t blockHeight;
   if (m_core.getBlockContainingTx(hash, blockHash, blockHeight)) {
     Block blk;
-    if (m_core.getBlockByHash(blockHash, blk)) {
-      size_t tx_cumulative_block_size;
-      m_core.getBlockSize(blockHash, tx_cumulative_block_size);
-      size_t blokBlobSize = getObjectBinarySize(blk);
-      size_t minerTxBlobSize = getObjectBinarySize(blk.baseTransaction);
+    size_t blockBlobSize;
+    std::vector<size_t> transactionSizes;
+    if (m_core.getBlockByHash(blockHash, blk) && m_core.getBlockBinarySizes(blockHash, blockBlobSize, transactionSizes)) {
+      auto txIt = std::find(blk.transactionHashes.begin(), blk.transactionHashes.end(), hash);
+      if (txIt != blk.transactionHashes.end()) {
+        transactionSize = transactionSizes[std::distance(blk.transactionHashes.begin(), txIt)];
+      }
+
       f_block_short_response block_short;
 
-      block_short.cumul_size = blokBlobSize + tx_cumulative_block_size - minerTxBlobSize;
+      block_short.cumul_size = std::accumulate(transactionSizes.begin(), transactionSizes.end(), blockBlobSize);
       block_short.timestamp = blk.timestamp;
       block_short.height = blockHeight;
       block_short.hash = Common::podToHex(blockHash);
-      block_short.cumul_size = blokBlobSize + tx_cumulative_block_size - minerTxBlobSize;
       block_short.tx_count = blk.transactionHashes.size() + 1;
       res.block = block_short;
     }
@@ -1098,7 +1194,7 @@ bool RpcServer::f_on_transaction_json(const F_COMMAND_RPC_GET_TRANSACTION_DETAIL
   get_inputs_money_amount(res.tx, amount_in);
   uint64_t amount_out = get_outs_money_amount(res.tx);
 
-  res.txDetails.hash = Common::podToHex(getObjectHash(res.tx));
+  res.txDetails.hash = Common::podToHex(hash);
   if (amount_in == 0)
     res.txDetails.fee = 0;
   else {
@@ -1108,7 +1204,8 @@ bool RpcServer::f_on_transaction_json(const F_COMMAND_RPC_GET_TRANSACTION_DETAIL
 		: amount_in - amount_out;
   }
   res.txDetails.amount_out = amount_out;
-  res.txDetails.size = getObjectBinarySize(res.tx);
+  // a miner transaction has no stored size of its own, nor has one still in the pool
+  res.txDetails.size = transactionSize != 0 ? transactionSize : getObjectBinarySize(res.tx);
 
   uint64_t mixin;
   if (!f_getMixin(res.tx, mixin)) {
@@ -1214,6 +1311,13 @@ bool RpcServer::on_getblocktemplate(const COMMAND_RPC_GETBLOCKTEMPLATE::request&
     throw JsonRpc::JsonRpcError{ CORE_RPC_ERROR_CODE_WRONG_WALLET_ADDRESS, "Failed to parse wallet address" };
   }
 
+  if (req.longpoll_id != 0) {
+    waitBlockTemplateUpdate(req.longpoll_id);
+  }
+
+  // taken before the template is built, so an update during the build makes the next long poll return at once
+  res.longpoll_id = m_core.getBlockTemplateVersion();
+
   Block b = boost::value_initialized<Block>();
   CryptoNote::BinaryArray blob_reserve;
   blob_reserve.resize(req.reserve_size, 0);
@@ -18,10 +18,14 @@
 #include "HttpServer.h"
 
 #include <functional>
+#include <memory>
 #include <unordered_map>
+#include <unordered_set>
 
 #include <Logging/LoggerRef.h>
 #include "Common/Math.h"
+#include "Common/ThreadPool.h"
+#include "CryptoNoteCore/ICoreObserver.h"
 #include "CoreRpcServerCommandsDefinitions.h"
 
 namespace CryptoNote {
@@ -30,9 +34,10 @@ class core;
 class NodeServer;
 class ICryptoNoteProtocolQuery;
 
-class RpcServer : public HttpServer {
+class RpcServer : public HttpServer, private ICoreObserver {
 public:
   RpcServer(System::Dispatcher& dispatcher, Logging::ILogger& log, core& c, NodeServer& p2p, const ICryptoNoteProtocolQuery& protocolQuery);
+  ~RpcServer();
   typedef std::function<bool(RpcServer*, const HttpRequest& request, HttpResponse& response)> HandlerFunction;
   bool setFeeAddress(const std::string& fee_address, const AccountPublicAddress& fee_acc);
   bool setViewKey(const std::string& view_key);
@@ -40,6 +45,8 @@ public:
   bool k_on_check_tx_proof(const K_COMMAND_RPC_CHECK_TX_PROOF::request& req, K_COMMAND_RPC_CHECK_TX_PROOF::response& res);
   bool k_on_check_reserve_proof(const K_COMMAND_RPC_CHECK_RESERVE_PROOF::request& req, K_COMMAND_RPC_CHECK_RESERVE_PROOF::response& res);  
   bool enableCors(const std::string domain);  
+  // handlers marked to run on workers leave the dispatcher to the peer connections; 0 runs everything on the dispatcher
+  bool setWorkerThreads(size_t threadCount);
   bool remotenode_check_incoming_tx(const BinaryArray& tx_blob);
 
 private:
@@ -48,6 +55,7 @@ private:
   struct RpcHandler {
     const Handler handler;
     const bool allowBusyCore;
+    const bool runOnWorker;
   };
 
   typedef void (RpcServer::*HandlerPtr)(const HttpRequest& request, HttpResponse& response);
@@ -56,6 +64,14 @@ private:
   virtual void processRequest(const HttpRequest& request, HttpResponse& response) override;
   bool processJsonRpcRequest(const HttpRequest& request, HttpResponse& response);
   bool isCoreReady();
+  void runHandler(bool runOnWorker, const std::function<void()>& handler);
+
+  // ICoreObserver, called on whichever thread changed the core
+  virtual void blockchainUpdated() override;
+  virtual void poolUpdated() override;
+  // wakes the long polling getblocktemplate calls on the dispatcher thread
+  void blockTemplateUpdated();
+  void waitBlockTemplateUpdate(uint64_t templateVersion);
 
   // binary handlers
   bool on_get_blocks(const COMMAND_RPC_GET_BLOCKS_FAST::request& req, COMMAND_RPC_GET_BLOCKS_FAST::response& res);
@@ -106,6 +122,9 @@ private:
   std::string m_fee_address;
   Crypto::SecretKey m_view_key = NULL_SECRET_KEY;
   AccountPublicAddress m_fee_acc; 
+  // shared with the wakeups spawned by blockTemplateUpdated, which may run after the server is gone
+  std::shared_ptr<std::unordered_set<System::Event*>> m_blockTemplateWaiters;
+  std::unique_ptr<Tools::ThreadPool> m_workerPool;
 };
 
 }
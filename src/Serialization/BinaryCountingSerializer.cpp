@@ -0,0 +1,116 @@
+// Copyright (c) 2017-2022 Fuego Developers
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Copyright (c) 2016-2019 The Karbowanec developers
+// Copyright (c) 2012-2018 The CryptoNote developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#include "BinaryCountingSerializer.h"
+
+#include <cassert>
+#include <stdexcept>
+
+namespace CryptoNote {
+
+ISerializer::SerializerType BinaryCountingSerializer::type() const {
+  return ISerializer::OUTPUT;
+}
+
+bool BinaryCountingSerializer::beginObject(Common::StringView name) {
+  return true;
+}
+
+void BinaryCountingSerializer::endObject() {
+}
+
+bool BinaryCountingSerializer::beginArray(size_t& size, Common::StringView name) {
+  countVarint(size);
+  return true;
+}
+
+void BinaryCountingSerializer::endArray() {
+}
+
+bool BinaryCountingSerializer::operator()(uint8_t& value, Common::StringView name) {
+  countVarint(value);
+  return true;
+}
+
+bool BinaryCountingSerializer::operator()(uint16_t& value, Common::StringView name) {
+  countVarint(value);
+  return true;
+}
+
+bool BinaryCountingSerializer::operator()(int16_t& value, Common::StringView name) {
+  countVarint(static_cast<uint16_t>(value));
+  return true;
+}
+
+bool BinaryCountingSerializer::operator()(uint32_t& value, Common::StringView name) {
+  countVarint(value);
+  return true;
+}
+
+bool BinaryCountingSerializer::operator()(int32_t& value, Common::StringView name) {
+  countVarint(static_cast<uint32_t>(value));
+  return true;
+}
+
+bool BinaryCountingSerializer::operator()(int64_t& value, Common::StringView name) {
+  countVarint(static_cast<uint64_t>(value));
+  return true;
+}
+
+bool BinaryCountingSerializer::operator()(uint64_t& value, Common::StringView name) {
+  countVarint(value);
+  return true;
+}
+
+bool BinaryCountingSerializer::operator()(bool& value, Common::StringView name) {
+  ++count;
+  return true;
+}
+
+bool BinaryCountingSerializer::operator()(std::string& value, Common::StringView name) {
+  countVarint(value.size());
+  count += value.size();
+  return true;
+}
+
+bool BinaryCountingSerializer::binary(void* value, size_t size, Common::StringView name) {
+  count += size;
+  return true;
+}
+
+bool BinaryCountingSerializer::binary(std::string& value, Common::StringView name) {
+  // counted as string (with size prefix)
+  return (*this)(value, name);
+}
+
+bool BinaryCountingSerializer::operator()(double& value, Common::StringView name) {
+  assert(false); //the method is not supported for this type of serialization
+  throw std::runtime_error("double serialization is not supported in BinaryCountingSerializer");
+  return false;
+}
+
+void BinaryCountingSerializer::countVarint(uint64_t value) {
+  // 7 bits per byte, as writeVarint emits them
+  while (value >= 0x80) {
+    ++count;
+    value >>= 7;
+  }
+
+  ++count;
+}
+
+}
@@ -17,25 +17,407 @@
 
 #include "Serialization/JsonInputStreamSerializer.h"
 
-#include <ctype.h>
-#include <exception>
+#include <cassert>
+#include <cctype>
+#include <cstdlib>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+#include "Common/StringTools.h"
 
 namespace CryptoNote {
 
 namespace {
 
-Common::JsonValue getJsonValueFromStreamHelper(std::istream& stream) {
-  Common::JsonValue value;
-  stream >> value;
-  return value;
+const size_t VALUE_NOT_FOUND = std::numeric_limits<size_t>::max();
+
+size_t skipWhitespaces(Common::StringView text, size_t pos) {
+  while (pos < text.getSize() && isspace(static_cast<unsigned char>(text[pos]))) {
+    ++pos;
+  }
+
+  return pos;
+}
+
+char readNonWsChar(Common::StringView text, size_t& pos) {
+  pos = skipWhitespaces(text, pos);
+  if (pos == text.getSize()) {
+    throw std::runtime_error("Unable to parse: unexpected end of stream");
+  }
+
+  return text[pos];
+}
+
+// 'pos' points past the opening quote, escapes are kept as they are, like JsonValue does
+Common::StringView readStringToken(Common::StringView text, size_t& pos) {
+  size_t begin = pos;
+  while (pos < text.getSize()) {
+    char c = text[pos++];
+    if (c == '"') {
+      return Common::StringView(text.getData() + begin, pos - 1 - begin);
+    }
+
+    if (c == '\\') {
+      ++pos;
+    }
+  }
+
+  throw std::runtime_error("Unable to parse: unexpected end of stream");
+}
+
+void readLiteral(Common::StringView text, size_t& pos, Common::StringView literal) {
+  if (text.getSize() - pos < literal.getSize() || !(Common::StringView(text.getData() + pos, literal.getSize()) == literal)) {
+    throw std::runtime_error("Unable to parse");
+  }
+
+  pos += literal.getSize();
+}
+
+// returns true if the number has a fractional part
+bool skipNumber(Common::StringView text, size_t& pos) {
+  size_t begin = pos++;
+  size_t dots = 0;
+  while (pos < text.getSize() && ((text[pos] >= '0' && text[pos] <= '9') || text[pos] == '.')) {
+    if (text[pos] == '.') {
+      ++dots;
+    }
+
+    ++pos;
+  }
+
+  if (dots > 0) {
+    if (dots > 1) {
+      throw std::runtime_error("Unable to parse");
+    }
+
+    if (pos < text.getSize() && text[pos] == 'e') {
+      ++pos;
+      if (pos < text.getSize() && (text[pos] == '+' || text[pos] == '-')) {
+        ++pos;
+      }
+
+      if (pos == text.getSize() || text[pos] < '0' || text[pos] > '9') {
+        throw std::runtime_error("Unable to parse");
+      }
+
+      while (pos < text.getSize() && text[pos] >= '0' && text[pos] <= '9') {
+        ++pos;
+      }
+    }
+
+    return true;
+  }
+
+  if (pos - begin > 1 && (text[begin] == '0' || (text[begin] == '-' && text[begin + 1] == '0'))) {
+    throw std::runtime_error("Unable to parse");
+  }
+
+  return false;
+}
+
+void skipValue(Common::StringView text, size_t& pos) {
+  char c = readNonWsChar(text, pos);
+
+  if (c == '{' || c == '[') {
+    char close = c == '{' ? '}' : ']';
+    ++pos;
+    c = readNonWsChar(text, pos);
+    if (c == close) {
+      ++pos;
+      return;
+    }
+
+    for (;;) {
+      if (close == '}') {
+        if (c != '"') {
+          throw std::runtime_error("Unable to parse");
+        }
+
+        ++pos;
+        readStringToken(text, pos);
+        if (readNonWsChar(text, pos) != ':') {
+          throw std::runtime_error("Unable to parse");
+        }
+
+        ++pos;
+      }
+
+      skipValue(text, pos);
+      c = readNonWsChar(text, pos);
+      ++pos;
+      if (c == close) {
+        break;
+      }
+
+      if (c != ',') {
+        throw std::runtime_error("Unable to parse");
+      }
+
+      c = readNonWsChar(text, pos);
+    }
+  } else if (c == 't') {
+    readLiteral(text, pos, "true");
+  } else if (c == 'f') {
+    readLiteral(text, pos, "false");
+  } else if (c == 'n') {
+    readLiteral(text, pos, "null");
+  } else if (c == '-' || (c >= '0' && c <= '9')) {
+    skipNumber(text, pos);
+  } else if (c == '"') {
+    ++pos;
+    readStringToken(text, pos);
+  } else {
+    throw std::runtime_error("Unable to parse");
+  }
 }
 
 }
 
-JsonInputStreamSerializer::JsonInputStreamSerializer(std::istream& stream) : JsonInputValueSerializer(getJsonValueFromStreamHelper(stream)) {
+JsonInputStreamSerializer::JsonInputStreamSerializer(std::istream& stream) :
+  buffer(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()), json(buffer) {
+  enterRoot();
+}
+
+JsonInputStreamSerializer::JsonInputStreamSerializer(Common::StringView json) : json(json) {
+  enterRoot();
 }
 
 JsonInputStreamSerializer::~JsonInputStreamSerializer() {
 }
 
+ISerializer::SerializerType JsonInputStreamSerializer::type() const {
+  return ISerializer::INPUT;
+}
+
+void JsonInputStreamSerializer::enterRoot() {
+  size_t pos = 0;
+  if (readNonWsChar(json, pos) != '{') {
+    throw std::runtime_error("Serializer doesn't support this type of serialization: Object expected.");
+  }
+
+  pos = enter(pos);
+  if (skipWhitespaces(json, pos) != json.getSize()) {
+    throw std::runtime_error("Unable to parse: unexpected data after the root object");
+  }
+}
+
+size_t JsonInputStreamSerializer::enter(size_t offset) {
+  bool isArray = json[offset] == '[';
+  chain.push_back({isArray, members.size(), 0});
+
+  size_t pos = offset + 1;
+  char c = readNonWsChar(json, pos);
+  if (c == (isArray ? ']' : '}')) {
+    return pos + 1;
+  }
+
+  for (;;) {
+    Member member;
+    if (!isArray) {
+      if (c != '"') {
+        throw std::runtime_error("Unable to parse");
+      }
+
+      ++pos;
+      member.name = readStringToken(json, pos);
+      if (readNonWsChar(json, pos) != ':') {
+        throw std::runtime_error("Unable to parse");
+      }
+
+      ++pos;
+    }
+
+    readNonWsChar(json, pos);
+    member.offset = pos;
+    members.push_back(member);
+
+    skipValue(json, pos);
+    c = readNonWsChar(json, pos);
+    ++pos;
+    if (c == (isArray ? ']' : '}')) {
+      return pos;
+    }
+
+    if (c != ',') {
+      throw std::runtime_error("Unable to parse");
+    }
+
+    c = readNonWsChar(json, pos);
+  }
+}
+
+size_t JsonInputStreamSerializer::findValue(Common::StringView name) {
+  assert(!chain.empty());
+  Level& level = chain.back();
+
+  if (level.isArray) {
+    size_t index = level.firstMember + level.nextElement++;
+    if (index >= members.size()) {
+      throw std::runtime_error("Array index is out of range");
+    }
+
+    return members[index].offset;
+  }
+
+  // the last one wins on duplicate names, as in JsonValue
+  for (size_t i = members.size(); i > level.firstMember; --i) {
+    if (members[i - 1].name == name) {
+      return members[i - 1].offset;
+    }
+  }
+
+  return VALUE_NOT_FOUND;
+}
+
+bool JsonInputStreamSerializer::beginObject(Common::StringView name) {
+  size_t offset = findValue(name);
+  if (offset == VALUE_NOT_FOUND) {
+    return false;
+  }
+
+  if (json[offset] != '{') {
+    throw std::runtime_error("JsonValue type is not OBJECT");
+  }
+
+  enter(offset);
+  return true;
+}
+
+void JsonInputStreamSerializer::endObject() {
+  assert(chain.size() > 1);
+  members.resize(chain.back().firstMember);
+  chain.pop_back();
+}
+
+bool JsonInputStreamSerializer::beginArray(size_t& size, Common::StringView name) {
+  size_t offset = findValue(name);
+  if (offset == VALUE_NOT_FOUND) {
+    size = 0;
+    return false;
+  }
+
+  if (json[offset] != '[') {
+    throw std::runtime_error("JsonValue type is not ARRAY");
+  }
+
+  enter(offset);
+  size = members.size() - chain.back().firstMember;
+  return true;
+}
+
+void JsonInputStreamSerializer::endArray() {
+  assert(chain.size() > 1);
+  members.resize(chain.back().firstMember);
+  chain.pop_back();
+}
+
+bool JsonInputStreamSerializer::getInteger(Common::StringView name, int64_t& value) {
+  size_t offset = findValue(name);
+  if (offset == VALUE_NOT_FOUND) {
+    return false;
+  }
+
+  size_t end = offset;
+  if ((json[offset] != '-' && (json[offset] < '0' || json[offset] > '9')) || skipNumber(json, end)) {
+    throw std::runtime_error("JsonValue type is not INTEGER");
+  }
+
+  // out of range values saturate, as stream extraction does for JsonValue
+  std::string text(json.getData() + offset, end - offset);
+  value = strtoll(text.c_str(), nullptr, 10);
+  return true;
+}
+
+bool JsonInputStreamSerializer::getString(Common::StringView name, Common::StringView& value) {
+  size_t offset = findValue(name);
+  if (offset == VALUE_NOT_FOUND) {
+    return false;
+  }
+
+  if (json[offset] != '"') {
+    throw std::runtime_error("JsonValue type is not STRING");
+  }
+
+  size_t pos = offset + 1;
+  value = readStringToken(json, pos);
+  return true;
+}
+
+bool JsonInputStreamSerializer::operator()(uint16_t& value, Common::StringView name) {
+  return getNumber(name, value);
+}
+
+bool JsonInputStreamSerializer::operator()(int16_t& value, Common::StringView name) {
+  return getNumber(name, value);
+}
+
+bool JsonInputStreamSerializer::operator()(uint32_t& value, Common::StringView name) {
+  return getNumber(name, value);
+}
+
+bool JsonInputStreamSerializer::operator()(int32_t& value, Common::StringView name) {
+  return getNumber(name, value);
+}
+
+bool JsonInputStreamSerializer::operator()(int64_t& value, Common::StringView name) {
+  return getNumber(name, value);
+}
+
+bool JsonInputStreamSerializer::operator()(uint64_t& value, Common::StringView name) {
+  return getNumber(name, value);
+}
+
+bool JsonInputStreamSerializer::operator()(double& value, Common::StringView name) {
+  return getNumber(name, value);
+}
+
+bool JsonInputStreamSerializer::operator()(uint8_t& value, Common::StringView name) {
+  return getNumber(name, value);
+}
+
+bool JsonInputStreamSerializer::operator()(std::string& value, Common::StringView name) {
+  Common::StringView text;
+  if (!getString(name, text)) {
+    return false;
+  }
+
+  value.assign(text.getData(), text.getSize());
+  return true;
+}
+
+bool JsonInputStreamSerializer::operator()(bool& value, Common::StringView name) {
+  size_t offset = findValue(name);
+  if (offset == VALUE_NOT_FOUND) {
+    return false;
+  }
+
+  if (json[offset] != 't' && json[offset] != 'f') {
+    throw std::runtime_error("JsonValue type is not BOOL");
+  }
+
+  value = json[offset] == 't';
+  return true;
+}
+
+bool JsonInputStreamSerializer::binary(void* value, size_t size, Common::StringView name) {
+  Common::StringView text;
+  if (!getString(name, text)) {
+    return false;
+  }
+
+  Common::fromHex(std::string(text), value, size);
+  return true;
+}
+
+bool JsonInputStreamSerializer::binary(std::string& value, Common::StringView name) {
+  Common::StringView text;
+  if (!getString(name, text)) {
+    return false;
+  }
+
+  value = Common::asString(Common::fromHex(std::string(text)));
+  return true;
+}
+
 } //namespace CryptoNote
@@ -17,19 +17,87 @@
 
 #pragma once
 
+#include <cstdint>
 #include <iosfwd>
 #include <string>
 #include <vector>
-#include "../Common/JsonValue.h"
-#include "JsonInputValueSerializer.h"
+#include "Common/StringView.h"
+#include "ISerializer.h"
 
 namespace CryptoNote {
 
 //deserialization
-class JsonInputStreamSerializer : public JsonInputValueSerializer {
+// Pull parser over JSON text. Entering an object or an array indexes where its
+// members start; values are only decoded when a field is read, so no JsonValue
+// tree is built. Strings and numbers follow the same rules as Common::JsonValue.
+class JsonInputStreamSerializer : public ISerializer {
 public:
   JsonInputStreamSerializer(std::istream& stream);
+  // the text must outlive the serializer
+  JsonInputStreamSerializer(Common::StringView json);
   virtual ~JsonInputStreamSerializer();
+
+  SerializerType type() const override;
+
+  virtual bool beginObject(Common::StringView name) override;
+  virtual void endObject() override;
+
+  virtual bool beginArray(size_t& size, Common::StringView name) override;
+  virtual void endArray() override;
+
+  virtual bool operator()(uint8_t& value, Common::StringView name) override;
+  virtual bool operator()(int16_t& value, Common::StringView name) override;
+  virtual bool operator()(uint16_t& value, Common::StringView name) override;
+  virtual bool operator()(int32_t& value, Common::StringView name) override;
+  virtual bool operator()(uint32_t& value, Common::StringView name) override;
+  virtual bool operator()(int64_t& value, Common::StringView name) override;
+  virtual bool operator()(uint64_t& value, Common::StringView name) override;
+  virtual bool operator()(double& value, Common::StringView name) override;
+  virtual bool operator()(bool& value, Common::StringView name) override;
+  virtual bool operator()(std::string& value, Common::StringView name) override;
+  virtual bool binary(void* value, size_t size, Common::StringView name) override;
+  virtual bool binary(std::string& value, Common::StringView name) override;
+
+  template<typename T>
+  bool operator()(T& value, Common::StringView name) {
+    return ISerializer::operator()(value, name);
+  }
+
+private:
+  struct Member {
+    Common::StringView name;
+    size_t offset;
+  };
+
+  struct Level {
+    bool isArray;
+    size_t firstMember;
+    size_t nextElement;
+  };
+
+  std::string buffer;
+  Common::StringView json;
+  std::vector<Member> members;
+  std::vector<Level> chain;
+
+  void enterRoot();
+  // returns the offset past the closing bracket
+  size_t enter(size_t offset);
+  // returns the offset of the value or SIZE_MAX if the field is missing
+  size_t findValue(Common::StringView name);
+  bool getString(Common::StringView name, Common::StringView& value);
+  bool getInteger(Common::StringView name, int64_t& value);
+
+  template <typename T>
+  bool getNumber(Common::StringView name, T& v) {
+    int64_t number;
+    if (!getInteger(name, number)) {
+      return false;
+    }
+
+    v = static_cast<T>(number);
+    return true;
+  }
 };
 
 }
@@ -17,6 +17,7 @@
 
 #include "JsonOutputStreamSerializer.h"
 #include <cassert>
+#include <cstdio>
 #include <stdexcept>
 #include "Common/StringTools.h"
 
@@ -25,26 +26,13 @@ using namespace CryptoNote;
 
 namespace CryptoNote {
 std::ostream& operator<<(std::ostream& out, const JsonOutputStreamSerializer& enumerator) {
-  out << enumerator.root;
+  out << enumerator.output;
   return out;
 }
 }
 
-namespace {
-
-template <typename T>
-void insertOrPush(JsonValue& js, Common::StringView name, const T& value) {
-  if (js.isArray()) {
-    js.pushBack(JsonValue(value));
-  } else {
-    js.insert(std::string(name), JsonValue(value));
-  }
-}
-
-}
-
-JsonOutputStreamSerializer::JsonOutputStreamSerializer() : root(JsonValue::OBJECT) {
-  chain.push_back(&root);
+JsonOutputStreamSerializer::JsonOutputStreamSerializer() : output("{}") {
+  chain.push_back({false, true});
 }
 
 JsonOutputStreamSerializer::~JsonOutputStreamSerializer() {
@@ -54,34 +42,59 @@ ISerializer::SerializerType JsonOutputStreamSerializer::type() const {
   return ISerializer::OUTPUT;
 }
 
-bool JsonOutputStreamSerializer::beginObject(Common::StringView name) {
-  JsonValue& parent = *chain.back();
-  JsonValue obj(JsonValue::OBJECT);
+JsonValue JsonOutputStreamSerializer::getValue() const {
+  return JsonValue::fromString(output);
+}
+
+void JsonOutputStreamSerializer::beginValue(Common::StringView name) {
+  assert(!chain.empty());
+  Level& level = chain.back();
 
-  if (parent.isObject()) {
-    chain.push_back(&parent.insert(std::string(name), obj));
-  } else {
-    chain.push_back(&parent.pushBack(obj));
+  output.pop_back();
+  if (!level.isEmpty) {
+    output += ',';
   }
 
+  level.isEmpty = false;
+  if (!level.isArray) {
+    output += '"';
+    output.append(name.getData(), name.getSize());
+    output += "\":";
+  }
+}
+
+void JsonOutputStreamSerializer::endValue() {
+  output += '}';
+}
+
+bool JsonOutputStreamSerializer::beginObject(Common::StringView name) {
+  beginValue(name);
+  output += '{';
+  endValue();
+  chain.push_back({false, true});
   return true;
 }
 
 void JsonOutputStreamSerializer::endObject() {
-  assert(!chain.empty());
+  assert(chain.size() > 1);
   chain.pop_back();
+  output.back() = '}';
+  endValue();
 }
 
 bool JsonOutputStreamSerializer::beginArray(size_t& size, Common::StringView name) {
-  JsonValue val(JsonValue::ARRAY);
-  JsonValue& res = chain.back()->insert(std::string(name), val);
-  chain.push_back(&res);
+  beginValue(name);
+  output += '[';
+  endValue();
+  chain.push_back({true, true});
   return true;
 }
 
 void JsonOutputStreamSerializer::endArray() {
-  assert(!chain.empty());
+  assert(chain.size() > 1);
   chain.pop_back();
+  output.back() = ']';
+  endValue();
 }
 
 bool JsonOutputStreamSerializer::operator()(uint64_t& value, Common::StringView name) {
@@ -110,33 +123,59 @@ bool JsonOutputStreamSerializer::operator()(int32_t& value, Common::StringView n
 }
 
 bool JsonOutputStreamSerializer::operator()(int64_t& value, Common::StringView name) {
-  insertOrPush(*chain.back(), name, value);
+  beginValue(name);
+  output += std::to_string(value);
+  endValue();
   return true;
 }
 
 bool JsonOutputStreamSerializer::operator()(double& value, Common::StringView name) {
-  insertOrPush(*chain.back(), name, value);
+  // same text as JsonValue prints for REAL: 11 fixed digits, trailing zeros trimmed
+  char buffer[512];
+  int length = snprintf(buffer, sizeof(buffer), "%.11f", value);
+  if (length < 0 || static_cast<size_t>(length) >= sizeof(buffer)) {
+    throw std::runtime_error("Unable to format double value");
+  }
+
+  std::string text(buffer, length);
+  while (text.size() > 1 && text[text.size() - 2] != '.' && text[text.size() - 1] == '0') {
+    text.resize(text.size() - 1);
+  }
+
+  beginValue(name);
+  output += text;
+  endValue();
   return true;
 }
 
 bool JsonOutputStreamSerializer::operator()(std::string& value, Common::StringView name) {
-  insertOrPush(*chain.back(), name, value);
+  beginValue(name);
+  output += '"';
+  output += value;
+  output += '"';
+  endValue();
   return true;
 }
 
 bool JsonOutputStreamSerializer::operator()(uint8_t& value, Common::StringView name) {
-  insertOrPush(*chain.back(), name, static_cast<int64_t>(value));
-  return true;
+  int64_t v = static_cast<int64_t>(value);
+  return operator()(v, name);
 }
 
 bool JsonOutputStreamSerializer::operator()(bool& value, Common::StringView name) {
-  insertOrPush(*chain.back(), name, value);
+  beginValue(name);
+  output += value ? "true" : "false";
+  endValue();
   return true;
 }
 
 bool JsonOutputStreamSerializer::binary(void* value, size_t size, Common::StringView name) {
-  std::string hex = Common::toHex(value, size);
-  return (*this)(hex, name);
+  beginValue(name);
+  output += '"';
+  Common::toHex(value, size, output);
+  output += '"';
+  endValue();
+  return true;
 }
 
 bool JsonOutputStreamSerializer::binary(std::string& value, Common::StringView name) {
@@ -18,11 +18,15 @@
 #pragma once
 
 #include <iostream>
+#include <string>
+#include <vector>
 #include "../Common/JsonValue.h"
 #include "ISerializer.h"
 
 namespace CryptoNote {
 
+// Writes JSON text straight into a string buffer, no JsonValue tree is built.
+// Object members appear in serialization order.
 class JsonOutputStreamSerializer : public ISerializer {
 public:
   JsonOutputStreamSerializer();
@@ -54,15 +58,31 @@ public:
     return ISerializer::operator()(value, name);
   }
 
-  const Common::JsonValue& getValue() const {
-    return root;
+  const std::string& getJson() const {
+    return output;
   }
 
+  // leaves the serializer empty, for handing large documents over without a copy
+  std::string takeJson() {
+    return std::move(output);
+  }
+
+  Common::JsonValue getValue() const;
+
   friend std::ostream& operator<<(std::ostream& out, const JsonOutputStreamSerializer& enumerator);
 
 private:
-  Common::JsonValue root;
-  std::vector<Common::JsonValue*> chain;
+  struct Level {
+    bool isArray;
+    bool isEmpty;
+  };
+
+  // the buffer always ends with the closing brace of the root object
+  std::string output;
+  std::vector<Level> chain;
+
+  void beginValue(Common::StringView name);
+  void endValue();
 };
 
 }
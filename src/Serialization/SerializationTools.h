@@ -17,11 +17,13 @@
 
 #pragma once
 
+#include <cassert>
 #include <list>
 #include <vector>
 #include <Common/MemoryInputStream.h>
 #include <Common/StringOutputStream.h>
 #include "JsonInputStreamSerializer.h"
+#include "JsonInputValueSerializer.h"
 #include "JsonOutputStreamSerializer.h"
 #include "KVBinaryInputStreamSerializer.h"
 #include "KVBinaryOutputStreamSerializer.h"
@@ -91,7 +93,32 @@ void loadFromJsonValue(std::list<T>& v, const Common::JsonValue& js) {
 
 template <typename T>
 std::string storeToJson(const T& v) {
-  return storeToJsonValue(v).toString();
+  JsonOutputStreamSerializer s;
+  serialize(const_cast<T&>(v), s);
+  return s.takeJson();
+}
+
+template <typename T>
+std::string storeToJson(const std::vector<T>& v) { return storeToJsonValue(v).toString(); }
+
+template <typename T>
+std::string storeToJson(const std::list<T>& v) { return storeToJsonValue(v).toString(); }
+
+inline std::string storeToJson(const std::string& v) { return storeToJsonValue(v).toString(); }
+
+// Adds the already serialized 'value' as member 'name' of the serialized object 'object'.
+inline void appendJsonMember(std::string& object, Common::StringView name, const std::string& value) {
+  assert(!object.empty() && object.back() == '}');
+  object.pop_back();
+  if (object.size() > 1) {
+    object += ',';
+  }
+
+  object += '"';
+  object.append(name.getData(), name.getSize());
+  object += "\":";
+  object += value;
+  object += '}';
 }
 
 template <typename T>
@@ -100,8 +127,8 @@ bool loadFromJson(T& v, const std::string& buf) {
     if (buf.empty()) {
       return true;
     }
-    auto js = Common::JsonValue::fromString(buf);
-    loadFromJsonValue(v, js);
+    JsonInputStreamSerializer s(buf);
+    serialize(v, s);
   } catch (std::exception&) {
     return false;
   }
@@ -0,0 +1,64 @@
+// Copyright (c) 2017-2022 Fuego Developers
+// Copyright (c) 2018-2019 Conceal Network & Conceal Devs
+// Copyright (c) 2016-2019 The Karbowanec developers
+// Copyright (c) 2012-2018 The CryptoNote developers
+//
+// This file is part of Fuego.
+//
+// Fuego is free software distributed in the hope that it
+// will be useful, but WITHOUT ANY WARRANTY; without even the
+// implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+// PURPOSE. You can redistribute it and/or modify it under the terms
+// of the GNU General Public License v3 or later versions as published
+// by the Free Software Foundation. Fuego includes elements written
+// by third parties. See file labeled LICENSE for more details.
+// You should have received a copy of the GNU General Public License
+// along with Fuego. If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <exception>
+#include <functional>
+#include <System/Dispatcher.h>
+#include <System/Event.h>
+#include <System/InterruptedException.h>
+#include "Common/ThreadPool.h"
+
+namespace System {
+
+// Runs work on a pool worker and runs other tasks on the dispatcher until it is done, then rethrows
+// what work threw. Like RemoteContext, but without a thread being started for every call.
+// The worker references this frame, so an interruption is only delivered once work has finished.
+inline void runOnPool(Dispatcher& dispatcher, Tools::ThreadPool& pool, const std::function<void()>& work) {
+  Event completed(dispatcher);
+  std::exception_ptr error;
+  pool.submit([&dispatcher, &work, &completed, &error] {
+    try {
+      work();
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    auto event = &completed;
+    dispatcher.remoteSpawn([event] { event->set(); });
+  });
+
+  bool interrupted = false;
+  while (!completed.get()) {
+    try {
+      completed.wait();
+    } catch (InterruptedException&) {
+      interrupted = true;
+    }
+  }
+
+  if (interrupted) {
+    dispatcher.interrupt();
+  }
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+}
@@ -258,6 +258,10 @@ void BlockchainSynchronizer::workingProcedure() {
   }
 
   actualizeFutureState();
+
+  // the node still writes into a query that is in flight
+  GetBlocksResponse discarded;
+  takePrefetchedBlocks(GetBlocksRequest(), discarded);
 }
 
 void BlockchainSynchronizer::start() {
@@ -350,12 +354,15 @@ void BlockchainSynchronizer::startBlockchainSync() {
   GetBlocksRequest req = getCommonHistory();
 
   try {
-    if (!req.knownBlocks.empty()) {
+    if (takePrefetchedBlocks(req, response)) {
+      prefetchBlocks(req, response);
+      processBlocks(response);
+    } else if (!req.knownBlocks.empty()) {
       auto queryBlocksCompleted = std::promise<std::error_code>();
       auto queryBlocksWaitFuture = queryBlocksCompleted.get_future();
 
       m_node.queryBlocks(
-        std::move(req.knownBlocks),
+        std::vector<Crypto::Hash>(req.knownBlocks),
         req.syncStart.timestamp,
         response.newBlocks,
         response.startHeight,
@@ -370,6 +377,7 @@ void BlockchainSynchronizer::startBlockchainSync() {
         setFutureStateIf(State::idle, [this] { return m_futureState != State::stopped; });
         m_observerManager.notify(&IBlockchainSynchronizerObserver::synchronizationCompleted, ec);
       } else {
+        prefetchBlocks(req, response);
         processBlocks(response);
       }
     }
@@ -379,6 +387,53 @@ void BlockchainSynchronizer::startBlockchainSync() {
   }
 }
 
+void BlockchainSynchronizer::prefetchBlocks(const GetBlocksRequest& request, const GetBlocksResponse& response) {
+  // nothing to ask for while the node has no blocks beyond this batch
+  if (response.newBlocks.empty() ||
+    response.startHeight + static_cast<uint32_t>(response.newBlocks.size()) > m_node.getLastLocalBlockHeight()) {
+    return;
+  }
+
+  std::unique_ptr<PrefetchedBlocks> prefetch(new PrefetchedBlocks());
+  prefetch->topBlockId = response.newBlocks.back().blockHash;
+
+  std::vector<Crypto::Hash> knownBlocks;
+  knownBlocks.reserve(request.knownBlocks.size() + 1);
+  knownBlocks.push_back(prefetch->topBlockId);
+  knownBlocks.insert(knownBlocks.end(), request.knownBlocks.begin(), request.knownBlocks.end());
+
+  auto queryBlocksCompleted = std::make_shared<std::promise<std::error_code>>();
+  prefetch->completed = queryBlocksCompleted->get_future();
+
+  m_node.queryBlocks(
+    std::move(knownBlocks),
+    request.syncStart.timestamp,
+    prefetch->response.newBlocks,
+    prefetch->response.startHeight,
+    [queryBlocksCompleted](std::error_code ec) {
+      queryBlocksCompleted->set_value(ec);
+    });
+
+  m_prefetchedBlocks = std::move(prefetch);
+}
+
+bool BlockchainSynchronizer::takePrefetchedBlocks(const GetBlocksRequest& request, GetBlocksResponse& response) {
+  if (!m_prefetchedBlocks) {
+    return false;
+  }
+
+  std::unique_ptr<PrefetchedBlocks> prefetch = std::move(m_prefetchedBlocks);
+  std::error_code ec = prefetch->completed.get();
+
+  // of no use if it failed or the consumers did not end up where it was assumed, e.g. after an error
+  if (ec || request.knownBlocks.empty() || request.knownBlocks.front() != prefetch->topBlockId) {
+    return false;
+  }
+
+  response = std::move(prefetch->response);
+  return true;
+}
+
 void BlockchainSynchronizer::processBlocks(GetBlocksResponse& response) {
   BlockchainInterval interval;
   interval.startHeight = response.startHeight;
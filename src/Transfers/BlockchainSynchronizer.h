@@ -75,6 +75,14 @@ private:
     std::vector<Crypto::Hash> knownBlocks;
   };
 
+  // Blocks asked for while the consumers still process the previous batch, on the assumption that
+  // they end up at topBlockId. At most one such query is in flight.
+  struct PrefetchedBlocks {
+    Crypto::Hash topBlockId;
+    GetBlocksResponse response;
+    std::future<std::error_code> completed;
+  };
+
   struct GetPoolResponse {
     bool isLastKnownBlockActual;
     std::vector<std::unique_ptr<ITransactionReader>> newTxs;
@@ -103,6 +111,8 @@ private:
   void startPoolSync();
   void startBlockchainSync();
 
+  void prefetchBlocks(const GetBlocksRequest& request, const GetBlocksResponse& response);
+  bool takePrefetchedBlocks(const GetBlocksRequest& request, GetBlocksResponse& response);
   void processBlocks(GetBlocksResponse& response);
   UpdateConsumersResult updateConsumers(const BlockchainInterval& interval, const std::vector<CompleteBlock>& blocks);
   std::error_code processPoolTxs(GetPoolResponse& response);
@@ -137,6 +147,7 @@ private:
   std::unique_ptr<std::thread> workingThread;
   std::list<std::pair<const ITransactionReader*, std::promise<std::error_code>>> m_addTransactionTasks;
   std::list<std::pair<const Crypto::Hash*, std::promise<void>>> m_removeTransactionTasks;
+  std::unique_ptr<PrefetchedBlocks> m_prefetchedBlocks;
 
   mutable std::mutex m_consumersMutex;
   mutable std::mutex m_stateMutex;
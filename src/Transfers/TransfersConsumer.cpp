@@ -18,12 +18,15 @@
 
 #include "TransfersConsumer.h"
 
-#include <numeric>
+#include <algorithm>
+#include <atomic>
 #include <future>
+#include <numeric>
+#include <thread>
 
 #include "CommonTypes.h"
 #include "Common/StringTools.h"
-#include "Common/BlockingQueue.h"
+#include "Common/ThreadPool.h"
 #include "CryptoNoteCore/CryptoNoteFormatUtils.h"
 #include "CryptoNoteCore/TransactionApi.h"
 #include "CryptoNoteCore/TransactionExtra.h"
@@ -61,21 +64,24 @@ void checkOutputKey(
 
 }
 
+struct OutputKey {
+  PublicKey key;
+  size_t keyIndex;
+  size_t outputIndex;
+};
+
 void findMyOutputs(
   const ITransactionReader& tx,
   const SecretKey& viewSecretKey,
   const std::unordered_set<PublicKey>& spendKeys,
   std::unordered_map<PublicKey, std::vector<uint32_t>>& outputs) {
 
-  auto txPublicKey = tx.getTransactionPublicKey();
-  KeyDerivation derivation;
-
-  if (!generate_key_derivation( txPublicKey, viewSecretKey, derivation)) {
-    return;
-  }
-
+  // gather the output keys first, so transactions without any skip the derivation
+  // and the remaining ones are checked in a single loop over a flat array
+  std::vector<OutputKey> keys;
   size_t keyIndex = 0;
   size_t outputCount = tx.getOutputCount();
+  keys.reserve(outputCount);
 
   for (size_t idx = 0; idx < outputCount; ++idx) {
 
@@ -86,7 +92,7 @@ void findMyOutputs(
       uint64_t amount;
       KeyOutput out;
       tx.getOutput(idx, out, amount);
-      checkOutputKey(derivation, out.key, keyIndex, idx, spendKeys, outputs);
+      keys.push_back({ out.key, keyIndex, idx });
       ++keyIndex;
 
     } else if (outType == TransactionTypes::OutputType::Multisignature) {
@@ -95,11 +101,33 @@ void findMyOutputs(
       MultisignatureOutput out;
       tx.getOutput(idx, out, amount);
       for (const auto& key : out.keys) {
-        checkOutputKey(derivation, key, idx, idx, spendKeys, outputs);
+        keys.push_back({ key, idx, idx });
         ++keyIndex;
      }
     }
   }
+
+  if (keys.empty()) {
+    return;
+  }
+
+  auto txPublicKey = tx.getTransactionPublicKey();
+  KeyDerivation derivation;
+
+  if (!generate_key_derivation( txPublicKey, viewSecretKey, derivation)) {
+    return;
+  }
+
+  for (const auto& key : keys) {
+    checkOutputKey(derivation, key.key, key.keyIndex, key.outputIndex, spendKeys, outputs);
+  }
+}
+
+// shared by all consumers, so wallets with many view keys do not multiply the scanning threads;
+// the calling thread takes a share of each batch as well
+Tools::ThreadPool& getScanningPool() {
+  static Tools::ThreadPool pool(std::max<size_t>(std::thread::hardware_concurrency(), 2) - 1);
+  return pool;
 }
 
 std::vector<Crypto::Hash> getBlockHashes(const CryptoNote::CompleteBlock* blocks, size_t count) {
@@ -118,7 +146,7 @@ std::vector<Crypto::Hash> getBlockHashes(const CryptoNote::CompleteBlock* blocks
 namespace CryptoNote {
 
 TransfersConsumer::TransfersConsumer(const CryptoNote::Currency& currency, INode& node, Logging::ILogger& logger, const SecretKey& viewSecret) :
-  m_node(node), m_viewSecret(viewSecret), m_currency(currency), m_logger(logger, "TransfersConsumer") {
+  m_node(node), m_viewSecret(viewSecret), m_currency(currency), m_logger(logger, "TransfersConsumer"), m_spendIndexValid(false) {
   updateSyncStart();
 }
 
@@ -132,6 +160,7 @@ ITransfersSubscription& TransfersConsumer::addSubscription(const AccountSubscrip
   if (res.get() == nullptr) {
     res.reset(new TransfersSubscription(m_currency, subscription));
     m_spendKeys.insert(subscription.keys.address.spendPublicKey);
+    m_spendIndexValid = false;
     updateSyncStart();
   }
 
@@ -200,106 +229,74 @@ bool TransfersConsumer::onNewBlocks(const CompleteBlock* blocks, uint32_t startH
   assert(blocks);
   assert(count > 0);
 
-  struct Tx {
+  struct PreprocessedTx : PreprocessInfo {
     TransactionBlockInfo blockInfo;
     const ITransactionReader* tx;
   };
 
-  struct PreprocessedTx : Tx, PreprocessInfo {};
-
+  // collected in block order, so the results need no sorting afterwards
   std::vector<PreprocessedTx> preprocessedTransactions;
-  std::mutex preprocessedTransactionsMutex;
 
-  size_t workers = std::thread::hardware_concurrency();
-  if (workers == 0) {
-    workers = 2;
-  }
+  for (uint32_t i = 0; i < count; ++i) {
+    const auto& block = blocks[i].block;
 
-  BlockingQueue<Tx> inputQueue(workers * 2);
-
-  std::atomic<bool> stopProcessing(false);
-
-  auto pushingThread = std::async(std::launch::async, [&] {
-    for( uint32_t i = 0; i < count && !stopProcessing; ++i) {
-      const auto& block = blocks[i].block;
+    if (!block.is_initialized()) {
+      continue;
+    }
 
-      if (!block.is_initialized()) {
-        continue;
-      }
+    // filter by syncStartTimestamp
+    if (m_syncStart.timestamp && block->timestamp < m_syncStart.timestamp) {
+      continue;
+    }
 
-      // filter by syncStartTimestamp
-      if (m_syncStart.timestamp && block->timestamp < m_syncStart.timestamp) {
-        continue;
+    TransactionBlockInfo blockInfo;
+    blockInfo.height = startHeight + i;
+    blockInfo.timestamp = block->timestamp;
+    blockInfo.transactionIndex = 0; // position in block
+
+    for (const auto& tx : blocks[i].transactions) {
+      auto pubKey = tx->getTransactionPublicKey();
+      if (pubKey != NULL_PUBLIC_KEY) {
+        preprocessedTransactions.emplace_back();
+        preprocessedTransactions.back().blockInfo = blockInfo;
+        preprocessedTransactions.back().tx = tx.get();
       }
 
-      TransactionBlockInfo blockInfo;
-      blockInfo.height = startHeight + i;
-      blockInfo.timestamp = block->timestamp;
-      blockInfo.transactionIndex = 0; // position in block
-
-      for (const auto& tx : blocks[i].transactions) {
-        auto pubKey = tx->getTransactionPublicKey();
-        if (pubKey == NULL_PUBLIC_KEY) {
-          ++blockInfo.transactionIndex;
-          continue;
-        }
-
-        Tx item = { blockInfo, tx.get() };
-        inputQueue.push(item);
-        ++blockInfo.transactionIndex;
-      }
+      ++blockInfo.transactionIndex;
     }
+  }
 
-    inputQueue.close();
-  });
+  std::vector<std::error_code> errors(preprocessedTransactions.size());
+  std::atomic<bool> stopProcessing(false);
 
-  auto processingFunction = [&] {
-    Tx item;
-    std::error_code ec;
-    while (!stopProcessing && inputQueue.pop(item)) {
-      PreprocessedTx output;
-      static_cast<Tx&>(output) = item;
+  std::error_code processingError;
+  try {
+    getScanningPool().parallelFor(preprocessedTransactions.size(), [&](size_t i) {
+      if (stopProcessing) {
+        return;
+      }
 
-      ec = preprocessOutputs(item.blockInfo, *item.tx, output);
-      if (ec) {
+      auto& item = preprocessedTransactions[i];
+      errors[i] = preprocessOutputs(item.blockInfo, *item.tx, item);
+      if (errors[i]) {
         stopProcessing = true;
-        break;
       }
+    });
 
-      std::lock_guard<std::mutex> lk(preprocessedTransactionsMutex);
-      preprocessedTransactions.push_back(std::move(output));
-    }
-    return ec;
-  };
-
-  std::vector<std::future<std::error_code>> processingThreads;
-  for (size_t i = 0; i < workers; ++i) {
-    processingThreads.push_back(std::async(std::launch::async, processingFunction));
-  }
-
-  std::error_code processingError;
-  for (auto& f : processingThreads) {
-    try {
-      std::error_code ec = f.get();
-      if (!processingError && ec) {
-        processingError = ec;
-      }
-    } catch (const std::system_error& e) {
-      processingError = e.code();
-    } catch (const std::exception&) {
-      processingError = std::make_error_code(std::errc::operation_canceled);
+    auto it = std::find_if(errors.begin(), errors.end(), [](const std::error_code& ec) { return static_cast<bool>(ec); });
+    if (it != errors.end()) {
+      processingError = *it;
     }
+  } catch (const std::system_error& e) {
+    processingError = e.code();
+  } catch (const std::exception&) {
+    processingError = std::make_error_code(std::errc::operation_canceled);
   }
 
   std::vector<Crypto::Hash> blockHashes = getBlockHashes(blocks, count);
   if (!processingError) {
     m_observerManager.notify(&IBlockchainConsumerObserver::onBlocksAdded, this, blockHashes);
 
-    // sort by block height and transaction index in block
-    std::sort(preprocessedTransactions.begin(), preprocessedTransactions.end(), [](const PreprocessedTx& a, const PreprocessedTx& b) {
-      return std::tie(a.blockInfo.height, a.blockInfo.transactionIndex) < std::tie(b.blockInfo.height, b.blockInfo.transactionIndex);
-    });
-
     for (const auto& tx : preprocessedTransactions) {
       processTransaction(tx.blockInfo, *tx.tx, tx);
     }
@@ -341,10 +338,7 @@ std::error_code TransfersConsumer::onPoolUpdated(const std::vector<std::unique_p
     m_poolTxs.erase(deletedTxHash);
 
     m_observerManager.notify(&IBlockchainConsumerObserver::onTransactionDeleteBegin, this, deletedTxHash);
-    for (auto& sub : m_subscriptions) {
-      sub.second->deleteUnconfirmedTransaction(*reinterpret_cast<const Hash*>(&deletedTxHash));
-    }
-
+    deleteUnconfirmedTransaction(deletedTxHash);
     m_observerManager.notify(&IBlockchainConsumerObserver::onTransactionDeleteEnd, this, deletedTxHash);
   }
 
@@ -366,12 +360,30 @@ std::error_code TransfersConsumer::addUnconfirmedTransaction(const ITransactionR
 
 void TransfersConsumer::removeUnconfirmedTransaction(const Crypto::Hash& transactionHash) {
   m_observerManager.notify(&IBlockchainConsumerObserver::onTransactionDeleteBegin, this, transactionHash);
-  for (auto& subscription : m_subscriptions) {
-    subscription.second->deleteUnconfirmedTransaction(transactionHash);
-  }
+  deleteUnconfirmedTransaction(transactionHash);
   m_observerManager.notify(&IBlockchainConsumerObserver::onTransactionDeleteEnd, this, transactionHash);
 }
 
+void TransfersConsumer::deleteUnconfirmedTransaction(const Crypto::Hash& transactionHash) {
+  // the set of unconfirmed transactions is only current while the spend index is, e.g. not right after a load
+  if (!m_spendIndexValid) {
+    rebuildSpendIndex();
+  }
+
+  if (m_unconfirmedTransactions.erase(transactionHash) != 0) {
+    for (auto& subscription : m_subscriptions) {
+      subscription.second->deleteUnconfirmedTransaction(transactionHash);
+    }
+
+    // outputs the transaction spent are available again
+    m_spendIndexValid = false;
+  }
+}
+
+void TransfersConsumer::invalidateSpendIndex() {
+  m_spendIndexValid = false;
+}
+
 void TransfersConsumer::addPublicKeysSeen(const Crypto::Hash& transactionHash, const Crypto::PublicKey& outputKey) {
     std::lock_guard<std::mutex> lk(seen_mutex);
     transactions_hash_seen.insert(transactionHash);
@@ -547,24 +559,109 @@ void TransfersConsumer::processTransaction(const TransactionBlockInfo& blockInfo
   std::vector<TransactionOutputInformationIn> emptyOutputs;
   std::vector<ITransfersContainer*> transactionContainers;
   bool someContainerUpdated = false;
-  for (auto& kv : m_subscriptions) {
-    auto it = info.outputs.find(kv.first);
+  for (auto sub : getAffectedSubscriptions(tx, info)) {
+    auto it = info.outputs.find(sub->getKeys().address.spendPublicKey);
     auto& subscriptionOutputs = (it == info.outputs.end()) ? emptyOutputs : it->second;
 
     bool containerContainsTx;
     bool containerUpdated;
-    processOutputs(blockInfo, *kv.second, tx, subscriptionOutputs, info.globalIdxs, containerContainsTx, containerUpdated);
+    processOutputs(blockInfo, *sub, tx, subscriptionOutputs, info.globalIdxs, containerContainsTx, containerUpdated);
     someContainerUpdated = someContainerUpdated || containerUpdated;
     if (containerContainsTx) {
-      transactionContainers.emplace_back(&kv.second->getContainer());
+      transactionContainers.emplace_back(&sub->getContainer());
     }
   }
 
+  updateSpendIndex(blockInfo, tx, info, !transactionContainers.empty());
+
   if (someContainerUpdated) {
     m_observerManager.notify(&IBlockchainConsumerObserver::onTransactionUpdated, this, tx.getTransactionHash(), transactionContainers);
   }
 }
 
+// Only subscriptions receiving outputs, spending a known key image or already holding the transaction
+// can be changed by it, so with many subscriptions the others are not visited at all.
+std::vector<TransfersSubscription*> TransfersConsumer::getAffectedSubscriptions(const ITransactionReader& tx, const PreprocessInfo& info) {
+  if (!m_spendIndexValid) {
+    rebuildSpendIndex();
+  }
+
+  std::vector<TransfersSubscription*> subscriptions;
+  bool allAffected = m_unconfirmedTransactions.count(tx.getTransactionHash()) != 0;
+
+  std::unordered_set<PublicKey> spendKeys;
+  for (const auto& kv : info.outputs) {
+    spendKeys.insert(kv.first);
+  }
+
+  size_t inputCount = tx.getInputCount();
+  for (size_t i = 0; i < inputCount && !allAffected; ++i) {
+    auto inputType = tx.getInputType(i);
+    if (inputType == TransactionTypes::InputType::Key) {
+      KeyInput input;
+      tx.getInput(i, input);
+      auto it = m_keyImages.find(input.keyImage);
+      if (it != m_keyImages.end()) {
+        spendKeys.insert(it->second);
+      }
+    } else if (inputType == TransactionTypes::InputType::Multisignature) {
+      // multisignature inputs refer to global output indices, which are not indexed
+      allAffected = true;
+    }
+  }
+
+  if (allAffected) {
+    subscriptions.reserve(m_subscriptions.size());
+    for (const auto& kv : m_subscriptions) {
+      subscriptions.push_back(kv.second.get());
+    }
+  } else {
+    for (const auto& spendKey : spendKeys) {
+      auto it = m_subscriptions.find(spendKey);
+      if (it != m_subscriptions.end()) {
+        subscriptions.push_back(it->second.get());
+      }
+    }
+  }
+
+  return subscriptions;
+}
+
+void TransfersConsumer::updateSpendIndex(const TransactionBlockInfo& blockInfo, const ITransactionReader& tx, const PreprocessInfo& info, bool added) {
+  for (const auto& kv : info.outputs) {
+    for (const auto& output : kv.second) {
+      if (output.type == TransactionTypes::OutputType::Key) {
+        m_keyImages[output.keyImage] = kv.first;
+      }
+    }
+  }
+
+  if (blockInfo.height != WALLET_UNCONFIRMED_TRANSACTION_HEIGHT) {
+    m_unconfirmedTransactions.erase(tx.getTransactionHash());
+  } else if (added) {
+    m_unconfirmedTransactions.insert(tx.getTransactionHash());
+  }
+}
+
+void TransfersConsumer::rebuildSpendIndex() {
+  m_keyImages.clear();
+  m_unconfirmedTransactions.clear();
+
+  for (const auto& kv : m_subscriptions) {
+    std::vector<KeyImage> keyImages;
+    kv.second->getKeyImages(keyImages);
+    for (const auto& keyImage : keyImages) {
+      m_keyImages[keyImage] = kv.first;
+    }
+
+    std::vector<Crypto::Hash> unconfirmedTransactions;
+    kv.second->getContainer().getUnconfirmedTransactions(unconfirmedTransactions);
+    m_unconfirmedTransactions.insert(unconfirmedTransactions.begin(), unconfirmedTransactions.end());
+  }
+
+  m_spendIndexValid = true;
+}
+
 void TransfersConsumer::processOutputs(const TransactionBlockInfo& blockInfo, TransfersSubscription& sub, const ITransactionReader& tx,
   const std::vector<TransactionOutputInformationIn>& transfers, const std::vector<uint32_t>& globalIdxs, bool& contains, bool& updated) {
 
@@ -46,6 +46,8 @@ public:
 
   void initTransactionPool(const std::unordered_set<Crypto::Hash>& uncommitedTransactions);
   void addPublicKeysSeen(const Crypto::Hash& transactionHash, const Crypto::PublicKey& outputKey);
+  // to be called when subscription containers were changed bypassing the consumer, e.g. loaded from a cache
+  void invalidateSpendIndex();
   
   // IBlockchainConsumer
   virtual SynchronizationStart getSyncStart() override;
@@ -79,6 +81,11 @@ private:
 
   std::error_code getGlobalIndices(const Crypto::Hash& transactionHash, std::vector<uint32_t>& outsGlobalIndices);
 
+  std::vector<TransfersSubscription*> getAffectedSubscriptions(const ITransactionReader& tx, const PreprocessInfo& info);
+  void updateSpendIndex(const TransactionBlockInfo& blockInfo, const ITransactionReader& tx, const PreprocessInfo& info, bool added);
+  void rebuildSpendIndex();
+  void deleteUnconfirmedTransaction(const Crypto::Hash& transactionHash);
+
   void updateSyncStart();
 
   SynchronizationStart m_syncStart;
@@ -87,6 +94,11 @@ private:
   std::unordered_map<Crypto::PublicKey, std::unique_ptr<TransfersSubscription>> m_subscriptions;
   std::unordered_set<Crypto::PublicKey> m_spendKeys;
   std::unordered_set<Crypto::Hash> m_poolTxs;
+  // key image of every owned output -> spend public key of its subscription
+  std::unordered_map<Crypto::KeyImage, Crypto::PublicKey> m_keyImages;
+  // transactions held by some subscription as unconfirmed
+  std::unordered_set<Crypto::Hash> m_unconfirmedTransactions;
+  bool m_spendIndexValid;
 
   INode& m_node;
   const CryptoNote::Currency& m_currency;
@@ -789,6 +789,21 @@ std::vector<TransactionOutputInformation> TransfersContainer::getTransactionInpu
   return result;
 }
 
+void TransfersContainer::getKeyImages(std::vector<Crypto::KeyImage>& keyImages) const {
+  std::lock_guard<std::mutex> lk(m_mutex);
+  for (const auto& t : m_availableTransfers) {
+    if (t.type == TransactionTypes::OutputType::Key) {
+      keyImages.push_back(t.keyImage);
+    }
+  }
+
+  for (const auto& t : m_unconfirmedTransfers) {
+    if (t.type == TransactionTypes::OutputType::Key) {
+      keyImages.push_back(t.keyImage);
+    }
+  }
+}
+
 void TransfersContainer::getUnconfirmedTransactions(std::vector<Crypto::Hash>& transactions) const {
   std::lock_guard<std::mutex> lk(m_mutex);
   transactions.clear();
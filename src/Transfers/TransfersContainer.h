@@ -207,6 +207,8 @@ public:
   void detach(uint32_t height, std::vector<Crypto::Hash>& deletedTransactions, std::vector<TransactionOutputInformation>& lockedTransfers);
   //returns outputs that are being unlocked
   std::vector<TransactionOutputInformation> advanceHeight(uint32_t height);
+  //key images of the key outputs that still can be spent
+  void getKeyImages(std::vector<Crypto::KeyImage>& keyImages) const;
 
   // ITransfersContainer
   virtual size_t transfersCount() const override;
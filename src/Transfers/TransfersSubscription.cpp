@@ -102,4 +102,8 @@ void TransfersSubscription::markTransactionConfirmed(const TransactionBlockInfo&
   m_observerManager.notify(&ITransfersObserver::onTransactionUpdated, this, transactionHash);
 }
 
+void TransfersSubscription::getKeyImages(std::vector<Crypto::KeyImage>& keyImages) const {
+  transfers.getKeyImages(keyImages);
+}
+
 }
@@ -293,6 +293,8 @@ void TransfersSyncronizer::load(std::istream& is) {
           s.endObject();
         }
         s.endArray();
+
+        subIter->second->invalidateSpendIndex();
       }
     }
 
@@ -307,6 +309,7 @@ void TransfersSyncronizer::load(std::istream& is) {
       for (const auto& sub : consumerState.subscriptionStates) {
         setObjectState(consumer->getSubscription(sub.first)->getContainer(), sub.second);
       }
+      consumer->invalidateSpendIndex();
     }
     throw;
   }
@@ -157,7 +157,7 @@ TEST(BlockingQueue, CloseAndWait)
   std::atomic<size_t> itemsPopped(0);
 
   // fill the queue
-  for (int i = 0; i < queueSize; ++i)
+  for (size_t i = 0; i < queueSize; ++i)
     bq.push(i); 
 
   p.spawn([&bq, &itemsPopped] {
@@ -0,0 +1,97 @@
+// Copyright (c) 2011-2016 The Cryptonote developers
+// Copyright (c) 2014-2016 SDN developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <gtest/gtest.h>
+#include "HTTP/HttpParser.h"
+#include "HTTP/HttpParserErrorCodes.h"
+
+#include <string>
+#include <system_error>
+
+using namespace CryptoNote;
+
+namespace {
+
+const std::string GET_INFO_REQUEST =
+  "GET /getinfo HTTP/1.1\r\n"
+  "Host: 127.0.0.1\r\n"
+  "\r\n";
+
+const std::string JSON_RPC_REQUEST =
+  "POST /json_rpc HTTP/1.1\r\n"
+  "Content-Type: application/json\r\n"
+  "Content-Length: 17\r\n"
+  "\r\n"
+  "{\"method\":\"test\"}";
+
+}
+
+TEST(HttpParser, ParseRequestReadsWholeRequest) {
+  HttpRequest request;
+
+  ASSERT_EQ(JSON_RPC_REQUEST.size(), HttpParser::parseRequest(JSON_RPC_REQUEST.data(), JSON_RPC_REQUEST.size(), request));
+  ASSERT_EQ("POST", request.getMethod());
+  ASSERT_EQ("/json_rpc", request.getUrl());
+  ASSERT_EQ(2, request.getHeaders().size());
+  ASSERT_EQ("application/json", request.getHeaders().at("content-type"));
+  ASSERT_EQ("17", request.getHeaders().at("content-length"));
+  ASSERT_EQ("{\"method\":\"test\"}", request.getBody());
+}
+
+TEST(HttpParser, ParseRequestWaitsForRequestSplitAcrossReads) {
+  for (size_t received = 0; received < JSON_RPC_REQUEST.size(); ++received) {
+    HttpRequest request;
+    ASSERT_EQ(0, HttpParser::parseRequest(JSON_RPC_REQUEST.data(), received, request)) << "received " << received;
+  }
+
+  HttpRequest request;
+  ASSERT_EQ(JSON_RPC_REQUEST.size(), HttpParser::parseRequest(JSON_RPC_REQUEST.data(), JSON_RPC_REQUEST.size(), request));
+  ASSERT_EQ("{\"method\":\"test\"}", request.getBody());
+}
+
+TEST(HttpParser, ParseRequestLeavesPipelinedRequestInBuffer) {
+  std::string buffer = JSON_RPC_REQUEST + GET_INFO_REQUEST + "GET /get";
+
+  HttpRequest first;
+  size_t firstSize = HttpParser::parseRequest(buffer.data(), buffer.size(), first);
+  ASSERT_EQ(JSON_RPC_REQUEST.size(), firstSize);
+  ASSERT_EQ("/json_rpc", first.getUrl());
+
+  HttpRequest second;
+  size_t secondSize = HttpParser::parseRequest(buffer.data() + firstSize, buffer.size() - firstSize, second);
+  ASSERT_EQ(GET_INFO_REQUEST.size(), secondSize);
+  ASSERT_EQ("GET", second.getMethod());
+  ASSERT_EQ("/getinfo", second.getUrl());
+  ASSERT_TRUE(second.getBody().empty());
+
+  HttpRequest third;
+  ASSERT_EQ(0, HttpParser::parseRequest(buffer.data() + firstSize + secondSize, buffer.size() - firstSize - secondSize, third));
+}
+
+TEST(HttpParser, ParseRequestWaitsForLargeIncompleteHeaders) {
+  std::string head = "GET /getinfo HTTP/1.1\r\nX-Padding: " + std::string(60 * 1024, 'a');
+  HttpRequest request;
+
+  ASSERT_EQ(0, HttpParser::parseRequest(head.data(), head.size(), request));
+}
+
+TEST(HttpParser, ParseRequestRejectsTooLargeHeaders) {
+  std::string head = "GET /getinfo HTTP/1.1\r\nX-Padding: " + std::string(64 * 1024, 'a');
+  HttpRequest request;
+
+  try {
+    HttpParser::parseRequest(head.data(), head.size(), request);
+    FAIL() << "headers larger than the limit were accepted";
+  } catch (std::system_error& e) {
+    ASSERT_EQ(make_error_code(error::HttpParserErrorCodes::HEADERS_TOO_LARGE), e.code());
+  }
+}
+
+TEST(HttpParser, ParseRequestRejectsHeaderWithoutColon) {
+  std::string buffer = "GET /getinfo HTTP/1.1\r\nHost\r\n\r\n";
+  HttpRequest request;
+
+  ASSERT_THROW(HttpParser::parseRequest(buffer.data(), buffer.size(), request), std::system_error);
+}
@@ -8,6 +8,7 @@
 #include <cstdint>
 #include <unordered_map>
 
+#include "Common/ThreadPool.h"
 #include "CryptoNoteCore/CryptoNoteBasic.h"
 #include "CryptoNoteCore/ICore.h"
 #include "CryptoNoteCore/ICoreObserver.h"
@@ -53,6 +54,7 @@ public:
   virtual void pause_mining() override {}
   virtual void update_block_template_and_resume_mining() override {}
   virtual bool handle_incoming_block_blob(const CryptoNote::BinaryArray& block_blob, CryptoNote::block_verification_context& bvc, bool control_miner, bool relay_block) override { return false; }
+  virtual void precomputeProofOfWork(const std::vector<const CryptoNote::Block*>& blocks) override {}
   virtual bool handle_get_objects(CryptoNote::NOTIFY_REQUEST_GET_OBJECTS::request& arg, CryptoNote::NOTIFY_RESPONSE_GET_OBJECTS::request& rsp) override { return false; }
   virtual void on_synchronized() override {}
   virtual bool getOutByMSigGIndex(uint64_t amount, uint64_t gindex, CryptoNote::MultisignatureOutput& out) override { return true; }
@@ -79,7 +81,9 @@ public:
   virtual bool getTransactionsByPaymentId(const Crypto::Hash& paymentId, std::vector<CryptoNote::Transaction>& transactions) override;
   virtual std::unique_ptr<CryptoNote::IBlock> getBlock(const Crypto::Hash& blockId) override;
   virtual bool handleIncomingTransaction(const CryptoNote::Transaction& tx, const Crypto::Hash& txHash, size_t blobSize, CryptoNote::tx_verification_context& tvc, bool keptByBlock, uint32_t height) override;
+  virtual void handleIncomingTransactions(const std::vector<CryptoNote::BinaryArray>& transactionBlobs, std::vector<CryptoNote::tx_verification_context>& tvcs) override { tvcs.resize(transactionBlobs.size()); }
   virtual std::error_code executeLocked(const std::function<std::error_code()>& func) override;
+  virtual Tools::ThreadPool& getWorkerPool() override { return workerPool; }
 
   virtual bool addMessageQueue(CryptoNote::MessageQueue<CryptoNote::BlockchainMessage>& messageQueuePtr) override;
   virtual bool removeMessageQueue(CryptoNote::MessageQueue<CryptoNote::BlockchainMessage>& messageQueuePtr) override;
@@ -116,4 +120,6 @@ private:
   std::unordered_map<Crypto::Hash, CryptoNote::Transaction> transactionPool;
   bool poolTxVerificationResult;
   bool poolChangesResult;
+
+  Tools::ThreadPool workerPool;
 };
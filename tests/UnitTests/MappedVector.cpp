@@ -0,0 +1,134 @@
+// Copyright (c) 2011-2016 The Cryptonote developers
+// Copyright (c) 2014-2016 SDN developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <gtest/gtest.h>
+#include "CryptoNoteCore/MappedVector.h"
+
+#include <cstdint>
+#include <thread>
+
+#include <boost/filesystem.hpp>
+
+namespace {
+
+struct Item {
+  uint64_t value;
+};
+
+void serialize(Item& item, CryptoNote::ISerializer& s) {
+  s(item.value, "value");
+}
+
+class MappedVectorTest : public ::testing::Test {
+public:
+  MappedVectorTest() :
+    m_dir(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("test_data_%%%%%%%%%%%%")) {
+    boost::filesystem::create_directories(m_dir);
+  }
+
+  ~MappedVectorTest() {
+    m_vector.close();
+    boost::filesystem::remove_all(m_dir);
+  }
+
+  bool open(size_t poolSize) {
+    return m_vector.open((m_dir / "items.dat").string(), (m_dir / "indexes.dat").string(), poolSize);
+  }
+
+  void push(uint64_t value) {
+    m_vector.push_back(Item{ value });
+  }
+
+  // Reads on a thread of its own, so the read goes through a cache other than the test thread's.
+  uint64_t readOnOtherThread(uint64_t index) {
+    uint64_t value = 0;
+    std::thread([this, index, &value] { value = m_vector[index].value; }).join();
+    return value;
+  }
+
+protected:
+  boost::filesystem::path m_dir;
+  MappedVector<Item> m_vector;
+};
+
+}
+
+TEST_F(MappedVectorTest, pushedItemsAreReadBack) {
+  ASSERT_TRUE(open(4));
+  for (uint64_t i = 0; i < 10; ++i) {
+    push(i);
+  }
+
+  ASSERT_EQ(10, m_vector.size());
+  for (uint64_t i = 0; i < 10; ++i) {
+    ASSERT_EQ(i, m_vector[i].value);
+  }
+}
+
+TEST_F(MappedVectorTest, itemReplacedAfterPopIsReadBack) {
+  ASSERT_TRUE(open(4));
+  push(1);
+  push(2);
+  ASSERT_EQ(2, m_vector[1].value);
+
+  m_vector.pop_back();
+  push(3);
+
+  ASSERT_EQ(3, m_vector[1].value);
+  ASSERT_EQ(3, m_vector.back().value);
+}
+
+TEST_F(MappedVectorTest, itemReplacedAfterPopIsReadBackByOtherThread) {
+  ASSERT_TRUE(open(4));
+  push(1);
+  push(2);
+
+  // a thread caching the popped item must not see it once another one has been pushed in its place
+  std::thread reader([this] {
+    ASSERT_EQ(2, m_vector[1].value);
+    m_vector.pop_back();
+  });
+  reader.join();
+
+  ASSERT_EQ(1, readOnOtherThread(0));
+  ASSERT_EQ(1, m_vector.size());
+  push(3);
+  ASSERT_EQ(3, m_vector[1].value);
+  ASSERT_EQ(3, readOnOtherThread(1));
+}
+
+TEST_F(MappedVectorTest, itemReplacedAfterClearIsReadBack) {
+  ASSERT_TRUE(open(4));
+  push(1);
+  ASSERT_EQ(1, m_vector[0].value);
+  ASSERT_EQ(1, readOnOtherThread(0));
+
+  m_vector.clear();
+  push(2);
+
+  ASSERT_EQ(2, m_vector[0].value);
+  ASSERT_EQ(2, readOnOtherThread(0));
+}
+
+TEST_F(MappedVectorTest, recentReferencesStayValidWhileOtherThreadsRead) {
+  ASSERT_TRUE(open(MappedVector<Item>::minThreadCacheSize));
+  for (uint64_t i = 0; i < 2 * MappedVector<Item>::minThreadCacheSize; ++i) {
+    push(i);
+  }
+
+  const Item& first = m_vector[0];
+  const Item& second = m_vector[1];
+
+  std::thread reader([this] {
+    for (uint64_t i = 0; i < m_vector.size(); ++i) {
+      ASSERT_EQ(i, m_vector[i].value);
+    }
+  });
+  reader.join();
+
+  ASSERT_EQ(0, first.value);
+  ASSERT_EQ(1, second.value);
+  ASSERT_EQ(&first, &m_vector[0]);
+}
@@ -0,0 +1,105 @@
+// Copyright (c) 2011-2016 The Cryptonote developers
+// Copyright (c) 2014-2016 SDN developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <gtest/gtest.h>
+#include "Common/RecursiveSharedMutex.h"
+
+#include <atomic>
+#include <chrono>
+#include <shared_mutex>
+#include <stdexcept>
+#include <thread>
+
+using namespace Tools;
+
+namespace {
+
+void waitUntil(const std::atomic<bool>& flag) {
+  while (!flag) {
+    std::this_thread::yield();
+  }
+}
+
+}
+
+TEST(RecursiveSharedMutex, SharedReentryDoesNotWaitForQueuedWriter) {
+  RecursiveSharedMutex mutex;
+  std::shared_lock<RecursiveSharedMutex> outer(mutex);
+
+  std::atomic<bool> writerStarted(false);
+  std::atomic<bool> writerLocked(false);
+  std::thread writer([&] {
+    writerStarted = true;
+    std::unique_lock<RecursiveSharedMutex> lock(mutex);
+    writerLocked = true;
+  });
+
+  waitUntil(writerStarted);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  {
+    std::shared_lock<RecursiveSharedMutex> nested(mutex);
+    EXPECT_FALSE(writerLocked);
+  }
+
+  outer.unlock();
+  writer.join();
+  ASSERT_TRUE(writerLocked);
+}
+
+TEST(RecursiveSharedMutex, QueuedWriterBlocksNewReaders) {
+  RecursiveSharedMutex mutex;
+  std::shared_lock<RecursiveSharedMutex> outer(mutex);
+
+  std::atomic<bool> writerStarted(false);
+  std::thread writer([&] {
+    writerStarted = true;
+    std::unique_lock<RecursiveSharedMutex> lock(mutex);
+  });
+
+  waitUntil(writerStarted);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  std::atomic<bool> readerLocked(false);
+  std::thread reader([&] {
+    std::shared_lock<RecursiveSharedMutex> lock(mutex);
+    readerLocked = true;
+  });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(readerLocked);
+
+  outer.unlock();
+  writer.join();
+  reader.join();
+  ASSERT_TRUE(readerLocked);
+}
+
+TEST(RecursiveSharedMutex, ExclusiveOwnerMayRelock) {
+  RecursiveSharedMutex mutex;
+  std::unique_lock<RecursiveSharedMutex> outer(mutex);
+  {
+    std::unique_lock<RecursiveSharedMutex> exclusive(mutex);
+    std::shared_lock<RecursiveSharedMutex> shared(mutex);
+  }
+
+  outer.unlock();
+
+  std::atomic<bool> locked(false);
+  std::thread other([&] {
+    std::unique_lock<RecursiveSharedMutex> lock(mutex);
+    locked = true;
+  });
+
+  other.join();
+  ASSERT_TRUE(locked);
+}
+
+TEST(RecursiveSharedMutex, UpgradeThrows) {
+  RecursiveSharedMutex mutex;
+  std::shared_lock<RecursiveSharedMutex> shared(mutex);
+
+  ASSERT_THROW(mutex.lock(), std::logic_error);
+}
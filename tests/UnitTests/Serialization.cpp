@@ -7,13 +7,151 @@
 
 #include "Common/StdInputStream.h"
 #include "Common/StdOutputStream.h"
+#include "crypto/crypto.h"
+#include "crypto/hash.h"
+#include "CryptoNoteConfig.h"
+#include "CryptoNoteCore/CryptoNoteSerialization.h"
+#include "CryptoNoteCore/CryptoNoteTools.h"
+#include "CryptoNoteCore/TransactionExtra.h"
+#include "Rpc/JsonRpc.h"
 #include "Serialization/BinaryInputStreamSerializer.h"
 #include "Serialization/BinaryOutputStreamSerializer.h"
 #include "Serialization/BinarySerializationTools.h"
+#include "Serialization/SerializationOverloads.h"
+#include "Serialization/SerializationTools.h"
+
+#include <limits>
 
 using namespace Common;
 using namespace CryptoNote;
 
+namespace {
+
+struct JsonTestItem {
+  std::string name;
+  uint64_t amount;
+
+  void serialize(ISerializer& s) {
+    KV_MEMBER(name)
+    KV_MEMBER(amount)
+  }
+
+  bool operator==(const JsonTestItem& other) const {
+    return name == other.name && amount == other.amount;
+  }
+};
+
+struct JsonTestDocument {
+  int64_t minInt;
+  int64_t maxInt;
+  uint64_t maxUint;
+  uint32_t maxUint32;
+  bool flag;
+  std::string escaped;
+  Crypto::Hash hash;
+  JsonTestItem inner;
+  std::vector<JsonTestItem> items;
+  std::vector<std::vector<uint32_t>> matrix;
+
+  void serialize(ISerializer& s) {
+    KV_MEMBER(minInt)
+    KV_MEMBER(maxInt)
+    KV_MEMBER(maxUint)
+    KV_MEMBER(maxUint32)
+    KV_MEMBER(flag)
+    KV_MEMBER(escaped)
+    KV_MEMBER(hash)
+    KV_MEMBER(inner)
+    KV_MEMBER(items)
+    KV_MEMBER(matrix)
+  }
+};
+
+JsonTestDocument createJsonTestDocument() {
+  JsonTestDocument document;
+  document.minInt = std::numeric_limits<int64_t>::min();
+  document.maxInt = std::numeric_limits<int64_t>::max();
+  document.maxUint = std::numeric_limits<uint64_t>::max();
+  document.maxUint32 = std::numeric_limits<uint32_t>::max();
+  document.flag = true;
+  // strings are written and read back as JSON text, escapes included, like JsonValue does
+  document.escaped = "quote \\\" backslash \\\\ newline \\n unicode \\u00e9 }]";
+  document.hash = Crypto::rand<Crypto::Hash>();
+  document.inner = { "inner", 0 };
+  document.items = { { "first", 1 }, { "", 2 }, { "third", std::numeric_limits<uint64_t>::max() } };
+  document.matrix = { {}, { 1 }, { 2, 3, std::numeric_limits<uint32_t>::max() } };
+  return document;
+}
+
+// every input and output type, with varints of one to ten bytes
+Transaction createSizeTestTransaction() {
+  Transaction tx;
+  tx.version = TRANSACTION_VERSION_1;
+  tx.unlockTime = 0x123456789;
+
+  tx.inputs.push_back(BaseInput{ std::numeric_limits<uint32_t>::max() });
+  tx.inputs.push_back(KeyInput{ std::numeric_limits<uint64_t>::max(), { 0, 127, 128, std::numeric_limits<uint32_t>::max() },
+    Crypto::rand<Crypto::KeyImage>() });
+  tx.inputs.push_back(MultisignatureInput{ 1000, 3, 300, 0 });
+  // deposit
+  tx.inputs.push_back(MultisignatureInput{ 5000000000, 1, 7, 21900 });
+
+  tx.outputs.push_back(TransactionOutput{ 1, KeyOutput{ Crypto::rand<Crypto::PublicKey>() } });
+  tx.outputs.push_back(TransactionOutput{ 200, MultisignatureOutput{ { Crypto::rand<Crypto::PublicKey>(),
+    Crypto::rand<Crypto::PublicKey>(), Crypto::rand<Crypto::PublicKey>() }, 2, 0 } });
+  tx.outputs.push_back(TransactionOutput{ 5000000000, MultisignatureOutput{ { Crypto::rand<Crypto::PublicKey>() }, 1, 5000000 } });
+
+  tx.extra.resize(200);
+  for (auto& byte : tx.extra) {
+    byte = Crypto::rand<uint8_t>();
+  }
+
+  // one signature per key input offset and per multisignature input signature
+  for (size_t signatureCount : { 0, 4, 3, 1 }) {
+    tx.signatures.emplace_back(signatureCount);
+    for (auto& signature : tx.signatures.back()) {
+      signature = Crypto::rand<Crypto::Signature>();
+    }
+  }
+
+  return tx;
+}
+
+Block createSizeTestBlock(uint8_t majorVersion) {
+  Block block;
+  block.majorVersion = majorVersion;
+  block.minorVersion = 0;
+  block.nonce = 0x12345678;
+  block.timestamp = 1500000000;
+  block.previousBlockHash = Crypto::rand<Crypto::Hash>();
+  block.baseTransaction = createSizeTestTransaction();
+  block.transactionHashes = { Crypto::rand<Crypto::Hash>(), Crypto::rand<Crypto::Hash>() };
+
+  if (majorVersion >= BLOCK_MAJOR_VERSION_2) {
+    block.parentBlock.majorVersion = BLOCK_MAJOR_VERSION_1;
+    block.parentBlock.minorVersion = 0;
+    block.parentBlock.previousBlockHash = Crypto::rand<Crypto::Hash>();
+    block.parentBlock.transactionCount = 5;
+    block.parentBlock.baseTransactionBranch.resize(Crypto::tree_depth(block.parentBlock.transactionCount));
+    for (auto& hash : block.parentBlock.baseTransactionBranch) {
+      hash = Crypto::rand<Crypto::Hash>();
+    }
+
+    TransactionExtraMergeMiningTag mmTag;
+    mmTag.depth = 2;
+    mmTag.merkleRoot = Crypto::rand<Crypto::Hash>();
+    block.parentBlock.baseTransaction.version = TRANSACTION_VERSION_1;
+    block.parentBlock.baseTransaction.unlockTime = 0;
+    block.parentBlock.baseTransaction.inputs.push_back(BaseInput{ 1000000 });
+    appendMergeMiningTagToExtra(block.parentBlock.baseTransaction.extra, mmTag);
+    block.parentBlock.blockchainBranch = { Crypto::rand<Crypto::Hash>(), Crypto::rand<Crypto::Hash>() };
+  }
+
+  return block;
+}
+
+}
+
 TEST(BinarySerializer, uint16) {
 
   std::stringstream ss;
@@ -43,6 +181,171 @@ TEST(BinarySerializer, uint16) {
   }
 }
 
+TEST(BinaryCountingSerializer, transactionSizeMatchesBinaryArray) {
+  Transaction tx = createSizeTestTransaction();
+
+  BinaryArray blob;
+  ASSERT_TRUE(toBinaryArray(tx, blob));
+  ASSERT_EQ(blob.size(), getObjectBinarySize(tx));
+
+  TransactionPrefix& prefix = tx;
+  BinaryArray prefixBlob;
+  ASSERT_TRUE(toBinaryArray(prefix, prefixBlob));
+  ASSERT_EQ(prefixBlob.size(), getObjectBinarySize(prefix));
+
+  Transaction empty;
+  empty.version = TRANSACTION_VERSION_1;
+  empty.unlockTime = 0;
+  BinaryArray emptyBlob;
+  ASSERT_TRUE(toBinaryArray(empty, emptyBlob));
+  ASSERT_EQ(emptyBlob.size(), getObjectBinarySize(empty));
+}
+
+TEST(BinaryCountingSerializer, failsLikeBinaryArray) {
+  Transaction tx = createSizeTestTransaction();
+  tx.signatures[1].pop_back();
+
+  BinaryArray blob;
+  size_t size;
+  ASSERT_FALSE(toBinaryArray(tx, blob));
+  ASSERT_FALSE(getObjectBinarySize(tx, size));
+}
+
+TEST(BinaryCountingSerializer, blockHeaderSizeMatchesBinaryArray) {
+  for (uint8_t majorVersion : { BLOCK_MAJOR_VERSION_1, BLOCK_MAJOR_VERSION_2, BLOCK_MAJOR_VERSION_9 }) {
+    BlockHeader header = createSizeTestBlock(majorVersion);
+    BinaryArray blob;
+    ASSERT_TRUE(toBinaryArray(header, blob));
+    ASSERT_EQ(blob.size(), getObjectBinarySize(header)) << static_cast<int>(majorVersion);
+  }
+}
+
+TEST(BinaryCountingSerializer, blockSizeMatchesBinaryArray) {
+  for (uint8_t majorVersion : { BLOCK_MAJOR_VERSION_1, BLOCK_MAJOR_VERSION_2, BLOCK_MAJOR_VERSION_9 }) {
+    Block block = createSizeTestBlock(majorVersion);
+    BinaryArray blob;
+    ASSERT_TRUE(toBinaryArray(block, blob));
+    ASSERT_EQ(blob.size(), getObjectBinarySize(block)) << static_cast<int>(majorVersion);
+  }
+}
+
+TEST(JsonSerializer, roundTripKeepsNestedValues) {
+  JsonTestDocument document = createJsonTestDocument();
+  std::string json = storeToJson(document);
+
+  JsonTestDocument loaded;
+  ASSERT_TRUE(loadFromJson(loaded, json)) << json;
+  ASSERT_EQ(document.minInt, loaded.minInt);
+  ASSERT_EQ(document.maxInt, loaded.maxInt);
+  ASSERT_EQ(document.maxUint, loaded.maxUint);
+  ASSERT_EQ(document.maxUint32, loaded.maxUint32);
+  ASSERT_EQ(document.flag, loaded.flag);
+  ASSERT_EQ(document.escaped, loaded.escaped);
+  ASSERT_EQ(document.hash, loaded.hash);
+  ASSERT_EQ(document.inner, loaded.inner);
+  ASSERT_EQ(document.items, loaded.items);
+  ASSERT_EQ(document.matrix, loaded.matrix);
+
+  // the text stays readable by JsonValue
+  ASSERT_EQ(json, storeToJson(loaded));
+  ASSERT_NO_THROW(JsonValue::fromString(json));
+}
+
+TEST(JsonSerializer, outputKeepsSerializationOrder) {
+  JsonTestItem item = { "a", 1 };
+
+  ASSERT_EQ("{\"name\":\"a\",\"amount\":1}", storeToJson(item));
+}
+
+TEST(JsonSerializer, inputFindsMembersInAnyOrder) {
+  JsonTestItem item;
+
+  ASSERT_TRUE(loadFromJson(item, " { \"unknown\" : [ {}, \"}\" ], \"amount\" : 7 , \"name\" : \"b\" } \n"));
+  ASSERT_EQ("b", item.name);
+  ASSERT_EQ(7, item.amount);
+}
+
+TEST(JsonSerializer, inputReadsIntegerLimits) {
+  JsonTestDocument document;
+
+  ASSERT_TRUE(loadFromJson(document, "{\"minInt\":-9223372036854775808,\"maxInt\":9223372036854775807,\"maxUint\":-1,\"maxUint32\":4294967295}"));
+  ASSERT_EQ(std::numeric_limits<int64_t>::min(), document.minInt);
+  ASSERT_EQ(std::numeric_limits<int64_t>::max(), document.maxInt);
+  ASSERT_EQ(std::numeric_limits<uint64_t>::max(), document.maxUint);
+  ASSERT_EQ(std::numeric_limits<uint32_t>::max(), document.maxUint32);
+}
+
+TEST(JsonSerializer, inputRejectsTruncatedDocument) {
+  std::string json = storeToJson(createJsonTestDocument());
+
+  for (size_t size = 1; size < json.size(); ++size) {
+    JsonTestDocument document;
+    ASSERT_FALSE(loadFromJson(document, json.substr(0, size))) << json.substr(0, size);
+  }
+}
+
+TEST(JsonSerializer, inputRejectsMalformedDocument) {
+  const std::vector<std::string> documents = {
+    "   ",
+    "[]",
+    "\"name\"",
+    "{\"name\":\"a\",}",
+    "{\"name\" \"a\"}",
+    "{name:\"a\"}",
+    "{\"name\":\"a\" \"amount\":1}",
+    "{\"amount\":01}",
+    "{\"amount\":1..2}",
+    "{\"amount\":tru}",
+    "{\"amount\":[1,2}",
+    "{\"amount\":1}}",
+    "{\"amount\":1}x",
+    "{\"amount\":1}{}",
+    "{\"amount\":\"1\"}",
+    "{\"amount\":1.5}",
+    "{\"name\":1}",
+  };
+
+  for (const auto& json : documents) {
+    JsonTestItem item;
+    ASSERT_FALSE(loadFromJson(item, json)) << json;
+  }
+}
+
+TEST(JsonRpcResponse, readsErrorAndResultFromOneParse) {
+  JsonRpc::JsonRpcResponse response;
+  response.parse("{\"jsonrpc\":\"2.0\",\"result\":{\"name\":\"a\",\"amount\":1},\"id\":0}");
+
+  JsonRpc::JsonRpcError error;
+  ASSERT_FALSE(response.getError(error));
+
+  JsonTestItem item;
+  ASSERT_TRUE(response.getResult(item));
+  ASSERT_EQ("a", item.name);
+  ASSERT_EQ(1, item.amount);
+
+  JsonTestItem again;
+  ASSERT_TRUE(response.getResult(again));
+  ASSERT_EQ(item, again);
+}
+
+TEST(JsonRpcResponse, readsResultAfterFailedLookup) {
+  JsonRpc::JsonRpcResponse response;
+  response.parse("{\"error\":{\"code\":\"bad\"},\"result\":{\"name\":\"a\",\"amount\":1}}");
+
+  JsonRpc::JsonRpcError error;
+  ASSERT_ANY_THROW(response.getError(error));
+
+  JsonTestItem item;
+  ASSERT_TRUE(response.getResult(item));
+  ASSERT_EQ("a", item.name);
+}
+
+TEST(JsonRpcResponse, parseRejectsMalformedBody) {
+  JsonRpc::JsonRpcResponse response;
+
+  ASSERT_THROW(response.parse("{\"result\":{}"), JsonRpc::JsonRpcError);
+}
+
 
 //#include <cstring>
 //#include <cstdint>
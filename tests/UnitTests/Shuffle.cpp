@@ -22,7 +22,7 @@ public:
 
     std::unordered_set<size_t> values;
 
-    for (auto i = 0; i < count; ++i) {
+    for (size_t i = 0; i < count; ++i) {
       auto value = gen();
       bool inserted = values.insert(value).second;
       EXPECT_TRUE(inserted);
@@ -31,7 +31,7 @@ public:
 
   template <typename Gen>
   void consume(Gen& gen, size_t count) {
-    for (auto i = 0; i < count; ++i) {
+    for (size_t i = 0; i < count; ++i) {
       gen();
     }
   }
@@ -21,7 +21,7 @@ TEST(protocol_pack, protocol_pack_command)
 
     CryptoNote::NOTIFY_RESPONSE_CHAIN_ENTRY::request r2;
     CryptoNote::loadFromBinaryKeyValue(r2, buff);
-    ASSERT_TRUE(r.m_block_ids.size() == i);
+    ASSERT_TRUE(r.m_block_ids.size() == static_cast<size_t>(i));
     ASSERT_TRUE(r.start_height == 1);
     ASSERT_TRUE(r.total_height == 3);
   }
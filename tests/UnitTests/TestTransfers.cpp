@@ -42,7 +42,7 @@ public:
     generator(m_currency),
     m_node(generator),
     m_sync(m_node, m_currency.genesisBlockHash()),
-    m_transfersSync(m_currency, m_sync, m_node) {
+    m_transfersSync(m_currency, m_logger, m_sync, m_node) {
   }
 
   void addAccounts(size_t count) {
@@ -119,11 +119,12 @@ public:
     CryptoNote::fromBinaryArray(outTx, data);
 
     std::promise<std::error_code> result;
+    auto resultFuture = result.get_future();
     m_node.relayTransaction(outTx, [&result](std::error_code ec) {
       std::promise<std::error_code> detachedPromise = std::move(result);
       detachedPromise.set_value(ec);
     });
-    return result.get_future().get();
+    return resultFuture.get();
   }
 
 protected:
@@ -354,7 +355,7 @@ TEST_F(TransfersApi, state) {
   m_sync.start();
 
   BlockchainSynchronizer bsync2(m_node, m_currency.genesisBlockHash());
-  TransfersSyncronizer sync2(m_currency, bsync2, m_node);
+  TransfersSyncronizer sync2(m_currency, m_logger, bsync2, m_node);
 
   for (size_t i = 0; i < m_accounts.size(); ++i) {
     sync2.addSubscription(createSubscription(i));
@@ -381,6 +382,67 @@ TEST_F(TransfersApi, state) {
   ASSERT_TRUE(compareStates(m_transfersSync, sync2));
 }
 
+TEST_F(TransfersApi, loadedUnconfirmedTransactionIsDeleted) {
+  addMinerAccount();
+  addAccounts(1);
+  subscribeAccounts();
+
+  generator.generateEmptyBlocks(2 * m_currency.minedMoneyUnlockWindow());
+
+  uint64_t sendAmount = (get_outs_money_amount(generator.getBlockchain()[1].baseTransaction) / 4) * 2;
+  auto fee = m_currency.minimumFee();
+
+  startSync();
+
+  auto& tc0 = m_subscriptions[0]->getContainer();
+  uint64_t balance = tc0.balance(ITransfersContainer::IncludeAll);
+
+  auto tx = createMoneyTransfer(sendAmount, fee, m_accounts[0], m_accounts[1].address, tc0);
+  m_node.setNextTransactionToPool();
+  submitTransaction(*tx);
+
+  refreshSync();
+
+  ASSERT_GT(balance, tc0.balance(ITransfersContainer::IncludeAll));
+
+  m_sync.stop();
+  std::stringstream memstm;
+  m_transfersSync.save(memstm);
+
+  BlockchainSynchronizer bsync2(m_node, m_currency.genesisBlockHash());
+  TransfersSyncronizer sync2(m_currency, m_logger, bsync2, m_node);
+
+  for (size_t i = 0; i < m_accounts.size(); ++i) {
+    sync2.addSubscription(createSubscription(i));
+  }
+
+  sync2.load(memstm);
+
+  auto& loaded0 = sync2.getSubscription(m_accounts[0].address)->getContainer();
+  auto& loaded1 = sync2.getSubscription(m_accounts[1].address)->getContainer();
+  ASSERT_EQ(tc0.balance(ITransfersContainer::IncludeAll), loaded0.balance(ITransfersContainer::IncludeAll));
+  ASSERT_EQ(sendAmount, loaded1.balance(ITransfersContainer::IncludeAll));
+
+  // the pool is empty and no blocks are added, so nothing but the deletion touches the loaded containers
+  m_node.cleanTransactionPool();
+
+  syncCompleted = std::promise<std::error_code>();
+  syncCompletedFuture = syncCompleted.get_future();
+  bsync2.addObserver(this);
+  bsync2.start();
+  syncCompletedFuture.get();
+  bsync2.removeObserver(this);
+
+  bsync2.removeUnconfirmedTransaction(tx->getTransactionHash()).get();
+  bsync2.stop();
+
+  TransactionInformation info;
+  ASSERT_FALSE(loaded0.getTransactionInformation(tx->getTransactionHash(), info));
+  ASSERT_FALSE(loaded1.getTransactionInformation(tx->getTransactionHash(), info));
+  ASSERT_EQ(balance, loaded0.balance(ITransfersContainer::IncludeAll));
+  ASSERT_EQ(0, loaded1.balance(ITransfersContainer::IncludeAll));
+}
+
 TEST_F(TransfersApi, sameTrackingKey) {
 
   size_t offset = 2; // miner account + ordinary account
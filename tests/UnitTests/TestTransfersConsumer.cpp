@@ -84,7 +84,7 @@ TransfersConsumerTest::TransfersConsumerTest() :
   m_generator(m_currency),
   m_node(m_generator, true),
   m_accountKeys(generateAccountKeys()),
-  m_consumer(m_currency, m_node, m_accountKeys.viewSecretKey)
+  m_consumer(m_currency, m_node, m_logger, m_accountKeys.viewSecretKey)
 {
 }
 
@@ -411,7 +411,7 @@ TEST_F(TransfersConsumerTest, onNewBlocks_getTransactionOutsGlobalIndicesError)
 
   INodeGlobalIndicesStub node;
 
-  TransfersConsumer consumer(m_currency, node, m_accountKeys.viewSecretKey);
+  TransfersConsumer consumer(m_currency, node, m_logger, m_accountKeys.viewSecretKey);
 
   auto subscription = getAccountSubscriptionWithSyncStart(m_accountKeys, 1234, 10);
 
@@ -530,7 +530,7 @@ TEST_F(TransfersConsumerTest, onNewBlocks_getTransactionOutsGlobalIndicesIsPrope
   };
 
   INodeGlobalIndicesStub node;
-  TransfersConsumer consumer(m_currency, node, m_accountKeys.viewSecretKey);
+  TransfersConsumer consumer(m_currency, node, m_logger, m_accountKeys.viewSecretKey);
 
   AccountSubscription subscription = getAccountSubscription(m_accountKeys);
   subscription.syncStart.height = 0;
@@ -568,7 +568,7 @@ TEST_F(TransfersConsumerTest, onNewBlocks_getTransactionOutsGlobalIndicesIsNotCa
   };
 
   INodeGlobalIndicesStub node;
-  TransfersConsumer consumer(m_currency, node, m_accountKeys.viewSecretKey);
+  TransfersConsumer consumer(m_currency, node, m_logger, m_accountKeys.viewSecretKey);
 
   AccountSubscription subscription = getAccountSubscription(m_accountKeys);
   subscription.syncStart.height = 0;
@@ -638,7 +638,7 @@ TEST_F(TransfersConsumerTest, onNewBlocks_checkTransactionOutputInformation) {
   const uint64_t index = 2;
 
   INodeGlobalIndexStub node;
-  TransfersConsumer consumer(m_currency, node, m_accountKeys.viewSecretKey);
+  TransfersConsumer consumer(m_currency, node, m_logger, m_accountKeys.viewSecretKey);
 
   node.globalIndex = index;
 
@@ -671,7 +671,7 @@ TEST_F(TransfersConsumerTest, onNewBlocks_checkTransactionOutputInformationMulti
   const uint64_t index = 2;
 
   INodeGlobalIndexStub node;
-  TransfersConsumer consumer(m_currency, node, m_accountKeys.viewSecretKey);
+  TransfersConsumer consumer(m_currency, node, m_logger, m_accountKeys.viewSecretKey);
 
   node.globalIndex = index;
 
@@ -892,7 +892,7 @@ TEST_F(TransfersConsumerTest, onPoolUpdated_deleteTransaction) {
     TestTransactionBuilder b1;
     auto unknownSender = generateAccountKeys();
     b1.addTestInput(10000, unknownSender);
-    auto out = b1.addTestKeyOutput(10000, UNCONFIRMED_TRANSACTION_GLOBAL_OUTPUT_INDEX, m_accountKeys);
+    b1.addTestKeyOutput(10000, UNCONFIRMED_TRANSACTION_GLOBAL_OUTPUT_INDEX, m_accountKeys);
 
     auto tx = std::shared_ptr<ITransactionReader>(b1.build().release());
 
@@ -978,6 +978,148 @@ TEST_F(TransfersConsumerTest, onNewBlocks_getsDepositOutputCorrectly) {
   EXPECT_EQ(TERM, transfers[0].term);
 }
 
+std::shared_ptr<ITransactionReader> createSpendingTransaction(const AccountKeys& owner, const TransactionOutputInformation& output) {
+  TestTransactionBuilder builder;
+  builder.addInput(owner, output);
+  builder.addTestKeyOutput(output.amount, UNCONFIRMED_TRANSACTION_GLOBAL_OUTPUT_INDEX);
+  return std::shared_ptr<ITransactionReader>(builder.build().release());
+}
+
+CompleteBlock createBlock(uint64_t timestamp, const std::shared_ptr<ITransactionReader>& tx) {
+  CompleteBlock block;
+  block.block = CryptoNote::Block();
+  block.block->timestamp = timestamp;
+  block.transactions.push_back(tx);
+  return block;
+}
+
+bool containsTransaction(const ITransfersContainer& container, const Crypto::Hash& transactionHash) {
+  TransactionInformation info;
+  return container.getTransactionInformation(transactionHash, info);
+}
+
+TEST_F(TransfersConsumerTest, onNewBlocks_spendReachesOnlyOwner) {
+  auto keys = generateAccount();
+  auto& sub1 = addSubscription();
+  auto& sub2 = addSubscription(keys);
+  TransfersObserver observer2;
+  sub2.addObserver(&observer2);
+
+  TestTransactionBuilder b1;
+  b1.addTestInput(10000);
+  b1.addTestKeyOutput(1000, 0, m_accountKeys);
+  b1.addTestKeyOutput(2000, 1, keys);
+  auto tx1 = std::shared_ptr<ITransactionReader>(b1.build().release());
+
+  CompleteBlock block1 = createBlock(0, tx1);
+  ASSERT_TRUE(m_consumer.onNewBlocks(&block1, 0, 1));
+
+  auto outs = sub1.getContainer().getTransactionOutputs(tx1->getTransactionHash(), ITransfersContainer::IncludeAll);
+  ASSERT_EQ(1, outs.size());
+
+  auto tx2 = createSpendingTransaction(m_accountKeys, outs[0]);
+  CompleteBlock block2 = createBlock(1, tx2);
+  ASSERT_TRUE(m_consumer.onNewBlocks(&block2, 1, 1));
+
+  ASSERT_TRUE(containsTransaction(sub1.getContainer(), tx2->getTransactionHash()));
+  ASSERT_EQ(1, sub1.getContainer().getSpentOutputs().size());
+
+  ASSERT_FALSE(containsTransaction(sub2.getContainer(), tx2->getTransactionHash()));
+  ASSERT_TRUE(sub2.getContainer().getSpentOutputs().empty());
+  ASSERT_EQ(std::vector<Hash>{ tx1->getTransactionHash() }, observer2.updated);
+}
+
+TEST_F(TransfersConsumerTest, onPoolUpdated_unconfirmedSpendReachesOwner) {
+  auto keys = generateAccount();
+  auto& sub1 = addSubscription();
+  auto& sub2 = addSubscription(keys);
+
+  TestTransactionBuilder b1;
+  b1.addTestInput(10000);
+  b1.addTestKeyOutput(1000, 0, m_accountKeys);
+  auto tx1 = std::shared_ptr<ITransactionReader>(b1.build().release());
+
+  CompleteBlock block1 = createBlock(0, tx1);
+  ASSERT_TRUE(m_consumer.onNewBlocks(&block1, 0, 1));
+
+  auto outs = sub1.getContainer().getTransactionOutputs(tx1->getTransactionHash(), ITransfersContainer::IncludeAll);
+  ASSERT_EQ(1, outs.size());
+
+  auto tx2 = createSpendingTransaction(m_accountKeys, outs[0]);
+  std::vector<std::unique_ptr<ITransactionReader>> added;
+  added.push_back(createTransactionPrefix(convertTx(*tx2)));
+  m_consumer.onPoolUpdated(added, {});
+
+  ASSERT_TRUE(containsTransaction(sub1.getContainer(), tx2->getTransactionHash()));
+  ASSERT_EQ(0, sub1.getContainer().balance(ITransfersContainer::IncludeAll));
+  ASSERT_FALSE(containsTransaction(sub2.getContainer(), tx2->getTransactionHash()));
+
+  // dropping the spend from the pool makes the output available again, and it can be spent anew
+  m_consumer.onPoolUpdated({}, { tx2->getTransactionHash() });
+
+  ASSERT_FALSE(containsTransaction(sub1.getContainer(), tx2->getTransactionHash()));
+  ASSERT_EQ(1000, sub1.getContainer().balance(ITransfersContainer::IncludeAll));
+
+  added.clear();
+  added.push_back(createTransactionPrefix(convertTx(*tx2)));
+  m_consumer.onPoolUpdated(added, {});
+  ASSERT_EQ(0, sub1.getContainer().balance(ITransfersContainer::IncludeAll));
+
+  // the confirmation of a transaction held as unconfirmed reaches its holder
+  CompleteBlock block2 = createBlock(1, tx2);
+  ASSERT_TRUE(m_consumer.onNewBlocks(&block2, 1, 1));
+
+  TransactionInformation info;
+  ASSERT_TRUE(sub1.getContainer().getTransactionInformation(tx2->getTransactionHash(), info));
+  ASSERT_EQ(1, info.blockHeight);
+  ASSERT_EQ(1, sub1.getContainer().getSpentOutputs().size());
+  ASSERT_FALSE(containsTransaction(sub2.getContainer(), tx2->getTransactionHash()));
+}
+
+TEST_F(TransfersConsumerTest, onBlockchainDetach_spendIndexRebuiltAfterReorg) {
+  auto keys = generateAccount();
+  auto& sub1 = addSubscription();
+  auto& sub2 = addSubscription(keys);
+
+  TestTransactionBuilder b1;
+  b1.addTestInput(10000);
+  b1.addTestKeyOutput(1000, 0, m_accountKeys);
+  b1.addTestKeyOutput(2000, 1, keys);
+  auto tx1 = std::shared_ptr<ITransactionReader>(b1.build().release());
+
+  CompleteBlock block1 = createBlock(0, tx1);
+  ASSERT_TRUE(m_consumer.onNewBlocks(&block1, 0, 1));
+
+  auto out1 = sub1.getContainer().getTransactionOutputs(tx1->getTransactionHash(), ITransfersContainer::IncludeAll);
+  auto out2 = sub2.getContainer().getTransactionOutputs(tx1->getTransactionHash(), ITransfersContainer::IncludeAll);
+  ASSERT_EQ(1, out1.size());
+  ASSERT_EQ(1, out2.size());
+
+  auto tx2 = createSpendingTransaction(m_accountKeys, out1[0]);
+  CompleteBlock block2 = createBlock(1, tx2);
+  ASSERT_TRUE(m_consumer.onNewBlocks(&block2, 1, 1));
+  ASSERT_EQ(1, sub1.getContainer().getSpentOutputs().size());
+
+  m_consumer.onBlockchainDetach(1);
+  ASSERT_FALSE(containsTransaction(sub1.getContainer(), tx2->getTransactionHash()));
+  ASSERT_TRUE(sub1.getContainer().getSpentOutputs().empty());
+
+  // a new subscription makes the consumer rebuild its spend index from the detached containers
+  addSubscription(generateAccount());
+
+  auto tx3 = createSpendingTransaction(keys, out2[0]);
+  CompleteBlock blocks[2] = { createBlock(1, tx3), createBlock(2, tx2) };
+  ASSERT_TRUE(m_consumer.onNewBlocks(&blocks[0], 1, 2));
+
+  ASSERT_TRUE(containsTransaction(sub1.getContainer(), tx2->getTransactionHash()));
+  ASSERT_FALSE(containsTransaction(sub1.getContainer(), tx3->getTransactionHash()));
+  ASSERT_EQ(1, sub1.getContainer().getSpentOutputs().size());
+
+  ASSERT_TRUE(containsTransaction(sub2.getContainer(), tx3->getTransactionHash()));
+  ASSERT_FALSE(containsTransaction(sub2.getContainer(), tx2->getTransactionHash()));
+  ASSERT_EQ(1, sub2.getContainer().getSpentOutputs().size());
+}
+
 
 class AutoTimer {
 public:
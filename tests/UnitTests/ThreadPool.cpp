@@ -0,0 +1,125 @@
+// Copyright (c) 2011-2016 The Cryptonote developers
+// Copyright (c) 2014-2016 SDN developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <gtest/gtest.h>
+#include "Common/ThreadPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace Tools;
+
+namespace {
+
+// Runs func on a separate thread and reports whether it finished within the timeout,
+// so that a deadlock fails the test instead of hanging the whole run. The thread is
+// left running on a timeout, so func must own everything it uses.
+template<typename F>
+bool finishesWithin(std::chrono::seconds timeout, F func) {
+  auto result = std::make_shared<std::promise<void>>();
+  std::future<void> done = result->get_future();
+  std::thread([result, func] {
+    func();
+    result->set_value();
+  }).detach();
+
+  return done.wait_for(timeout) == std::future_status::ready;
+}
+
+}
+
+TEST(ThreadPool, ParallelForEmptyRangeDoesNotCallFunc) {
+  ThreadPool pool(4);
+  std::atomic<size_t> calls(0);
+
+  pool.parallelFor(0, [&calls](size_t) { ++calls; });
+
+  ASSERT_EQ(0, calls.load());
+}
+
+TEST(ThreadPool, ParallelForRangeSmallerThanThreadCount) {
+  ThreadPool pool(8);
+  std::vector<std::atomic<size_t>> calls(3);
+  for (auto& c : calls) {
+    c = 0;
+  }
+
+  pool.parallelFor(calls.size(), [&calls](size_t i) { ++calls[i]; });
+
+  for (auto& c : calls) {
+    ASSERT_EQ(1, c.load());
+  }
+}
+
+TEST(ThreadPool, ParallelForCallsEveryIndexOnce) {
+  ThreadPool pool(4);
+  std::vector<std::atomic<size_t>> calls(1000);
+  for (auto& c : calls) {
+    c = 0;
+  }
+
+  pool.parallelFor(calls.size(), [&calls](size_t i) { ++calls[i]; });
+
+  for (auto& c : calls) {
+    ASSERT_EQ(1, c.load());
+  }
+}
+
+TEST(ThreadPool, ParallelForRethrowsException) {
+  ThreadPool pool(4);
+
+  ASSERT_THROW(pool.parallelFor(100, [](size_t i) {
+    if (i == 42) {
+      throw std::runtime_error("failure");
+    }
+  }), std::runtime_error);
+}
+
+TEST(ThreadPool, ParallelForUsableAfterException) {
+  ThreadPool pool(4);
+  ASSERT_ANY_THROW(pool.parallelFor(10, [](size_t) { throw std::runtime_error("failure"); }));
+
+  std::atomic<size_t> calls(0);
+  pool.parallelFor(10, [&calls](size_t) { ++calls; });
+
+  ASSERT_EQ(10, calls.load());
+}
+
+TEST(ThreadPool, NestedParallelForFromWorkerDoesNotDeadlock) {
+  auto pool = std::make_shared<ThreadPool>(1);
+  auto calls = std::make_shared<std::atomic<size_t>>(0);
+
+  ASSERT_TRUE(finishesWithin(std::chrono::seconds(10), [pool, calls] {
+    pool->parallelFor(4, [&pool, &calls](size_t) {
+      pool->parallelFor(4, [&calls](size_t) { ++*calls; });
+    });
+  }));
+
+  ASSERT_EQ(16, calls->load());
+}
+
+TEST(ThreadPool, NestedParallelForFromEveryWorkerDoesNotDeadlock) {
+  auto pool = std::make_shared<ThreadPool>(4);
+  auto calls = std::make_shared<std::atomic<size_t>>(0);
+
+  ASSERT_TRUE(finishesWithin(std::chrono::seconds(10), [pool, calls] {
+    pool->parallelFor(64, [&pool, &calls](size_t) {
+      pool->parallelFor(64, [&calls](size_t) { ++*calls; });
+    });
+  }));
+
+  ASSERT_EQ(64 * 64, calls->load());
+}
+
+TEST(ThreadPool, SubmitReturnsResult) {
+  ThreadPool pool(2);
+
+  ASSERT_EQ(42, pool.submit([] { return 42; }).get());
+}
@@ -6,10 +6,15 @@
 #include "gtest/gtest.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
 
 #include <boost/filesystem/operations.hpp>
 
 #include "CryptoNoteCore/Account.h"
+#include "CryptoNoteCore/BlockchainIndices.h"
 #include "CryptoNoteCore/CryptoNoteFormatUtils.h"
 #include "CryptoNoteCore/CryptoNoteTools.h"
 #include "CryptoNoteCore/Currency.h"
@@ -76,7 +81,7 @@ public:
     {
       m_miners[i].generate();
 
-      if (!m_currency.constructMinerTx(0, 0, 0, 2, 0, m_miners[i].getAccountKeys().address, m_miner_txs[i])) {
+      if (!m_currency.constructMinerTx(BLOCK_MAJOR_VERSION_1, 0, 0, 0, 2, 0, m_miners[i].getAccountKeys().address, m_miner_txs[i])) {
         return false;
       }
 
@@ -111,7 +116,8 @@ public:
       destinations.push_back(TransactionDestinationEntry(amountPerOut, rv_acc.getAccountKeys().address));
     }
 
-    constructTransaction(m_realSenderKeys, m_sources, destinations, std::vector<uint8_t>(), tx, 0, m_logger);
+    Crypto::SecretKey txSecretKey;
+    constructTransaction(m_realSenderKeys, m_sources, destinations, std::vector<uint8_t>(), tx, 0, m_logger, txSecretKey);
   }
 
   std::vector<AccountBase> m_miners;
@@ -291,8 +297,9 @@ TEST_F(tx_pool, fillblock_same_fee)
   size_t totalSize = 0;
   uint64_t txFee = 0;
   uint64_t median = 5000;
+  uint32_t height = 0;
 
-  ASSERT_TRUE(pool.fill_block_template(bl, median, textMaxCumulativeSize, 0, totalSize, txFee));
+  ASSERT_TRUE(pool.fill_block_template(bl, median, textMaxCumulativeSize, 0, totalSize, txFee, height));
   ASSERT_TRUE(totalSize * 100 < median * 125);
 
   // now, check that the block is opimally filled
@@ -325,7 +332,7 @@ TEST_F(tx_pool, fillblock_same_size)
 
 
   // generate transactions
-  for (int i = 0; i <= totalTransactions; ++i) {
+  for (size_t i = 0; i <= totalTransactions; ++i) {
 
     TestTransactionGenerator txGenerator(currency, 1);
     txGenerator.createSources();
@@ -351,8 +358,9 @@ TEST_F(tx_pool, fillblock_same_size)
   size_t totalSize = 0;
   uint64_t txFee = 0;
   uint64_t median = 5000;
+  uint32_t height = 0;
 
-  ASSERT_TRUE(pool.fill_block_template(bl, median, textMaxCumulativeSize, 0, totalSize, txFee));
+  ASSERT_TRUE(pool.fill_block_template(bl, median, textMaxCumulativeSize, 0, totalSize, txFee, height));
   ASSERT_TRUE(totalSize * 100 < median * 125);
 
   // check that fill_block_template prefers transactions with double fee
@@ -763,7 +771,8 @@ public:
     Block block;
     size_t totalSize;
     uint64_t totalFee;
-    ASSERT_TRUE(pool->fill_block_template(block, currency.blockGrantedFullRewardZone(), std::numeric_limits<size_t>::max(), 0, totalSize, totalFee));
+    uint32_t height = 0;
+    ASSERT_TRUE(pool->fill_block_template(block, currency.blockGrantedFullRewardZone(), std::numeric_limits<size_t>::max(), 0, totalSize, totalFee, height));
 
     size_t fusionTxCount = 0;
     size_t ordinaryTxCount = 0;
@@ -805,3 +814,406 @@ TEST_F(TxPool_FillBlockTemplate, TxPoolContinuesToAddOrdinaryTransactionsUpTo125
     TEST_MAX_TX_COUNT_PER_BLOCK - fusionTxCount,
     fusionTxCount));
 }
+
+namespace {
+
+// Models the main chain for the ready check the way Blockchain does: a failure is remembered by the block it was
+// found at, and a transaction is not checked again while that block stays in the chain.
+class LockedInputsTransactionValidator : public TransactionValidator {
+public:
+  uint32_t chainHeight = 0;
+  uint32_t unlockHeight = 0;
+
+  static Crypto::Hash blockId(uint32_t height) {
+    Crypto::Hash id = NULL_HASH;
+    *reinterpret_cast<uint32_t*>(id.data) = height + 1;
+    return id;
+  }
+
+  virtual bool checkTransactionInputs(const CryptoNote::Transaction& tx, BlockInfo& maxUsedBlock, BlockInfo& lastFailed) override {
+    if (maxUsedBlock.empty() && !lastFailed.empty() && chainHeight > lastFailed.height && blockId(lastFailed.height) == lastFailed.id) {
+      return false;
+    }
+
+    if (chainHeight < unlockHeight) {
+      lastFailed.height = chainHeight - 1;
+      lastFailed.id = blockId(lastFailed.height);
+      return false;
+    }
+
+    maxUsedBlock.height = chainHeight - 1;
+    maxUsedBlock.id = blockId(maxUsedBlock.height);
+    return true;
+  }
+};
+
+}
+
+TEST_F(tx_pool, TransactionWithLockedInputsEntersBlockTemplateOnceUnlocked) {
+  LockedInputsTransactionValidator validator;
+  FakeTimeProvider timeProvider;
+  tx_memory_pool pool(currency, validator, timeProvider, logger);
+
+  Transaction tx;
+  GenerateTransaction(currency, tx, currency.minimumFee(), 1);
+  tx_verification_context tvc = boost::value_initialized<tx_verification_context>();
+  ASSERT_TRUE(pool.add_tx(tx, tvc, false, 0));
+
+  validator.chainHeight = 10;
+  validator.unlockHeight = 12;
+
+  auto fillTemplate = [&](Block& block) {
+    InitBlock(block);
+    block.previousBlockHash = LockedInputsTransactionValidator::blockId(validator.chainHeight - 1);
+    size_t totalSize;
+    uint64_t totalFee;
+    uint32_t height = validator.chainHeight;
+    return pool.fill_block_template(block, currency.blockGrantedFullRewardZone(), textMaxCumulativeSize, 0, totalSize, totalFee, height);
+  };
+
+  Block block;
+  ASSERT_TRUE(fillTemplate(block));
+  ASSERT_TRUE(block.transactionHashes.empty());
+
+  validator.chainHeight = 11;
+  ASSERT_TRUE(fillTemplate(block));
+  ASSERT_TRUE(block.transactionHashes.empty());
+
+  validator.chainHeight = 12;
+  ASSERT_TRUE(fillTemplate(block));
+  ASSERT_EQ(1, block.transactionHashes.size());
+  ASSERT_EQ(getObjectHash(tx), block.transactionHashes.front());
+}
+
+namespace {
+
+// Waits for the condition for at most ten seconds, so that a lost wakeup fails the test instead of hanging it.
+bool waitUntil(const std::function<bool()>& condition) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (!condition()) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+
+    std::this_thread::yield();
+  }
+
+  return true;
+}
+
+class CountingTransactionValidator : public TransactionValidator {
+public:
+  std::atomic<size_t> inputChecks{0};
+  std::function<void()> onCheckInputs;
+
+  virtual bool checkTransactionInputs(const CryptoNote::Transaction& tx, BlockInfo& maxUsedBlock) override {
+    ++inputChecks;
+    if (onCheckInputs) {
+      onCheckInputs();
+    }
+
+    return true;
+  }
+};
+
+}
+
+TEST_F(tx_pool, ConcurrentConflictingAdmissionsAcceptOnlyOne) {
+  TestTransactionGenerator txGenerator(currency, 1);
+  ASSERT_TRUE(txGenerator.createSources());
+
+  Transaction tx;
+  Transaction txDouble;
+  txGenerator.construct(txGenerator.m_source_amount, currency.minimumFee(), 1, tx);
+  txGenerator.rv_acc.generate();
+  txGenerator.construct(txGenerator.m_source_amount, currency.minimumFee(), 1, txDouble);
+
+  CountingTransactionValidator validator;
+  FakeTimeProvider timeProvider;
+  tx_memory_pool pool(currency, validator, timeProvider, logger);
+
+  // each admission is held in its input check until the other one got there too,
+  // so both have passed the conflict check made before it
+  std::atomic<size_t> checking(0);
+  validator.onCheckInputs = [&checking] {
+    ++checking;
+    waitUntil([&checking] { return checking == 2; });
+  };
+
+  tx_verification_context tvc = boost::value_initialized<tx_verification_context>();
+  tx_verification_context tvcDouble = boost::value_initialized<tx_verification_context>();
+  bool added = false;
+  std::thread other([&] { added = pool.add_tx(tx, tvc, false, 0); });
+  bool addedDouble = pool.add_tx(txDouble, tvcDouble, false, 0);
+  other.join();
+
+  ASSERT_EQ(2, validator.inputChecks);
+  ASSERT_NE(added, addedDouble);
+  ASSERT_NE(tvc.m_added_to_pool, tvcDouble.m_added_to_pool);
+  ASSERT_NE(tvc.m_verification_failed, tvcDouble.m_verification_failed);
+  ASSERT_EQ(1, pool.get_transactions_count());
+}
+
+TEST_F(tx_pool, ConcurrentAdmissionsOfSameTransactionCheckItOnce) {
+  TestTransactionGenerator txGenerator(currency, 1);
+  ASSERT_TRUE(txGenerator.createSources());
+
+  Transaction tx;
+  txGenerator.construct(txGenerator.m_source_amount, currency.minimumFee(), 1, tx);
+
+  CountingTransactionValidator validator;
+  FakeTimeProvider timeProvider;
+  tx_memory_pool pool(currency, validator, timeProvider, logger);
+
+  std::atomic<bool> checking(false);
+  std::atomic<bool> duplicateDone(false);
+  validator.onCheckInputs = [&checking, &duplicateDone] {
+    checking = true;
+    waitUntil([&duplicateDone] { return duplicateDone.load(); });
+  };
+
+  tx_verification_context tvc = boost::value_initialized<tx_verification_context>();
+  bool added = false;
+  std::thread first([&] { added = pool.add_tx(tx, tvc, false, 0); });
+
+  EXPECT_TRUE(waitUntil([&checking] { return checking.load(); }));
+  tx_verification_context tvcDuplicate = boost::value_initialized<tx_verification_context>();
+  bool addedDuplicate = pool.add_tx(tx, tvcDuplicate, false, 0);
+  duplicateDone = true;
+  first.join();
+
+  ASSERT_TRUE(addedDuplicate);
+  ASSERT_FALSE(tvcDuplicate.m_added_to_pool);
+  ASSERT_FALSE(tvcDuplicate.m_should_be_relayed);
+  ASSERT_FALSE(tvcDuplicate.m_verification_failed);
+
+  ASSERT_TRUE(added);
+  ASSERT_TRUE(tvc.m_added_to_pool);
+  ASSERT_FALSE(tvc.m_verification_failed);
+  ASSERT_EQ(1, validator.inputChecks);
+  ASSERT_EQ(1, pool.get_transactions_count());
+}
+
+namespace {
+
+Crypto::Hash makeTestId(uint8_t n) {
+  Crypto::Hash id = NULL_HASH;
+  id.data[0] = n;
+  return id;
+}
+
+std::vector<Crypto::Hash> priorityOrder(const TransactionPriorityIndex& index) {
+  std::vector<Crypto::Hash> ids;
+  index.forEach([&ids](const TransactionPriorityIndex::Entry& entry) { ids.push_back(entry.id); });
+  return ids;
+}
+
+}
+
+TEST(TransactionPriorityIndex, OrdersByFeeRateThenSizeThenAge) {
+  TransactionPriorityIndex index;
+  ASSERT_TRUE(index.add(makeTestId(1), 1000, 100, 10)); // 10 per byte
+  ASSERT_TRUE(index.add(makeTestId(2), 2010, 200, 10)); // 10.05 per byte, same whole rate
+  ASSERT_TRUE(index.add(makeTestId(3), 4000, 200, 10)); // 20 per byte
+  ASSERT_TRUE(index.add(makeTestId(4), 500, 50, 10));   // 10 per byte, smaller
+  ASSERT_TRUE(index.add(makeTestId(5), 1000, 100, 5));  // 10 per byte, older
+  ASSERT_TRUE(index.add(makeTestId(6), 0, 100, 1));
+
+  std::vector<Crypto::Hash> expected{ makeTestId(3), makeTestId(2), makeTestId(4), makeTestId(5), makeTestId(1), makeTestId(6) };
+  ASSERT_EQ(expected, priorityOrder(index));
+  ASSERT_EQ(6, index.size());
+}
+
+TEST(TransactionPriorityIndex, ForEachReverseVisitsLeastPreferredFirstAndStops) {
+  TransactionPriorityIndex index;
+  for (uint8_t i = 1; i <= 5; ++i) {
+    ASSERT_TRUE(index.add(makeTestId(i), i * 1000, 100, 0));
+  }
+
+  std::vector<Crypto::Hash> visited;
+  index.forEachReverse([&visited](const TransactionPriorityIndex::Entry& entry) {
+    visited.push_back(entry.id);
+    return visited.size() < 3;
+  });
+
+  std::vector<Crypto::Hash> expected{ makeTestId(1), makeTestId(2), makeTestId(3) };
+  ASSERT_EQ(expected, visited);
+}
+
+TEST(TransactionPriorityIndex, EqualEntriesKeepInsertionOrderAndRemoveById) {
+  TransactionPriorityIndex index;
+  for (uint8_t i = 1; i <= 4; ++i) {
+    ASSERT_TRUE(index.add(makeTestId(i), 1000, 100, 7));
+  }
+
+  ASSERT_TRUE(index.remove(makeTestId(3), 1000, 100, 7));
+  ASSERT_FALSE(index.remove(makeTestId(3), 1000, 100, 7));
+  ASSERT_FALSE(index.remove(makeTestId(1), 1000, 100, 8));
+
+  std::vector<Crypto::Hash> expected{ makeTestId(1), makeTestId(2), makeTestId(4) };
+  ASSERT_EQ(expected, priorityOrder(index));
+  ASSERT_EQ(3, index.size());
+}
+
+TEST(TransactionPriorityIndex, MatchesSortByFeePerByte) {
+  struct Tx {
+    Crypto::Hash id;
+    uint64_t fee;
+    uint64_t blobSize;
+    uint64_t receiveTime;
+  };
+
+  std::vector<Tx> txs;
+  TransactionPriorityIndex index;
+  uint64_t seed = 12345;
+  for (uint8_t i = 0; i < 200; ++i) {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    Tx tx{ makeTestId(i), (seed >> 33) % 5000, 100 + (seed >> 20) % 900, (seed >> 8) % 16 };
+    txs.push_back(tx);
+    ASSERT_TRUE(index.add(tx.id, tx.fee, tx.blobSize, tx.receiveTime));
+  }
+
+  for (size_t i = 0; i < txs.size(); i += 3) {
+    ASSERT_TRUE(index.remove(txs[i].id, txs[i].fee, txs[i].blobSize, txs[i].receiveTime));
+    txs[i].blobSize = 0;
+  }
+
+  txs.erase(std::remove_if(txs.begin(), txs.end(), [](const Tx& tx) { return tx.blobSize == 0; }), txs.end());
+  std::stable_sort(txs.begin(), txs.end(), [](const Tx& lhs, const Tx& rhs) {
+    return lhs.fee * rhs.blobSize > rhs.fee * lhs.blobSize ||
+      (lhs.fee * rhs.blobSize == rhs.fee * lhs.blobSize && lhs.blobSize < rhs.blobSize) ||
+      (lhs.fee * rhs.blobSize == rhs.fee * lhs.blobSize && lhs.blobSize == rhs.blobSize && lhs.receiveTime < rhs.receiveTime);
+  });
+
+  std::vector<Crypto::Hash> expected;
+  for (const Tx& tx : txs) {
+    expected.push_back(tx.id);
+  }
+
+  ASSERT_EQ(expected, priorityOrder(index));
+  ASSERT_EQ(expected.size(), index.size());
+}
+
+namespace {
+
+class TxPoolEviction : public tx_pool {
+public:
+  TxPoolEviction() : pool(currency, validator, timeProvider, logger) {
+  }
+
+  Transaction makeTransaction(uint64_t fee) {
+    Transaction tx;
+    GenerateTransaction(currency, tx, fee, 1);
+    return tx;
+  }
+
+  bool addTransaction(const Transaction& tx, bool keptByBlock, tx_verification_context& tvc) {
+    tvc = boost::value_initialized<tx_verification_context>();
+    return pool.add_tx(tx, tvc, keptByBlock, 0);
+  }
+
+  bool haveTransaction(const Transaction& tx) {
+    return pool.have_tx(getObjectHash(tx));
+  }
+
+  TransactionValidator validator;
+  FakeTimeProvider timeProvider;
+  tx_memory_pool pool;
+};
+
+}
+
+TEST_F(TxPoolEviction, EvictsLeastPreferredTransactionFirst) {
+  Transaction low = makeTransaction(currency.minimumFee());
+  Transaction high = makeTransaction(3 * currency.minimumFee());
+  Transaction middle = makeTransaction(2 * currency.minimumFee());
+  pool.setMaxSize(getObjectBinarySize(low) + getObjectBinarySize(high) + getObjectBinarySize(middle) - 1);
+
+  tx_verification_context tvc;
+  ASSERT_TRUE(addTransaction(low, false, tvc));
+  ASSERT_TRUE(addTransaction(high, false, tvc));
+  ASSERT_TRUE(addTransaction(middle, false, tvc));
+  ASSERT_TRUE(tvc.m_added_to_pool);
+
+  ASSERT_FALSE(haveTransaction(low));
+  ASSERT_TRUE(haveTransaction(high));
+  ASSERT_TRUE(haveTransaction(middle));
+  ASSERT_EQ(2, pool.getStatistics().transactionsCount);
+  ASSERT_EQ(1, pool.getStatistics().evictedCount);
+  ASSERT_EQ(getObjectBinarySize(high) + getObjectBinarySize(middle), pool.getStatistics().size);
+}
+
+TEST_F(TxPoolEviction, AddedTransactionThatIsLeastPreferredIsNotKept) {
+  Transaction high = makeTransaction(3 * currency.minimumFee());
+  Transaction low = makeTransaction(currency.minimumFee());
+  pool.setMaxSize(getObjectBinarySize(high));
+
+  tx_verification_context tvc;
+  ASSERT_TRUE(addTransaction(high, false, tvc));
+  addTransaction(low, false, tvc);
+
+  ASSERT_FALSE(tvc.m_added_to_pool);
+  ASSERT_FALSE(tvc.m_should_be_relayed);
+  ASSERT_FALSE(haveTransaction(low));
+  ASSERT_TRUE(haveTransaction(high));
+}
+
+TEST_F(TxPoolEviction, SkipsTransactionsKeptByBlock) {
+  Transaction kept = makeTransaction(currency.minimumFee());
+  Transaction low = makeTransaction(2 * currency.minimumFee());
+  Transaction high = makeTransaction(3 * currency.minimumFee());
+  pool.setMaxSize(getObjectBinarySize(kept) + getObjectBinarySize(high));
+
+  tx_verification_context tvc;
+  ASSERT_TRUE(addTransaction(kept, true, tvc));
+  ASSERT_TRUE(addTransaction(low, false, tvc));
+  ASSERT_TRUE(addTransaction(high, false, tvc));
+
+  ASSERT_TRUE(haveTransaction(kept));
+  ASSERT_FALSE(haveTransaction(low));
+  ASSERT_TRUE(haveTransaction(high));
+  ASSERT_EQ(1, pool.getStatistics().evictedCount);
+}
+
+TEST_F(TxPoolEviction, EvictedTransactionIsRejectedWhenAddedAgain) {
+  Transaction low = makeTransaction(currency.minimumFee());
+  Transaction high = makeTransaction(3 * currency.minimumFee());
+  pool.setMaxSize(getObjectBinarySize(high));
+
+  tx_verification_context tvc;
+  ASSERT_TRUE(addTransaction(low, false, tvc));
+  ASSERT_TRUE(addTransaction(high, false, tvc));
+  ASSERT_FALSE(haveTransaction(low));
+
+  pool.setMaxSize(std::numeric_limits<uint64_t>::max());
+  ASSERT_TRUE(addTransaction(low, false, tvc));
+  ASSERT_FALSE(tvc.m_added_to_pool);
+  ASSERT_FALSE(tvc.m_should_be_relayed);
+  ASSERT_FALSE(haveTransaction(low));
+  ASSERT_EQ(1, pool.getStatistics().transactionsCount);
+}
+
+TEST_F(TxPoolEviction, SizeReturnsToZeroAfterAllTransactionsAreRemoved) {
+  std::vector<Transaction> txs;
+  for (uint64_t i = 1; i <= 4; ++i) {
+    txs.push_back(makeTransaction(i * currency.minimumFee()));
+  }
+
+  pool.setMaxSize(getObjectBinarySize(txs[0]) + getObjectBinarySize(txs[1]) + getObjectBinarySize(txs[2]));
+
+  tx_verification_context tvc;
+  for (const Transaction& tx : txs) {
+    ASSERT_TRUE(addTransaction(tx, false, tvc));
+  }
+
+  ASSERT_EQ(3, pool.getStatistics().transactionsCount);
+  for (const Transaction& tx : txs) {
+    Transaction taken;
+    size_t blobSize;
+    uint64_t fee;
+    pool.take_tx(getObjectHash(tx), taken, blobSize, fee);
+  }
+
+  ASSERT_EQ(0, pool.getStatistics().transactionsCount);
+  ASSERT_EQ(0, pool.getStatistics().size);
+}